@@ -2,15 +2,29 @@ add_library(consumer_v00_lib STATIC)
 target_sources(consumer_v00_lib
 	PUBLIC 
 	${PROJECT_SOURCE_DIR}/src/consumer_lib.cpp
+	${PROJECT_SOURCE_DIR}/src/consumer_patterns_lib.cpp
+	${PROJECT_SOURCE_DIR}/src/consumer_sharded_lib.cpp
+	${PROJECT_SOURCE_DIR}/src/consumer_latency_lib.cpp
 	PRIVATE 
+	${PROJECT_SOURCE_DIR}/src/clock_lib.cpp
 	${PROJECT_SOURCE_DIR}/src/v00/transport_lib.cpp
+	${PROJECT_SOURCE_DIR}/src/v01/transport_lib.cpp
+	${PROJECT_SOURCE_DIR}/src/json/transport_lib.cpp
 	${PROJECT_SOURCE_DIR}/src/v00/neutrino_frames_serialized_network_bo.cpp
 	${PROJECT_SOURCE_DIR}/src/shared_lib.cpp
+	${PROJECT_SOURCE_DIR}/src/transport/endpoint_framed.cpp
 )
-if(TARGET_WIN32)
+if(TARGET_POSIX)
 	target_sources(consumer_v00_lib
 		PRIVATE 
-		${PROJECT_SOURCE_DIR}/src/v00/neutrino_frames_serialized_network_bo_win32.cpp
+		${PROJECT_SOURCE_DIR}/src/transport/endpoint_shm_ring_posix.cpp
+		${PROJECT_SOURCE_DIR}/src/transport/endpoint_socket_posix.cpp
+		${PROJECT_SOURCE_DIR}/src/transport/endpoint_journal_posix.cpp
 	)
 endif()
 target_include_directories(consumer_v00_lib PRIVATE ${PROJECT_SOURCE_DIR}/include)
+target_link_libraries(consumer_v00_lib PUBLIC Threads::Threads)
+if(TARGET_POSIX AND NOT APPLE)
+	#shm_open lives in librt before glibc 2.34
+	target_link_libraries(consumer_v00_lib PUBLIC rt)
+endif()
@@ -3,14 +3,21 @@ target_sources(producer_v00_lib
 	PUBLIC 
 	${PROJECT_SOURCE_DIR}/src/producer_lib.cpp
 	PRIVATE 
+	${PROJECT_SOURCE_DIR}/src/clock_lib.cpp
 	${PROJECT_SOURCE_DIR}/src/v00/transport_lib.cpp
+	${PROJECT_SOURCE_DIR}/src/v01/transport_lib.cpp
+	${PROJECT_SOURCE_DIR}/src/json/transport_lib.cpp
 	${PROJECT_SOURCE_DIR}/src/v00/neutrino_frames_serialized_network_bo.cpp
 	${PROJECT_SOURCE_DIR}/src/shared_lib.cpp
+	${PROJECT_SOURCE_DIR}/src/transport/endpoint_framed.cpp
 )
-if(TARGET_WIN32)
+if(TARGET_POSIX)
 	target_sources(producer_v00_lib
 		PRIVATE 
-		${PROJECT_SOURCE_DIR}/src/v00/neutrino_frames_serialized_network_bo_win32.cpp
+		${PROJECT_SOURCE_DIR}/src/transport/endpoint_shm_ring_posix.cpp
+		${PROJECT_SOURCE_DIR}/src/transport/endpoint_async_posix_handle.cpp
+		${PROJECT_SOURCE_DIR}/src/transport/endpoint_socket_posix.cpp
+		${PROJECT_SOURCE_DIR}/src/transport/endpoint_journal_posix.cpp
 	)
 endif()
 
@@ -18,6 +25,9 @@ if(USE_MT)
 target_sources(producer_v00_lib
 	PUBLIC 
 	${PROJECT_SOURCE_DIR}/src/transport/consumer_stub_buffered_mt.cpp
+	${PROJECT_SOURCE_DIR}/src/transport/consumer_stub_buffered_per_thread.cpp
+	${PROJECT_SOURCE_DIR}/src/transport/consumer_stub_buffered_sharded.cpp
+	${PROJECT_SOURCE_DIR}/src/transport/consumer_stub_buffered_flush_scheduler.cpp
 )
 else()
 target_sources(producer_v00_lib
@@ -27,3 +37,8 @@ target_sources(producer_v00_lib
 endif()
 
 target_include_directories(producer_v00_lib PRIVATE ${PROJECT_SOURCE_DIR}/include)
+target_link_libraries(producer_v00_lib PUBLIC Threads::Threads)
+if(TARGET_POSIX AND NOT APPLE)
+	#shm_open lives in librt before glibc 2.34
+	target_link_libraries(producer_v00_lib PUBLIC rt)
+endif()
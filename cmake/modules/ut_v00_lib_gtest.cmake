@@ -1,9 +1,11 @@
 add_executable(ut_v00_lib_gtest)
 
-target_link_options(ut_v00_lib_gtest 
-	PRIVATE
-		"/PROFILE"
-)
+if(MSVC)
+	target_link_options(ut_v00_lib_gtest 
+		PRIVATE
+			"/PROFILE"
+	)
+endif()
 
 get_target_property(producer_v00_lib_SOURCES producer_v00_lib INTERFACE_SOURCES)
 get_target_property(consumer_v00_lib_SOURCES consumer_v00_lib INTERFACE_SOURCES)
@@ -12,17 +14,27 @@ target_sources(ut_v00_lib_gtest
 		${producer_v00_lib_SOURCES}
 		${consumer_v00_lib_SOURCES}
 		${PROJECT_SOURCE_DIR}/src/shared_lib.cpp
+		${PROJECT_SOURCE_DIR}/src/clock_lib.cpp
 		${PROJECT_SOURCE_DIR}/src/v00/transport_lib.cpp
+		${PROJECT_SOURCE_DIR}/src/v00/neutrino_frames_serialized_network_bo.cpp
+		${PROJECT_SOURCE_DIR}/src/v01/transport_lib.cpp
+		${PROJECT_SOURCE_DIR}/src/transport/endpoint_framed.cpp
+		${PROJECT_SOURCE_DIR}/src/json/transport_lib.cpp
 		${PROJECT_SOURCE_DIR}/src/ut/mock_lib.cpp
 		${PROJECT_SOURCE_DIR}/src/ut/gtest_main.cpp
 		${PROJECT_SOURCE_DIR}/src/v00/ut_lib_gtest.cpp
+		${PROJECT_SOURCE_DIR}/src/v01/ut_lib_gtest.cpp
+		${PROJECT_SOURCE_DIR}/src/json/ut_lib_gtest.cpp
 		${PROJECT_SOURCE_DIR}/src/transport/ut_lib_gtest.cpp
 		${PROJECT_SOURCE_DIR}/src/ut_lib_gtest.cpp
 )
-if(TARGET_WIN32)
+if(TARGET_POSIX)
 	target_sources(ut_v00_lib_gtest
 		PRIVATE 
-		${PROJECT_SOURCE_DIR}/src/v00/neutrino_frames_serialized_network_bo_win32.cpp
+		${PROJECT_SOURCE_DIR}/src/transport/endpoint_shm_ring_posix.cpp
+		${PROJECT_SOURCE_DIR}/src/transport/endpoint_async_posix_handle.cpp
+		${PROJECT_SOURCE_DIR}/src/transport/endpoint_socket_posix.cpp
+		${PROJECT_SOURCE_DIR}/src/transport/endpoint_journal_posix.cpp
 	)
 endif()
 
@@ -30,6 +42,9 @@ if(USE_MT)
 target_sources(ut_v00_lib_gtest
 	PUBLIC 
 	${PROJECT_SOURCE_DIR}/src/transport/consumer_stub_buffered_mt.cpp
+	${PROJECT_SOURCE_DIR}/src/transport/consumer_stub_buffered_per_thread.cpp
+	${PROJECT_SOURCE_DIR}/src/transport/consumer_stub_buffered_sharded.cpp
+	${PROJECT_SOURCE_DIR}/src/transport/consumer_stub_buffered_flush_scheduler.cpp
 	${PROJECT_SOURCE_DIR}/src/transport/consumer_stub_buffered_st.cpp
 )
 else()
@@ -47,6 +62,11 @@ target_link_libraries(ut_v00_lib_gtest
 		#GTest::gmock 
 		#GTest::gmock_main
 )
+target_link_libraries(ut_v00_lib_gtest PRIVATE Threads::Threads)
+if(TARGET_POSIX AND NOT APPLE)
+	target_link_libraries(ut_v00_lib_gtest PRIVATE rt)
+endif()
+file(MAKE_DIRECTORY ${CMAKE_BINARY_DIR}/gtest)
 gtest_discover_tests(ut_v00_lib_gtest
 	WORKING_DIRECTORY ${CMAKE_BINARY_DIR}/gtest
 )
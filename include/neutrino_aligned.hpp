@@ -0,0 +1,70 @@
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <new>
+#include <utility>
+
+namespace neutrino
+{
+    namespace impl
+    {
+        // storage for types with alignas over the alignment of new (cache line separated members):
+        // operator new and std::allocator do not honor it before C++17 (MSVC without /Zc:alignedNew),
+        // the object is placed by hand, the pointer new returned is kept in front of it.
+        // Every over-aligned type the library allocates goes through it.
+        template <typename T>
+        struct aligned_allocator_t
+        {
+            typedef T value_type;
+
+            aligned_allocator_t() = default;
+            template <typename U>
+            aligned_allocator_t(const aligned_allocator_t<U>&) {}
+
+            T* allocate(const std::size_t n)
+            {
+                uint8_t* raw = static_cast<uint8_t*>(::operator new(n * sizeof(T) + alignof(T) + sizeof(void*)));
+                const std::uintptr_t at = (reinterpret_cast<std::uintptr_t>(raw) + sizeof(void*) + alignof(T) - 1) & ~std::uintptr_t(alignof(T) - 1);
+                reinterpret_cast<void**>(at)[-1] = raw;
+                return reinterpret_cast<T*>(at);
+            }
+
+            void deallocate(T* p, const std::size_t)
+            {
+                ::operator delete(reinterpret_cast<void**>(p)[-1]);
+            }
+
+            template <typename U>
+            bool operator==(const aligned_allocator_t<U>&) const { return true; }
+            template <typename U>
+            bool operator!=(const aligned_allocator_t<U>&) const { return false; }
+        };
+
+        template <typename T>
+        struct aligned_delete_t
+        {
+            void operator()(T* p) const
+            {
+                p->~T();
+                aligned_allocator_t<T>().deallocate(p, 1);
+            }
+        };
+
+        template <typename T>
+        using aligned_unique_ptr = std::unique_ptr<T, aligned_delete_t<T>>;
+
+        // single object through aligned_allocator_t
+        template <typename T, typename... args_t>
+        aligned_unique_ptr<T> aligned_new(args_t&&... args)
+        {
+            return aligned_unique_ptr<T>(new (aligned_allocator_t<T>().allocate(1)) T(std::forward<args_t>(args)...));
+        }
+
+        template <typename T, typename... args_t>
+        std::shared_ptr<T> aligned_shared(args_t&&... args)
+        {
+            return std::allocate_shared<T>(aligned_allocator_t<T>(), std::forward<args_t>(args)...);
+        }
+    }
+}
@@ -0,0 +1,42 @@
+#pragma once
+
+#include <stdint.h>
+#include <chrono>
+
+namespace neutrino
+{
+    namespace impl
+    {
+        namespace clock
+        {
+            enum class clock_source_t
+            {
+                STEADY // std::chrono::steady_clock
+                , MONOTONIC_COARSE // CLOCK_MONOTONIC_COARSE, tick of a few ms, STEADY where not available
+                , TSC // invariant TSC converted to nanoseconds of STEADY epoch
+                , TSC_RAW // invariant TSC ticks as is, consumer converts them with calibration frame
+            };
+
+            // nanoepoch = m_nanoepoch0 + ((ticks - m_ticks0) * m_mult) >> m_shift
+            struct tsc_calibration_t
+            {
+                uint64_t m_ticks0 = 0;
+                uint64_t m_nanoepoch0 = 0;
+                uint64_t m_mult = 0;
+                uint8_t m_shift = 0;
+
+                uint64_t to_nanoepoch(const uint64_t ticks) const noexcept;
+            };
+
+            // selects clock source for neutrino_nanoepoch(), calibrates TSC if needed
+            // call before producer threads start (neutrino_producer_startup)
+            // returns false and falls back to STEADY when requested source is not supported
+            bool startup(clock_source_t source, std::chrono::milliseconds calibration_period = std::chrono::milliseconds(20)) noexcept;
+
+            clock_source_t source() noexcept;
+            const tsc_calibration_t& calibration() noexcept;
+
+            uint64_t nanoepoch() noexcept;
+        }
+    }
+}
@@ -0,0 +1,212 @@
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <vector>
+#include "neutrino_aligned.hpp"
+#include "neutrino_transport.hpp"
+#include "neutrino_consumer_patterns.hpp"
+#include "neutrino_consumer_latency.hpp"
+
+namespace neutrino
+{
+    namespace impl
+    {
+        namespace consumer
+        {
+            struct open_context_t
+            {
+                local::payload::nanoepoch_t::type_t m_nanoepoch; // of CONTEXT_ENTER
+                local::payload::event_id_t::type_t m_event_id;
+            };
+
+            // CONSUMER_AGGREGATOR state of one stream_id
+            struct stream_state_t
+            {
+                constexpr static const uint32_t npos = ~uint32_t(0);
+
+                local::payload::stream_id_t::type_t m_stream_id;
+                local::payload::nanoepoch_t::type_t m_last_nanoepoch; // of any frame, for idle eviction
+                local::payload::nanoepoch_t::type_t m_checkpoint_nanoepoch;
+                local::payload::event_id_t::type_t m_checkpoint_event_id;
+                uint32_t m_depth; // open contexts
+                uint32_t m_top_block; // pool block with the top of the stack, npos when empty
+                uint32_t m_lru_prev;
+                uint32_t m_lru_next;
+                bool m_has_checkpoint;
+            };
+
+            // a stream moved between tables, contexts from the outermost one
+            struct stream_snapshot_t
+            {
+                stream_state_t m_state; // links and blocks are not meaningful
+                std::vector<open_context_t> m_contexts;
+                std::vector<pattern_cursor_t> m_cursors;
+            };
+
+            // open addressing (linear probing) over a dense array of stream states, sized once by the params,
+            // so nothing is allocated per event. Open contexts live in fixed-size blocks of a shared pool.
+            // When m_max_streams are tracked, a new stream evicts the least recently used one.
+            // Not thread safe, one table per aggregator thread.
+            struct stream_table_t
+            {
+                struct stream_table_params_t
+                {
+                    std::size_t m_max_streams{ 64 * 1024 };
+                    std::size_t m_max_stack_blocks{ 64 * 1024 }; // block_contexts each, shared by all streams
+                    std::size_t m_pattern_cursors{ 0 }; // per stream, aggregator_t sets the categories of its patterns
+                } const m_params;
+
+                constexpr static const std::size_t block_contexts = 3;
+
+                struct metrics_t
+                {
+                    uint64_t m_evicted_lru = 0;
+                    uint64_t m_evicted_idle = 0;
+                    uint64_t m_stack_overflows = 0; // contexts not pushed, pool has no free block
+                };
+
+                stream_table_t(const stream_table_params_t po);
+
+                // existing or new state, becomes the most recently used one
+                stream_state_t& touch(const local::payload::stream_id_t::type_t stream_id, const local::payload::nanoepoch_t::type_t nanoepoch);
+                stream_state_t* find(const local::payload::stream_id_t::type_t stream_id);
+                bool erase(const local::payload::stream_id_t::type_t stream_id);
+                // streams not touched since now - idle, walks from the least recently used one; evicted count
+                std::size_t evict_idle(const local::payload::nanoepoch_t::type_t now, const local::payload::nanoepoch_t::type_t idle);
+
+                bool push(stream_state_t& s, const open_context_t& c);
+                const open_context_t* top(const stream_state_t& s) const;
+                void pop(stream_state_t& s);
+                // contexts to pop to close the innermost open one of event_id, 0 when there is none
+                std::size_t depth_of(const stream_state_t& s, const local::payload::event_id_t::type_t event_id) const;
+                // m_pattern_cursors of the stream, moved with it
+                pattern_cursor_t* cursors(const stream_state_t& s) { return m_cursors.data() + std::size_t(&s - m_states.data()) * m_params.m_pattern_cursors; }
+
+                // moves out the streams pred(stream_id) accepts; moved count
+                template <typename pred_t>
+                std::size_t extract(pred_t&& pred, std::vector<stream_snapshot_t>& out)
+                {
+                    std::size_t n = 0;
+                    // remove() fills the hole with the last state, which is already visited
+                    for (std::size_t idx = m_states.size(); idx-- > 0; )
+                    {
+                        if (!pred(m_states[idx].m_stream_id))
+                            continue;
+                        out.push_back(snapshot(uint32_t(idx)));
+                        remove(uint32_t(idx));
+                        n++;
+                    }
+                    return n;
+                }
+                // a stream moved in, replaces a state with the same stream_id; may evict as touch() does
+                void insert(const stream_snapshot_t& snapshot);
+
+                std::size_t size() const { return m_states.size(); }
+                const metrics_t& metrics() const { return m_metrics; }
+
+            private:
+                struct slot_t
+                {
+                    local::payload::stream_id_t::type_t m_stream_id;
+                    uint32_t m_state; // npos: free
+                };
+
+                struct alignas(64) stack_block_t
+                {
+                    open_context_t m_contexts[block_contexts];
+                    uint32_t m_prev; // block below, or next free block
+                };
+
+                std::vector<slot_t> m_slots; // power of 2, at least twice m_max_streams
+                std::size_t m_shift;
+                std::vector<stream_state_t> m_states; // dense, capacity m_max_streams
+                std::vector<pattern_cursor_t> m_cursors; // m_pattern_cursors per state, parallel to m_states
+                std::vector<stack_block_t, impl::aligned_allocator_t<stack_block_t>> m_blocks;
+                uint32_t m_free_block = stream_state_t::npos;
+                uint32_t m_lru_head = stream_state_t::npos; // most recently used
+                uint32_t m_lru_tail = stream_state_t::npos;
+                metrics_t m_metrics;
+
+                std::size_t slot_of(const local::payload::stream_id_t::type_t stream_id) const;
+                void lru_unlink(const uint32_t idx);
+                void lru_push_front(const uint32_t idx);
+                void remove(const uint32_t idx);
+                stream_snapshot_t snapshot(const uint32_t idx) const;
+            };
+
+            // CONSUMER_AGGREGATOR front: keeps stream states from the frames of all producers
+            struct aggregator_t : public transport::consumer_t
+            {
+                struct aggregator_params_t
+                {
+                    stream_table_t::stream_table_params_t m_streams;
+                    std::shared_ptr<const pattern_automaton_t> m_patterns; // optional
+                    latency_table_t::latency_table_params_t m_latencies; // durations of closed contexts, m_max_keys 0: off
+                } const m_params;
+
+                struct metrics_t
+                {
+                    uint64_t m_checkpoints = 0;
+                    uint64_t m_contexts = 0;
+                    uint64_t m_unmatched = 0; // leave or panic without an open enter of the event_id
+                    uint64_t m_unwound = 0; // contexts left open inside a closed one
+                    uint64_t m_patterns = 0; // matched
+                };
+
+                aggregator_t(const aggregator_params_t po)
+                    : m_params(po), m_streams(streams_params(po))
+                    , m_latencies(po.m_latencies.m_max_keys ? new latency_table_t(po.m_latencies) : nullptr) {}
+
+                void consume_checkpoint(
+                    const local::payload::nanoepoch_t::type_t& nanoepoch
+                    , const local::payload::stream_id_t::type_t& stream_id
+                    , const local::payload::event_id_t::type_t& event_id
+                ) override;
+                void consume_context(
+                    const local::payload::nanoepoch_t::type_t& nanoepoch
+                    , const local::payload::stream_id_t::type_t& stream_id
+                    , const local::payload::event_id_t::type_t& event_id
+                    , const local::payload::event_type_t::event_types& event_type
+                ) override;
+                void consume_columns(const transport::frames_columns_t& c) override;
+
+                // a pattern of m_patterns ended with the frame at nanoepoch
+                virtual void consume_pattern(
+                    const local::payload::stream_id_t::type_t&
+                    , const std::size_t /*pattern index*/
+                    , const local::payload::nanoepoch_t::type_t&
+                ) {};
+
+                stream_table_t& streams() { return m_streams; }
+                // nullptr when off, snapshots are safe from any thread
+                const latency_table_t* latencies() const { return m_latencies.get(); }
+                const metrics_t& metrics() const { return m_metrics; }
+
+            protected:
+                stream_table_t m_streams;
+                std::unique_ptr<latency_table_t> m_latencies;
+                metrics_t m_metrics;
+
+                void checkpoint(
+                    const local::payload::nanoepoch_t::type_t nanoepoch
+                    , const local::payload::stream_id_t::type_t stream_id
+                    , const local::payload::event_id_t::type_t event_id
+                );
+                void context(
+                    const local::payload::nanoepoch_t::type_t nanoepoch
+                    , const local::payload::stream_id_t::type_t stream_id
+                    , const local::payload::event_id_t::type_t event_id
+                    , const local::payload::event_type_t::type_t event_type
+                );
+                static stream_table_t::stream_table_params_t streams_params(const aggregator_params_t& po);
+                void match(
+                    stream_state_t& s
+                    , const local::payload::nanoepoch_t::type_t nanoepoch
+                    , const local::payload::event_id_t::type_t event_id
+                    , const local::payload::event_type_t::type_t event_type
+                );
+            };
+        }
+    }
+}
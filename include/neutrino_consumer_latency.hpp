@@ -0,0 +1,106 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <memory>
+#include "neutrino_frames_local.hpp"
+
+namespace neutrino
+{
+    namespace impl
+    {
+        namespace consumer
+        {
+            // durations in log-linear buckets (HDR style): values below 32 exactly,
+            // then 16 buckets per power of 2, so a value is known within 1/16 of it.
+            // Fixed size, merged by adding counts.
+            struct latency_histogram_t
+            {
+                constexpr static const unsigned sub_bucket_bits = 4;
+                constexpr static const unsigned max_bits = 40; // longer durations count as 2^40 - 1 ns, about 18 minutes
+                constexpr static const std::size_t buckets = (max_bits - sub_bucket_bits + 1) << sub_bucket_bits;
+
+                std::array<uint64_t, buckets> m_counts{ {} };
+
+                static std::size_t bucket_of(const uint64_t v) noexcept;
+                // largest value counted in bucket b
+                static uint64_t highest_of(const std::size_t b) noexcept;
+
+                void record(const uint64_t v) { m_counts[bucket_of(v)]++; }
+                void merge(const latency_histogram_t& h);
+                uint64_t count() const;
+                // value not exceeded by p (0..1) of the samples, as the largest value of its bucket; 0 when empty
+                uint64_t value_at(const double p) const;
+            };
+
+            // latency_histogram_t per (stream_id, event_id), fixed memory per key, keys are never removed.
+            // One writer thread (the aggregator), any thread takes snapshots while it writes: counts are atomics
+            // written without read-modify-write, a key is published after it is written.
+            struct latency_table_t
+            {
+                struct latency_table_params_t
+                {
+                    std::size_t m_max_keys{ 0 };
+                } const m_params;
+
+                struct metrics_t
+                {
+                    uint64_t m_dropped = 0; // samples of new keys over m_max_keys
+                };
+
+                latency_table_t(const latency_table_params_t po);
+
+                // writer
+                void record(
+                    const local::payload::stream_id_t::type_t stream_id
+                    , const local::payload::event_id_t::type_t event_id
+                    , const local::payload::nanoepoch_t::type_t duration
+                );
+                const metrics_t& metrics() const { return m_metrics; }
+
+                // any thread, adds the counts of the key to h; false when there is no such key
+                bool snapshot(
+                    const local::payload::stream_id_t::type_t stream_id
+                    , const local::payload::event_id_t::type_t event_id
+                    , latency_histogram_t& h
+                ) const;
+
+                // any thread, f(stream_id, event_id, const latency_histogram_t&) for every key
+                template <typename f_t>
+                void for_each(f_t&& f) const
+                {
+                    const std::size_t n = size();
+                    for (std::size_t cc = 0; cc < n; cc++)
+                    {
+                        latency_histogram_t h;
+                        copy(m_records[cc], h);
+                        f(m_records[cc].m_stream_id, m_records[cc].m_event_id, h);
+                    }
+                }
+
+                std::size_t size() const { return m_size.load(std::memory_order_acquire); }
+
+            private:
+                struct record_t
+                {
+                    local::payload::stream_id_t::type_t m_stream_id;
+                    local::payload::event_id_t::type_t m_event_id;
+                    std::array<std::atomic<uint64_t>, latency_histogram_t::buckets> m_counts;
+                };
+
+                std::unique_ptr<record_t[]> m_records; // m_max_keys
+                std::unique_ptr<std::atomic<uint32_t>[]> m_slots; // record index or npos, power of 2, at least twice m_max_keys
+                std::size_t m_mask;
+                std::atomic<std::size_t> m_size{ 0 };
+                metrics_t m_metrics;
+
+                std::size_t find(
+                    const local::payload::stream_id_t::type_t stream_id
+                    , const local::payload::event_id_t::type_t event_id
+                    , uint32_t& record
+                ) const;
+                static void copy(const record_t& r, latency_histogram_t& h);
+            };
+        }
+    }
+}
@@ -0,0 +1,181 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include "neutrino_frames_local.hpp"
+
+namespace neutrino
+{
+    namespace impl
+    {
+        namespace consumer
+        {
+            // one neutrino of a PATTERN, event_type NO_CONTEXT is a checkpoint
+            struct pattern_step_t
+            {
+                local::payload::event_type_t::type_t m_event_type;
+                local::payload::event_id_t::type_t m_event_id;
+            };
+
+            struct pattern_t
+            {
+                std::string m_name;
+                std::string m_category; // patterns of a category are matched together, see pattern_automaton_t
+                std::vector<pattern_step_t> m_steps;
+                std::vector<pattern_step_t> m_exclusions; // any of them between two steps breaks the series
+                local::payload::nanoepoch_t::type_t m_max_gap{ 0 }; // between consecutive steps, 0: unbounded
+            };
+
+            // per stream matching state of one category
+            struct pattern_cursor_t
+            {
+                uint32_t m_state = 0; // 0: at the root
+                local::payload::nanoepoch_t::type_t m_nanoepoch = 0; // of the last significant frame
+            };
+
+            // patterns compiled into Aho-Corasick automata over (event_type, event_id) symbols, one per m_category.
+            // A category is matched on its own significant symbols (steps and exclusions of its patterns): frames of other
+            // symbols are skipped, so a pattern matches a run of consecutive frames significant to its category, and patterns
+            // of other categories never break its partial matches. A pattern in a category of its own is matched on its own symbols.
+            // A stream keeps a cursor per category, a frame moves the cursors of the categories its symbol is significant to.
+            // A gap longer than the bound of the cursor state drops to the longest suffix whose bound allows it;
+            // patterns sharing a prefix share its states, such state takes the loosest bound of them.
+            // Immutable once built, shared by all aggregator threads.
+            struct pattern_automaton_t
+            {
+                constexpr static const uint32_t npos = ~uint32_t(0);
+
+                pattern_automaton_t(std::vector<pattern_t> patterns);
+
+                // advances cursors (categories() of them) by one frame, f(pattern index) for every pattern ending at it;
+                // amortized constant time per category of the symbol
+                template <typename f_t>
+                void match(
+                    pattern_cursor_t* cursors
+                    , const local::payload::nanoepoch_t::type_t nanoepoch
+                    , const local::payload::event_type_t::type_t event_type
+                    , const local::payload::event_id_t::type_t event_id
+                    , f_t&& f
+                ) const
+                {
+                    const symbol_slot_t* symbol = find_symbol(event_type, event_id);
+                    if (!symbol)
+                        return;
+                    for (uint32_t cc = symbol->m_categories_begin; cc < symbol->m_categories_end; cc++)
+                    {
+                        const uint32_t category = m_symbol_categories[cc];
+                        advance(cursors[category], category, symbol->m_symbol, nanoepoch, f);
+                    }
+                }
+
+                const pattern_t& pattern(const std::size_t idx) const { return m_patterns[idx]; }
+                std::size_t patterns() const { return m_patterns.size(); }
+                std::size_t categories() const { return m_categories; }
+                std::size_t states() const { return m_states.size(); }
+                std::size_t symbols() const { return m_symbols_count; }
+
+            private:
+                struct state_t
+                {
+                    uint32_t m_fail; // root of the category points to itself
+                    uint32_t m_dict; // nearest state on the fail chain with outputs
+                    uint32_t m_outputs_begin;
+                    uint32_t m_outputs_end;
+                    local::payload::nanoepoch_t::type_t m_max_gap;
+                };
+
+                struct symbol_slot_t
+                {
+                    local::payload::event_id_t::type_t m_event_id;
+                    uint32_t m_symbol; // npos: free
+                    local::payload::event_type_t::type_t m_event_type;
+                    uint32_t m_categories_begin; // in m_symbol_categories
+                    uint32_t m_categories_end;
+                };
+
+                struct edge_slot_t
+                {
+                    uint32_t m_state; // npos: free
+                    uint32_t m_symbol;
+                    uint32_t m_next;
+                };
+
+                const std::vector<pattern_t> m_patterns;
+                std::size_t m_categories = 0; // state c is the root of category c
+                std::vector<state_t> m_states;
+                std::vector<uint32_t> m_outputs;
+                std::vector<symbol_slot_t> m_symbols; // open addressing, power of 2
+                std::vector<uint32_t> m_symbol_categories;
+                std::vector<edge_slot_t> m_edges; // open addressing, power of 2
+                std::size_t m_symbols_count = 0;
+
+                static std::size_t hash(const uint64_t a, const uint64_t b) noexcept
+                {
+                    return std::size_t(((a * 0x9E3779B97F4A7C15ull) ^ (b * 0xC2B2AE3D27D4EB4Full)) >> 29);
+                }
+
+                const symbol_slot_t* find_symbol(const local::payload::event_type_t::type_t event_type, const local::payload::event_id_t::type_t event_id) const noexcept
+                {
+                    const std::size_t mask = m_symbols.size() - 1;
+                    for (std::size_t i = hash(event_id, event_type) & mask; m_symbols[i].m_symbol != npos; i = (i + 1) & mask)
+                    {
+                        if (m_symbols[i].m_event_id == event_id && m_symbols[i].m_event_type == event_type)
+                            return &m_symbols[i];
+                    }
+                    return nullptr;
+                }
+
+                uint32_t find_edge(const uint32_t state, const uint32_t symbol) const noexcept
+                {
+                    const std::size_t mask = m_edges.size() - 1;
+                    for (std::size_t i = hash(state, symbol) & mask; m_edges[i].m_state != npos; i = (i + 1) & mask)
+                    {
+                        if (m_edges[i].m_state == state && m_edges[i].m_symbol == symbol)
+                            return m_edges[i].m_next;
+                    }
+                    return npos;
+                }
+
+                template <typename f_t>
+                void advance(
+                    pattern_cursor_t& cursor
+                    , const uint32_t root
+                    , const uint32_t symbol
+                    , const local::payload::nanoepoch_t::type_t nanoepoch
+                    , f_t& f
+                ) const
+                {
+                    uint32_t s = cursor.m_state ? cursor.m_state : root;
+                    if (nanoepoch > cursor.m_nanoepoch)
+                    {
+                        const local::payload::nanoepoch_t::type_t gap = nanoepoch - cursor.m_nanoepoch;
+                        while (s != root && gap > m_states[s].m_max_gap)
+                            s = m_states[s].m_fail;
+                    }
+                    for (;;)
+                    {
+                        const uint32_t next = find_edge(s, symbol);
+                        if (next != npos)
+                        {
+                            s = next;
+                            break;
+                        }
+                        if (s == root)
+                            break;
+                        s = m_states[s].m_fail;
+                    }
+                    cursor.m_state = s == root ? 0 : s;
+                    cursor.m_nanoepoch = nanoepoch;
+
+                    for (uint32_t o = m_states[s].m_outputs_begin != m_states[s].m_outputs_end ? s : m_states[s].m_dict; o != npos; o = m_states[o].m_dict)
+                    {
+                        for (uint32_t cc = m_states[o].m_outputs_begin; cc < m_states[o].m_outputs_end; cc++)
+                            f(m_outputs[cc]);
+                    }
+                }
+
+                uint32_t add_symbol(const pattern_step_t& step);
+            };
+        }
+    }
+}
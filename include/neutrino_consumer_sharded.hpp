@@ -0,0 +1,160 @@
+#pragma once
+
+#include <atomic>
+#include <functional>
+#include <memory>
+#include <thread>
+#include <vector>
+#include "neutrino_aligned.hpp"
+#include "neutrino_consumer.hpp"
+
+namespace neutrino
+{
+    namespace impl
+    {
+        namespace consumer
+        {
+            // CONSUMER_AGGREGATOR over several threads.
+            // The ingest thread (the one calling consume_*, usually a deserializer) routes frames by stream_id
+            // into a SPSC ring per worker, every worker thread feeds its own aggregator_t,
+            // so stream states and pattern cursors are never shared and nothing is locked per frame.
+            // Streams are routed in buckets of a stream_id hash. A worker which got much more frames than another one
+            // since the last check gives one of its buckets away together with the stream states:
+            // the old owner exports the states after the last frame routed to it, the new owner imports them
+            // before the first frame routed to it, so frames of a stream keep their order. One bucket moves at a time.
+            // Single ingest thread.
+            struct sharded_aggregator_t : public transport::consumer_t
+            {
+                typedef std::function<std::unique_ptr<aggregator_t>(const std::size_t /*worker*/)> aggregator_factory_t;
+
+                struct sharded_aggregator_params_t
+                {
+                    std::size_t m_workers{ 4 };
+                    std::size_t m_ring_frames{ 64 * 1024 }; // per worker, rounded up to power of 2
+                    std::size_t m_buckets{ 1024 }; // rounded up to power of 2
+                    std::size_t m_rebalance_frames{ 64 * 1024 }; // routed between load checks, 0: buckets never move
+                    aggregator_t::aggregator_params_t m_aggregator; // of every worker, when there is no m_factory
+                    aggregator_factory_t m_factory; // optional, e.g. for aggregators with consume_pattern
+                } const m_params;
+
+                struct metrics_t
+                {
+                    uint64_t m_frames = 0;
+                    uint64_t m_ring_waits = 0; // ingest waited for a full ring
+                    uint64_t m_migrations = 0; // buckets moved
+                };
+
+                sharded_aggregator_t(const sharded_aggregator_params_t po);
+                // processes everything routed and joins the workers
+                ~sharded_aggregator_t();
+
+                void consume_checkpoint(
+                    const local::payload::nanoepoch_t::type_t& nanoepoch
+                    , const local::payload::stream_id_t::type_t& stream_id
+                    , const local::payload::event_id_t::type_t& event_id
+                ) override;
+                void consume_context(
+                    const local::payload::nanoepoch_t::type_t& nanoepoch
+                    , const local::payload::stream_id_t::type_t& stream_id
+                    , const local::payload::event_id_t::type_t& event_id
+                    , const local::payload::event_type_t::event_types& event_type
+                ) override;
+                void consume_columns(const transport::frames_columns_t& c) override;
+                // every worker gets it in order with its frames
+                void consume_clock_calibration(
+                    const local::payload::ticks_t::type_t& ticks
+                    , const local::payload::nanoepoch_t::type_t& nanoepoch
+                    , const local::payload::ticks_mult_t::type_t& mult
+                    , const local::payload::ticks_shift_t::type_t& shift
+                ) override;
+
+                // waits until the workers processed everything routed so far
+                void flush();
+
+                std::size_t workers() const { return m_workers.size(); }
+                // consistent after flush() until the next frame
+                aggregator_t& aggregator(const std::size_t worker) { return *m_workers[worker]->m_aggregator; }
+                // any thread, while frames come: adds the durations of the key from every worker to h,
+                // a stream which moved between workers has them in both
+                bool latency(
+                    const local::payload::stream_id_t::type_t stream_id
+                    , const local::payload::event_id_t::type_t event_id
+                    , latency_histogram_t& h
+                ) const;
+                std::size_t worker_of(const local::payload::stream_id_t::type_t stream_id) const { return m_owner[bucket_of(stream_id)]; }
+                const metrics_t& metrics() const { return m_metrics; }
+
+            private:
+                struct message_t
+                {
+                    enum class kind_t : uint8_t
+                    {
+                        FRAME,
+                        CALIBRATION, // ticks in m_stream_id, mult in m_event_id, shift in m_event_type
+                        RELEASE, // export streams of bucket m_stream_id
+                        ACQUIRE // import streams of bucket m_stream_id
+                    };
+
+                    local::payload::nanoepoch_t::type_t m_nanoepoch;
+                    local::payload::stream_id_t::type_t m_stream_id;
+                    local::payload::event_id_t::type_t m_event_id;
+                    local::payload::event_type_t::type_t m_event_type;
+                    kind_t m_kind;
+                };
+
+                struct worker_t
+                {
+                    std::unique_ptr<aggregator_t> m_aggregator;
+                    std::vector<message_t> m_ring;
+                    const uint64_t m_mask;
+
+                    // ingest side
+                    alignas(64) std::atomic<uint64_t> m_head{ 0 };
+                    uint64_t m_pending_head = 0; // written, not published yet
+                    uint64_t m_cached_tail = 0;
+                    uint64_t m_load = 0; // frames since the last check
+
+                    // worker side, moves after the messages are processed
+                    alignas(64) std::atomic<uint64_t> m_tail{ 0 };
+
+                    std::thread m_thread;
+
+                    worker_t(std::unique_ptr<aggregator_t> aggregator, const std::size_t ring_frames);
+                };
+
+                std::vector<aligned_unique_ptr<worker_t>> m_workers; // over-aligned, allocated by aligned_new
+                std::vector<uint16_t> m_owner; // worker of a bucket, changed by ingest only
+                std::vector<uint32_t> m_bucket_load; // frames since the last check, reset by it
+                std::size_t m_bucket_shift;
+                uint64_t m_until_rebalance;
+                metrics_t m_metrics;
+
+                // bucket in flight: exported by the old owner, imported by the new one
+                std::vector<stream_snapshot_t> m_handoff;
+                std::atomic<bool> m_handoff_ready{ false };
+                std::atomic<bool> m_migrating{ false };
+                std::atomic<bool> m_stop{ false };
+
+                std::size_t bucket_of(const local::payload::stream_id_t::type_t stream_id) const noexcept
+                {
+                    // not the multiplier of stream_table_t, streams of a worker still spread over its whole table
+                    uint64_t h = stream_id ^ (stream_id >> 33);
+                    h *= 0xFF51AFD7ED558CCDull;
+                    h ^= h >> 33;
+                    return std::size_t(h >> m_bucket_shift);
+                }
+
+                void push(worker_t& w, const message_t& m);
+                void publish();
+                void route(
+                    const local::payload::nanoepoch_t::type_t nanoepoch
+                    , const local::payload::stream_id_t::type_t stream_id
+                    , const local::payload::event_id_t::type_t event_id
+                    , const local::payload::event_type_t::type_t event_type
+                );
+                void rebalance();
+                void run(worker_t& w);
+            };
+        }
+    }
+}
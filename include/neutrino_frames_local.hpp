@@ -1,66 +1,117 @@
-#pragma once
-
-#include <stdint.h>
-
-namespace neutrino
-{
-    namespace impl
-    {
-        namespace local
-        {
-            namespace payload
-            {
-                struct header_t
-                {
-                    typedef uint8_t type_t;
-                };
-                struct nanoepoch_t
-                {
-                    typedef uint64_t type_t;
-                };
-                struct stream_id_t
-                {
-                    typedef uint64_t type_t;
-                };
-                struct event_id_t
-                {
-                    typedef uint64_t type_t;
-                };
-                struct event_type_t
-                {
-                    typedef uint8_t type_t;
-                    enum class event_types
-                    {
-                        NO_CONTEXT = 0
-                        , CONTEXT_ENTER = 1
-                        , CONTEXT_LEAVE = 2
-                        , CONTEXT_PANIC = 3
-                        , _LAST
-                    };
-                };
-                struct error_t
-                {
-                    typedef uint8_t type_t;
-                };
-            }
-            namespace frame
-            {
-                namespace v00
-                {
-                    namespace frame_error
-                    {
-                        const uint8_t header = uint8_t(1) & 0b00111111;
-                    }
-                    namespace checkpoint
-                    {
-                        const uint8_t header = uint8_t(2) & 0b00111111;
-                    }
-                    namespace context
-                    {
-                        const uint8_t header_context = uint8_t(3) & 0b00111111;
-                    }
-                }
-            }
-        }
-    }
-}
+#pragma once
+
+#include <stdint.h>
+#include <cstddef>
+
+namespace neutrino
+{
+    namespace impl
+    {
+        namespace local
+        {
+            namespace payload
+            {
+                struct header_t
+                {
+                    typedef uint8_t type_t;
+                };
+                struct nanoepoch_t
+                {
+                    typedef uint64_t type_t;
+                };
+                struct stream_id_t
+                {
+                    typedef uint64_t type_t;
+                };
+                struct event_id_t
+                {
+                    typedef uint64_t type_t;
+                };
+                struct event_type_t
+                {
+                    typedef uint8_t type_t;
+                    enum class event_types
+                    {
+                        NO_CONTEXT = 0
+                        , CONTEXT_ENTER = 1
+                        , CONTEXT_LEAVE = 2
+                        , CONTEXT_PANIC = 3
+                        , _LAST
+                    };
+                };
+                struct error_t
+                {
+                    typedef uint8_t type_t;
+                };
+                // clock::tsc_calibration_t
+                struct ticks_t
+                {
+                    typedef uint64_t type_t;
+                };
+                struct ticks_mult_t
+                {
+                    typedef uint64_t type_t;
+                };
+                struct ticks_shift_t
+                {
+                    typedef uint8_t type_t;
+                };
+            }
+            namespace frame
+            {
+                namespace v00
+                {
+                    namespace frame_error
+                    {
+                        const uint8_t header = uint8_t(1) & 0b00111111;
+                    }
+                    namespace checkpoint
+                    {
+                        const uint8_t header = uint8_t(2) & 0b00111111;
+                    }
+                    namespace context
+                    {
+                        const uint8_t header_context = uint8_t(3) & 0b00111111;
+                    }
+                    namespace clock_calibration
+                    {
+                        const uint8_t header = uint8_t(4) & 0b00111111;
+                    }
+                }
+                // compact frames: header byte, then LEB128 varints, no footer
+                // frames of one consume() call form a block, the first one is a reset point and the rest are deltas against
+                // the previous frame of the block, so every block (and every buffer of blocks) decodes independently
+                namespace v01
+                {
+                    namespace bits
+                    {
+                        const uint8_t MASK_VERSION = 0b11000000; // v00 headers have 00 there
+                        const uint8_t VERSION = 0b01000000;
+                        const uint8_t MASK_KIND = 0b00000011;
+                        const uint8_t RESET = 0b00000100; // nanoepoch is absolute, stream_id is present
+                        const uint8_t STREAM = 0b00001000; // stream_id differs from previous frame, it is present
+                        const uint8_t MASK_EVENT_TYPE = 0b00110000; // context event_types
+                        const uint8_t SHIFT_EVENT_TYPE = 4;
+                    }
+                    namespace checkpoint
+                    {
+                        // [nanoepoch: varint absolute or zigzag delta][stream_id: varint, RESET|STREAM][event_id: varint]
+                        const uint8_t kind = 1;
+                    }
+                    namespace context
+                    {
+                        // same as checkpoint, event type in MASK_EVENT_TYPE
+                        const uint8_t kind = 2;
+                    }
+                    namespace clock_calibration
+                    {
+                        // [ticks: varint][nanoepoch: varint][mult: varint][shift: byte], does not change block state
+                        const uint8_t kind = 3;
+                    }
+                    const std::size_t max_varint_size = 10;
+                    const std::size_t max_frame_size = 1 + 3 * max_varint_size;
+                }
+            }
+        }
+    }
+}
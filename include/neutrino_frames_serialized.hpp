@@ -1,32 +1,128 @@
-#pragma once
-
-#include <tuple>
-
-#include "neutrino_frames_local.hpp"
-
-namespace neutrino
-{
-    namespace impl
-    {
-        namespace serialized
-        {
-            template <typename _local_t>
-            struct raw_base_t
-            {
-                typedef _local_t local_t;
-                typedef typename _local_t::type_t local_type_t;
-            };
-
-            template <typename _local_t, typename byte_order_t>
-            struct raw_t : public raw_base_t<_local_t>
-            {
-                static constexpr std::size_t span() = delete;
-                static bool convert(const uint8_t* p, local_type_t& h) noexcept = delete;
-                static uint8_t* convert(const local_type_t h, uint8_t* p) noexcept = delete;
-            };
-
-            struct native_byte_order_target_t {};
-            struct network_byte_order_target_t {};
-        }
-    }
-}
+#pragma once
+
+#include <tuple>
+#include <cstddef>
+
+#include "neutrino_frames_local.hpp"
+
+namespace neutrino
+{
+    namespace impl
+    {
+        namespace serialized
+        {
+            template <typename _local_t>
+            struct raw_base_t
+            {
+                typedef _local_t local_t;
+                typedef typename _local_t::type_t local_type_t;
+            };
+
+            template <typename _local_t, typename byte_order_t>
+            struct raw_t : public raw_base_t<_local_t>
+            {
+                typedef typename raw_base_t<_local_t>::local_type_t local_type_t;
+
+                static constexpr std::size_t span() = delete;
+                static bool convert(const uint8_t* p, local_type_t& h) noexcept = delete;
+                static uint8_t* convert(const local_type_t h, uint8_t* p) noexcept = delete;
+            };
+
+            struct native_byte_order_target_t {};
+            struct network_byte_order_target_t {};
+
+            // frame declared once as a typelist of local::payload types: [header][fields...][header]
+            template <local::payload::header_t::type_t header, typename... fields_t>
+            struct frame_layout_t {};
+
+            // wire spans, offsets and per-field codec of a run of fields
+            template <typename byte_order_t, typename... fields_t>
+            struct fields_codec_t
+            {
+                static constexpr std::size_t span() { return 0; }
+                static uint8_t* encode(uint8_t* p) noexcept { return p; }
+                static void decode(const uint8_t*) noexcept {}
+            };
+
+            template <typename byte_order_t, typename head_t, typename... tail_t>
+            struct fields_codec_t<byte_order_t, head_t, tail_t...>
+            {
+                typedef raw_t<head_t, byte_order_t> head_raw_t;
+                typedef fields_codec_t<byte_order_t, tail_t...> tail_fields_t;
+
+                static constexpr std::size_t span() { return head_raw_t::span() + tail_fields_t::span(); }
+
+                static uint8_t* encode(uint8_t* p, const typename head_t::type_t& h, const typename tail_t::type_t&... t) noexcept
+                {
+                    return tail_fields_t::encode(head_raw_t::convert(h, p), t...);
+                }
+
+                static void decode(const uint8_t* p, typename head_t::type_t& h, typename tail_t::type_t&... t) noexcept
+                {
+                    head_raw_t::convert(p, h);
+                    tail_fields_t::decode(p + head_raw_t::span(), t...);
+                }
+            };
+
+            template <std::size_t idx, typename byte_order_t, typename... fields_t>
+            struct field_offset_t;
+
+            template <typename byte_order_t, typename head_t, typename... tail_t>
+            struct field_offset_t<0, byte_order_t, head_t, tail_t...>
+            {
+                static constexpr std::size_t value = 0;
+            };
+
+            template <std::size_t idx, typename byte_order_t, typename head_t, typename... tail_t>
+            struct field_offset_t<idx, byte_order_t, head_t, tail_t...>
+            {
+                static constexpr std::size_t value = raw_t<head_t, byte_order_t>::span() + field_offset_t<idx - 1, byte_order_t, tail_t...>::value;
+            };
+
+            template <typename layout_t, typename byte_order_t>
+            struct frame_fields_t;
+
+            template <local::payload::header_t::type_t header, typename... layout_fields_t, typename byte_order_t>
+            struct frame_fields_t<frame_layout_t<header, layout_fields_t...>, byte_order_t>
+            {
+                typedef raw_t<local::payload::header_t, byte_order_t> header_raw_t;
+                typedef fields_codec_t<byte_order_t, layout_fields_t...> payload_t;
+
+                static constexpr local::payload::header_t::type_t header_value = header;
+                static constexpr std::size_t span() { return 2 * header_raw_t::span() + payload_t::span(); }
+
+                // offset of idx-th field from the frame start
+                template <std::size_t idx>
+                static constexpr std::size_t offset() { return header_raw_t::span() + field_offset_t<idx, byte_order_t, layout_fields_t...>::value; }
+
+                static uint8_t* encode(uint8_t* p, const typename layout_fields_t::type_t&... v) noexcept
+                {
+                    return header_raw_t::convert(header, payload_t::encode(header_raw_t::convert(header, p), v...));
+                }
+
+                // whole frame with matching header and footer starts at p
+                static bool check(const uint8_t* p, const uint8_t* e) noexcept
+                {
+                    if (e - p < std::ptrdiff_t(span()))
+                        return false;
+                    local::payload::header_t::type_t h, f;
+                    header_raw_t::convert(p, h);
+                    header_raw_t::convert(p + span() - header_raw_t::span(), f);
+                    return h == header && f == header;
+                }
+
+                // fields of a checked frame
+                static void decode(const uint8_t* p, typename layout_fields_t::type_t&... v) noexcept
+                {
+                    payload_t::decode(p + header_raw_t::span(), v...);
+                }
+            };
+
+            // codec generated from a layout, byte orders may specialize it (see native_bo)
+            template <typename layout_t, typename byte_order_t>
+            struct frame_t : public frame_fields_t<layout_t, byte_order_t>
+            {
+            };
+        }
+    }
+}
@@ -0,0 +1,73 @@
+#pragma once
+
+#include <cstring>
+#include <new>
+
+#include "neutrino_frames_serialized.hpp"
+
+namespace neutrino
+{
+    namespace impl
+    {
+        namespace serialized
+        {
+            // host byte order, memcpy is a plain unaligned load/store
+            template <typename _local_t>
+            struct raw_t<_local_t, native_byte_order_target_t> : public raw_base_t<_local_t>
+            {
+                typedef typename _local_t::type_t local_type_t;
+
+                static constexpr std::size_t span() { return sizeof(local_type_t); }
+
+                static bool convert(const uint8_t* p, local_type_t& h) noexcept
+                {
+                    std::memcpy(&h, p, sizeof(h));
+                    return true;
+                }
+
+                static uint8_t* convert(const local_type_t h, uint8_t* p) noexcept
+                {
+                    std::memcpy(p, &h, sizeof(h));
+                    return p + sizeof(h);
+                }
+            };
+
+#pragma pack(push, 1)
+            // host layout without padding, same bytes as the fields one after another
+            template <typename... types_t>
+            struct packed_t;
+
+            template <typename head_t>
+            struct packed_t<head_t>
+            {
+                head_t m_head;
+                packed_t(const head_t& h) : m_head(h) {}
+            };
+
+            template <typename head_t, typename... tail_t>
+            struct packed_t<head_t, tail_t...>
+            {
+                head_t m_head;
+                packed_t<tail_t...> m_tail;
+                packed_t(const head_t& h, const tail_t&... t) : m_head(h), m_tail(t...) {}
+            };
+#pragma pack(pop)
+
+            // whole frame is the packed struct constructed in place (alignment 1), no per-field conversion
+            template <local::payload::header_t::type_t header, typename... layout_fields_t>
+            struct frame_t<frame_layout_t<header, layout_fields_t...>, native_byte_order_target_t>
+                : public frame_fields_t<frame_layout_t<header, layout_fields_t...>, native_byte_order_target_t>
+            {
+                typedef frame_fields_t<frame_layout_t<header, layout_fields_t...>, native_byte_order_target_t> fields_base_t;
+                typedef packed_t<local::payload::header_t::type_t, typename layout_fields_t::type_t..., local::payload::header_t::type_t> packed_frame_t;
+                static_assert(sizeof(packed_frame_t) == fields_base_t::span(), "packed frame must match the layout");
+
+                static uint8_t* encode(uint8_t* p, const typename layout_fields_t::type_t&... v) noexcept
+                {
+                    new (p) packed_frame_t(header, v..., header);
+                    return p + sizeof(packed_frame_t);
+                }
+            };
+        }
+    }
+}
@@ -0,0 +1,84 @@
+#pragma once
+
+#include <cstring>
+
+#include "neutrino_frames_serialized.hpp"
+
+#if defined(_MSC_VER)
+#include <stdlib.h>
+#endif
+
+namespace neutrino
+{
+    namespace impl
+    {
+        namespace serialized
+        {
+            namespace bo
+            {
+#if defined(_MSC_VER)
+                inline uint16_t bswap(const uint16_t v) noexcept { return _byteswap_ushort(v); }
+                inline uint32_t bswap(const uint32_t v) noexcept { return _byteswap_ulong(v); }
+                inline uint64_t bswap(const uint64_t v) noexcept { return _byteswap_uint64(v); }
+                constexpr bool host_is_network = false;
+#else
+                inline uint16_t bswap(const uint16_t v) noexcept { return __builtin_bswap16(v); }
+                inline uint32_t bswap(const uint32_t v) noexcept { return __builtin_bswap32(v); }
+                inline uint64_t bswap(const uint64_t v) noexcept { return __builtin_bswap64(v); }
+                constexpr bool host_is_network = __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__;
+#endif
+                inline uint8_t bswap(const uint8_t v) noexcept { return v; }
+
+                // the same for both directions, a single bswap (or movbe when fused with the load/store)
+                template <typename T>
+                inline T network(const T v) noexcept { return host_is_network ? v : bswap(v); }
+            }
+
+            template <typename _local_t>
+            struct raw_t<_local_t, network_byte_order_target_t> : public raw_base_t<_local_t>
+            {
+                typedef typename _local_t::type_t local_type_t;
+
+                static constexpr std::size_t span() { return sizeof(local_type_t); }
+
+                static bool convert(const uint8_t* p, local_type_t& h) noexcept
+                {
+                    local_type_t v;
+                    std::memcpy(&v, p, sizeof(v));
+                    h = bo::network(v);
+                    return true;
+                }
+
+                static uint8_t* convert(const local_type_t h, uint8_t* p) noexcept
+                {
+                    const local_type_t v = bo::network(h);
+                    std::memcpy(p, &v, sizeof(v));
+                    return p + sizeof(v);
+                }
+            };
+
+            namespace v00
+            {
+                // count back to back checkpoint frames [header][nanoepoch][stream_id][event_id][header] at p,
+                // headers are checked by the caller. Uses SSSE3 byte shuffles when the CPU has them.
+                void decode_checkpoints_network_bo(
+                    const uint8_t* p
+                    , const std::size_t count
+                    , local::payload::nanoepoch_t::type_t* nanoepoch
+                    , local::payload::stream_id_t::type_t* stream_id
+                    , local::payload::event_id_t::type_t* event_id
+                ) noexcept;
+                // the same field by field, the reference for the shuffles
+                void decode_checkpoints_network_bo_scalar(
+                    const uint8_t* p
+                    , const std::size_t count
+                    , local::payload::nanoepoch_t::type_t* nanoepoch
+                    , local::payload::stream_id_t::type_t* stream_id
+                    , local::payload::event_id_t::type_t* event_id
+                ) noexcept;
+                // decode_checkpoints_network_bo takes the shuffles on this CPU
+                bool network_bo_shuffle() noexcept;
+            }
+        }
+    }
+}
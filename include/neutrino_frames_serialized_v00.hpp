@@ -0,0 +1,59 @@
+#pragma once
+
+#include "neutrino_frames_serialized.hpp"
+#include "neutrino_frames_serialized_native_bo.hpp"
+#include "neutrino_frames_serialized_network_bo.hpp"
+#include "neutrino_frames_local.hpp"
+
+namespace neutrino
+{
+    namespace impl
+    {
+        namespace serialized
+        {
+            namespace v00
+            {
+                typedef frame_layout_t<local::frame::v00::checkpoint::header
+                    , local::payload::nanoepoch_t, local::payload::stream_id_t, local::payload::event_id_t> checkpoint_layout_t;
+                typedef frame_layout_t<local::frame::v00::context::header_context
+                    , local::payload::nanoepoch_t, local::payload::stream_id_t, local::payload::event_id_t, local::payload::event_type_t> context_layout_t;
+                typedef frame_layout_t<local::frame::v00::clock_calibration::header
+                    , local::payload::ticks_t, local::payload::nanoepoch_t, local::payload::ticks_mult_t, local::payload::ticks_shift_t> clock_calibration_layout_t;
+
+                // v00 frame codecs for a byte order, generated from the layouts above
+                template <typename byte_order_t>
+                struct frames_t
+                {
+                    typedef frame_t<checkpoint_layout_t, byte_order_t> checkpoint_t;
+                    typedef frame_t<context_layout_t, byte_order_t> context_t;
+                    typedef frame_t<clock_calibration_layout_t, byte_order_t> clock_calibration_t;
+
+                    constexpr static const std::size_t checkpoint_size = checkpoint_t::span();
+                    constexpr static const std::size_t context_size = context_t::span();
+                    constexpr static const std::size_t clock_calibration_size = clock_calibration_t::span();
+
+                    static uint8_t* checkpoint(
+                        uint8_t* p
+                        , const local::payload::nanoepoch_t::type_t& nanoepoch
+                        , const local::payload::stream_id_t::type_t& stream_id
+                        , const local::payload::event_id_t::type_t& event_id
+                    ) noexcept
+                    {
+                        return checkpoint_t::encode(p, nanoepoch, stream_id, event_id);
+                    }
+
+                    static uint8_t* context(
+                        uint8_t* p
+                        , const local::payload::nanoepoch_t::type_t& nanoepoch
+                        , const local::payload::stream_id_t::type_t& stream_id
+                        , const local::payload::event_id_t::type_t& event_id
+                        , const local::payload::event_type_t::type_t& event_type
+                    ) noexcept
+                    {
+                        return context_t::encode(p, nanoepoch, stream_id, event_id, event_type);
+                    }
+                };
+            }
+        }
+    }
+}
@@ -1,24 +1,33 @@
-#pragma once
-
-#include <stdint.h>
-
-#ifdef __cplusplus
-extern "C"
-{
-#endif
-
-    void neutrino_producer_startup(const char* cfg, const uint32_t cfg_bytes);
-    void neutrino_producer_shutdown(void);
-
-    /*TODO: errors as retvals?*/
-
-    uint64_t neutrino_nanoepoch(void);
-    void neutrino_checkpoint(const uint64_t m_nanoepoch, const uint64_t stream_id, const uint64_t event_id);
-    void neutrino_context_enter(const uint64_t m_nanoepoch, const uint64_t stream_id, const uint64_t event_id);
-    void neutrino_context_leave(const uint64_t m_nanoepoch, const uint64_t stream_id, const uint64_t event_id);
-    void neutrino_context_panic(const uint64_t m_nanoepoch, const uint64_t stream_id, const uint64_t event_id);
-    void neutrino_flush();
-
-#ifdef __cplusplus
-}
-#endif
+#pragma once
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+    void neutrino_producer_startup(const char* cfg, const uint32_t cfg_bytes);
+    void neutrino_producer_shutdown(void);
+
+    /*TODO: errors as retvals?*/
+
+    uint64_t neutrino_nanoepoch(void);
+    void neutrino_checkpoint(const uint64_t m_nanoepoch, const uint64_t stream_id, const uint64_t event_id);
+    void neutrino_context_enter(const uint64_t m_nanoepoch, const uint64_t stream_id, const uint64_t event_id);
+    void neutrino_context_leave(const uint64_t m_nanoepoch, const uint64_t stream_id, const uint64_t event_id);
+    void neutrino_context_panic(const uint64_t m_nanoepoch, const uint64_t stream_id, const uint64_t event_id);
+    void neutrino_flush();
+    /* sends clock calibration when neutrino_nanoepoch returns raw TSC ticks, call after the consumer is set */
+    void neutrino_clock_calibration(void);
+
+    /* struct-of-arrays batches, serialized in one pass */
+#define NEUTRINO_CONTEXT_ENTER 1
+#define NEUTRINO_CONTEXT_LEAVE 2
+#define NEUTRINO_CONTEXT_PANIC 3
+    void neutrino_checkpoint_batch(const uint32_t count, const uint64_t* nanoepoch, const uint64_t* stream_id, const uint64_t* event_id);
+    void neutrino_context_batch(const uint32_t count, const uint64_t* nanoepoch, const uint64_t* stream_id, const uint64_t* event_id, const uint8_t* event_type);
+
+#ifdef __cplusplus
+}
+#endif
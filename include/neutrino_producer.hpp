@@ -1,99 +1,124 @@
-#pragma once
-
-#include <stdexcept>
-#include <memory>
-#include "neutrino_producer.h"
-#include "neutrino_transport.hpp"
-
-namespace neutrino
-{
-    namespace impl
-    {
-        namespace producer
-        {
-            struct config_t
-            {
-                std::string m_producer_id{ 0 }; // TODO: UUID?
-                std::string m_producer_role;
-                /*
-                std::unique_ptr<transport::endpoint_consumer_t::endpoint_params_t> ep;
-                std::unique_ptr<transport::async_posix_consumer_t::async_posix_consumer_params_t> aep;
-
-                std::unique_ptr < transport::buffered_consumer_t::buffered_consumer_params_t> bpo;
-                std::unique_ptr < transport::buffered_exclusive_consumer_t::buffered_exclusive_consumer_params_t> epo;
-                std::unique_ptr < transport::buffered_optimistic_consumer_t::buffered_optimistic_consumer_params_t> opo;
-                */
-            };
-
-            const config_t configure_from_json(const char* cfg, const uint32_t cfg_bytes);
-
-            std::shared_ptr<transport::consumer_stub_t> set_consumer(std::shared_ptr<transport::consumer_stub_t> p) noexcept;
-            std::shared_ptr<transport::consumer_stub_t> get_consumer() noexcept;
-
-        }
-    }
-
-    namespace helpers
-    {
-        struct context_t
-        {
-            int64_t m_event_id;
-            int64_t m_stream_id;
-#ifdef UT
-            uint64_t m_enter_nanoepoch = 0;
-            uint64_t m_exit_nanoepoch = 0;
-#endif
-#ifdef __cplusplus >= 201703L
-            int m_count = std::uncaught_exceptions();
-#endif
-            context_t(
-                uint64_t stream_id
-                , uint64_t event_id
-#ifdef UT
-                , uint64_t enter_nanoepoch = 0
-                , uint64_t exit_nanoepoch = 0
-#endif
-            )
-                : m_event_id(event_id), m_stream_id(stream_id)
-#ifdef UT
-                , m_enter_nanoepoch(enter_nanoepoch)
-                , m_exit_nanoepoch(exit_nanoepoch)
-#endif
-            {
-                neutrino_context_enter(
-#ifdef UT
-                    m_enter_nanoepoch == 0 ? neutrino_nanoepoch() : m_enter_nanoepoch
-#else
-                    neutrino_nanoepoch()
-#endif
-                    , stream_id, event_id);
-            }
-            ~context_t()
-            {
-                uint64_t ne = 
-#ifdef UT
-                    m_exit_nanoepoch == 0 ? neutrino_nanoepoch() : m_exit_nanoepoch
-#else
-                    neutrino_nanoepoch()
-#endif
-                    ;
-
-                bool is_exception = 
-#ifdef __cplusplus >= 201703L
-                    m_count != std::uncaught_exceptions()
-#else
-                    std::uncaught_exception()
-#endif
-                    ;
-                if(is_exception)
-                {
-                    neutrino_context_panic(ne, m_stream_id, m_event_id);
-                }
-                else
-                {
-                    neutrino_context_leave(ne, m_stream_id, m_event_id);
-                }
-            }
-        };
-    }
+#pragma once
+
+#include <stdexcept>
+#include <memory>
+#include "neutrino_producer.h"
+#include "neutrino_transport.hpp"
+#include "neutrino_clock.hpp"
+
+namespace neutrino
+{
+    namespace impl
+    {
+        namespace producer
+        {
+            struct config_t
+            {
+                std::string m_producer_id{ 0 }; // TODO: UUID?
+                std::string m_producer_role;
+                clock::clock_source_t m_clock_source{ clock::clock_source_t::STEADY };
+                /*
+                std::unique_ptr<transport::endpoint_consumer_t::endpoint_params_t> ep;
+                std::unique_ptr<transport::async_posix_consumer_t::async_posix_consumer_params_t> aep;
+
+                std::unique_ptr < transport::buffered_consumer_t::buffered_consumer_params_t> bpo;
+                std::unique_ptr < transport::buffered_exclusive_consumer_t::buffered_exclusive_consumer_params_t> epo;
+                std::unique_ptr < transport::buffered_optimistic_consumer_t::buffered_optimistic_consumer_params_t> opo;
+                */
+            };
+
+            const config_t configure_from_json(const char* cfg, const uint32_t cfg_bytes);
+
+            // returns previous consumer when no thread uses it anymore
+            std::shared_ptr<transport::consumer_stub_t> set_consumer(std::shared_ptr<transport::consumer_stub_t> p) noexcept;
+            std::shared_ptr<transport::consumer_stub_t> get_consumer() noexcept;
+
+            // read-side section, active consumer stays alive until leave_consumer() (no shared writes, see shared_lib.cpp)
+            transport::consumer_stub_t* enter_consumer() noexcept;
+            void leave_consumer() noexcept;
+
+            struct consumer_guard_t
+            {
+                transport::consumer_stub_t* const m_consumer;
+
+                consumer_guard_t() noexcept
+                    : m_consumer(enter_consumer()) {}
+                ~consumer_guard_t()
+                {
+                    leave_consumer();
+                }
+
+                consumer_guard_t(const consumer_guard_t&) = delete;
+                consumer_guard_t& operator=(const consumer_guard_t&) = delete;
+
+                explicit operator bool() const noexcept { return m_consumer != nullptr; }
+                transport::consumer_stub_t* operator->() const noexcept { return m_consumer; }
+            };
+
+        }
+    }
+
+    namespace helpers
+    {
+        struct context_t
+        {
+            int64_t m_event_id;
+            int64_t m_stream_id;
+#ifdef UT
+            uint64_t m_enter_nanoepoch = 0;
+            uint64_t m_exit_nanoepoch = 0;
+#endif
+#ifdef __cplusplus >= 201703L
+            int m_count = std::uncaught_exceptions();
+#endif
+            context_t(
+                uint64_t stream_id
+                , uint64_t event_id
+#ifdef UT
+                , uint64_t enter_nanoepoch = 0
+                , uint64_t exit_nanoepoch = 0
+#endif
+            )
+                : m_event_id(event_id), m_stream_id(stream_id)
+#ifdef UT
+                , m_enter_nanoepoch(enter_nanoepoch)
+                , m_exit_nanoepoch(exit_nanoepoch)
+#endif
+            {
+                neutrino_context_enter(
+#ifdef UT
+                    m_enter_nanoepoch == 0 ? neutrino_nanoepoch() : m_enter_nanoepoch
+#else
+                    neutrino_nanoepoch()
+#endif
+                    , stream_id, event_id);
+            }
+            ~context_t()
+            {
+                uint64_t ne = 
+#ifdef UT
+                    m_exit_nanoepoch == 0 ? neutrino_nanoepoch() : m_exit_nanoepoch
+#else
+                    neutrino_nanoepoch()
+#endif
+                    ;
+
+                bool is_exception = 
+#ifdef __cplusplus >= 201703L
+                    m_count != std::uncaught_exceptions()
+#else
+                    std::uncaught_exception()
+#endif
+                    ;
+                if(is_exception)
+                {
+                    neutrino_context_panic(ne, m_stream_id, m_event_id);
+                }
+                else
+                {
+                    neutrino_context_leave(ne, m_stream_id, m_event_id);
+                }
+            }
+        };
+    }
 }
\ No newline at end of file
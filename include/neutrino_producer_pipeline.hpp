@@ -0,0 +1,168 @@
+#pragma once
+
+#include <array>
+#include <algorithm>
+#include <vector>
+#include <utility>
+#include "neutrino_frames_serialized_v00.hpp"
+
+namespace neutrino
+{
+    namespace impl
+    {
+        // producer chain composed at compile time, e.g.
+        //   pipeline_t<serializer_t<native_byte_order_target_t>, buffered_t<endpoint_stage_t<shm_ring_endpoint_t>, 1 << 16>>
+        // every stage is a concrete member of the previous one, so no call on the way to the buffer is virtual
+        // and the frame is encoded in place. Stages are not thread safe unless the wrapped endpoint is,
+        // use one pipeline per thread or endpoint_stage_t over an MT endpoint.
+        // The runtime path (frame_v00::create_consumer_stub + endpoint_t chain) is unchanged.
+        namespace pipeline
+        {
+            // stage interface: reserve(b)/commit(p, b) for in-place frames, consume(p, e) otherwise, flush();
+            // commit, consume and flush return false when data was refused downstream
+            template <typename byte_order_t>
+            struct serializer_t
+            {
+                typedef serialized::v00::frames_t<byte_order_t> frames_t;
+
+                // false when the frame or a flush it caused was refused
+                template <typename stage_t>
+                static bool checkpoint(
+                    stage_t& stage
+                    , const local::payload::nanoepoch_t::type_t& nanoepoch
+                    , const local::payload::stream_id_t::type_t& stream_id
+                    , const local::payload::event_id_t::type_t& event_id
+                )
+                {
+                    if (uint8_t* p = stage.reserve(frames_t::checkpoint_size))
+                    {
+                        frames_t::checkpoint(p, nanoepoch, stream_id, event_id);
+                        return stage.commit(p, frames_t::checkpoint_size);
+                    }
+                    std::array<uint8_t, frames_t::checkpoint_size> buf;
+                    return stage.consume(buf.data(), frames_t::checkpoint(buf.data(), nanoepoch, stream_id, event_id));
+                }
+
+                template <typename stage_t>
+                static bool context(
+                    stage_t& stage
+                    , const local::payload::nanoepoch_t::type_t& nanoepoch
+                    , const local::payload::stream_id_t::type_t& stream_id
+                    , const local::payload::event_id_t::type_t& event_id
+                    , const local::payload::event_type_t::type_t& event_type
+                )
+                {
+                    if (uint8_t* p = stage.reserve(frames_t::context_size))
+                    {
+                        frames_t::context(p, nanoepoch, stream_id, event_id, event_type);
+                        return stage.commit(p, frames_t::context_size);
+                    }
+                    std::array<uint8_t, frames_t::context_size> buf;
+                    return stage.consume(buf.data(), frames_t::context(buf.data(), nanoepoch, stream_id, event_id, event_type));
+                }
+            };
+
+            // single producer buffer, handed over to sink_t as a whole when the next frame does not fit
+            template <typename sink_t, std::size_t size>
+            struct buffered_t
+            {
+                sink_t m_sink;
+                std::vector<uint8_t> m_buf;
+                std::size_t m_used = 0;
+
+                template <typename... args_t>
+                buffered_t(args_t&&... args)
+                    : m_sink(std::forward<args_t>(args)...), m_buf(size) {}
+
+                uint8_t* reserve(const std::size_t b)
+                {
+                    if (m_used + b > size && !flush())
+                        return nullptr;
+                    if (b > size)
+                        return nullptr;
+                    return m_buf.data() + m_used;
+                }
+
+                bool commit(uint8_t*, const std::size_t b)
+                {
+                    m_used += b;
+                    return true;
+                }
+
+                bool consume(const uint8_t* p, const uint8_t* e)
+                {
+                    if (p == e)
+                        return flush();
+                    const std::size_t b = e - p;
+                    uint8_t* d = reserve(b);
+                    if (!d)
+                        return false;
+                    std::copy(p, e, d);
+                    commit(d, b);
+                    return true;
+                }
+
+                bool flush()
+                {
+                    if (!m_used)
+                        return true;
+                    // refused data stays, the next reserve or flush delivers it again
+                    if (!m_sink.consume(m_buf.data(), m_buf.data() + m_used))
+                        return false;
+                    m_used = 0;
+                    return true;
+                }
+            };
+
+            // any transport endpoint as a stage, its members are called without virtual dispatch
+            template <typename runtime_endpoint_t>
+            struct endpoint_stage_t
+            {
+                runtime_endpoint_t m_endpoint;
+
+                template <typename... args_t>
+                endpoint_stage_t(args_t&&... args)
+                    : m_endpoint(std::forward<args_t>(args)...) {}
+
+                uint8_t* reserve(const std::size_t b) { return m_endpoint.runtime_endpoint_t::reserve(b); }
+                bool commit(uint8_t* p, const std::size_t b) { return m_endpoint.runtime_endpoint_t::commit(p, b); } // false: watermark flush failed
+                bool consume(const uint8_t* p, const uint8_t* e) { return m_endpoint.runtime_endpoint_t::consume(p, e); }
+                bool flush() { return m_endpoint.runtime_endpoint_t::consume(nullptr, nullptr); } // 0 bytes is a flush
+            };
+
+            template <typename serializer_t, typename stage_t>
+            struct pipeline_t
+            {
+                stage_t m_stage;
+
+                template <typename... args_t>
+                pipeline_t(args_t&&... args)
+                    : m_stage(std::forward<args_t>(args)...) {}
+
+                bool checkpoint(
+                    const local::payload::nanoepoch_t::type_t& nanoepoch
+                    , const local::payload::stream_id_t::type_t& stream_id
+                    , const local::payload::event_id_t::type_t& event_id
+                )
+                {
+                    return serializer_t::checkpoint(m_stage, nanoepoch, stream_id, event_id);
+                }
+
+                bool context(
+                    const local::payload::nanoepoch_t::type_t& nanoepoch
+                    , const local::payload::stream_id_t::type_t& stream_id
+                    , const local::payload::event_id_t::type_t& event_id
+                    , const local::payload::event_type_t::event_types& event_type
+                )
+                {
+                    return serializer_t::context(m_stage, nanoepoch, stream_id, event_id, static_cast<local::payload::event_type_t::type_t>(event_type));
+                }
+
+                bool flush()
+                {
+                    return m_stage.flush();
+                }
+            };
+        }
+    }
+}
@@ -1,66 +1,249 @@
-#pragma once
-
-#include <memory>
-#include "neutrino_frames_local.hpp"
-
-namespace neutrino
-{
-    namespace impl
-    {
-        namespace transport
-        {
-            struct endpoint_t
-            {
-                virtual ~endpoint_t() = default;
-
-                virtual bool consume(const uint8_t*, const uint8_t*) { return false; };
-                virtual bool flush() { return false; };
-            };
-
-            struct consumer_t
-            {
-                virtual ~consumer_t() = default;
-                virtual void consume_checkpoint(
-                    const local::payload::nanoepoch_t::type_t&
-                    , const local::payload::stream_id_t::type_t&
-                    , const local::payload::event_id_t::type_t&
-                ) {};
-                virtual void consume_context(
-                    const local::payload::nanoepoch_t::type_t&
-                    , const local::payload::stream_id_t::type_t&
-                    , const local::payload::event_id_t::type_t&
-                    , const local::payload::event_type_t::event_types&
-                ) {};
-            };
-
-            struct consumer_stub_t : public consumer_t
-            {
-                endpoint_t& m_endpoint;
-
-                consumer_stub_t(endpoint_t& endpoint)
-                    : m_endpoint(endpoint) {}
-            };
-
-            struct endpoint_impl_t : public endpoint_t
-            {
-                consumer_t& m_consumer;
-
-                endpoint_impl_t(consumer_t& consumer)
-                    : m_consumer(consumer) {}
-            };
-
-            namespace frame_v00
-            {
-                enum class known_encodings_t
-                {
-                    BINARY_NETWORK
-                    , BINARY_NATIVE // for localhost
-                    , JSON
-                };
-
-                std::shared_ptr<consumer_stub_t> create_consumer_stub(known_encodings_t, endpoint_t& endpoint);
-                std::shared_ptr<endpoint_impl_t> create_endpoint_impl(known_encodings_t, consumer_t& consumer);
-            }
-        }
-    }
-}
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <memory>
+#include <vector>
+#include <algorithm>
+#include "neutrino_frames_local.hpp"
+
+namespace neutrino
+{
+    namespace impl
+    {
+        namespace transport
+        {
+            struct endpoint_t
+            {
+                virtual ~endpoint_t() = default;
+
+                virtual bool consume(const uint8_t*, const uint8_t*) { return false; };
+                virtual bool flush() { return false; };
+
+                // run of frames of the same size, buffered endpoints may split it between frames only
+                // false: some of the frames were not consumed
+                virtual bool consume_frames(const uint8_t* p, const uint8_t* e, const std::size_t frame_size)
+                {
+                    bool ret = true;
+                    for (; p + frame_size <= e; p += frame_size)
+                        ret = consume(p, p + frame_size) && ret;
+                    return ret && p == e;
+                };
+
+                struct region_t
+                {
+                    const uint8_t* m_p;
+                    const uint8_t* m_e;
+                };
+
+                // gather: regions are consumed as if they were one contiguous range
+                // endpoints with own buffer copy each region into it, sinks may pass them to writev/sendmsg as is
+                virtual bool consumev(const region_t* r, const std::size_t count)
+                {
+                    if (count == 1)
+                        return consume(r->m_p, r->m_e);
+
+                    std::size_t b = 0;
+                    for (std::size_t cc = 0; cc < count; cc++)
+                        b += r[cc].m_e - r[cc].m_p;
+
+                    if (uint8_t* p = reserve(b))
+                    {
+                        uint8_t* d = p;
+                        for (std::size_t cc = 0; cc < count; cc++)
+                            d = std::copy(r[cc].m_p, r[cc].m_e, d);
+                        return commit(p, b);
+                    }
+
+                    // scratch of the thread keeps its capacity between calls, taken out while in use:
+                    // consume() may end up here again for a downstream endpoint
+                    static thread_local std::vector<uint8_t> scratch;
+                    std::vector<uint8_t> buf;
+                    buf.swap(scratch);
+                    buf.clear();
+                    for (std::size_t cc = 0; cc < count; cc++)
+                        buf.insert(buf.end(), r[cc].m_p, r[cc].m_e);
+                    const bool ret = consume(buf.data(), buf.data() + buf.size());
+                    buf.swap(scratch);
+                    return ret;
+                };
+
+                // writable region of exactly b bytes inside endpoint's buffer, caller fills it and calls commit(p, b)
+                // nullptr: endpoint has no buffer or region is not available, use consume()
+                virtual uint8_t* reserve(const std::size_t) { return nullptr; };
+                virtual bool commit(uint8_t*, const std::size_t) { return false; };
+
+                // endpoints which keep consumed bytes back to back in one buffer until it goes downstream
+                // count the buffers here, a serializer may refer to its previous frame while the count stays
+                // nullptr: bytes of other threads may come in between or buffers are cut elsewhere
+                virtual const std::atomic<uint64_t>* ordered_deliveries() const { return nullptr; }
+            };
+
+            // decoded frames in buffer order as struct-of-arrays, event_type NO_CONTEXT is a checkpoint
+            struct frames_columns_t
+            {
+                std::size_t m_count;
+                const local::payload::nanoepoch_t::type_t* m_nanoepoch;
+                const local::payload::stream_id_t::type_t* m_stream_id;
+                const local::payload::event_id_t::type_t* m_event_id;
+                const local::payload::event_type_t::type_t* m_event_type;
+            };
+
+            struct consumer_t
+            {
+                virtual ~consumer_t() = default;
+                virtual void consume_checkpoint(
+                    const local::payload::nanoepoch_t::type_t&
+                    , const local::payload::stream_id_t::type_t&
+                    , const local::payload::event_id_t::type_t&
+                ) {};
+                virtual void consume_context(
+                    const local::payload::nanoepoch_t::type_t&
+                    , const local::payload::stream_id_t::type_t&
+                    , const local::payload::event_id_t::type_t&
+                    , const local::payload::event_type_t::event_types&
+                ) {};
+                // struct-of-arrays batches, event_type are event_types values
+                virtual void consume_checkpoint_batch(
+                    const std::size_t count
+                    , const local::payload::nanoepoch_t::type_t* nanoepoch
+                    , const local::payload::stream_id_t::type_t* stream_id
+                    , const local::payload::event_id_t::type_t* event_id
+                )
+                {
+                    for (std::size_t cc = 0; cc < count; cc++)
+                        consume_checkpoint(nanoepoch[cc], stream_id[cc], event_id[cc]);
+                };
+                virtual void consume_context_batch(
+                    const std::size_t count
+                    , const local::payload::nanoepoch_t::type_t* nanoepoch
+                    , const local::payload::stream_id_t::type_t* stream_id
+                    , const local::payload::event_id_t::type_t* event_id
+                    , const local::payload::event_type_t::type_t* event_type
+                )
+                {
+                    for (std::size_t cc = 0; cc < count; cc++)
+                        consume_context(nanoepoch[cc], stream_id[cc], event_id[cc], static_cast<local::payload::event_type_t::event_types>(event_type[cc]));
+                };
+                // deserializers deliver whole decoded buffers here, default adapts to per-frame calls
+                virtual void consume_columns(const frames_columns_t& c)
+                {
+                    for (std::size_t cc = 0; cc < c.m_count; cc++)
+                    {
+                        if (c.m_event_type[cc] == static_cast<local::payload::event_type_t::type_t>(local::payload::event_type_t::event_types::NO_CONTEXT))
+                            consume_checkpoint(c.m_nanoepoch[cc], c.m_stream_id[cc], c.m_event_id[cc]);
+                        else
+                            consume_context(c.m_nanoepoch[cc], c.m_stream_id[cc], c.m_event_id[cc], static_cast<local::payload::event_type_t::event_types>(c.m_event_type[cc]));
+                    }
+                };
+                // nanoepoch of following frames are raw ticks (clock_source_t::TSC_RAW), see clock::tsc_calibration_t
+                virtual void consume_clock_calibration(
+                    const local::payload::ticks_t::type_t&
+                    , const local::payload::nanoepoch_t::type_t&
+                    , const local::payload::ticks_mult_t::type_t&
+                    , const local::payload::ticks_shift_t::type_t&
+                ) {};
+            };
+
+            struct consumer_stub_t : public consumer_t
+            {
+                endpoint_t& m_endpoint;
+
+                consumer_stub_t(endpoint_t& endpoint)
+                    : m_endpoint(endpoint) {}
+            };
+
+            struct endpoint_impl_t : public endpoint_t
+            {
+                consumer_t& m_consumer;
+
+                endpoint_impl_t(consumer_t& consumer)
+                    : m_consumer(consumer) {}
+            };
+
+            // deserializer side: collects decoded frames and passes them to consumer_t::consume_columns in chunks
+            template <std::size_t capacity>
+            struct frames_columns_collector_t
+            {
+                consumer_t& m_consumer;
+                std::size_t m_count = 0;
+                std::array<local::payload::nanoepoch_t::type_t, capacity> m_nanoepoch;
+                std::array<local::payload::stream_id_t::type_t, capacity> m_stream_id;
+                std::array<local::payload::event_id_t::type_t, capacity> m_event_id;
+                std::array<local::payload::event_type_t::type_t, capacity> m_event_type;
+
+                frames_columns_collector_t(consumer_t& consumer)
+                    : m_consumer(consumer) {}
+
+                void push(
+                    const local::payload::nanoepoch_t::type_t nanoepoch
+                    , const local::payload::stream_id_t::type_t stream_id
+                    , const local::payload::event_id_t::type_t event_id
+                    , const local::payload::event_type_t::type_t event_type
+                )
+                {
+                    m_nanoepoch[m_count] = nanoepoch;
+                    m_stream_id[m_count] = stream_id;
+                    m_event_id[m_count] = event_id;
+                    m_event_type[m_count] = event_type;
+                    if (++m_count == capacity)
+                        flush();
+                }
+
+                // room for n <= capacity frames at m_count, caller fills them and calls commit(n)
+                std::size_t reserve(const std::size_t n)
+                {
+                    if (m_count + n > capacity)
+                        flush();
+                    return m_count;
+                }
+
+                void commit(const std::size_t n)
+                {
+                    m_count += n;
+                    if (m_count == capacity)
+                        flush(); // push() writes at m_count
+                }
+
+                void flush()
+                {
+                    if (!m_count)
+                        return;
+                    const frames_columns_t c{ m_count, m_nanoepoch.data(), m_stream_id.data(), m_event_id.data(), m_event_type.data() };
+                    m_count = 0;
+                    m_consumer.consume_columns(c);
+                }
+            };
+
+            namespace frame_v00
+            {
+                enum class known_encodings_t
+                {
+                    BINARY_NETWORK
+                    , BINARY_NATIVE // for localhost
+                    , JSON // frame_json, one object per line
+                    , COMPACT_V01 // frame_v01
+                    , _LAST
+                };
+
+                std::shared_ptr<consumer_stub_t> create_consumer_stub(known_encodings_t, endpoint_t& endpoint);
+                std::shared_ptr<endpoint_impl_t> create_endpoint_impl(known_encodings_t, consumer_t& consumer);
+                // input is a byte stream, frames may be cut between consume() calls; decoding resumes after a broken frame.
+                // nullptr for encodings which need record boundaries (COMPACT_V01)
+                std::shared_ptr<endpoint_impl_t> create_stream_endpoint_impl(known_encodings_t, consumer_t& consumer);
+            }
+
+            namespace frame_v01
+            {
+                std::shared_ptr<consumer_stub_t> create_consumer_stub(endpoint_t& endpoint);
+                std::shared_ptr<endpoint_impl_t> create_endpoint_impl(consumer_t& consumer);
+            }
+
+            namespace frame_json
+            {
+                std::shared_ptr<consumer_stub_t> create_consumer_stub(endpoint_t& endpoint);
+                std::shared_ptr<endpoint_impl_t> create_endpoint_impl(consumer_t& consumer);
+            }
+        }
+    }
+}
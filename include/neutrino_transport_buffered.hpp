@@ -1,41 +1,64 @@
-#pragma once
-
-#include <vector>
-#include <memory>
-#include "neutrino_transport.hpp"
-
-namespace neutrino
-{
-    namespace impl
-    {
-        namespace transport
-        {
-            struct buffered_endpoint_t : public endpoint_t
-            {
-                struct buffered_endpoint_params_t
-                {
-                    std::size_t m_message_buf_size{ 0 };
-                    std::size_t m_message_buf_watermark{ 0 };
-                } const m_buffered_endpoint_params;
-
-                std::vector<uint8_t> m_message_buf;
-                uint8_t* m_data = nullptr;
-                std::size_t m_sz = 0;
-
-                std::shared_ptr<endpoint_t> m_endpoint_sp;
-                endpoint_t* m_endpoint = nullptr;
-
-                buffered_endpoint_t(std::shared_ptr<endpoint_t> endpoint, const buffered_endpoint_params_t po)
-                    : m_endpoint_sp(endpoint), m_buffered_endpoint_params(po)
-                {
-                    m_message_buf.resize(m_buffered_endpoint_params.m_message_buf_size);
-                    m_data = m_message_buf.data();
-                    m_sz = m_message_buf.size();
-
-                    m_endpoint = m_endpoint_sp.get();
-                }
-
-            };
-        }
-    }
-}
+#pragma once
+
+#include <vector>
+#include <memory>
+#include <atomic>
+#include "neutrino_transport.hpp"
+
+namespace neutrino
+{
+    namespace impl
+    {
+        namespace transport
+        {
+            struct buffered_endpoint_t : public endpoint_t
+            {
+                struct buffered_endpoint_params_t
+                {
+                    std::size_t m_message_buf_size{ 0 };
+                    std::size_t m_message_buf_watermark{ 0 };
+                } const m_buffered_endpoint_params;
+
+                std::vector<uint8_t> m_message_buf;
+                uint8_t* m_data = nullptr;
+                std::size_t m_sz = 0;
+
+                std::shared_ptr<endpoint_t> m_endpoint_sp;
+                endpoint_t* m_endpoint = nullptr;
+
+                std::atomic<uint64_t> m_deliveries{ 0 }; // buffers sent downstream, see flush_scheduler_t
+
+                buffered_endpoint_t(std::shared_ptr<endpoint_t> endpoint, const buffered_endpoint_params_t po)
+                    : m_endpoint_sp(endpoint), m_buffered_endpoint_params(po)
+                {
+                    m_message_buf.resize(m_buffered_endpoint_params.m_message_buf_size);
+                    m_data = m_message_buf.data();
+                    m_sz = m_message_buf.size();
+
+                    m_endpoint = m_endpoint_sp.get();
+                }
+
+                // bytes held in the buffer, 0 when endpoint can't be flushed from other thread (flush_scheduler_t skips it)
+                virtual uint64_t pending() { return 0; }
+
+                // longest run of whole frames which fits after occupied bytes (whole buffer when it is about to be flushed)
+                std::size_t frames_chunk(const std::size_t occupied, const std::size_t frame_size, const std::size_t remaining) const noexcept
+                {
+                    std::size_t room = occupied + 1 < m_sz ? m_sz - occupied - 1 : 0;
+                    if (room < frame_size)
+                        room = m_sz - 1;
+                    room -= room % frame_size;
+                    return room < remaining ? room : remaining;
+                }
+
+            protected:
+                bool deliver(const uint8_t* p, const uint8_t* e)
+                {
+                    m_deliveries.fetch_add(1, std::memory_order_relaxed);
+                    return m_endpoint->consume(p, e);
+                }
+
+            };
+        }
+    }
+}
@@ -0,0 +1,63 @@
+#pragma once
+
+#include <vector>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <chrono>
+#include <condition_variable>
+#include "neutrino_transport_buffered.hpp"
+
+namespace neutrino
+{
+    namespace impl
+    {
+        namespace transport
+        {
+            // background thread which bounds time data stays in registered buffered endpoints.
+            // Every m_max_latency/2 it samples pending() and m_deliveries of each endpoint,
+            // an endpoint which held data for a whole period without any delivery is flushed.
+            // Sampling runs at low priority, flushes at normal one: producers may wait for a buffer while it is flushed.
+            // Endpoints must be multi thread safe, buffered_singlethread_endpoint_t reports no pending data and is never flushed.
+            struct flush_scheduler_t
+            {
+                struct flush_scheduler_params_t
+                {
+                    std::chrono::microseconds m_max_latency{ 5000 };
+                } const m_params;
+
+                struct metrics_t
+                {
+                    uint64_t m_flushes = 0;
+                    uint64_t m_failed_flushes = 0; // downstream refused the buffer
+                };
+
+                flush_scheduler_t(const flush_scheduler_params_t po);
+                ~flush_scheduler_t();
+
+                // endpoint is held weakly, it leaves the schedule once destroyed
+                void add(std::shared_ptr<buffered_endpoint_t> e);
+
+                metrics_t metrics();
+
+            private:
+                struct entry_t
+                {
+                    std::weak_ptr<buffered_endpoint_t> m_endpoint;
+                    uint64_t m_deliveries = 0;
+                    bool m_pending = false;
+                };
+
+                std::mutex m_mtx;
+                std::condition_variable m_cv;
+                std::vector<entry_t> m_entries; // guarded by m_mtx
+                bool m_stop = false;
+                metrics_t m_metrics; // guarded by m_mtx
+
+                std::thread m_thread;
+
+                void run();
+            };
+        }
+    }
+}
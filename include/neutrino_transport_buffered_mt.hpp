@@ -1,48 +1,146 @@
-#pragma once
-
-#include <mutex>
-#include <atomic>
-#include "neutrino_transport_buffered_st.hpp"
-
-namespace neutrino
-{
-    namespace impl
-    {
-        namespace transport
-        {
-            struct buffered_exclusive_endpoint_t : public buffered_singlethread_endpoint_t
-            {
-                using buffered_singlethread_endpoint_t::buffered_singlethread_endpoint_t;
-
-                std::mutex m_buffer_mtx;
-
-                bool consume(const uint8_t* p, const uint8_t* e) override;
-            };
-
-            struct buffered_optimistic_endpoint_t : public buffered_endpoint_t
-            {
-                struct buffered_optimistic_consumer_params_t
-                {
-                    std::size_t m_optimistic_lock_retries{ 1000 };
-                } const m_params;
-
-                std::atomic<uint64_t> m_frame_start{ 0 };
-
-                buffered_optimistic_endpoint_t(
-                    std::shared_ptr<endpoint_t> endpoint
-                    , const buffered_endpoint_t::buffered_endpoint_params_t bpo
-                    , const buffered_optimistic_consumer_params_t po
-                )
-                    : m_params(po), buffered_endpoint_t(endpoint, bpo)
-                {
-                }
-
-                bool consume(const uint8_t* p, const uint8_t* e) final;
-            protected:
-                bool flush() final;
-
-            };
-
-        }
-    }
-}
+#pragma once
+
+#include <mutex>
+#include <atomic>
+#include <vector>
+#include <memory>
+#include "neutrino_aligned.hpp"
+#include "neutrino_transport_buffered_st.hpp"
+
+namespace neutrino
+{
+    namespace impl
+    {
+        namespace transport
+        {
+            struct buffered_exclusive_endpoint_t : public buffered_singlethread_endpoint_t
+            {
+                using buffered_singlethread_endpoint_t::buffered_singlethread_endpoint_t;
+
+                std::mutex m_buffer_mtx;
+
+                bool consume(const uint8_t* p, const uint8_t* e) override;
+                bool consume_frames(const uint8_t* p, const uint8_t* e, const std::size_t frame_size) override;
+                uint64_t pending() override;
+
+                // buffer stays locked between reserve() and commit()
+                uint8_t* reserve(const std::size_t b) override;
+                bool commit(uint8_t* p, const std::size_t b) override;
+                // frames of threads interleave
+                const std::atomic<uint64_t>* ordered_deliveries() const final { return nullptr; }
+            };
+
+            struct buffered_optimistic_endpoint_t : public buffered_endpoint_t
+            {
+                struct buffered_optimistic_consumer_params_t
+                {
+                    std::size_t m_optimistic_lock_retries{ 1000 };
+                } const m_params;
+
+                std::atomic<uint64_t> m_frame_start{ 0 };
+
+                buffered_optimistic_endpoint_t(
+                    std::shared_ptr<endpoint_t> endpoint
+                    , const buffered_endpoint_t::buffered_endpoint_params_t bpo
+                    , const buffered_optimistic_consumer_params_t po
+                )
+                    : m_params(po), buffered_endpoint_t(endpoint, bpo)
+                {
+                }
+
+                bool consume(const uint8_t* p, const uint8_t* e) final;
+                bool consume_frames(const uint8_t* p, const uint8_t* e, const std::size_t frame_size) final;
+                uint64_t pending() final { return m_frame_start.load(std::memory_order_relaxed); }
+            protected:
+                bool flush() final;
+
+            };
+
+            // producers claim space with one fetch_add on m_reserved, copy in parallel and publish with fetch_add on m_committed.
+            // The thread whose claim crosses the buffer end (or the one sealing it at the watermark/flush)
+            // waits for claims before it to commit, consumes the buffer downstream and reopens it.
+            // Over-aligned: create it with impl::aligned_shared (std::make_shared does not honor alignas before C++17).
+            struct buffered_reserve_commit_endpoint_t : public buffered_endpoint_t
+            {
+                using buffered_endpoint_t::buffered_endpoint_t;
+
+                alignas(64) std::atomic<uint64_t> m_reserved{ 0 }; // > m_sz: buffer is full or sealed
+                alignas(64) std::atomic<uint64_t> m_committed{ 0 };
+
+                bool consume(const uint8_t* p, const uint8_t* e) final;
+                bool consume_frames(const uint8_t* p, const uint8_t* e, const std::size_t frame_size) final;
+                uint64_t pending() final { return m_reserved.load(std::memory_order_relaxed); }
+
+                // claims a region, other threads keep claiming and committing theirs meanwhile
+                uint8_t* reserve(const std::size_t b) final;
+                bool commit(uint8_t* p, const std::size_t b) final;
+
+            protected:
+                bool flush() final;
+
+            private:
+                static constexpr uint64_t sealed = uint64_t(1) << 62;
+
+                bool seal();
+                bool flush_extent(const uint64_t extent);
+            };
+
+            // optimistic endpoint over a ring of buffers: full buffer is sealed and replaced by the next one,
+            // producers keep appending to the new buffer while the sealed one is consumed downstream.
+            // Sealed buffers are consumed in the order they were sealed.
+            struct buffered_multi_optimistic_endpoint_t : public buffered_endpoint_t
+            {
+                struct buffered_multi_optimistic_params_t
+                {
+                    enum class all_in_flight_policy_t
+                    {
+                        WAIT // sealing thread waits for the next buffer to drain, producers spin meanwhile
+                        , DROP // frame which does not fit is refused and counted in dropped_bytes()
+                    };
+
+                    std::size_t m_buffers{ 2 };
+                    all_in_flight_policy_t m_all_in_flight{ all_in_flight_policy_t::WAIT };
+                    std::size_t m_optimistic_lock_retries{ 1000 };
+                } const m_params;
+
+                struct buffer_t
+                {
+                    uint8_t* m_data = nullptr;
+                    std::vector<uint8_t> m_storage; // first buffer uses buffered_endpoint_t::m_message_buf
+                    std::atomic<uint64_t> m_frame_start{ 0 }; // > m_sz: copy in progress or sealed
+                    uint64_t m_seal_seq = 0;
+                };
+
+                std::vector<std::unique_ptr<buffer_t>> m_buffers;
+                std::atomic<std::size_t> m_active{ 0 };
+
+                std::atomic<uint64_t> m_seal_seq{ 0 };
+                std::atomic<uint64_t> m_consume_seq{ 0 };
+                std::atomic<uint64_t> m_dropped_bytes{ 0 };
+
+                buffered_multi_optimistic_endpoint_t(
+                    std::shared_ptr<endpoint_t> endpoint
+                    , const buffered_endpoint_t::buffered_endpoint_params_t bpo
+                    , const buffered_multi_optimistic_params_t po
+                );
+
+                bool consume(const uint8_t* p, const uint8_t* e) final;
+                bool consume_frames(const uint8_t* p, const uint8_t* e, const std::size_t frame_size) final;
+
+                uint64_t dropped_bytes() const { return m_dropped_bytes.load(); }
+                uint64_t pending() final { return m_buffers[m_active.load()]->m_frame_start.load(std::memory_order_relaxed); }
+
+            protected:
+                bool flush() final;
+
+            private:
+                uint64_t in_copy() const noexcept { return m_sz + 1; }
+                uint64_t sealed() const noexcept { return m_sz + 2; }
+
+                enum class seal_result_t { SEALED, RETRY, ALL_IN_FLIGHT, CONSUME_FAILED };
+                seal_result_t seal(const std::size_t idx, uint64_t occupied);
+            };
+
+        }
+    }
+}
@@ -0,0 +1,133 @@
+#pragma once
+
+#include <vector>
+#include <mutex>
+#include <algorithm>
+#include <atomic>
+#include <thread>
+#include <chrono>
+#include <condition_variable>
+#include "neutrino_aligned.hpp"
+#include "neutrino_transport_buffered_st.hpp"
+
+namespace neutrino
+{
+    namespace impl
+    {
+        namespace transport
+        {
+            // each producer thread writes into its own SPSC ring (registered lazily on first consume),
+            // single drainer thread moves records from rings into the inherited buffer and flushes it downstream
+            // with usual size/watermark rules.
+            struct buffered_per_thread_endpoint_t : public buffered_singlethread_endpoint_t
+            {
+                struct buffered_per_thread_params_t
+                {
+                    std::size_t m_ring_size{ 64 * 1024 }; // per thread, rounded up to power of 2
+                    std::chrono::microseconds m_drain_period{ 1000 };
+                } const m_params;
+
+                // over-aligned, allocated by aligned_shared
+                struct ring_t
+                {
+                    typedef uint32_t record_len_t;
+                    static constexpr record_len_t wrap_marker = ~record_len_t(0);
+
+                    std::vector<uint8_t> m_buf;
+                    const uint64_t m_mask;
+
+                    // producer side
+                    alignas(64) std::atomic<uint64_t> m_head{ 0 };
+                    uint64_t m_cached_tail = 0;
+                    uint64_t m_reserved_head = 0; // end of the reserved record, published by commit()
+                    std::atomic<uint64_t> m_dropped_bytes{ 0 }; // written by producer only
+
+                    // drainer side
+                    alignas(64) std::atomic<uint64_t> m_tail{ 0 };
+
+                    std::atomic<bool> m_orphaned{ false }; // producer thread exited
+                    std::atomic<bool> m_detached{ false }; // endpoint is gone
+
+                    ring_t(std::size_t sz);
+
+                    bool push(const uint8_t* p, const uint8_t* e) noexcept;
+                    // room for a record of b bytes, invisible to the drainer until commit(); nullptr when full
+                    uint8_t* reserve(const std::size_t b) noexcept;
+                    void commit() noexcept { m_head.store(m_reserved_head, std::memory_order_release); }
+
+                    // calls f(p, e) for every record in order, stops (keeping the record) when f fails
+                    template <typename F>
+                    bool drain(F f)
+                    {
+                        auto tail = m_tail.load(std::memory_order_relaxed);
+                        const auto head = m_head.load(std::memory_order_acquire);
+                        bool ret = true;
+                        while (tail != head)
+                        {
+                            const auto idx = tail & m_mask;
+                            const auto contiguous = m_buf.size() - idx;
+                            record_len_t len = wrap_marker;
+                            if (contiguous >= sizeof(len))
+                                std::copy_n(&m_buf[idx], sizeof(len), reinterpret_cast<uint8_t*>(&len));
+                            if (len == wrap_marker)
+                            {
+                                tail += contiguous;
+                                continue;
+                            }
+                            const uint8_t* p = &m_buf[idx] + sizeof(len);
+                            if (!f(p, p + len))
+                            {
+                                ret = false;
+                                break;
+                            }
+                            tail += sizeof(len) + len;
+                        }
+                        m_tail.store(tail, std::memory_order_release);
+                        return ret;
+                    }
+                };
+
+                const uint64_t m_id; // process-wide unique, keys thread local ring lookup
+
+                std::mutex m_new_rings_mtx;
+                std::vector<std::shared_ptr<ring_t>> m_new_rings; // registered, not yet seen by drainer
+
+                std::mutex m_drain_mtx;
+                std::condition_variable m_drain_cv;
+                std::vector<std::shared_ptr<ring_t>> m_rings; // guarded by m_drain_mtx
+                std::atomic<uint64_t> m_retired_dropped_bytes{ 0 };
+                bool m_stop = false;
+
+                std::thread m_drainer;
+
+                buffered_per_thread_endpoint_t(
+                    std::shared_ptr<endpoint_t> endpoint
+                    , const buffered_endpoint_t::buffered_endpoint_params_t bpo
+                    , const buffered_per_thread_params_t po
+                );
+                ~buffered_per_thread_endpoint_t() override;
+
+                bool consume(const uint8_t* p, const uint8_t* e) final;
+                bool consume_frames(const uint8_t* p, const uint8_t* e, const std::size_t frame_size) final;
+                // a record in the ring of the calling thread, not the inherited buffer which is the drainer's
+                uint8_t* reserve(const std::size_t b) final;
+                bool commit(uint8_t* p, const std::size_t b) final;
+                // drainer interleaves records of threads
+                const std::atomic<uint64_t>* ordered_deliveries() const final { return nullptr; }
+
+                // bytes refused by producers because their ring was full
+                uint64_t dropped_bytes();
+                uint64_t pending() final;
+
+            protected:
+                bool flush() final;
+
+            private:
+                ring_t* this_thread_ring();
+                bool append_locked(const uint8_t* p, const uint8_t* e);
+                bool drain_locked();
+                void drainer();
+            };
+        }
+    }
+}
@@ -0,0 +1,61 @@
+#pragma once
+
+#include <vector>
+#include <memory>
+#include <functional>
+#include "neutrino_aligned.hpp"
+#include "neutrino_transport_buffered.hpp"
+
+namespace neutrino
+{
+    namespace impl
+    {
+        namespace transport
+        {
+            // routes producer threads to one of N multi thread safe buffered endpoints (shards) by CPU or thread id,
+            // so threads running on different cores do not share buffer cache lines.
+            // Each shard flushes independently into the downstream endpoint.
+            // Thread moving to other shard flushes its previous shard first, so frames of a thread reach downstream in order;
+            // frames of a stream written by several threads are ordered by nanoepoch.
+            struct buffered_sharded_endpoint_t : public endpoint_t
+            {
+                struct buffered_sharded_params_t
+                {
+                    enum class shard_selector_t
+                    {
+                        CPU // current CPU (sched_getcpu/GetCurrentProcessorNumber), thread id where not available
+                        , THREAD // hashed thread id, thread always stays in the same shard
+                    };
+                    std::size_t m_shards{ 0 }; // 0: one per hardware thread
+                    shard_selector_t m_selector{ shard_selector_t::CPU };
+                } const m_params;
+
+                // creates a shard, it must be multi thread safe and chained to the same downstream endpoint
+                typedef std::function<std::shared_ptr<endpoint_t>()> shard_factory_t;
+
+                struct alignas(64) shard_t
+                {
+                    std::shared_ptr<endpoint_t> m_endpoint;
+                };
+                std::vector<shard_t, aligned_allocator_t<shard_t>> m_shards;
+
+                const uint64_t m_id; // process-wide unique, keys thread local last shard lookup
+
+                buffered_sharded_endpoint_t(shard_factory_t f, const buffered_sharded_params_t po);
+                ~buffered_sharded_endpoint_t() override;
+
+                bool consume(const uint8_t* p, const uint8_t* e) final;
+                bool consume_frames(const uint8_t* p, const uint8_t* e, const std::size_t frame_size) final;
+
+                // live endpoints the calling thread keeps its last shard for, entries of destroyed ones are dropped
+                static std::size_t this_thread_endpoints();
+
+            protected:
+                bool flush() final;
+
+            private:
+                endpoint_t* this_thread_shard();
+            };
+        }
+    }
+}
@@ -1,25 +1,29 @@
-#pragma once
-
-#include <atomic>
-#include "neutrino_transport_buffered.hpp"
-
-namespace neutrino
-{
-    namespace impl
-    {
-        namespace transport
-        {
-            struct buffered_singlethread_endpoint_t : public buffered_endpoint_t
-            {
-                using buffered_endpoint_t::buffered_endpoint_t;
-
-                uint64_t m_frame_start{ 0 };
-
-                bool consume(const uint8_t* p, const uint8_t* e) override;
-
-            protected:
-                bool flush() override;
-            };
-        }
-    }
-}
+#pragma once
+
+#include <atomic>
+#include "neutrino_transport_buffered.hpp"
+
+namespace neutrino
+{
+    namespace impl
+    {
+        namespace transport
+        {
+            struct buffered_singlethread_endpoint_t : public buffered_endpoint_t
+            {
+                using buffered_endpoint_t::buffered_endpoint_t;
+
+                uint64_t m_frame_start{ 0 };
+
+                bool consume(const uint8_t* p, const uint8_t* e) override;
+                bool consume_frames(const uint8_t* p, const uint8_t* e, const std::size_t frame_size) override;
+                uint8_t* reserve(const std::size_t b) override;
+                bool commit(uint8_t* p, const std::size_t b) override;
+                const std::atomic<uint64_t>* ordered_deliveries() const override { return &m_deliveries; }
+
+            protected:
+                bool flush() override;
+            };
+        }
+    }
+}
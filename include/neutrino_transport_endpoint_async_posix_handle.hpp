@@ -1,31 +1,82 @@
-#pragma once
-
-#include "neutrino_transport.hpp"
-
-namespace neutrino
-{
-    namespace impl
-    {
-        namespace transport
-        {
-            struct async_posix_consumer_t : public endpoint_t
-            {
-                struct async_posix_consumer_params_t
-                {
-                };
-
-                async_posix_consumer_params_t m_params;
-
-                async_posix_consumer_t(const async_posix_consumer_params_t asp/*, const endpoint_consumer_t::endpoint_params_t p*/)
-                    : m_params(asp), endpoint_t(/*p*/)
-                {
-                }
-
-                bool consume(const uint8_t* p, const uint8_t* e) final
-                {
-                    return false;
-                }
-            };
-        }
-    }
-}
+#pragma once
+
+#include <deque>
+#include <vector>
+#include <mutex>
+#include <atomic>
+#include <thread>
+#include <chrono>
+#include <condition_variable>
+#include "neutrino_transport.hpp"
+
+namespace neutrino
+{
+    namespace impl
+    {
+        namespace transport
+        {
+            // file, pipe or FIFO sink: consume() copies the buffer into a queue and returns,
+            // writer thread coalesces queued buffers with writev, waits for POLLOUT on EAGAIN and resumes partial writes.
+            // Producer thread never blocks on the fd; buffer which does not fit under m_max_queue_bytes is dropped and counted.
+            struct async_posix_consumer_t : public endpoint_t
+            {
+                struct async_posix_consumer_params_t
+                {
+                    int m_fd{ -1 };
+                    bool m_close_fd{ false }; // fd is owned, closed on destruction
+                    std::size_t m_max_queue_bytes{ 16 * 1024 * 1024 };
+                    std::size_t m_max_iov{ 64 }; // buffers per writev, capped by IOV_MAX
+                };
+
+                async_posix_consumer_params_t m_params;
+
+                struct metrics_t
+                {
+                    std::size_t m_queue_depth = 0; // buffers waiting for the writer
+                    uint64_t m_bytes_in_flight = 0; // queued or being written
+                    uint64_t m_bytes_written = 0;
+                    uint64_t m_bytes_dropped = 0; // queue overflow or write error
+                    uint64_t m_writes = 0; // writev calls
+                    uint64_t m_write_errors = 0;
+                    std::chrono::nanoseconds m_last_write_latency{ 0 }; // oldest buffer of a batch, enqueue to fully written
+                    std::chrono::nanoseconds m_max_write_latency{ 0 };
+                };
+
+                async_posix_consumer_t(const async_posix_consumer_params_t asp);
+                ~async_posix_consumer_t() override;
+
+                bool consume(const uint8_t* p, const uint8_t* e) final;
+                bool consumev(const region_t* r, const std::size_t count) final;
+
+                // waits until everything queued so far is written (or dropped on error)
+                bool flush() final;
+
+                metrics_t metrics();
+
+            private:
+                struct buffer_t
+                {
+                    std::vector<uint8_t> m_data;
+                    std::chrono::steady_clock::time_point m_queued;
+                };
+
+                std::mutex m_mtx;
+                std::condition_variable m_cv; // writer waits for data
+                std::condition_variable m_written_cv; // flush() waits for the writer
+                std::deque<buffer_t> m_queue;
+                std::vector<std::vector<uint8_t>> m_free; // written buffers reused by consume()
+                uint64_t m_enqueued_seq = 0;
+                uint64_t m_written_seq = 0;
+                bool m_stop = false;
+                metrics_t m_metrics;
+
+                std::thread m_writer;
+
+                bool enqueue(const region_t* r, const std::size_t count);
+                void writer();
+                // bytes written, the whole batch unless an error stopped it
+                uint64_t write_batch(const std::deque<buffer_t>& batch, uint64_t& writes);
+            };
+        }
+    }
+}
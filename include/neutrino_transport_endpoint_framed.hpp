@@ -0,0 +1,91 @@
+#pragma once
+
+#include <array>
+#include <memory>
+#include <vector>
+#include "neutrino_transport.hpp"
+
+namespace neutrino
+{
+    namespace impl
+    {
+        namespace transport
+        {
+            // self-delimiting records for channels which may corrupt or mix data (files, pipes, foreign producers):
+            // magic[2] kind[1] flags[1] length[4] crc32c[4] payload[length], integers in network byte order.
+            // crc covers kind, flags, length and the payload, so a damaged length is caught as well.
+            namespace framed
+            {
+                const uint8_t magic[2] = { 0xF7, 0x4E };
+                const std::size_t header_size = 12;
+
+                // Castagnoli, crc32 instruction when the CPU has SSE4.2, table otherwise; crc of the bytes before p in, 0 to start
+                uint32_t crc32c(uint32_t crc, const uint8_t* p, const uint8_t* e) noexcept;
+                // the same with the table, the reference for the instruction
+                uint32_t crc32c_scalar(uint32_t crc, const uint8_t* p, const uint8_t* e) noexcept;
+                // crc32c takes the instruction on this CPU
+                bool crc32c_sse42() noexcept;
+            }
+
+            // producer side: every consume() becomes one record of m_kind in front of the endpoint
+            struct framed_endpoint_t : public endpoint_t
+            {
+                struct framed_params_t
+                {
+                    frame_v00::known_encodings_t m_kind{ frame_v00::known_encodings_t::BINARY_NATIVE };
+                } const m_params;
+
+                endpoint_t& m_endpoint;
+
+                framed_endpoint_t(const framed_params_t po, endpoint_t& endpoint)
+                    : m_params(po), m_endpoint(endpoint) {}
+
+                bool consume(const uint8_t* p, const uint8_t* e) final;
+                // the run is one record, so it is never split by the buffered endpoint behind
+                bool consume_frames(const uint8_t* p, const uint8_t* e, const std::size_t) final { return consume(p, e); }
+                bool flush() final { return m_endpoint.flush(); }
+            };
+
+            // consumer side: checks records and hands payloads to the deserializer of their kind.
+            // Records of unknown kinds are skipped by length, after a bad header or crc the input is scanned for the next magic.
+            // A record cut at the end of the input is kept and completed by the next consume(), so reads may cut anywhere.
+            struct deframer_endpoint_t : public endpoint_t
+            {
+                struct deframer_params_t
+                {
+                    std::size_t m_max_record{ 16 * 1024 * 1024 }; // larger length is treated as corruption
+                } const m_params;
+
+                struct metrics_t
+                {
+                    uint64_t m_records = 0; // passed the crc check
+                    uint64_t m_records_unknown = 0; // skipped, no deserializer for the kind
+                    uint64_t m_records_refused = 0; // deserializer did not consume the whole payload
+                    uint64_t m_records_corrupt = 0; // crc mismatch
+                    uint64_t m_resyncs = 0; // scans for the next magic
+                    uint64_t m_bytes_dropped = 0; // skipped by the scans, including truncated records
+                };
+
+                deframer_endpoint_t(const deframer_params_t po, consumer_t& consumer)
+                    : m_params(po), m_consumer(consumer) {}
+
+                // false: something was dropped, see metrics(); a record waiting for its rest is not dropped yet
+                bool consume(const uint8_t* p, const uint8_t* e) final;
+                bool flush() final { return true; }
+
+                // not synchronized with consume()
+                const metrics_t& metrics() const { return m_metrics; }
+
+            private:
+                consumer_t& m_consumer;
+                metrics_t m_metrics;
+                std::array<std::shared_ptr<endpoint_impl_t>, static_cast<std::size_t>(frame_v00::known_encodings_t::_LAST)> m_deserializers;
+                std::vector<uint8_t> m_tail; // beginning of a record cut by the end of the previous input, starts with magic[0]
+
+                endpoint_impl_t* deserializer(const uint8_t kind);
+                // whole record at p with a sane length: false on crc mismatch, ret is false when the payload is refused
+                bool deliver(const uint8_t* p, bool& ret);
+            };
+        }
+    }
+}
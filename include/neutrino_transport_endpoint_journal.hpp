@@ -0,0 +1,120 @@
+#pragma once
+
+#include <string>
+#include <mutex>
+#include <atomic>
+#include "neutrino_transport.hpp"
+#include "neutrino_clock.hpp"
+
+namespace neutrino
+{
+    namespace impl
+    {
+        namespace transport
+        {
+            // append only capture journal: segment files <m_path>.000000, <m_path>.000001, ... preallocated and memory mapped.
+            // Each consume() is one length prefixed record copied into the mapping, then published in the segment header,
+            // so the hot path has no syscalls and whatever was published survives a crash of the process.
+            // Segments are never overwritten: a new run starts with the segment after the last existing one
+            // (each segment keeps the clock calibration of its run) and seals the one the previous run left open.
+            namespace journal
+            {
+                struct segment_header_t
+                {
+                    static constexpr uint64_t magic = 0x006C6E726A746E6Eull; // "nntjrnl"
+                    static constexpr uint32_t version = 1;
+                    typedef uint32_t record_len_t;
+
+                    uint64_t m_magic;
+                    uint32_t m_version;
+                    uint32_t m_header_size; // records start here
+                    uint64_t m_segment_seq;
+                    uint64_t m_segment_size;
+                    uint32_t m_encoding; // frame_v00::known_encodings_t
+                    uint32_t m_clock_source; // clock::clock_source_t, m_calibration is valid for TSC_RAW
+                    uint64_t m_ticks0;
+                    uint64_t m_nanoepoch0;
+                    uint64_t m_mult;
+                    uint64_t m_shift;
+                    char m_producer_id[64]; // zero terminated, truncated
+
+                    alignas(64) std::atomic<uint64_t> m_committed; // record bytes published after the header
+                    std::atomic<uint32_t> m_sealed; // 1: writer moved to the next segment
+                };
+
+                std::string segment_path(const std::string& path, const uint64_t seq);
+            }
+
+            struct journal_endpoint_t : public endpoint_t
+            {
+                struct journal_params_t
+                {
+                    std::string m_path; // segment files prefix
+                    std::size_t m_segment_size{ 64 * 1024 * 1024 };
+                    frame_v00::known_encodings_t m_encoding{ frame_v00::known_encodings_t::BINARY_NATIVE };
+                    std::string m_producer_id; // producer::config_t::m_producer_id
+                } const m_params;
+
+                journal_endpoint_t(const journal_params_t po);
+                ~journal_endpoint_t() override;
+
+                bool valid() const { return m_segment != nullptr; }
+                // errno of the last segment which could not be created, EEXIST: another writer uses the path
+                int error() const { return m_error; }
+                uint64_t segment_seq() const { return m_seq; }
+
+                // record larger than a segment is refused
+                bool consume(const uint8_t* p, const uint8_t* e) final;
+
+                // asks kernel to write dirty pages back (msync MS_ASYNC), not needed for crash of the process
+                bool flush() final;
+
+            private:
+                std::mutex m_mtx; // buffered endpoints may flush from several threads
+                uint64_t m_seq = 0;
+                int m_error = 0;
+                journal::segment_header_t* m_segment = nullptr;
+                uint64_t m_committed = 0; // writer's copy of m_segment->m_committed
+
+                bool open_segment(const uint64_t seq);
+                void close_segment();
+            };
+
+            // replays journal segments in order, records are handed to the endpoint straight from the mapping
+            struct journal_reader_t
+            {
+                struct metrics_t
+                {
+                    uint64_t m_records = 0; // handed to the endpoint
+                    uint64_t m_records_refused = 0; // endpoint returned false
+                    uint64_t m_damaged = 0; // record out of the published bytes, the rest of them is skipped
+                    uint64_t m_bytes_skipped = 0;
+                };
+
+                journal_reader_t(const std::string& path);
+                ~journal_reader_t();
+
+                // maps the next segment, false when there is none (or it is not a journal segment)
+                bool next_segment();
+
+                // current segment, pick deserializer by m_encoding and clock by m_clock_source/calibration
+                const journal::segment_header_t* header() const { return m_segment; }
+
+                // hands published records of current segment not replayed yet to e, returns their number
+                std::size_t replay(endpoint_t& e);
+
+                const metrics_t& metrics() const { return m_metrics; }
+
+            private:
+                const std::string m_path;
+                uint64_t m_next_seq = 0;
+                journal::segment_header_t* m_segment = nullptr;
+                std::size_t m_mapping_size = 0;
+                uint64_t m_replayed = 0;
+                metrics_t m_metrics;
+
+                void close_segment();
+            };
+        }
+    }
+}
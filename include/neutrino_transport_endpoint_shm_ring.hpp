@@ -0,0 +1,116 @@
+#pragma once
+
+#include <string>
+#include <mutex>
+#include <atomic>
+#include <chrono>
+#include "neutrino_transport.hpp"
+
+namespace neutrino
+{
+    namespace impl
+    {
+        namespace transport
+        {
+            // single producer process -> aggregator ring in shared memory (shm_open name or memfd)
+            // each consume() is one length prefixed record, the reader hands records to its endpoint (deserializer) as is.
+            // Reader sleeps on a futex in the ring only when the ring is empty, so steady state flush costs no syscall.
+            // Ring outlives the producer: aggregator drains what was published before producer exited or crashed,
+            // a producer restarted with the same name appends to the ring it left.
+            namespace shm_ring
+            {
+                struct header_t
+                {
+                    static constexpr uint64_t magic = 0x00676E6972746E6Eull; // "nntring"
+                    typedef uint32_t record_len_t;
+                    static constexpr record_len_t wrap_marker = ~record_len_t(0);
+
+                    std::atomic<uint64_t> m_magic; // set last, ring is ready
+                    uint64_t m_size; // data bytes following the header, power of 2
+
+                    alignas(64) std::atomic<uint64_t> m_head; // producer
+                    std::atomic<uint64_t> m_dropped_bytes;
+
+                    alignas(64) std::atomic<uint64_t> m_tail; // reader
+                    std::atomic<uint32_t> m_reader_idle; // futex word, 1: reader is about to sleep or sleeps
+
+                    alignas(64) uint8_t m_data[1];
+                };
+
+                // bytes to map for a ring with data_size bytes of data
+                std::size_t mapping_size(const std::size_t data_size);
+            }
+
+            struct shm_ring_endpoint_t : public endpoint_t
+            {
+                struct shm_ring_params_t
+                {
+                    std::string m_name; // shm_open name, empty: anonymous memfd, pass fd() to the aggregator
+                                        // an existing object must be a ring of the same size, it is never truncated
+                    std::size_t m_size{ 1024 * 1024 }; // rounded up to power of 2
+                } const m_params;
+
+                shm_ring_endpoint_t(const shm_ring_params_t po);
+                ~shm_ring_endpoint_t() override;
+
+                // false when ring could not be created or attached
+                bool valid() const { return m_ring != nullptr; }
+                // errno of the failed step when not valid(), EINVAL: existing object is not a ring of this size
+                int error() const { return m_error; }
+                int fd() const { return m_fd; }
+
+                // record does not fit when reader is behind, it is dropped and counted
+                bool consume(const uint8_t* p, const uint8_t* e) final;
+
+                uint64_t dropped_bytes() const;
+
+            private:
+                int m_fd = -1;
+                int m_error = 0;
+                std::size_t m_mapping_size = 0;
+                shm_ring::header_t* m_ring = nullptr;
+                std::mutex m_mtx; // buffered endpoints may flush from several threads
+            };
+
+            struct shm_ring_reader_t
+            {
+                struct metrics_t
+                {
+                    uint64_t m_records = 0; // handed to the endpoint
+                    uint64_t m_records_refused = 0; // endpoint returned false
+                    uint64_t m_corruptions = 0; // length or wrap out of the published range
+                    uint64_t m_bytes_skipped = 0; // published bytes dropped after a corruption
+                };
+
+                // opens the ring by shm_open name or by fd received from the producer
+                shm_ring_reader_t(const std::string& name);
+                shm_ring_reader_t(int fd);
+                ~shm_ring_reader_t();
+
+                bool valid() const { return m_ring != nullptr; }
+
+                // hands published records to e in order, returns number of bytes drained
+                // a record which does not fit into what is published skips everything published, see metrics()
+                std::size_t drain(endpoint_t& e);
+
+                // false on timeout, sleeps only when the ring is empty
+                bool wait(const std::chrono::milliseconds timeout);
+
+                uint64_t dropped_bytes() const;
+                // not synchronized with drain()
+                const metrics_t& metrics() const { return m_metrics; }
+
+                // removes shm_open name, mappings stay valid
+                static bool remove(const std::string& name);
+
+            private:
+                int m_fd = -1;
+                std::size_t m_mapping_size = 0;
+                shm_ring::header_t* m_ring = nullptr;
+                metrics_t m_metrics;
+
+                void map(int fd);
+            };
+        }
+    }
+}
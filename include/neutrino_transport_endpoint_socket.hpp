@@ -0,0 +1,142 @@
+#pragma once
+
+#include <deque>
+#include <vector>
+#include <string>
+#include <mutex>
+#include <atomic>
+#include <thread>
+#include <chrono>
+#include <functional>
+#include <condition_variable>
+#include "neutrino_transport.hpp"
+
+namespace neutrino
+{
+    namespace impl
+    {
+        namespace transport
+        {
+            namespace socket
+            {
+                enum class kind_t
+                {
+                    UNIX_STREAM // m_address is a file system path
+                    , UNIX_SEQPACKET
+                    , TCP // m_address is "host:port", port 0 asks acceptor for an ephemeral one
+                };
+
+                // every consumed buffer is one record on the wire: 32 bit length in network byte order, then the buffer
+                typedef uint32_t record_len_t;
+            }
+
+            // sender side: consume() queues the buffer, sender thread batches queued records into one sendmsg,
+            // reconnects every m_reconnect_period and keeps up to m_max_backlog_bytes meanwhile (excess is dropped and counted).
+            // Record cut by a broken connection is sent again as a whole on the next one,
+            // records written whole before the break are not (the peer may have lost them, it never gets them twice).
+            struct socket_endpoint_t : public endpoint_t
+            {
+                struct socket_endpoint_params_t
+                {
+                    socket::kind_t m_kind{ socket::kind_t::UNIX_STREAM };
+                    std::string m_address;
+                    std::size_t m_max_backlog_bytes{ 16 * 1024 * 1024 };
+                    std::size_t m_max_iov{ 64 }; // records per sendmsg on stream sockets
+                    std::chrono::milliseconds m_reconnect_period{ 100 };
+                } const m_params;
+
+                struct metrics_t
+                {
+                    bool m_connected = false;
+                    std::size_t m_queue_depth = 0;
+                    uint64_t m_backlog_bytes = 0; // queued records including length prefix
+                    uint64_t m_bytes_sent = 0;
+                    uint64_t m_bytes_dropped = 0;
+                    uint64_t m_sends = 0; // sendmsg calls
+                    uint64_t m_connects = 0;
+                    uint64_t m_disconnects = 0;
+                };
+
+                socket_endpoint_t(const socket_endpoint_params_t po);
+                ~socket_endpoint_t() override;
+
+                bool consume(const uint8_t* p, const uint8_t* e) final;
+                bool consumev(const region_t* r, const std::size_t count) final;
+
+                // waits until everything queued so far is sent, false on timeout
+                bool flush(const std::chrono::milliseconds timeout);
+                bool flush() final { return flush(std::chrono::milliseconds(1000)); }
+
+                metrics_t metrics();
+
+            private:
+                std::mutex m_mtx;
+                std::condition_variable m_cv;
+                std::condition_variable m_sent_cv;
+                std::deque<std::vector<uint8_t>> m_queue; // only sender pops, records stay in place while being sent
+                std::vector<std::vector<uint8_t>> m_free;
+                uint64_t m_enqueued_seq = 0;
+                uint64_t m_sent_seq = 0;
+                bool m_stop = false;
+                metrics_t m_metrics;
+
+                int m_fd = -1; // sender thread only
+
+                std::thread m_sender;
+
+                bool enqueue(const region_t* r, const std::size_t count);
+                void sender();
+                bool connect();
+                // number of records written whole, less than records.size() when the connection broke
+                std::size_t send(const std::vector<region_t>& records);
+            };
+
+            // server side: accepts connections of socket_endpoint_t, reassembles records split across reads
+            // and hands each one to the endpoint created for the connection (frame_v00 deserializer)
+            struct socket_acceptor_t
+            {
+                typedef std::function<std::shared_ptr<endpoint_t>()> connection_endpoint_factory_t;
+
+                struct socket_acceptor_params_t
+                {
+                    socket::kind_t m_kind{ socket::kind_t::UNIX_STREAM };
+                    std::string m_address;
+                    std::size_t m_max_record{ 16 * 1024 * 1024 }; // connection sending a larger record is closed
+                } const m_params;
+
+                socket_acceptor_t(const socket_acceptor_params_t po, connection_endpoint_factory_t f);
+                ~socket_acceptor_t();
+
+                bool valid() const { return m_listen_fd >= 0; }
+                // bound TCP port, useful with port 0
+                uint16_t port() const { return m_port; }
+
+                uint64_t records() const { return m_records.load(); }
+                uint64_t records_refused() const { return m_records_refused.load(); } // endpoint returned false
+                uint64_t connections() const { return m_connections.load(); }
+
+            private:
+                struct connection_t
+                {
+                    int m_fd;
+                    std::shared_ptr<endpoint_t> m_endpoint;
+                    std::vector<uint8_t> m_tail; // part of a record received so far
+                };
+
+                const connection_endpoint_factory_t m_factory;
+                int m_listen_fd = -1;
+                int m_wakeup[2] = { -1, -1 };
+                uint16_t m_port = 0;
+                std::atomic<uint64_t> m_records{ 0 };
+                std::atomic<uint64_t> m_records_refused{ 0 };
+                std::atomic<uint64_t> m_connections{ 0 };
+                std::vector<uint8_t> m_read_buf; // acceptor thread only
+
+                std::thread m_thread;
+
+                void run();
+                bool receive(connection_t& c);
+            };
+        }
+    }
+}
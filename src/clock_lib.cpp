@@ -0,0 +1,217 @@
+#include <atomic>
+#include <thread>
+#include <chrono>
+
+#include <time.h>
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#define NEUTRINO_CLOCK_X86
+#elif defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#include <cpuid.h>
+#define NEUTRINO_CLOCK_X86
+#endif
+
+#include <neutrino_clock.hpp>
+
+namespace
+{
+    using namespace neutrino::impl::clock;
+
+    const uint8_t tsc_mult_shift = 32;
+
+    std::atomic<clock_source_t> active_source{ clock_source_t::STEADY };
+    tsc_calibration_t active_calibration; // written before active_source is released
+
+    uint64_t steady_nanoepoch() noexcept
+    {
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+    }
+
+    uint64_t coarse_nanoepoch() noexcept
+    {
+#if defined(CLOCK_MONOTONIC_COARSE)
+        timespec ts;
+        clock_gettime(CLOCK_MONOTONIC_COARSE, &ts);
+        return uint64_t(ts.tv_sec) * 1000000000ull + uint64_t(ts.tv_nsec);
+#else
+        return steady_nanoepoch();
+#endif
+    }
+
+    bool coarse_supported() noexcept
+    {
+#if defined(CLOCK_MONOTONIC_COARSE)
+        timespec ts;
+        return 0 == clock_gettime(CLOCK_MONOTONIC_COARSE, &ts);
+#else
+        return false;
+#endif
+    }
+
+    uint64_t read_tsc() noexcept
+    {
+#if defined(NEUTRINO_CLOCK_X86)
+        return __rdtsc();
+#else
+        return 0;
+#endif
+    }
+
+    // serializing variant for calibration, waits for previous instructions to retire
+    uint64_t read_tscp() noexcept
+    {
+#if defined(NEUTRINO_CLOCK_X86)
+        unsigned int aux;
+        return __rdtscp(&aux);
+#else
+        return 0;
+#endif
+    }
+
+    bool invariant_tsc_supported() noexcept
+    {
+#if defined(NEUTRINO_CLOCK_X86)
+        // CPUID.80000007H:EDX[8] invariant TSC: constant rate in all ACPI P-, C- and T-states
+#if defined(_MSC_VER)
+        int regs[4];
+        __cpuid(regs, 0x80000000);
+        if (unsigned(regs[0]) < 0x80000007u)
+            return false;
+        __cpuid(regs, 0x80000007);
+        return (regs[3] & (1 << 8)) != 0;
+#else
+        unsigned int eax, ebx, ecx, edx;
+        if (!__get_cpuid(0x80000007, &eax, &ebx, &ecx, &edx))
+            return false;
+        return (edx & (1u << 8)) != 0;
+#endif
+#else
+        return false;
+#endif
+    }
+
+    uint64_t mul_shift(const uint64_t a, const uint64_t b, const uint8_t shift) noexcept
+    {
+#if defined(_MSC_VER) && defined(_M_X64)
+        uint64_t hi;
+        const uint64_t lo = _umul128(a, b, &hi);
+        return shift ? (hi << (64 - shift)) | (lo >> shift) : lo;
+#elif defined(__SIZEOF_INT128__)
+        return uint64_t((static_cast<unsigned __int128>(a) * b) >> shift);
+#else
+        // 32x32 partial products
+        const uint64_t a_lo = a & 0xffffffffull, a_hi = a >> 32;
+        const uint64_t b_lo = b & 0xffffffffull, b_hi = b >> 32;
+        const uint64_t lo_lo = a_lo * b_lo;
+        const uint64_t mid1 = a_hi * b_lo + (lo_lo >> 32);
+        const uint64_t mid2 = a_lo * b_hi + (mid1 & 0xffffffffull);
+        const uint64_t hi = a_hi * b_hi + (mid1 >> 32) + (mid2 >> 32);
+        const uint64_t lo = (mid2 << 32) | (lo_lo & 0xffffffffull);
+        return shift ? (hi << (64 - shift)) | (lo >> shift) : lo;
+#endif
+    }
+
+    // pairs steady clock with TSC read around it, the narrowest of a few attempts wins
+    void sample(uint64_t& ticks, uint64_t& nanoepoch) noexcept
+    {
+        uint64_t best = ~uint64_t(0);
+        for (int cc = 0; cc < 5; cc++)
+        {
+            const auto t0 = read_tscp();
+            const auto ns = steady_nanoepoch();
+            const auto t1 = read_tscp();
+            if (t1 - t0 < best)
+            {
+                best = t1 - t0;
+                ticks = t0 + (t1 - t0) / 2;
+                nanoepoch = ns;
+            }
+        }
+    }
+
+    bool calibrate_tsc(std::chrono::milliseconds period, tsc_calibration_t& c) noexcept
+    {
+        if (!invariant_tsc_supported())
+            return false;
+
+        uint64_t ticks0, ns0, ticks1, ns1;
+        sample(ticks0, ns0);
+        std::this_thread::sleep_for(period);
+        sample(ticks1, ns1);
+
+        if (ticks1 <= ticks0 || ns1 <= ns0)
+            return false;
+
+        c.m_ticks0 = ticks0;
+        c.m_nanoepoch0 = ns0;
+        c.m_shift = tsc_mult_shift;
+        c.m_mult = uint64_t(double(ns1 - ns0) * double(uint64_t(1) << tsc_mult_shift) / double(ticks1 - ticks0));
+        return c.m_mult != 0;
+    }
+}
+
+namespace neutrino
+{
+    namespace impl
+    {
+        namespace clock
+        {
+            uint64_t tsc_calibration_t::to_nanoepoch(const uint64_t ticks) const noexcept
+            {
+                // ticks read on a core slightly behind calibration sample
+                if (ticks < m_ticks0)
+                    return m_nanoepoch0 - mul_shift(m_ticks0 - ticks, m_mult, m_shift);
+                return m_nanoepoch0 + mul_shift(ticks - m_ticks0, m_mult, m_shift);
+            }
+
+            bool startup(clock_source_t source, std::chrono::milliseconds calibration_period) noexcept
+            {
+                bool ret = true;
+                switch (source)
+                {
+                case clock_source_t::MONOTONIC_COARSE:
+                    ret = coarse_supported();
+                    break;
+                case clock_source_t::TSC:
+                case clock_source_t::TSC_RAW:
+                    ret = calibrate_tsc(calibration_period, active_calibration);
+                    break;
+                case clock_source_t::STEADY:
+                default:
+                    break;
+                }
+                active_source.store(ret ? source : clock_source_t::STEADY, std::memory_order_release);
+                return ret;
+            }
+
+            clock_source_t source() noexcept
+            {
+                return active_source.load(std::memory_order_acquire);
+            }
+
+            const tsc_calibration_t& calibration() noexcept
+            {
+                return active_calibration;
+            }
+
+            uint64_t nanoepoch() noexcept
+            {
+                switch (active_source.load(std::memory_order_acquire))
+                {
+                case clock_source_t::TSC:
+                    return active_calibration.to_nanoepoch(read_tsc());
+                case clock_source_t::TSC_RAW:
+                    return read_tsc();
+                case clock_source_t::MONOTONIC_COARSE:
+                    return coarse_nanoepoch();
+                case clock_source_t::STEADY:
+                default:
+                    break;
+                }
+                return steady_nanoepoch();
+            }
+        }
+    }
+}
@@ -0,0 +1,165 @@
+#include <algorithm>
+#include <cmath>
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
+#include <neutrino_consumer_latency.hpp>
+
+namespace neutrino
+{
+    namespace impl
+    {
+        namespace consumer
+        {
+            namespace
+            {
+                const uint32_t npos = ~uint32_t(0);
+                const uint64_t linear_values = uint64_t(2) << latency_histogram_t::sub_bucket_bits;
+                const uint64_t max_value = (uint64_t(1) << latency_histogram_t::max_bits) - 1;
+
+                inline unsigned bit_length(const uint64_t v) noexcept
+                {
+#if defined(_MSC_VER)
+                    unsigned long idx;
+                    _BitScanReverse64(&idx, v | 1);
+                    return unsigned(idx) + 1;
+#else
+                    return 64 - unsigned(__builtin_clzll(v | 1));
+#endif
+                }
+
+                inline std::size_t hash(const uint64_t a, const uint64_t b) noexcept
+                {
+                    return std::size_t(((a * 0x9E3779B97F4A7C15ull) ^ (b * 0xC2B2AE3D27D4EB4Full)) >> 29);
+                }
+            }
+
+            std::size_t latency_histogram_t::bucket_of(const uint64_t v) noexcept
+            {
+                const uint64_t c = std::min(v, max_value);
+                if (c < linear_values)
+                    return std::size_t(c);
+                // top sub_bucket_bits + 1 bits of the value, e dropped below them
+                const unsigned e = bit_length(c) - 1 - sub_bucket_bits;
+                return (std::size_t(e + 1) << sub_bucket_bits) + std::size_t((c >> e) - (uint64_t(1) << sub_bucket_bits));
+            }
+
+            uint64_t latency_histogram_t::highest_of(const std::size_t b) noexcept
+            {
+                if (b < linear_values)
+                    return b;
+                const unsigned e = unsigned(b >> sub_bucket_bits) - 1;
+                const uint64_t top = (uint64_t(1) << sub_bucket_bits) + (b & ((std::size_t(1) << sub_bucket_bits) - 1));
+                return (top << e) + (uint64_t(1) << e) - 1;
+            }
+
+            void latency_histogram_t::merge(const latency_histogram_t& h)
+            {
+                for (std::size_t b = 0; b < buckets; b++)
+                    m_counts[b] += h.m_counts[b];
+            }
+
+            uint64_t latency_histogram_t::count() const
+            {
+                uint64_t n = 0;
+                for (const auto c : m_counts)
+                    n += c;
+                return n;
+            }
+
+            uint64_t latency_histogram_t::value_at(const double p) const
+            {
+                const uint64_t n = count();
+                if (!n)
+                    return 0;
+                const uint64_t rank = std::min<uint64_t>(n, std::max<uint64_t>(1, uint64_t(std::ceil(p * double(n)))));
+                uint64_t seen = 0;
+                for (std::size_t b = 0; b < buckets; b++)
+                {
+                    seen += m_counts[b];
+                    if (seen >= rank)
+                        return highest_of(b);
+                }
+                return max_value;
+            }
+
+            latency_table_t::latency_table_t(const latency_table_params_t po)
+                : m_params(po)
+                , m_records(new record_t[std::max<std::size_t>(po.m_max_keys, 1)]())
+            {
+                std::size_t slots = 2;
+                while (slots < 2 * m_params.m_max_keys)
+                    slots *= 2;
+                m_slots.reset(new std::atomic<uint32_t>[slots]);
+                for (std::size_t cc = 0; cc < slots; cc++)
+                    m_slots[cc].store(npos, std::memory_order_relaxed);
+                m_mask = slots - 1;
+            }
+
+            std::size_t latency_table_t::find(
+                const local::payload::stream_id_t::type_t stream_id
+                , const local::payload::event_id_t::type_t event_id
+                , uint32_t& record
+            ) const
+            {
+                // linear probing without removal, a reader stops at the first slot not published yet
+                std::size_t i = hash(stream_id, event_id) & m_mask;
+                for (;; i = (i + 1) & m_mask)
+                {
+                    record = m_slots[i].load(std::memory_order_acquire);
+                    if (record == npos || (m_records[record].m_stream_id == stream_id && m_records[record].m_event_id == event_id))
+                        return i;
+                }
+            }
+
+            void latency_table_t::copy(const record_t& r, latency_histogram_t& h)
+            {
+                for (std::size_t b = 0; b < latency_histogram_t::buckets; b++)
+                    h.m_counts[b] += r.m_counts[b].load(std::memory_order_relaxed);
+            }
+
+            void latency_table_t::record(
+                const local::payload::stream_id_t::type_t stream_id
+                , const local::payload::event_id_t::type_t event_id
+                , const local::payload::nanoepoch_t::type_t duration
+            )
+            {
+                uint32_t r;
+                const std::size_t i = find(stream_id, event_id, r);
+                if (r == npos)
+                {
+                    const std::size_t n = m_size.load(std::memory_order_relaxed);
+                    if (n == m_params.m_max_keys)
+                    {
+                        m_metrics.m_dropped++;
+                        return;
+                    }
+                    r = uint32_t(n);
+                    m_records[r].m_stream_id = stream_id;
+                    m_records[r].m_event_id = event_id;
+                    m_slots[i].store(r, std::memory_order_release);
+                    m_size.store(n + 1, std::memory_order_release);
+                }
+                // single writer, a plain increment readers see whole
+                std::atomic<uint64_t>& c = m_records[r].m_counts[latency_histogram_t::bucket_of(duration)];
+                c.store(c.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+            }
+
+            bool latency_table_t::snapshot(
+                const local::payload::stream_id_t::type_t stream_id
+                , const local::payload::event_id_t::type_t event_id
+                , latency_histogram_t& h
+            ) const
+            {
+                uint32_t r;
+                find(stream_id, event_id, r);
+                if (r == npos)
+                    return false;
+                copy(m_records[r], h);
+                return true;
+            }
+        }
+    }
+}
@@ -1,7 +1,354 @@
-
-namespace neutrino
-{
-    namespace impl
-    {
-    }
-}
\ No newline at end of file
+#include <algorithm>
+
+#include <neutrino_consumer.hpp>
+
+namespace neutrino
+{
+    namespace impl
+    {
+        namespace consumer
+        {
+            namespace
+            {
+                const uint32_t npos = stream_state_t::npos;
+
+                stream_table_t::stream_table_params_t at_least_one_stream(stream_table_t::stream_table_params_t po)
+                {
+                    po.m_max_streams = std::max<std::size_t>(po.m_max_streams, 1);
+                    return po;
+                }
+            }
+
+            stream_table_t::stream_table_t(const stream_table_params_t po)
+                : m_params(at_least_one_stream(po))
+            {
+                std::size_t slots = 2;
+                m_shift = 63;
+                while (slots < 2 * m_params.m_max_streams)
+                {
+                    slots *= 2;
+                    m_shift--;
+                }
+                m_slots.resize(slots, slot_t{ 0, npos });
+                m_states.reserve(m_params.m_max_streams);
+                m_cursors.resize(m_params.m_max_streams * m_params.m_pattern_cursors);
+
+                m_blocks.resize(m_params.m_max_stack_blocks);
+                for (std::size_t cc = m_blocks.size(); cc-- > 0; )
+                {
+                    m_blocks[cc].m_prev = m_free_block;
+                    m_free_block = uint32_t(cc);
+                }
+            }
+
+            std::size_t stream_table_t::slot_of(const local::payload::stream_id_t::type_t stream_id) const
+            {
+                // fibonacci hashing, sequential stream ids spread over the table
+                const std::size_t mask = m_slots.size() - 1;
+                std::size_t i = std::size_t((stream_id * 0x9E3779B97F4A7C15ull) >> m_shift);
+                while (m_slots[i].m_state != npos && m_slots[i].m_stream_id != stream_id)
+                    i = (i + 1) & mask;
+                return i;
+            }
+
+            void stream_table_t::lru_unlink(const uint32_t idx)
+            {
+                stream_state_t& s = m_states[idx];
+                (s.m_lru_prev != npos ? m_states[s.m_lru_prev].m_lru_next : m_lru_head) = s.m_lru_next;
+                (s.m_lru_next != npos ? m_states[s.m_lru_next].m_lru_prev : m_lru_tail) = s.m_lru_prev;
+            }
+
+            void stream_table_t::lru_push_front(const uint32_t idx)
+            {
+                stream_state_t& s = m_states[idx];
+                s.m_lru_prev = npos;
+                s.m_lru_next = m_lru_head;
+                (m_lru_head != npos ? m_states[m_lru_head].m_lru_prev : m_lru_tail) = idx;
+                m_lru_head = idx;
+            }
+
+            void stream_table_t::remove(const uint32_t idx)
+            {
+                stream_state_t& s = m_states[idx];
+                while (s.m_depth)
+                    pop(s);
+
+                // backward shift deletion, probe chains stay without tombstones
+                const std::size_t mask = m_slots.size() - 1;
+                std::size_t i = slot_of(s.m_stream_id);
+                for (std::size_t j = (i + 1) & mask; m_slots[j].m_state != npos; j = (j + 1) & mask)
+                {
+                    const std::size_t home = std::size_t((m_slots[j].m_stream_id * 0x9E3779B97F4A7C15ull) >> m_shift);
+                    if (i <= j ? (i < home && home <= j) : (i < home || home <= j))
+                        continue;
+                    m_slots[i] = m_slots[j];
+                    i = j;
+                }
+                m_slots[i].m_state = npos;
+                lru_unlink(idx);
+
+                // last state moves into the hole
+                const uint32_t last = uint32_t(m_states.size() - 1);
+                if (idx != last)
+                {
+                    stream_state_t& moved = m_states[idx] = m_states[last];
+                    m_slots[slot_of(moved.m_stream_id)].m_state = idx;
+                    (moved.m_lru_prev != npos ? m_states[moved.m_lru_prev].m_lru_next : m_lru_head) = idx;
+                    (moved.m_lru_next != npos ? m_states[moved.m_lru_next].m_lru_prev : m_lru_tail) = idx;
+                    std::copy_n(m_cursors.begin() + last * m_params.m_pattern_cursors, m_params.m_pattern_cursors, m_cursors.begin() + idx * m_params.m_pattern_cursors);
+                }
+                m_states.pop_back();
+            }
+
+            stream_state_t& stream_table_t::touch(const local::payload::stream_id_t::type_t stream_id, const local::payload::nanoepoch_t::type_t nanoepoch)
+            {
+                std::size_t i = slot_of(stream_id);
+                if (m_slots[i].m_state != npos)
+                {
+                    const uint32_t idx = m_slots[i].m_state;
+                    if (idx != m_lru_head)
+                    {
+                        lru_unlink(idx);
+                        lru_push_front(idx);
+                    }
+                    stream_state_t& s = m_states[idx];
+                    s.m_last_nanoepoch = nanoepoch;
+                    return s;
+                }
+
+                if (m_states.size() == m_params.m_max_streams)
+                {
+                    remove(m_lru_tail);
+                    m_metrics.m_evicted_lru++;
+                    i = slot_of(stream_id);
+                }
+
+                const uint32_t idx = uint32_t(m_states.size());
+                m_states.push_back(stream_state_t{ stream_id, nanoepoch, 0, 0, 0, npos, npos, npos, false });
+                std::fill_n(m_cursors.begin() + idx * m_params.m_pattern_cursors, m_params.m_pattern_cursors, pattern_cursor_t());
+                m_slots[i] = slot_t{ stream_id, idx };
+                lru_push_front(idx);
+                return m_states[idx];
+            }
+
+            stream_state_t* stream_table_t::find(const local::payload::stream_id_t::type_t stream_id)
+            {
+                const std::size_t i = slot_of(stream_id);
+                return m_slots[i].m_state != npos ? &m_states[m_slots[i].m_state] : nullptr;
+            }
+
+            bool stream_table_t::erase(const local::payload::stream_id_t::type_t stream_id)
+            {
+                const std::size_t i = slot_of(stream_id);
+                if (m_slots[i].m_state == npos)
+                    return false;
+                remove(m_slots[i].m_state);
+                return true;
+            }
+
+            std::size_t stream_table_t::evict_idle(const local::payload::nanoepoch_t::type_t now, const local::payload::nanoepoch_t::type_t idle)
+            {
+                std::size_t evicted = 0;
+                while (m_lru_tail != npos && m_states[m_lru_tail].m_last_nanoepoch < now && now - m_states[m_lru_tail].m_last_nanoepoch > idle)
+                {
+                    remove(m_lru_tail);
+                    evicted++;
+                }
+                m_metrics.m_evicted_idle += evicted;
+                return evicted;
+            }
+
+            bool stream_table_t::push(stream_state_t& s, const open_context_t& c)
+            {
+                const std::size_t at = s.m_depth % block_contexts;
+                if (!at)
+                {
+                    if (m_free_block == npos)
+                    {
+                        m_metrics.m_stack_overflows++;
+                        return false;
+                    }
+                    const uint32_t b = m_free_block;
+                    m_free_block = m_blocks[b].m_prev;
+                    m_blocks[b].m_prev = s.m_top_block;
+                    s.m_top_block = b;
+                }
+                m_blocks[s.m_top_block].m_contexts[at] = c;
+                s.m_depth++;
+                return true;
+            }
+
+            const open_context_t* stream_table_t::top(const stream_state_t& s) const
+            {
+                return s.m_depth ? &m_blocks[s.m_top_block].m_contexts[(s.m_depth - 1) % block_contexts] : nullptr;
+            }
+
+            void stream_table_t::pop(stream_state_t& s)
+            {
+                if (!s.m_depth)
+                    return;
+                if (--s.m_depth % block_contexts == 0)
+                {
+                    const uint32_t b = s.m_top_block;
+                    s.m_top_block = m_blocks[b].m_prev;
+                    m_blocks[b].m_prev = m_free_block;
+                    m_free_block = b;
+                }
+            }
+
+            std::size_t stream_table_t::depth_of(const stream_state_t& s, const local::payload::event_id_t::type_t event_id) const
+            {
+                std::size_t n = 0;
+                std::size_t at = s.m_depth ? (s.m_depth - 1) % block_contexts + 1 : 0;
+                for (uint32_t b = s.m_top_block; b != npos; b = m_blocks[b].m_prev, at = block_contexts)
+                {
+                    for (std::size_t cc = at; cc-- > 0; )
+                    {
+                        n++;
+                        if (m_blocks[b].m_contexts[cc].m_event_id == event_id)
+                            return n;
+                    }
+                }
+                return 0;
+            }
+
+            stream_snapshot_t stream_table_t::snapshot(const uint32_t idx) const
+            {
+                const stream_state_t& s = m_states[idx];
+                const auto cursors = m_cursors.begin() + idx * m_params.m_pattern_cursors;
+                stream_snapshot_t r{ s, std::vector<open_context_t>(s.m_depth), std::vector<pattern_cursor_t>(cursors, cursors + m_params.m_pattern_cursors) };
+                std::size_t i = s.m_depth;
+                std::size_t at = s.m_depth ? (s.m_depth - 1) % block_contexts + 1 : 0;
+                for (uint32_t b = s.m_top_block; b != npos; b = m_blocks[b].m_prev, at = block_contexts)
+                {
+                    for (std::size_t cc = at; cc-- > 0; )
+                        r.m_contexts[--i] = m_blocks[b].m_contexts[cc];
+                }
+                return r;
+            }
+
+            void stream_table_t::insert(const stream_snapshot_t& snapshot)
+            {
+                erase(snapshot.m_state.m_stream_id);
+                stream_state_t& s = touch(snapshot.m_state.m_stream_id, snapshot.m_state.m_last_nanoepoch);
+                s.m_checkpoint_nanoepoch = snapshot.m_state.m_checkpoint_nanoepoch;
+                s.m_checkpoint_event_id = snapshot.m_state.m_checkpoint_event_id;
+                s.m_has_checkpoint = snapshot.m_state.m_has_checkpoint;
+                std::copy_n(snapshot.m_cursors.begin(), std::min(snapshot.m_cursors.size(), m_params.m_pattern_cursors), cursors(s));
+                for (const auto& c : snapshot.m_contexts)
+                {
+                    if (!push(s, c))
+                        break;
+                }
+            }
+
+            void aggregator_t::checkpoint(
+                const local::payload::nanoepoch_t::type_t nanoepoch
+                , const local::payload::stream_id_t::type_t stream_id
+                , const local::payload::event_id_t::type_t event_id
+            )
+            {
+                stream_state_t& s = m_streams.touch(stream_id, nanoepoch);
+                s.m_checkpoint_nanoepoch = nanoepoch;
+                s.m_checkpoint_event_id = event_id;
+                s.m_has_checkpoint = true;
+                m_metrics.m_checkpoints++;
+                match(s, nanoepoch, event_id, static_cast<local::payload::event_type_t::type_t>(local::payload::event_type_t::event_types::NO_CONTEXT));
+            }
+
+            stream_table_t::stream_table_params_t aggregator_t::streams_params(const aggregator_params_t& po)
+            {
+                stream_table_t::stream_table_params_t r = po.m_streams;
+                r.m_pattern_cursors = po.m_patterns ? po.m_patterns->categories() : 0;
+                return r;
+            }
+
+            void aggregator_t::match(
+                stream_state_t& s
+                , const local::payload::nanoepoch_t::type_t nanoepoch
+                , const local::payload::event_id_t::type_t event_id
+                , const local::payload::event_type_t::type_t event_type
+            )
+            {
+                if (!m_params.m_patterns)
+                    return;
+                m_params.m_patterns->match(m_streams.cursors(s), nanoepoch, event_type, event_id, [&](const uint32_t pattern)
+                {
+                    m_metrics.m_patterns++;
+                    consume_pattern(s.m_stream_id, pattern, nanoepoch);
+                });
+            }
+
+            void aggregator_t::context(
+                const local::payload::nanoepoch_t::type_t nanoepoch
+                , const local::payload::stream_id_t::type_t stream_id
+                , const local::payload::event_id_t::type_t event_id
+                , const local::payload::event_type_t::type_t event_type
+            )
+            {
+                stream_state_t& s = m_streams.touch(stream_id, nanoepoch);
+                m_metrics.m_contexts++;
+                match(s, nanoepoch, event_id, event_type);
+                switch (static_cast<local::payload::event_type_t::event_types>(event_type))
+                {
+                case local::payload::event_type_t::event_types::CONTEXT_ENTER:
+                    m_streams.push(s, open_context_t{ nanoepoch, event_id });
+                    break;
+                case local::payload::event_type_t::event_types::CONTEXT_LEAVE:
+                case local::payload::event_type_t::event_types::CONTEXT_PANIC:
+                {
+                    std::size_t n = m_streams.depth_of(s, event_id);
+                    if (!n)
+                    {
+                        m_metrics.m_unmatched++;
+                        break;
+                    }
+                    // inner contexts without their leave are closed with this one
+                    m_metrics.m_unwound += n - 1;
+                    while (--n)
+                        m_streams.pop(s);
+                    if (m_latencies)
+                    {
+                        const open_context_t* c = m_streams.top(s);
+                        m_latencies->record(stream_id, event_id, nanoepoch > c->m_nanoepoch ? nanoepoch - c->m_nanoepoch : 0);
+                    }
+                    m_streams.pop(s);
+                    break;
+                }
+                default:
+                    break;
+                }
+            }
+
+            void aggregator_t::consume_checkpoint(
+                const local::payload::nanoepoch_t::type_t& nanoepoch
+                , const local::payload::stream_id_t::type_t& stream_id
+                , const local::payload::event_id_t::type_t& event_id
+            )
+            {
+                checkpoint(nanoepoch, stream_id, event_id);
+            }
+
+            void aggregator_t::consume_context(
+                const local::payload::nanoepoch_t::type_t& nanoepoch
+                , const local::payload::stream_id_t::type_t& stream_id
+                , const local::payload::event_id_t::type_t& event_id
+                , const local::payload::event_type_t::event_types& event_type
+            )
+            {
+                context(nanoepoch, stream_id, event_id, static_cast<local::payload::event_type_t::type_t>(event_type));
+            }
+
+            void aggregator_t::consume_columns(const transport::frames_columns_t& c)
+            {
+                for (std::size_t cc = 0; cc < c.m_count; cc++)
+                {
+                    if (c.m_event_type[cc] == static_cast<local::payload::event_type_t::type_t>(local::payload::event_type_t::event_types::NO_CONTEXT))
+                        checkpoint(c.m_nanoepoch[cc], c.m_stream_id[cc], c.m_event_id[cc]);
+                    else
+                        context(c.m_nanoepoch[cc], c.m_stream_id[cc], c.m_event_id[cc], c.m_event_type[cc]);
+                }
+            }
+        }
+    }
+}
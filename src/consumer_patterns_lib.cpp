@@ -0,0 +1,162 @@
+#include <deque>
+#include <limits>
+#include <algorithm>
+#include <unordered_map>
+
+#include <neutrino_consumer_patterns.hpp>
+
+namespace neutrino
+{
+    namespace impl
+    {
+        namespace consumer
+        {
+            namespace
+            {
+                std::size_t pow2_at_least(const std::size_t n)
+                {
+                    std::size_t ret = 2;
+                    while (ret < n)
+                        ret *= 2;
+                    return ret;
+                }
+            }
+
+            uint32_t pattern_automaton_t::add_symbol(const pattern_step_t& step)
+            {
+                const std::size_t mask = m_symbols.size() - 1;
+                std::size_t i = hash(step.m_event_id, step.m_event_type) & mask;
+                for (; m_symbols[i].m_symbol != npos; i = (i + 1) & mask)
+                {
+                    if (m_symbols[i].m_event_id == step.m_event_id && m_symbols[i].m_event_type == step.m_event_type)
+                        return m_symbols[i].m_symbol;
+                }
+                m_symbols[i] = symbol_slot_t{ step.m_event_id, uint32_t(m_symbols_count), step.m_event_type, 0, 0 };
+                return uint32_t(m_symbols_count++);
+            }
+
+            pattern_automaton_t::pattern_automaton_t(std::vector<pattern_t> patterns)
+                : m_patterns(std::move(patterns))
+            {
+                const local::payload::nanoepoch_t::type_t unbounded = std::numeric_limits<local::payload::nanoepoch_t::type_t>::max();
+
+                std::size_t steps = 0;
+                for (const auto& p : m_patterns)
+                    steps += p.m_steps.size() + p.m_exclusions.size();
+                m_symbols.assign(pow2_at_least(2 * steps), symbol_slot_t{ 0, npos, 0, 0, 0 });
+
+                // categories in the order they first appear, each with its root
+                std::unordered_map<std::string, uint32_t> category_ids;
+                std::vector<uint32_t> category_of;
+                for (const auto& p : m_patterns)
+                    category_of.push_back(category_ids.emplace(p.m_category, uint32_t(category_ids.size())).first->second);
+                m_categories = category_ids.size();
+
+                // trie of the steps, goto edges keyed by (state, symbol)
+                std::unordered_map<uint64_t, uint32_t> trie;
+                std::vector<std::vector<std::pair<uint32_t, uint32_t>>> children(m_categories); // (symbol, state)
+                std::vector<std::vector<uint32_t>> outputs(m_categories);
+                std::vector<uint32_t> root_of;
+                std::vector<std::vector<uint32_t>> symbol_categories;
+                for (uint32_t c = 0; c < m_categories; c++)
+                {
+                    m_states.push_back(state_t{ c, npos, 0, 0, unbounded });
+                    root_of.push_back(c);
+                }
+                auto add = [&](const pattern_step_t& step, const uint32_t category)
+                {
+                    const uint32_t symbol = add_symbol(step);
+                    if (symbol_categories.size() <= symbol)
+                        symbol_categories.resize(symbol + 1);
+                    auto& c = symbol_categories[symbol];
+                    if (std::find(c.begin(), c.end(), category) == c.end())
+                        c.push_back(category);
+                    return symbol;
+                };
+                for (std::size_t idx = 0; idx < m_patterns.size(); idx++)
+                {
+                    const pattern_t& p = m_patterns[idx];
+                    const uint32_t root = category_of[idx];
+                    for (const auto& step : p.m_exclusions)
+                        add(step, root);
+                    if (p.m_steps.empty())
+                        continue;
+
+                    uint32_t s = root;
+                    for (const auto& step : p.m_steps)
+                    {
+                        const uint32_t symbol = add(step, root);
+                        if (s != root)
+                            m_states[s].m_max_gap = std::max(m_states[s].m_max_gap, p.m_max_gap ? p.m_max_gap : unbounded);
+                        auto it = trie.find((uint64_t(s) << 32) | symbol);
+                        if (it == trie.end())
+                        {
+                            const uint32_t next = uint32_t(m_states.size());
+                            m_states.push_back(state_t{ root, npos, 0, 0, 0 });
+                            root_of.push_back(root);
+                            children.emplace_back();
+                            outputs.emplace_back();
+                            children[s].emplace_back(symbol, next);
+                            it = trie.emplace((uint64_t(s) << 32) | symbol, next).first;
+                        }
+                        s = it->second;
+                    }
+                    outputs[s].push_back(uint32_t(idx));
+                }
+
+                for (auto& slot : m_symbols)
+                {
+                    if (slot.m_symbol == npos)
+                        continue;
+                    slot.m_categories_begin = uint32_t(m_symbol_categories.size());
+                    m_symbol_categories.insert(m_symbol_categories.end(), symbol_categories[slot.m_symbol].begin(), symbol_categories[slot.m_symbol].end());
+                    slot.m_categories_end = uint32_t(m_symbol_categories.size());
+                }
+
+                m_edges.assign(pow2_at_least(2 * trie.size()), edge_slot_t{ npos, 0, 0 });
+                const std::size_t mask = m_edges.size() - 1;
+                for (const auto& e : trie)
+                {
+                    const uint32_t state = uint32_t(e.first >> 32);
+                    const uint32_t symbol = uint32_t(e.first);
+                    std::size_t i = hash(state, symbol) & mask;
+                    while (m_edges[i].m_state != npos)
+                        i = (i + 1) & mask;
+                    m_edges[i] = edge_slot_t{ state, symbol, e.second };
+                }
+
+                // fail links breadth first, states closer to the root are complete before their children
+                std::deque<uint32_t> queue;
+                for (uint32_t c = 0; c < m_categories; c++)
+                {
+                    for (const auto& child : children[c])
+                        queue.push_back(child.second);
+                }
+                while (!queue.empty())
+                {
+                    const uint32_t u = queue.front();
+                    queue.pop_front();
+                    const uint32_t root = root_of[u];
+                    for (const auto& c : children[u])
+                    {
+                        uint32_t f = m_states[u].m_fail;
+                        uint32_t next;
+                        while ((next = find_edge(f, c.first)) == npos && f != root)
+                            f = m_states[f].m_fail;
+                        state_t& v = m_states[c.second];
+                        v.m_fail = next != npos ? next : root;
+                        v.m_dict = !outputs[v.m_fail].empty() ? v.m_fail : m_states[v.m_fail].m_dict;
+                        queue.push_back(c.second);
+                    }
+                }
+
+                for (std::size_t s = 0; s < m_states.size(); s++)
+                {
+                    m_states[s].m_outputs_begin = uint32_t(m_outputs.size());
+                    m_outputs.insert(m_outputs.end(), outputs[s].begin(), outputs[s].end());
+                    m_states[s].m_outputs_end = uint32_t(m_outputs.size());
+                }
+            }
+        }
+    }
+}
@@ -0,0 +1,303 @@
+#include <algorithm>
+#include <array>
+#include <chrono>
+
+#include <neutrino_consumer_sharded.hpp>
+
+namespace neutrino
+{
+    namespace impl
+    {
+        namespace consumer
+        {
+            namespace
+            {
+                // messages a worker takes from its ring at once, tail moves after them
+                const std::size_t batch_frames = 256;
+                const unsigned idle_yields = 1024;
+                const std::chrono::microseconds idle_sleep{ 50 };
+
+                std::unique_ptr<aggregator_t> create_aggregator(const sharded_aggregator_t::sharded_aggregator_params_t& po, const std::size_t worker)
+                {
+                    if (po.m_factory)
+                        return po.m_factory(worker);
+                    return std::unique_ptr<aggregator_t>(new aggregator_t(po.m_aggregator));
+                }
+            }
+
+            sharded_aggregator_t::worker_t::worker_t(std::unique_ptr<aggregator_t> aggregator, const std::size_t ring_frames)
+                : m_aggregator(std::move(aggregator)), m_ring(ring_frames), m_mask(ring_frames - 1)
+            {
+            }
+
+            sharded_aggregator_t::sharded_aggregator_t(const sharded_aggregator_params_t po)
+                : m_params(po), m_until_rebalance(po.m_rebalance_frames)
+            {
+                const std::size_t workers = std::min<std::size_t>(std::max<std::size_t>(m_params.m_workers, 1), 0xFFFF);
+
+                std::size_t ring = 2;
+                while (ring < m_params.m_ring_frames)
+                    ring *= 2;
+
+                std::size_t buckets = 2;
+                m_bucket_shift = 63;
+                while (buckets < std::max(m_params.m_buckets, workers))
+                {
+                    buckets *= 2;
+                    m_bucket_shift--;
+                }
+                m_owner.resize(buckets);
+                for (std::size_t b = 0; b < buckets; b++)
+                    m_owner[b] = uint16_t(b % workers);
+                m_bucket_load.resize(buckets, 0);
+
+                for (std::size_t cc = 0; cc < workers; cc++)
+                    m_workers.push_back(aligned_new<worker_t>(create_aggregator(m_params, cc), ring));
+                for (auto& w : m_workers)
+                {
+                    worker_t* pw = w.get();
+                    w->m_thread = std::thread([this, pw]() { run(*pw); });
+                }
+            }
+
+            sharded_aggregator_t::~sharded_aggregator_t()
+            {
+                publish();
+                m_stop.store(true, std::memory_order_release);
+                for (auto& w : m_workers)
+                    w->m_thread.join();
+            }
+
+            void sharded_aggregator_t::push(worker_t& w, const message_t& m)
+            {
+                if (w.m_pending_head - w.m_cached_tail > w.m_mask)
+                {
+                    // the worker must see what is there to make room
+                    w.m_head.store(w.m_pending_head, std::memory_order_release);
+                    w.m_cached_tail = w.m_tail.load(std::memory_order_acquire);
+                    if (w.m_pending_head - w.m_cached_tail > w.m_mask)
+                    {
+                        m_metrics.m_ring_waits++;
+                        do
+                        {
+                            std::this_thread::yield();
+                            w.m_cached_tail = w.m_tail.load(std::memory_order_acquire);
+                        } while (w.m_pending_head - w.m_cached_tail > w.m_mask);
+                    }
+                }
+                w.m_ring[w.m_pending_head & w.m_mask] = m;
+                w.m_pending_head++;
+            }
+
+            void sharded_aggregator_t::publish()
+            {
+                for (auto& w : m_workers)
+                {
+                    if (w->m_pending_head != w->m_head.load(std::memory_order_relaxed))
+                        w->m_head.store(w->m_pending_head, std::memory_order_release);
+                }
+            }
+
+            void sharded_aggregator_t::route(
+                const local::payload::nanoepoch_t::type_t nanoepoch
+                , const local::payload::stream_id_t::type_t stream_id
+                , const local::payload::event_id_t::type_t event_id
+                , const local::payload::event_type_t::type_t event_type
+            )
+            {
+                const std::size_t b = bucket_of(stream_id);
+                worker_t& w = *m_workers[m_owner[b]];
+                push(w, message_t{ nanoepoch, stream_id, event_id, event_type, message_t::kind_t::FRAME });
+                m_bucket_load[b]++;
+                w.m_load++;
+                m_metrics.m_frames++;
+                if (m_params.m_rebalance_frames && !--m_until_rebalance)
+                    rebalance();
+            }
+
+            void sharded_aggregator_t::rebalance()
+            {
+                m_until_rebalance = m_params.m_rebalance_frames;
+
+                if (m_workers.size() > 1 && !m_migrating.load(std::memory_order_acquire))
+                {
+                    std::size_t hot = 0, cold = 0;
+                    for (std::size_t cc = 1; cc < m_workers.size(); cc++)
+                    {
+                        if (m_workers[cc]->m_load > m_workers[hot]->m_load)
+                            hot = cc;
+                        if (m_workers[cc]->m_load < m_workers[cold]->m_load)
+                            cold = cc;
+                    }
+                    const uint64_t diff = m_workers[hot]->m_load - m_workers[cold]->m_load;
+                    if (diff > m_workers[hot]->m_load / 4)
+                    {
+                        // the busiest bucket which does not make the cold worker the hot one
+                        std::size_t best = m_owner.size();
+                        for (std::size_t b = 0; b < m_owner.size(); b++)
+                        {
+                            if (m_owner[b] == hot && m_bucket_load[b] && m_bucket_load[b] <= diff / 2
+                                && (best == m_owner.size() || m_bucket_load[b] > m_bucket_load[best]))
+                                best = b;
+                        }
+                        if (best != m_owner.size())
+                        {
+                            m_migrating.store(true, std::memory_order_relaxed);
+                            worker_t& from = *m_workers[hot];
+                            push(from, message_t{ 0, best, 0, 0, message_t::kind_t::RELEASE });
+                            // release is visible before the new owner may wait for it
+                            from.m_head.store(from.m_pending_head, std::memory_order_release);
+                            m_owner[best] = uint16_t(cold);
+                            push(*m_workers[cold], message_t{ 0, best, 0, 0, message_t::kind_t::ACQUIRE });
+                            m_metrics.m_migrations++;
+                        }
+                    }
+                }
+
+                for (auto& w : m_workers)
+                    w->m_load = 0;
+                std::fill(m_bucket_load.begin(), m_bucket_load.end(), 0);
+            }
+
+            void sharded_aggregator_t::run(worker_t& w)
+            {
+                std::array<local::payload::nanoepoch_t::type_t, batch_frames> nanoepoch;
+                std::array<local::payload::stream_id_t::type_t, batch_frames> stream_id;
+                std::array<local::payload::event_id_t::type_t, batch_frames> event_id;
+                std::array<local::payload::event_type_t::type_t, batch_frames> event_type;
+                std::size_t n = 0;
+                auto deliver = [&]()
+                {
+                    if (!n)
+                        return;
+                    const transport::frames_columns_t c{ n, nanoepoch.data(), stream_id.data(), event_id.data(), event_type.data() };
+                    n = 0;
+                    w.m_aggregator->consume_columns(c);
+                };
+
+                unsigned idle = 0;
+                for (;;)
+                {
+                    uint64_t tail = w.m_tail.load(std::memory_order_relaxed);
+                    const bool stop = m_stop.load(std::memory_order_acquire);
+                    const uint64_t head = std::min<uint64_t>(w.m_head.load(std::memory_order_acquire), tail + batch_frames);
+                    if (tail == head)
+                    {
+                        if (stop)
+                            break;
+                        if (++idle < idle_yields)
+                            std::this_thread::yield();
+                        else
+                            std::this_thread::sleep_for(idle_sleep);
+                        continue;
+                    }
+                    idle = 0;
+
+                    for (; tail != head; tail++)
+                    {
+                        const message_t& m = w.m_ring[tail & w.m_mask];
+                        switch (m.m_kind)
+                        {
+                        case message_t::kind_t::FRAME:
+                            nanoepoch[n] = m.m_nanoepoch;
+                            stream_id[n] = m.m_stream_id;
+                            event_id[n] = m.m_event_id;
+                            event_type[n] = m.m_event_type;
+                            n++;
+                            break;
+                        case message_t::kind_t::CALIBRATION:
+                            deliver();
+                            w.m_aggregator->consume_clock_calibration(m.m_stream_id, m.m_nanoepoch, m.m_event_id, m.m_event_type);
+                            break;
+                        case message_t::kind_t::RELEASE:
+                        {
+                            deliver();
+                            const std::size_t b = std::size_t(m.m_stream_id);
+                            w.m_aggregator->streams().extract([&](const local::payload::stream_id_t::type_t id) { return bucket_of(id) == b; }, m_handoff);
+                            m_handoff_ready.store(true, std::memory_order_release);
+                            break;
+                        }
+                        case message_t::kind_t::ACQUIRE:
+                            deliver();
+                            while (!m_handoff_ready.load(std::memory_order_acquire))
+                                std::this_thread::yield();
+                            for (const auto& s : m_handoff)
+                                w.m_aggregator->streams().insert(s);
+                            m_handoff.clear();
+                            m_handoff_ready.store(false, std::memory_order_relaxed);
+                            m_migrating.store(false, std::memory_order_release);
+                            break;
+                        }
+                    }
+                    deliver();
+                    w.m_tail.store(tail, std::memory_order_release);
+                }
+            }
+
+            void sharded_aggregator_t::consume_checkpoint(
+                const local::payload::nanoepoch_t::type_t& nanoepoch
+                , const local::payload::stream_id_t::type_t& stream_id
+                , const local::payload::event_id_t::type_t& event_id
+            )
+            {
+                route(nanoepoch, stream_id, event_id, static_cast<local::payload::event_type_t::type_t>(local::payload::event_type_t::event_types::NO_CONTEXT));
+                publish();
+            }
+
+            void sharded_aggregator_t::consume_context(
+                const local::payload::nanoepoch_t::type_t& nanoepoch
+                , const local::payload::stream_id_t::type_t& stream_id
+                , const local::payload::event_id_t::type_t& event_id
+                , const local::payload::event_type_t::event_types& event_type
+            )
+            {
+                route(nanoepoch, stream_id, event_id, static_cast<local::payload::event_type_t::type_t>(event_type));
+                publish();
+            }
+
+            void sharded_aggregator_t::consume_columns(const transport::frames_columns_t& c)
+            {
+                for (std::size_t cc = 0; cc < c.m_count; cc++)
+                    route(c.m_nanoepoch[cc], c.m_stream_id[cc], c.m_event_id[cc], c.m_event_type[cc]);
+                publish();
+            }
+
+            void sharded_aggregator_t::consume_clock_calibration(
+                const local::payload::ticks_t::type_t& ticks
+                , const local::payload::nanoepoch_t::type_t& nanoepoch
+                , const local::payload::ticks_mult_t::type_t& mult
+                , const local::payload::ticks_shift_t::type_t& shift
+            )
+            {
+                for (auto& w : m_workers)
+                    push(*w, message_t{ nanoepoch, ticks, mult, shift, message_t::kind_t::CALIBRATION });
+                publish();
+            }
+
+            bool sharded_aggregator_t::latency(
+                const local::payload::stream_id_t::type_t stream_id
+                , const local::payload::event_id_t::type_t event_id
+                , latency_histogram_t& h
+            ) const
+            {
+                bool found = false;
+                for (const auto& w : m_workers)
+                {
+                    if (const latency_table_t* t = w->m_aggregator->latencies())
+                        found = t->snapshot(stream_id, event_id, h) || found;
+                }
+                return found;
+            }
+
+            void sharded_aggregator_t::flush()
+            {
+                publish();
+                for (auto& w : m_workers)
+                {
+                    while (w->m_tail.load(std::memory_order_acquire) != w->m_pending_head)
+                        std::this_thread::yield();
+                }
+            }
+        }
+    }
+}
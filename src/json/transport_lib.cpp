@@ -0,0 +1,434 @@
+#include <array>
+#include <vector>
+#include <cstring>
+#include <limits>
+#include <algorithm>
+
+#include <neutrino_transport.hpp>
+
+using namespace neutrino::impl;
+
+namespace
+{
+    // one object per line:
+    // {"type":"checkpoint","nanoepoch":1,"stream_id":2,"event_id":3}
+    // {"type":"context_enter"|"context_leave"|"context_panic","nanoepoch":1,"stream_id":2,"event_id":3}
+    // {"type":"clock_calibration","ticks":1,"nanoepoch":2,"mult":3,"shift":4}
+    const std::size_t max_line_size = 192;
+
+    const char digit_pairs[] =
+        "00010203040506070809101112131415161718192021222324252627282930313233343536373839"
+        "40414243444546474849505152535455565758596061626364656667686970717273747576777879"
+        "8081828384858687888990919293949596979899";
+
+    // [0] is 0 so that 0 has one digit
+    const uint64_t pow10[] = {
+        0ull, 10ull, 100ull, 1000ull, 10000ull, 100000ull, 1000000ull, 10000000ull, 100000000ull, 1000000000ull
+        , 10000000000ull, 100000000000ull, 1000000000000ull, 10000000000000ull, 100000000000000ull, 1000000000000000ull
+        , 10000000000000000ull, 100000000000000000ull, 1000000000000000000ull, 10000000000000000000ull
+    };
+
+    inline unsigned bit_length(const uint64_t v) noexcept
+    {
+#if defined(_MSC_VER)
+        unsigned long idx;
+        _BitScanReverse64(&idx, v | 1);
+        return unsigned(idx) + 1;
+#else
+        return 64 - unsigned(__builtin_clzll(v | 1));
+#endif
+    }
+
+    // decimal digits without a loop over them: log10 from the bit length, one table compare
+    inline unsigned digits10(const uint64_t v) noexcept
+    {
+        const unsigned t = (bit_length(v) * 1233) >> 12;
+        return t + (v >= pow10[t]);
+    }
+
+    inline uint8_t* put_uint(uint64_t v, uint8_t* p) noexcept
+    {
+        uint8_t* e = p + digits10(v);
+        uint8_t* d = e;
+        while (v >= 100)
+        {
+            const std::size_t i = std::size_t(v % 100) * 2;
+            v /= 100;
+            *--d = digit_pairs[i + 1];
+            *--d = digit_pairs[i];
+        }
+        if (v >= 10)
+        {
+            *--d = digit_pairs[v * 2 + 1];
+            *--d = digit_pairs[v * 2];
+        }
+        else
+        {
+            *--d = uint8_t('0' + v);
+        }
+        return e;
+    }
+
+    template <std::size_t n>
+    inline uint8_t* put_literal(const char (&s)[n], uint8_t* p) noexcept
+    {
+        std::memcpy(p, s, n - 1);
+        return p + n - 1;
+    }
+
+    inline uint8_t* put_event(
+        uint8_t* p
+        , const local::payload::event_type_t::type_t event_type
+        , const local::payload::nanoepoch_t::type_t nanoepoch
+        , const local::payload::stream_id_t::type_t stream_id
+        , const local::payload::event_id_t::type_t event_id
+    ) noexcept
+    {
+        switch (static_cast<local::payload::event_type_t::event_types>(event_type))
+        {
+        case local::payload::event_type_t::event_types::CONTEXT_ENTER:
+            p = put_literal("{\"type\":\"context_enter\",\"nanoepoch\":", p);
+            break;
+        case local::payload::event_type_t::event_types::CONTEXT_LEAVE:
+            p = put_literal("{\"type\":\"context_leave\",\"nanoepoch\":", p);
+            break;
+        case local::payload::event_type_t::event_types::CONTEXT_PANIC:
+            p = put_literal("{\"type\":\"context_panic\",\"nanoepoch\":", p);
+            break;
+        default:
+            p = put_literal("{\"type\":\"checkpoint\",\"nanoepoch\":", p);
+            break;
+        }
+        p = put_literal(",\"stream_id\":", put_uint(nanoepoch, p));
+        p = put_literal(",\"event_id\":", put_uint(stream_id, p));
+        return put_literal("}\n", put_uint(event_id, p));
+    }
+
+    struct frame_json_serializer_consumer_stub_impl_t : public transport::consumer_stub_t
+    {
+        using transport::consumer_stub_t::consumer_stub_t;
+
+        constexpr static const std::size_t batch_frames = 64;
+
+        void consume_checkpoint(
+            const local::payload::nanoepoch_t::type_t& nanoepoch
+            , const local::payload::stream_id_t::type_t& stream_id
+            , const local::payload::event_id_t::type_t& event_id
+        ) final
+        {
+            // line length is not known upfront, no reserve()
+            std::array<uint8_t, max_line_size> buf;
+            m_endpoint.consume(buf.data(), put_event(buf.data(), static_cast<local::payload::event_type_t::type_t>(local::payload::event_type_t::event_types::NO_CONTEXT), nanoepoch, stream_id, event_id));
+        }
+
+        void consume_context(
+            const local::payload::nanoepoch_t::type_t& nanoepoch
+            , const local::payload::stream_id_t::type_t& stream_id
+            , const local::payload::event_id_t::type_t& event_id
+            , const local::payload::event_type_t::event_types& event_type
+        ) final
+        {
+            std::array<uint8_t, max_line_size> buf;
+            m_endpoint.consume(buf.data(), put_event(buf.data(), static_cast<local::payload::event_type_t::type_t>(event_type), nanoepoch, stream_id, event_id));
+        }
+
+        void consume_checkpoint_batch(
+            const std::size_t count
+            , const local::payload::nanoepoch_t::type_t* nanoepoch
+            , const local::payload::stream_id_t::type_t* stream_id
+            , const local::payload::event_id_t::type_t* event_id
+        ) final
+        {
+            // whole lines only in every consume()
+            std::array<uint8_t, batch_frames * max_line_size> buf;
+            for (std::size_t cc = 0; cc < count; )
+            {
+                uint8_t* p = buf.data();
+                for (const auto last = std::min(count, cc + batch_frames); cc < last; cc++)
+                    p = put_event(p, static_cast<local::payload::event_type_t::type_t>(local::payload::event_type_t::event_types::NO_CONTEXT), nanoepoch[cc], stream_id[cc], event_id[cc]);
+                m_endpoint.consume(buf.data(), p);
+            }
+        }
+
+        void consume_context_batch(
+            const std::size_t count
+            , const local::payload::nanoepoch_t::type_t* nanoepoch
+            , const local::payload::stream_id_t::type_t* stream_id
+            , const local::payload::event_id_t::type_t* event_id
+            , const local::payload::event_type_t::type_t* event_type
+        ) final
+        {
+            std::array<uint8_t, batch_frames * max_line_size> buf;
+            for (std::size_t cc = 0; cc < count; )
+            {
+                uint8_t* p = buf.data();
+                for (const auto last = std::min(count, cc + batch_frames); cc < last; cc++)
+                {
+                    if (event_type[cc] > static_cast<local::payload::event_type_t::type_t>(local::payload::event_type_t::event_types::NO_CONTEXT)
+                        && event_type[cc] < static_cast<local::payload::event_type_t::type_t>(local::payload::event_type_t::event_types::_LAST))
+                    {
+                        p = put_event(p, event_type[cc], nanoepoch[cc], stream_id[cc], event_id[cc]);
+                    }
+                }
+                if (p != buf.data())
+                    m_endpoint.consume(buf.data(), p);
+            }
+        }
+
+        void consume_clock_calibration(
+            const local::payload::ticks_t::type_t& ticks
+            , const local::payload::nanoepoch_t::type_t& nanoepoch
+            , const local::payload::ticks_mult_t::type_t& mult
+            , const local::payload::ticks_shift_t::type_t& shift
+        ) final
+        {
+            std::array<uint8_t, max_line_size> buf;
+            uint8_t* p = put_literal("{\"type\":\"clock_calibration\",\"ticks\":", buf.data());
+            p = put_literal(",\"nanoepoch\":", put_uint(ticks, p));
+            p = put_literal(",\"mult\":", put_uint(nanoepoch, p));
+            p = put_literal(",\"shift\":", put_uint(mult, p));
+            p = put_literal("}\n", put_uint(shift, p));
+            m_endpoint.consume(buf.data(), p);
+        }
+    };
+
+    // lines may be split between consume() calls, the partial one is kept until its end arrives
+    struct frame_json_deserializer_endpoint_impl_t : public transport::endpoint_impl_t
+    {
+        using transport::endpoint_impl_t::endpoint_impl_t;
+
+        constexpr static const std::size_t columns_frames = 256;
+
+        constexpr static const std::size_t max_tail_size = 4096; // lines from other writers may carry extra keys
+
+        std::vector<uint8_t> m_tail;
+        bool m_skip_line = false;
+        uint64_t m_malformed = 0; // lines dropped
+
+        enum class type_t { UNKNOWN, CHECKPOINT, CONTEXT_ENTER, CONTEXT_LEAVE, CONTEXT_PANIC, CLOCK_CALIBRATION };
+
+        enum field_bits_t : unsigned
+        {
+            NANOEPOCH = 1, STREAM_ID = 2, EVENT_ID = 4, TICKS = 8, MULT = 16, SHIFT = 32
+        };
+
+        struct line_t
+        {
+            type_t m_type = type_t::UNKNOWN;
+            unsigned m_fields = 0;
+            uint64_t m_nanoepoch = 0, m_stream_id = 0, m_event_id = 0, m_ticks = 0, m_mult = 0, m_shift = 0;
+        };
+
+        template <std::size_t n>
+        static bool is(const uint8_t* p, const uint8_t* e, const char (&s)[n]) noexcept
+        {
+            return std::size_t(e - p) == n - 1 && !std::memcmp(p, s, n - 1);
+        }
+
+        static const uint8_t* skip_ws(const uint8_t* p, const uint8_t* e) noexcept
+        {
+            while (p < e && (*p == ' ' || *p == '\t' || *p == '\r'))
+                p++;
+            return p;
+        }
+
+        // p at the opening quote, s is set past it, returns past the closing quote; escapes are skipped, not decoded
+        static const uint8_t* get_string(const uint8_t* p, const uint8_t* e, const uint8_t*& s) noexcept
+        {
+            if (p == e || *p != '"')
+                return nullptr;
+            s = ++p;
+            while (p < e && *p != '"')
+            {
+                if (*p == '\\' && ++p == e)
+                    return nullptr;
+                p++;
+            }
+            return p < e ? p + 1 : nullptr;
+        }
+
+        static const uint8_t* get_uint(const uint8_t* p, const uint8_t* e, uint64_t& v) noexcept
+        {
+            const uint8_t* b = p;
+            v = 0;
+            for (; p < e && uint8_t(*p - '0') < 10; p++)
+            {
+                const uint64_t d = uint64_t(*p - '0');
+                if (v > (std::numeric_limits<uint64_t>::max() - d) / 10)
+                    return nullptr; // does not fit, the line is malformed
+                v = v * 10 + d;
+            }
+            return p != b ? p : nullptr;
+        }
+
+        static bool parse(const uint8_t* p, const uint8_t* e, line_t& l) noexcept
+        {
+            p = skip_ws(p, e);
+            if (p == e || *p++ != '{')
+                return false;
+            for (;;)
+            {
+                p = skip_ws(p, e);
+                if (p < e && *p == '}')
+                    return true;
+                const uint8_t* key;
+                const uint8_t* key_end = get_string(p, e, key);
+                if (!key_end)
+                    return false;
+                p = skip_ws(key_end, e);
+                if (p == e || *p++ != ':')
+                    return false;
+                p = skip_ws(p, e);
+                if (p == e)
+                    return false;
+                key_end--;
+                if (*p == '"')
+                {
+                    const uint8_t* s;
+                    const uint8_t* s_end = get_string(p, e, s);
+                    if (!s_end)
+                        return false;
+                    p = s_end--;
+                    if (is(key, key_end, "type"))
+                    {
+                        l.m_type = is(s, s_end, "checkpoint") ? type_t::CHECKPOINT
+                            : is(s, s_end, "context_enter") ? type_t::CONTEXT_ENTER
+                            : is(s, s_end, "context_leave") ? type_t::CONTEXT_LEAVE
+                            : is(s, s_end, "context_panic") ? type_t::CONTEXT_PANIC
+                            : is(s, s_end, "clock_calibration") ? type_t::CLOCK_CALIBRATION
+                            : type_t::UNKNOWN;
+                    }
+                }
+                else
+                {
+                    uint64_t v;
+                    if (!(p = get_uint(p, e, v)))
+                        return false;
+                    if (is(key, key_end, "nanoepoch")) { l.m_nanoepoch = v; l.m_fields |= NANOEPOCH; }
+                    else if (is(key, key_end, "stream_id")) { l.m_stream_id = v; l.m_fields |= STREAM_ID; }
+                    else if (is(key, key_end, "event_id")) { l.m_event_id = v; l.m_fields |= EVENT_ID; }
+                    else if (is(key, key_end, "ticks")) { l.m_ticks = v; l.m_fields |= TICKS; }
+                    else if (is(key, key_end, "mult")) { l.m_mult = v; l.m_fields |= MULT; }
+                    else if (is(key, key_end, "shift")) { l.m_shift = v; l.m_fields |= SHIFT; }
+                    // unknown keys are skipped
+                }
+                p = skip_ws(p, e);
+                if (p < e && *p == ',')
+                    p++;
+                else if (p == e || *p != '}')
+                    return false;
+            }
+        }
+
+        template <typename columns_t>
+        bool consume_line(const uint8_t* p, const uint8_t* e, columns_t& columns)
+        {
+            if (skip_ws(p, e) == e)
+                return true; // empty line
+
+            line_t l;
+            if (!parse(p, e, l))
+                return false;
+
+            const unsigned event_fields = NANOEPOCH | STREAM_ID | EVENT_ID;
+            switch (l.m_type)
+            {
+            case type_t::CHECKPOINT:
+            case type_t::CONTEXT_ENTER:
+            case type_t::CONTEXT_LEAVE:
+            case type_t::CONTEXT_PANIC:
+                if ((l.m_fields & event_fields) != event_fields)
+                    return false;
+                columns.push(l.m_nanoepoch, l.m_stream_id, l.m_event_id, static_cast<local::payload::event_type_t::type_t>(
+                    l.m_type == type_t::CONTEXT_ENTER ? local::payload::event_type_t::event_types::CONTEXT_ENTER
+                    : l.m_type == type_t::CONTEXT_LEAVE ? local::payload::event_type_t::event_types::CONTEXT_LEAVE
+                    : l.m_type == type_t::CONTEXT_PANIC ? local::payload::event_type_t::event_types::CONTEXT_PANIC
+                    : local::payload::event_type_t::event_types::NO_CONTEXT));
+                return true;
+            case type_t::CLOCK_CALIBRATION:
+                if ((l.m_fields & (TICKS | NANOEPOCH | MULT | SHIFT)) != (TICKS | NANOEPOCH | MULT | SHIFT))
+                    return false;
+                columns.flush(); // frames before calibration are in the old time base
+                m_consumer.consume_clock_calibration(l.m_ticks, l.m_nanoepoch, l.m_mult, static_cast<local::payload::ticks_shift_t::type_t>(l.m_shift));
+                return true;
+            default:
+                return false;
+            }
+        }
+
+        // false: some lines were malformed and dropped, the rest is consumed
+        bool consume(const uint8_t* p, const uint8_t* e) final
+        {
+            transport::frames_columns_collector_t<columns_frames> columns(m_consumer);
+            std::size_t malformed = 0;
+
+            if (m_skip_line || !m_tail.empty())
+            {
+                const uint8_t* nl = std::find(p, e, uint8_t('\n'));
+                if (!m_skip_line)
+                    m_tail.insert(m_tail.end(), p, nl);
+                if (nl == e)
+                {
+                    if (m_skip_line || m_tail.size() <= max_tail_size)
+                        return true;
+                    // not a line of ours, resync on its end
+                    m_tail.clear();
+                    m_skip_line = true;
+                    m_malformed++;
+                    return false;
+                }
+                if (!m_skip_line)
+                    malformed += !consume_line(m_tail.data(), m_tail.data() + m_tail.size(), columns);
+                m_tail.clear();
+                m_skip_line = false;
+                p = nl + 1;
+            }
+
+            while (p < e)
+            {
+                const uint8_t* nl = static_cast<const uint8_t*>(std::memchr(p, '\n', e - p));
+                if (!nl)
+                {
+                    if (std::size_t(e - p) <= max_tail_size)
+                    {
+                        m_tail.assign(p, e);
+                    }
+                    else
+                    {
+                        m_skip_line = true;
+                        malformed++;
+                    }
+                    break;
+                }
+                malformed += !consume_line(p, nl, columns);
+                p = nl + 1;
+            }
+            columns.flush();
+
+            m_malformed += malformed;
+            return !malformed;
+        }
+    };
+}
+
+namespace neutrino
+{
+    namespace impl
+    {
+        namespace transport
+        {
+            namespace frame_json
+            {
+                std::shared_ptr<consumer_stub_t> create_consumer_stub(endpoint_t& endpoint)
+                {
+                    return std::shared_ptr<consumer_stub_t>(new frame_json_serializer_consumer_stub_impl_t(endpoint));
+                }
+
+                std::shared_ptr<endpoint_impl_t> create_endpoint_impl(consumer_t& consumer)
+                {
+                    return std::shared_ptr<endpoint_impl_t>(new frame_json_deserializer_endpoint_impl_t(consumer));
+                }
+            }
+        }
+    }
+}
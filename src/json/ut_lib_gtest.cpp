@@ -0,0 +1,132 @@
+#include <gtest/gtest.h>
+#include <chrono>
+#include <string>
+#include <vector>
+#include <iostream>
+#include <neutrino_mock.hpp>
+
+#include <neutrino_transport.hpp>
+
+using namespace neutrino::impl;
+using neutrino::mock::concat_endpoint_t;
+using neutrino::mock::counting_consumer_t;
+
+namespace
+{
+    bool consume(transport::endpoint_impl_t& impl, const std::string& s)
+    {
+        const uint8_t* p = reinterpret_cast<const uint8_t*>(s.data());
+        return impl.consume(p, p + s.size());
+    }
+}
+
+TEST(neutrino_frame_json, lines)
+{
+    concat_endpoint_t collected;
+    auto stub = transport::frame_v00::create_consumer_stub(transport::frame_v00::known_encodings_t::JSON, collected);
+    stub->consume_checkpoint(0, 9, 10);
+    stub->consume_context(18446744073709551615ull, 99, 100, local::payload::event_type_t::event_types::CONTEXT_LEAVE);
+    stub->consume_clock_calibration(1234567, 1000000000000000000ull, 3, 7);
+
+    ASSERT_EQ(std::string(
+        "{\"type\":\"checkpoint\",\"nanoepoch\":0,\"stream_id\":9,\"event_id\":10}\n"
+        "{\"type\":\"context_leave\",\"nanoepoch\":18446744073709551615,\"stream_id\":99,\"event_id\":100}\n"
+        "{\"type\":\"clock_calibration\",\"ticks\":1234567,\"nanoepoch\":1000000000000000000,\"mult\":3,\"shift\":7}\n")
+        , std::string(collected.m_data.begin(), collected.m_data.end()));
+}
+
+TEST(neutrino_frame_json, lines_split_between_buffers)
+{
+    concat_endpoint_t collected;
+    auto stub = transport::frame_v00::create_consumer_stub(transport::frame_v00::known_encodings_t::JSON, collected);
+    for (uint64_t cc = 0; cc < 100; cc++)
+        stub->consume_checkpoint(1000000 + cc * 12345, cc % 3, cc);
+
+    // every split point, including the ones inside a number and right after a line end
+    for (std::size_t chunk = 1; chunk < 200; chunk += 7)
+    {
+        neutrino::mock::consumer_t split_consumer;
+        for (uint64_t cc = 0; cc < 100; cc++)
+            split_consumer.expect_checkpoint(1000000 + cc * 12345, cc % 3, cc);
+        auto impl = transport::frame_v00::create_endpoint_impl(transport::frame_v00::known_encodings_t::JSON, split_consumer);
+        for (std::size_t pos = 0; pos < collected.m_data.size(); pos += chunk)
+            ASSERT_TRUE(impl->consume(collected.m_data.data() + pos, collected.m_data.data() + std::min(collected.m_data.size(), pos + chunk)));
+        ASSERT_TRUE(split_consumer.m_expected_checkpoints.empty());
+        ASSERT_EQ(std::size_t{ 100 }, split_consumer.m_actual_checkpoints.size());
+    }
+}
+
+TEST(neutrino_frame_json, malformed_lines_are_dropped)
+{
+    counting_consumer_t consumer;
+    auto impl = transport::frame_v00::create_endpoint_impl(transport::frame_v00::known_encodings_t::JSON, consumer);
+
+    ASSERT_FALSE(consume(*impl,
+        "{\"type\":\"checkpoint\",\"nanoepoch\":1,\"stream_id\":2,\"event_id\":3}\n"
+        "{\"type\":\"checkpoint\",\"nanoepoch\":1,\"stream_id\":2}\n" // no event_id
+        "{\"type\":\"unknown\",\"nanoepoch\":1,\"stream_id\":2,\"event_id\":3}\n"
+        "garbage\n"
+        "\n"
+        " { \"event_id\" : 3 , \"host\" : \"a\\\"b\" , \"stream_id\" : 2 , \"nanoepoch\" : 1 , \"type\" : \"checkpoint\" }\r\n"
+        "{\"type\":\"clock_calibration\",\"ticks\":5,\"nanoepoch\":6,\"mult\":7,\"shift\":8}\n"));
+    ASSERT_EQ(std::size_t{ 2 }, consumer.m_cc);
+    ASSERT_EQ(uint64_t{ 5 }, consumer.m_calibration_ticks);
+
+    // a line longer than any valid one is dropped up to its end
+    ASSERT_TRUE(consume(*impl, "{\"type\":\"checkpoint\""));
+    ASSERT_FALSE(consume(*impl, std::string(5000, ' ')));
+    ASSERT_TRUE(consume(*impl, "}\n{\"type\":\"checkpoint\",\"nanoepoch\":1,\"stream_id\":2,\"event_id\":3}\n"));
+    ASSERT_EQ(std::size_t{ 3 }, consumer.m_cc);
+
+    // the largest uint64_t fits, one more or more digits do not wrap into another id
+    ASSERT_TRUE(consume(*impl, "{\"type\":\"checkpoint\",\"nanoepoch\":1,\"stream_id\":2,\"event_id\":18446744073709551615}\n"));
+    ASSERT_EQ(std::size_t{ 4 }, consumer.m_cc);
+    ASSERT_FALSE(consume(*impl,
+        "{\"type\":\"checkpoint\",\"nanoepoch\":1,\"stream_id\":2,\"event_id\":18446744073709551616}\n"
+        "{\"type\":\"checkpoint\",\"nanoepoch\":1,\"stream_id\":200000000000000000003,\"event_id\":3}\n"));
+    ASSERT_EQ(std::size_t{ 4 }, consumer.m_cc);
+}
+
+TEST(neutrino_frame_json, benchmark_against_binary)
+{
+    const std::size_t n = 100000;
+    std::vector<uint64_t> nanoepoch, stream_id, event_id;
+    uint64_t ne = 1700000000000000000ull;
+    for (std::size_t cc = 0; cc < n; cc++)
+    {
+        ne += 1000 + (cc * 7919) % 4000;
+        nanoepoch.push_back(ne);
+        stream_id.push_back(0x10000 + (cc * 31) % 4);
+        event_id.push_back((cc * 13) % 100);
+    }
+    using clock_t = std::chrono::steady_clock;
+
+    auto run = [&](transport::frame_v00::known_encodings_t ke, const char* name, double& total)
+    {
+        concat_endpoint_t collected;
+        auto stub = transport::frame_v00::create_consumer_stub(ke, collected);
+        const auto t0 = clock_t::now();
+        for (std::size_t cc = 0; cc < n; cc++)
+            stub->consume_checkpoint(nanoepoch[cc], stream_id[cc], event_id[cc]);
+        const auto t1 = clock_t::now();
+
+        counting_consumer_t consumer;
+        auto impl = transport::frame_v00::create_endpoint_impl(ke, consumer);
+        const auto t2 = clock_t::now();
+        EXPECT_TRUE(impl->consume(collected.m_data.data(), collected.m_data.data() + collected.m_data.size()));
+        const auto t3 = clock_t::now();
+        EXPECT_EQ(n, consumer.m_cc);
+
+        const double enc = std::chrono::duration<double>(t1 - t0).count();
+        const double dec = std::chrono::duration<double>(t3 - t2).count();
+        total = enc + dec;
+        std::cout << "[ BENCH    ] " << name << ": " << double(collected.m_data.size()) / n << " bytes/event"
+            << ", encode " << enc * 1e9 / n << " ns/event"
+            << ", decode " << dec * 1e9 / n << " ns/event" << std::endl;
+    };
+
+    double binary = 0, json = 0;
+    run(transport::frame_v00::known_encodings_t::BINARY_NATIVE, "v00 native", binary);
+    run(transport::frame_v00::known_encodings_t::JSON, "json", json);
+    std::cout << "[ BENCH    ] json/binary: " << (binary > 0 ? json / binary : 0) << "x" << std::endl;
+}
@@ -1,41 +1,80 @@
-#include <chrono>
-
-#include <neutrino_producer.hpp>
-#include <neutrino_frames_local.hpp>
-
-using namespace neutrino::impl;
-
-extern "C"
-{
-
-uint64_t neutrino_nanoepoch(void)
-{
-    return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
-}
-
-void neutrino_checkpoint(const uint64_t nanoepoch, const uint64_t stream_id, const uint64_t event_id)
-{
-    producer::get_consumer()->consume_checkpoint(nanoepoch, stream_id, event_id);
-}
-
-void neutrino_context_enter(const uint64_t nanoepoch, const uint64_t stream_id, const uint64_t event_id)
-{
-    producer::get_consumer()->consume_context(nanoepoch, stream_id, event_id, local::payload::event_type_t::event_types::CONTEXT_ENTER);
-}
-
-void neutrino_context_leave(const uint64_t nanoepoch, const uint64_t stream_id, const uint64_t event_id)
-{
-    producer::get_consumer()->consume_context(nanoepoch, stream_id, event_id, local::payload::event_type_t::event_types::CONTEXT_LEAVE);
-}
-
-void neutrino_context_panic(const uint64_t nanoepoch, const uint64_t stream_id, const uint64_t event_id)
-{
-    producer::get_consumer()->consume_context(nanoepoch, stream_id, event_id, local::payload::event_type_t::event_types::CONTEXT_PANIC);
-}
-
-void neutrino_flush()
-{
-    producer::get_consumer()->m_endpoint.flush();
-}
-
-} // extern "C"
+#include <neutrino_producer.hpp>
+#include <neutrino_clock.hpp>
+#include <neutrino_frames_local.hpp>
+
+using namespace neutrino::impl;
+
+static_assert(NEUTRINO_CONTEXT_ENTER == static_cast<int>(local::payload::event_type_t::event_types::CONTEXT_ENTER), "C API event type mismatch");
+static_assert(NEUTRINO_CONTEXT_LEAVE == static_cast<int>(local::payload::event_type_t::event_types::CONTEXT_LEAVE), "C API event type mismatch");
+static_assert(NEUTRINO_CONTEXT_PANIC == static_cast<int>(local::payload::event_type_t::event_types::CONTEXT_PANIC), "C API event type mismatch");
+
+extern "C"
+{
+
+uint64_t neutrino_nanoepoch(void)
+{
+    return clock::nanoepoch();
+}
+
+void neutrino_checkpoint(const uint64_t nanoepoch, const uint64_t stream_id, const uint64_t event_id)
+{
+    producer::consumer_guard_t c;
+    if(c)
+        c->consume_checkpoint(nanoepoch, stream_id, event_id);
+}
+
+void neutrino_context_enter(const uint64_t nanoepoch, const uint64_t stream_id, const uint64_t event_id)
+{
+    producer::consumer_guard_t c;
+    if(c)
+        c->consume_context(nanoepoch, stream_id, event_id, local::payload::event_type_t::event_types::CONTEXT_ENTER);
+}
+
+void neutrino_context_leave(const uint64_t nanoepoch, const uint64_t stream_id, const uint64_t event_id)
+{
+    producer::consumer_guard_t c;
+    if(c)
+        c->consume_context(nanoepoch, stream_id, event_id, local::payload::event_type_t::event_types::CONTEXT_LEAVE);
+}
+
+void neutrino_context_panic(const uint64_t nanoepoch, const uint64_t stream_id, const uint64_t event_id)
+{
+    producer::consumer_guard_t c;
+    if(c)
+        c->consume_context(nanoepoch, stream_id, event_id, local::payload::event_type_t::event_types::CONTEXT_PANIC);
+}
+
+void neutrino_checkpoint_batch(const uint32_t count, const uint64_t* nanoepoch, const uint64_t* stream_id, const uint64_t* event_id)
+{
+    producer::consumer_guard_t c;
+    if(c)
+        c->consume_checkpoint_batch(count, nanoepoch, stream_id, event_id);
+}
+
+void neutrino_context_batch(const uint32_t count, const uint64_t* nanoepoch, const uint64_t* stream_id, const uint64_t* event_id, const uint8_t* event_type)
+{
+    producer::consumer_guard_t c;
+    if(c)
+        c->consume_context_batch(count, nanoepoch, stream_id, event_id, event_type);
+}
+
+void neutrino_flush()
+{
+    producer::consumer_guard_t c;
+    if(c)
+        c->m_endpoint.flush();
+}
+
+void neutrino_clock_calibration(void)
+{
+    if (clock::source() != clock::clock_source_t::TSC_RAW)
+        return;
+    producer::consumer_guard_t c;
+    if(c)
+    {
+        const auto& calibration = clock::calibration();
+        c->consume_clock_calibration(calibration.m_ticks0, calibration.m_nanoepoch0, calibration.m_mult, calibration.m_shift);
+    }
+}
+
+} // extern "C"
@@ -1,25 +1,209 @@
-#include <memory>
-
-#include <neutrino_producer.hpp>
-#include <neutrino_transport.hpp>
-
-namespace neutrino
-{
-    namespace impl
-    {
-        namespace producer
-        {
-            static std::shared_ptr<transport::consumer_stub_t> active_consumer = std::shared_ptr<transport::consumer_stub_t>();
-
-            std::shared_ptr<transport::consumer_stub_t> set_consumer(std::shared_ptr<transport::consumer_stub_t> p) noexcept
-            {
-                active_consumer.swap(p);
-                return p;
-            }
-            std::shared_ptr<transport::consumer_stub_t> get_consumer() noexcept
-            {
-                return std::shared_ptr<transport::consumer_stub_t>(active_consumer);
-            }
-        }
-    }
-}
+#include <new>
+#include <memory>
+#include <mutex>
+#include <atomic>
+#include <thread>
+
+#if defined(_WIN32)
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#elif defined(__linux__)
+#include <unistd.h>
+#include <sys/syscall.h>
+#include <linux/membarrier.h>
+#endif
+
+#include <neutrino_aligned.hpp>
+#include <neutrino_producer.hpp>
+#include <neutrino_transport.hpp>
+
+namespace
+{
+    using namespace neutrino::impl;
+
+    // Read side of the active consumer publication (RCU style).
+    // Each thread owns a reader record, readers only write to their own record (own cache line).
+    // Writer publishes a new raw pointer, then waits a grace period:
+    // every record seen inside read-side section (odd m_seq) must leave it before the old consumer is released.
+    struct alignas(64) reader_t
+    {
+        std::atomic<uint64_t> m_seq{ 0 }; // odd: owner thread is inside read-side section
+        std::atomic<bool> m_in_use{ true }; // record is owned by a live thread
+        std::size_t m_depth = 0; // nesting, accessed by owner thread only
+        reader_t* m_next = nullptr; // records are never deleted, reused by new threads
+    };
+
+    std::atomic<reader_t*> readers{ nullptr };
+
+    std::atomic<transport::consumer_stub_t*> active_consumer_raw{ nullptr };
+
+    std::mutex active_consumer_mtx;
+    std::shared_ptr<transport::consumer_stub_t> active_consumer; // owns *active_consumer_raw, guarded by active_consumer_mtx
+
+    // records are never deleted
+    reader_t* new_reader()
+    {
+        return aligned_new<reader_t>().release();
+    }
+
+    reader_t* acquire_reader()
+    {
+        for (auto* r = readers.load(std::memory_order_acquire); r; r = r->m_next)
+        {
+            bool in_use = false;
+            if (!r->m_in_use.load(std::memory_order_relaxed) && r->m_in_use.compare_exchange_strong(in_use, true))
+                return r;
+        }
+        auto* r = new_reader();
+        r->m_next = readers.load(std::memory_order_relaxed);
+        while (!readers.compare_exchange_weak(r->m_next, r))
+        {
+        }
+        return r;
+    }
+
+    void release_reader(reader_t* r) noexcept
+    {
+        r->m_in_use.store(false, std::memory_order_release);
+    }
+
+    // Record of the thread, taken by its first read-side section and given back when the thread exits.
+    // Destructors of other thread_local objects may still run sections after that:
+    // such a section takes a record for its own duration, the record given back is never written again.
+    thread_local reader_t* this_thread_record = nullptr;
+    thread_local bool this_thread_exited = false;
+
+    struct thread_reader_t
+    {
+        bool m_armed = false;
+        ~thread_reader_t()
+        {
+            this_thread_exited = true;
+            reader_t* r = this_thread_record;
+            if (r && !r->m_depth)
+            {
+                this_thread_record = nullptr;
+                release_reader(r);
+            }
+        }
+    };
+
+    thread_local thread_reader_t this_thread_reader;
+
+    reader_t& enter_reader()
+    {
+        if (!this_thread_record)
+        {
+            this_thread_record = acquire_reader();
+            // not touched once destroyed
+            if (!this_thread_exited)
+                this_thread_reader.m_armed = true;
+        }
+        return *this_thread_record;
+    }
+
+    // Reader's m_seq store must be visible before it loads the consumer pointer (store-load order).
+    // Where the OS provides a process-wide barrier the writer pays for it (heavy_fence)
+    // and reader gets away with compiler-only fence (light_fence).
+    struct asymmetric_fence_t
+    {
+        bool m_available = false;
+
+        asymmetric_fence_t()
+        {
+#if defined(_WIN32)
+            m_available = true;
+#elif defined(__linux__) && defined(__NR_membarrier)
+            m_available = 0 == syscall(__NR_membarrier, MEMBARRIER_CMD_REGISTER_PRIVATE_EXPEDITED, 0);
+#endif
+        }
+
+        void light() const noexcept
+        {
+            if (m_available)
+                std::atomic_signal_fence(std::memory_order_seq_cst);
+            else
+                std::atomic_thread_fence(std::memory_order_seq_cst);
+        }
+
+        void heavy() const noexcept
+        {
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+            if (!m_available)
+                return;
+#if defined(_WIN32)
+            FlushProcessWriteBuffers();
+#elif defined(__linux__) && defined(__NR_membarrier)
+            syscall(__NR_membarrier, MEMBARRIER_CMD_PRIVATE_EXPEDITED, 0);
+#endif
+        }
+    } const asymmetric_fence;
+
+    void wait_for_readers() noexcept
+    {
+        for (auto* r = readers.load(std::memory_order_acquire); r; r = r->m_next)
+        {
+            const auto seq = r->m_seq.load(std::memory_order_acquire);
+            if (!(seq & 1))
+                continue;
+            // reader may still use previous consumer, wait until it leaves read-side section
+            while (r->m_seq.load(std::memory_order_acquire) == seq)
+                std::this_thread::yield();
+        }
+    }
+}
+
+namespace neutrino
+{
+    namespace impl
+    {
+        namespace producer
+        {
+            std::shared_ptr<transport::consumer_stub_t> set_consumer(std::shared_ptr<transport::consumer_stub_t> p) noexcept
+            {
+                std::lock_guard<std::mutex> l(active_consumer_mtx);
+
+                active_consumer.swap(p);
+                active_consumer_raw.store(active_consumer.get(), std::memory_order_release);
+
+                asymmetric_fence.heavy();
+                wait_for_readers();
+
+                // no reader refers to previous consumer anymore, caller may release it
+                return p;
+            }
+
+            std::shared_ptr<transport::consumer_stub_t> get_consumer() noexcept
+            {
+                std::lock_guard<std::mutex> l(active_consumer_mtx);
+                return std::shared_ptr<transport::consumer_stub_t>(active_consumer);
+            }
+
+            transport::consumer_stub_t* enter_consumer() noexcept
+            {
+                auto& r = enter_reader();
+                if (!r.m_depth++)
+                {
+                    r.m_seq.store(r.m_seq.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+                    asymmetric_fence.light();
+                }
+                return active_consumer_raw.load(std::memory_order_acquire);
+            }
+
+            void leave_consumer() noexcept
+            {
+                auto& r = *this_thread_record;
+                if (!--r.m_depth)
+                {
+                    r.m_seq.store(r.m_seq.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+                    if (this_thread_exited)
+                    {
+                        this_thread_record = nullptr;
+                        release_reader(&r);
+                    }
+                }
+            }
+        }
+    }
+}
@@ -0,0 +1,114 @@
+#include <algorithm>
+
+#if defined(_WIN32)
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#elif defined(__linux__)
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+#include <neutrino_transport_buffered_flush_scheduler.hpp>
+
+namespace
+{
+    // of the calling thread: low while sampling, normal while a flush holds the buffer producers wait for
+    void set_priority(const bool low)
+    {
+#if defined(_WIN32)
+        SetThreadPriority(GetCurrentThread(), low ? THREAD_PRIORITY_LOWEST : THREAD_PRIORITY_NORMAL);
+#elif defined(__linux__) && defined(SCHED_BATCH)
+        // not SCHED_IDLE: it can't be left without CAP_SYS_NICE, SCHED_BATCH and SCHED_OTHER switch freely at the same nice
+        sched_param sp{};
+        pthread_setschedparam(pthread_self(), low ? SCHED_BATCH : SCHED_OTHER, &sp);
+#else
+        (void)low;
+#endif
+    }
+}
+
+namespace neutrino
+{
+    namespace impl
+    {
+        namespace transport
+        {
+            flush_scheduler_t::flush_scheduler_t(const flush_scheduler_params_t po)
+                : m_params(po)
+            {
+                m_thread = std::thread([this]() { run(); });
+            }
+
+            flush_scheduler_t::~flush_scheduler_t()
+            {
+                {
+                    std::lock_guard<std::mutex> l(m_mtx);
+                    m_stop = true;
+                }
+                m_cv.notify_one();
+                m_thread.join();
+            }
+
+            void flush_scheduler_t::add(std::shared_ptr<buffered_endpoint_t> e)
+            {
+                entry_t entry;
+                entry.m_deliveries = e->m_deliveries.load(std::memory_order_relaxed);
+                entry.m_endpoint = e;
+
+                std::lock_guard<std::mutex> l(m_mtx);
+                m_entries.push_back(entry);
+            }
+
+            flush_scheduler_t::metrics_t flush_scheduler_t::metrics()
+            {
+                std::lock_guard<std::mutex> l(m_mtx);
+                return m_metrics;
+            }
+
+            void flush_scheduler_t::run()
+            {
+                // data arriving right after a sample is seen pending on the next one and flushed on the one after
+                const auto period = std::max(m_params.m_max_latency / 2, std::chrono::microseconds(1));
+
+                set_priority(true);
+                std::unique_lock<std::mutex> l(m_mtx);
+                while (!m_cv.wait_for(l, period, [this]() { return m_stop; }))
+                {
+                    bool raised = false;
+                    for (auto it = m_entries.begin(); it != m_entries.end(); )
+                    {
+                        auto e = it->m_endpoint.lock();
+                        if (!e)
+                        {
+                            it = m_entries.erase(it);
+                            continue;
+                        }
+
+                        auto deliveries = e->m_deliveries.load(std::memory_order_relaxed);
+                        bool pending = e->pending() != 0;
+                        if (pending && it->m_pending && deliveries == it->m_deliveries)
+                        {
+                            if (!raised)
+                            {
+                                set_priority(false);
+                                raised = true;
+                            }
+                            uint8_t dummy[1];
+                            m_metrics.m_flushes++;
+                            if (!e->consume(dummy, dummy))
+                                m_metrics.m_failed_flushes++;
+                            deliveries = e->m_deliveries.load(std::memory_order_relaxed);
+                            pending = false;
+                        }
+                        it->m_deliveries = deliveries;
+                        it->m_pending = pending;
+                        ++it;
+                    }
+                    if (raised)
+                        set_priority(true);
+                }
+            }
+        }
+    }
+}
@@ -1,115 +1,449 @@
-#include <cstring>
-#include <thread>
-#include <cassert>
-
-#include <neutrino_transport_buffered_mt.hpp>
-
-namespace neutrino
-{
-    namespace impl
-    {
-        namespace transport
-        {
-            bool buffered_exclusive_endpoint_t::consume(const std::uint8_t* p, const std::uint8_t* e)
-            {
-                std::lock_guard<std::mutex> l(m_buffer_mtx);
-                return buffered_singlethread_endpoint_t::consume(p, e);
-            }
-
-            bool buffered_optimistic_endpoint_t::consume(const std::uint8_t* p, const std::uint8_t* e)
-            {
-                const auto beyond_the_end = (unsigned long long)1 + m_message_buf.size();
-
-                // step one: copy data
-                auto b = e - p;
-
-                if(!b) // 0 bytes is a way how caller asks to flush the buffer
-                {
-                    return flush();
-                }
-
-                auto optimistic_lock_retries_on_frame_add = m_params.m_optimistic_lock_retries;
-                while (optimistic_lock_retries_on_frame_add--)
-                {
-                    auto start = m_frame_start.load();
-
-                    if(start > m_message_buf.size())
-                    {
-                        // flush in progress
-                        std::this_thread::yield();
-                        continue;
-                    }
-
-                    auto end = start + b;
-
-                    if (end >= m_message_buf.size()) // TODO: overflow
-                    {
-                        // proposed amount of bytes + current buffer in-use bytes may overflow the buffer, flush first
-                        if(!flush())
-                        {
-                            // TODO error.fetch_or(neutrino::impl::frame_v00::header::bits::MASK_PREV_FRAME_ERROR);
-                            return false;
-                        }
-                        optimistic_lock_retries_on_frame_add++; // add retry since flush() is not a failure
-                        continue;
-                    }
-
-                    if (!m_frame_start.compare_exchange_strong(start, beyond_the_end))
-                    {
-                        // conflict: other thread updated m_frame_start, retry
-                        std::this_thread::yield();
-                        continue;
-                    }
-
-                    // a region [pcfg->m_message_buf + start ... pcfg->m_message_buf + start + b) is now in exclusive use of current thread
-                    std::copy_n(p, b, m_message_buf.begin() + start);
-
-                    auto dummy = beyond_the_end;
-                    if (!m_frame_start.compare_exchange_strong(dummy, end))
-                    {
-                        // conflict: other thread updated m_frame_start, retry
-                        std::this_thread::yield();
-                        continue;
-                    }
-
-                    // step two: send if data above watermark
-                    return m_frame_start.load() <= m_buffered_endpoint_params.m_message_buf_watermark || flush();
-                }
-                return false;
-            }
-
-            bool buffered_optimistic_endpoint_t::flush()
-            {
-                auto optimistic_lock_retries_on_consume = m_params.m_optimistic_lock_retries;
-
-                while (optimistic_lock_retries_on_consume--)
-                {
-                    auto occupied = m_frame_start.load();
-                    if (!occupied)
-                        return true;
-                    // prevent any other additions to a buffer while it is being flushed
-                    // also block (spin lock) other threads flush
-                    auto beyond_the_end = decltype(occupied)(2) + m_message_buf.size();
-                    if (occupied < m_message_buf.size() && m_frame_start.compare_exchange_strong(occupied, beyond_the_end))
-                    {
-                        const auto* p = &(m_message_buf[0]);
-                        if (!m_endpoint->consume(p, p + occupied))
-                        {
-                            // TODO: retry on fatal consumer error
-                            // TODO: retval & retry || retval & fatal
-                            // TODO error.fetch_or(neutrino::impl::frame_v00::header::bits::MASK_PREV_FRAME_ERROR);
-                            return false;
-                        }
-                        if(m_frame_start.compare_exchange_strong(beyond_the_end, 0)) // TODO: allows sporadic re-consume
-                            break;
-                    }
-
-                    // more data has been added to a buffer during consume operation, consume that new data
-                    std::this_thread::yield();
-                }
-
-                return true;
-            }
-        }
-    }
-}
+#include <cstring>
+#include <thread>
+#include <cassert>
+
+#include <neutrino_transport_buffered_mt.hpp>
+
+namespace neutrino
+{
+    namespace impl
+    {
+        namespace transport
+        {
+            bool buffered_exclusive_endpoint_t::consume(const std::uint8_t* p, const std::uint8_t* e)
+            {
+                std::lock_guard<std::mutex> l(m_buffer_mtx);
+                return buffered_singlethread_endpoint_t::consume(p, e);
+            }
+
+            bool buffered_exclusive_endpoint_t::consume_frames(const std::uint8_t* p, const std::uint8_t* e, const std::size_t frame_size)
+            {
+                std::lock_guard<std::mutex> l(m_buffer_mtx);
+                return buffered_singlethread_endpoint_t::consume_frames(p, e, frame_size);
+            }
+
+            uint64_t buffered_exclusive_endpoint_t::pending()
+            {
+                std::lock_guard<std::mutex> l(m_buffer_mtx);
+                return m_frame_start;
+            }
+
+            uint8_t* buffered_exclusive_endpoint_t::reserve(const std::size_t b)
+            {
+                m_buffer_mtx.lock();
+                auto* p = buffered_singlethread_endpoint_t::reserve(b);
+                if (!p)
+                    m_buffer_mtx.unlock();
+                return p;
+            }
+
+            bool buffered_exclusive_endpoint_t::commit(uint8_t* p, const std::size_t b)
+            {
+                std::lock_guard<std::mutex> l(m_buffer_mtx, std::adopt_lock);
+                return buffered_singlethread_endpoint_t::commit(p, b);
+            }
+
+            bool buffered_optimistic_endpoint_t::consume_frames(const std::uint8_t* p, const std::uint8_t* e, const std::size_t frame_size)
+            {
+                while (p < e)
+                {
+                    // size is a hint only, consume() flushes first when other threads took the room meanwhile
+                    const auto start = m_frame_start.load();
+                    const auto b = frames_chunk(start > m_message_buf.size() ? 0 : start, frame_size, e - p);
+                    if (!b || !consume(p, p + b))
+                        return false;
+                    p += b;
+                }
+                return true;
+            }
+
+            bool buffered_optimistic_endpoint_t::consume(const std::uint8_t* p, const std::uint8_t* e)
+            {
+                const uint64_t beyond_the_end = uint64_t(1) + m_message_buf.size();
+
+                // step one: copy data
+                auto b = e - p;
+
+                if(!b) // 0 bytes is a way how caller asks to flush the buffer
+                {
+                    return flush();
+                }
+
+                auto optimistic_lock_retries_on_frame_add = m_params.m_optimistic_lock_retries;
+                while (optimistic_lock_retries_on_frame_add--)
+                {
+                    auto start = m_frame_start.load();
+
+                    if(start > m_message_buf.size())
+                    {
+                        // flush in progress
+                        std::this_thread::yield();
+                        continue;
+                    }
+
+                    auto end = start + b;
+
+                    if (end >= m_message_buf.size()) // TODO: overflow
+                    {
+                        // proposed amount of bytes + current buffer in-use bytes may overflow the buffer, flush first
+                        if(!flush())
+                        {
+                            // TODO error.fetch_or(neutrino::impl::frame_v00::header::bits::MASK_PREV_FRAME_ERROR);
+                            return false;
+                        }
+                        optimistic_lock_retries_on_frame_add++; // add retry since flush() is not a failure
+                        continue;
+                    }
+
+                    if (!m_frame_start.compare_exchange_strong(start, beyond_the_end))
+                    {
+                        // conflict: other thread updated m_frame_start, retry
+                        std::this_thread::yield();
+                        continue;
+                    }
+
+                    // a region [pcfg->m_message_buf + start ... pcfg->m_message_buf + start + b) is now in exclusive use of current thread
+                    std::copy_n(p, b, m_message_buf.begin() + start);
+
+                    auto dummy = beyond_the_end;
+                    if (!m_frame_start.compare_exchange_strong(dummy, end))
+                    {
+                        // conflict: other thread updated m_frame_start, retry
+                        std::this_thread::yield();
+                        continue;
+                    }
+
+                    // step two: send if data above watermark
+                    return m_frame_start.load() <= m_buffered_endpoint_params.m_message_buf_watermark || flush();
+                }
+                return false;
+            }
+
+            bool buffered_optimistic_endpoint_t::flush()
+            {
+                auto optimistic_lock_retries_on_consume = m_params.m_optimistic_lock_retries;
+
+                while (optimistic_lock_retries_on_consume--)
+                {
+                    auto occupied = m_frame_start.load();
+                    if (!occupied)
+                        return true;
+                    // prevent any other additions to a buffer while it is being flushed
+                    // also block (spin lock) other threads flush
+                    auto beyond_the_end = decltype(occupied)(2) + m_message_buf.size();
+                    if (occupied < m_message_buf.size() && m_frame_start.compare_exchange_strong(occupied, beyond_the_end))
+                    {
+                        const auto* p = &(m_message_buf[0]);
+                        if (!deliver(p, p + occupied))
+                        {
+                            // TODO: retry on fatal consumer error
+                            // TODO: retval & retry || retval & fatal
+                            // TODO error.fetch_or(neutrino::impl::frame_v00::header::bits::MASK_PREV_FRAME_ERROR);
+                            return false;
+                        }
+                        if(m_frame_start.compare_exchange_strong(beyond_the_end, 0)) // TODO: allows sporadic re-consume
+                            break;
+                    }
+
+                    // more data has been added to a buffer during consume operation, consume that new data
+                    std::this_thread::yield();
+                }
+
+                return true;
+            }
+
+            bool buffered_reserve_commit_endpoint_t::consume(const std::uint8_t* p, const std::uint8_t* e)
+            {
+                const uint64_t b = e - p;
+
+                if (!b) // 0 bytes is a way how caller asks to flush the buffer
+                    return flush();
+
+                auto* d = reserve(b);
+                if (!d)
+                    return false;
+
+                std::copy(p, e, d);
+                return commit(d, b);
+            }
+
+            uint8_t* buffered_reserve_commit_endpoint_t::reserve(const std::size_t b)
+            {
+                if (!b || b > m_sz)
+                    return nullptr;
+
+                for (;;)
+                {
+                    const auto start = m_reserved.fetch_add(b);
+
+                    if (start + b <= m_sz)
+                    {
+                        // a region [start ... start + b) is now in exclusive use of current thread
+                        return m_data + start;
+                    }
+
+                    if (start <= m_sz)
+                    {
+                        // claim crosses the buffer end: consume what is claimed before it and retry in the reopened buffer
+                        if (!flush_extent(start))
+                        {
+                            // TODO error.fetch_or(neutrino::impl::frame_v00::header::bits::MASK_PREV_FRAME_ERROR);
+                            return nullptr;
+                        }
+                        continue;
+                    }
+
+                    // buffer is full or sealed, wait for the flushing thread to reopen it
+                    while (m_reserved.load(std::memory_order_acquire) > m_sz)
+                        std::this_thread::yield();
+                }
+            }
+
+            bool buffered_reserve_commit_endpoint_t::commit(uint8_t* p, const std::size_t b)
+            {
+                const uint64_t start = p - m_data;
+                const uint64_t end = start + b;
+                m_committed.fetch_add(b, std::memory_order_release);
+
+                // step two: the claim which crosses watermark sends the buffer
+                const auto watermark = m_buffered_endpoint_params.m_message_buf_watermark;
+                return start > watermark || end <= watermark || seal();
+            }
+
+            bool buffered_reserve_commit_endpoint_t::consume_frames(const std::uint8_t* p, const std::uint8_t* e, const std::size_t frame_size)
+            {
+                while (p < e)
+                {
+                    // size is a hint only, consume() waits for the reopened buffer when other threads took the room meanwhile
+                    const auto start = m_reserved.load();
+                    const auto b = frames_chunk(start > m_sz ? 0 : start, frame_size, e - p);
+                    if (!b || !consume(p, p + b))
+                        return false;
+                    p += b;
+                }
+                return true;
+            }
+
+            bool buffered_reserve_commit_endpoint_t::seal()
+            {
+                const auto extent = m_reserved.exchange(sealed);
+                if (extent > m_sz)
+                {
+                    // other thread is flushing, it reopens the buffer
+                    return true;
+                }
+                return flush_extent(extent);
+            }
+
+            bool buffered_reserve_commit_endpoint_t::flush_extent(const uint64_t extent)
+            {
+                // claims before extent are copied by their threads, claims after it are refused and retried
+                while (m_committed.load(std::memory_order_acquire) != extent)
+                    std::this_thread::yield();
+
+                if (extent && !deliver(m_data, m_data + extent))
+                {
+                    // TODO: retry on fatal consumer error
+                    // keep the data, reopen buffer as it is
+                    m_reserved.store(extent, std::memory_order_release);
+                    return false;
+                }
+
+                m_committed.store(0, std::memory_order_relaxed);
+                m_reserved.store(0, std::memory_order_release);
+                return true;
+            }
+
+            bool buffered_reserve_commit_endpoint_t::flush()
+            {
+                if (!seal())
+                    return false;
+
+                // data sealed by other thread is delivered as well
+                while (m_reserved.load(std::memory_order_acquire) > m_sz)
+                    std::this_thread::yield();
+                return true;
+            }
+
+            buffered_multi_optimistic_endpoint_t::buffered_multi_optimistic_endpoint_t(
+                std::shared_ptr<endpoint_t> endpoint
+                , const buffered_endpoint_t::buffered_endpoint_params_t bpo
+                , const buffered_multi_optimistic_params_t po
+            )
+                : buffered_endpoint_t(endpoint, bpo), m_params(po)
+            {
+                const std::size_t cc_buffers = m_params.m_buffers < 2 ? 2 : m_params.m_buffers;
+                for (std::size_t cc = 0; cc < cc_buffers; cc++)
+                {
+                    m_buffers.emplace_back(new buffer_t());
+                    auto& b = *m_buffers.back();
+                    if (cc)
+                    {
+                        b.m_storage.resize(m_sz);
+                        b.m_data = b.m_storage.data();
+                    }
+                    else
+                    {
+                        b.m_data = m_data;
+                    }
+                }
+            }
+
+            buffered_multi_optimistic_endpoint_t::seal_result_t buffered_multi_optimistic_endpoint_t::seal(const std::size_t idx, uint64_t occupied)
+            {
+                auto& b = *m_buffers[idx];
+
+                // fails when another thread is copying into the buffer or has sealed it already
+                if (!occupied || !b.m_frame_start.compare_exchange_strong(occupied, sealed()))
+                    return seal_result_t::RETRY;
+
+                const auto next_idx = (idx + 1) % m_buffers.size();
+                const auto& next = *m_buffers[next_idx];
+                while (next.m_frame_start.load() == sealed())
+                {
+                    // next buffer is still being consumed downstream
+                    if (m_params.m_all_in_flight == buffered_multi_optimistic_params_t::all_in_flight_policy_t::DROP)
+                    {
+                        b.m_frame_start.store(occupied);
+                        return seal_result_t::ALL_IN_FLIGHT;
+                    }
+                    std::this_thread::yield();
+                }
+
+                b.m_seal_seq = m_seal_seq++;
+                m_active.store(next_idx);
+
+                // producers append to the next buffer from now on, consume sealed one in seal order
+                while (m_consume_seq.load() != b.m_seal_seq)
+                    std::this_thread::yield();
+
+                const bool consumed = deliver(b.m_data, b.m_data + occupied);
+                if (!consumed)
+                {
+                    // TODO: retry on fatal consumer error
+                    m_dropped_bytes += occupied;
+                }
+
+                b.m_frame_start.store(0);
+                m_consume_seq++;
+
+                return consumed ? seal_result_t::SEALED : seal_result_t::CONSUME_FAILED;
+            }
+
+            bool buffered_multi_optimistic_endpoint_t::consume(const std::uint8_t* p, const std::uint8_t* e)
+            {
+                const uint64_t b = e - p;
+
+                if (!b) // 0 bytes is a way how caller asks to flush the buffer
+                    return flush();
+
+                if (b >= m_sz)
+                {
+                    m_dropped_bytes += b;
+                    return false;
+                }
+
+                auto optimistic_lock_retries_on_frame_add = m_params.m_optimistic_lock_retries;
+                while (optimistic_lock_retries_on_frame_add--)
+                {
+                    const auto idx = m_active.load();
+                    auto& buf = *m_buffers[idx];
+                    auto start = buf.m_frame_start.load();
+
+                    if (start > m_sz)
+                    {
+                        // copy or seal in progress
+                        std::this_thread::yield();
+                        continue;
+                    }
+
+                    const auto end = start + b;
+
+                    if (end >= m_sz)
+                    {
+                        // does not fit, seal current buffer and continue with the next one
+                        switch (seal(idx, start))
+                        {
+                        case seal_result_t::ALL_IN_FLIGHT:
+                            m_dropped_bytes += b;
+                            return false;
+                        case seal_result_t::CONSUME_FAILED:
+                            return false;
+                        default:
+                            break;
+                        }
+                        optimistic_lock_retries_on_frame_add++; // add retry since seal is not a failure
+                        continue;
+                    }
+
+                    if (!buf.m_frame_start.compare_exchange_strong(start, in_copy()))
+                    {
+                        // conflict: other thread updated m_frame_start, retry
+                        std::this_thread::yield();
+                        continue;
+                    }
+
+                    if (m_active.load() != idx)
+                    {
+                        // buffer was sealed, consumed and reset after idx had been read, it is not the active one anymore
+                        buf.m_frame_start.store(start);
+                        continue;
+                    }
+
+                    // a region [start ... end) is now in exclusive use of current thread
+                    std::copy(p, e, buf.m_data + start);
+                    buf.m_frame_start.store(end);
+
+                    // step two: send if data above watermark
+                    return end <= m_buffered_endpoint_params.m_message_buf_watermark || seal(idx, end) != seal_result_t::CONSUME_FAILED;
+                }
+                return false;
+            }
+
+            bool buffered_multi_optimistic_endpoint_t::consume_frames(const std::uint8_t* p, const std::uint8_t* e, const std::size_t frame_size)
+            {
+                while (p < e)
+                {
+                    const auto start = m_buffers[m_active.load()]->m_frame_start.load();
+                    const auto b = frames_chunk(start > m_sz ? 0 : start, frame_size, e - p);
+                    if (!b || !consume(p, p + b))
+                        return false;
+                    p += b;
+                }
+                return true;
+            }
+
+            bool buffered_multi_optimistic_endpoint_t::flush()
+            {
+                bool ret = true;
+                auto optimistic_lock_retries_on_consume = m_params.m_optimistic_lock_retries;
+                while (optimistic_lock_retries_on_consume--)
+                {
+                    const auto idx = m_active.load();
+                    const auto occupied = m_buffers[idx]->m_frame_start.load();
+                    if (!occupied)
+                        break;
+                    if (occupied <= m_sz)
+                    {
+                        const auto r = seal(idx, occupied);
+                        if (r == seal_result_t::SEALED)
+                            break;
+                        if (r == seal_result_t::CONSUME_FAILED)
+                        {
+                            ret = false;
+                            break;
+                        }
+                    }
+                    std::this_thread::yield();
+                }
+
+                // buffers sealed by other threads are delivered as well
+                const auto sealed_before = m_seal_seq.load();
+                while (m_consume_seq.load() < sealed_before)
+                    std::this_thread::yield();
+
+                return ret;
+            }
+        }
+    }
+}
@@ -0,0 +1,290 @@
+#include <cstring>
+#include <algorithm>
+#include <utility>
+
+#include <neutrino_transport_buffered_per_thread.hpp>
+
+namespace
+{
+    using neutrino::impl::transport::buffered_per_thread_endpoint_t;
+
+    std::atomic<uint64_t> next_endpoint_id{ 1 };
+
+    std::size_t round_up_pow2(std::size_t sz)
+    {
+        std::size_t ret = 64;
+        while (ret < sz)
+            ret <<= 1;
+        return ret;
+    }
+
+    // rings of the current thread, one per endpoint it has written to
+    struct thread_rings_t
+    {
+        std::vector<std::pair<uint64_t, std::shared_ptr<buffered_per_thread_endpoint_t::ring_t>>> m_rings;
+
+        // last used ring, fast path for the common one-endpoint case
+        uint64_t m_last_id = 0;
+        buffered_per_thread_endpoint_t::ring_t* m_last = nullptr;
+
+        ~thread_rings_t()
+        {
+            // drainer picks up what is left and releases the ring
+            for (auto& r : m_rings)
+                r.second->m_orphaned.store(true, std::memory_order_release);
+        }
+    };
+
+    thread_local thread_rings_t this_thread_rings;
+}
+
+namespace neutrino
+{
+    namespace impl
+    {
+        namespace transport
+        {
+            buffered_per_thread_endpoint_t::ring_t::ring_t(std::size_t sz)
+                : m_buf(round_up_pow2(sz)), m_mask(m_buf.size() - 1)
+            {
+            }
+
+            uint8_t* buffered_per_thread_endpoint_t::ring_t::reserve(const std::size_t b) noexcept
+            {
+                const record_len_t len = static_cast<record_len_t>(b);
+                const std::size_t need = sizeof(len) + b;
+
+                auto head = m_head.load(std::memory_order_relaxed);
+                const auto idx = head & m_mask;
+                const auto contiguous = m_buf.size() - idx;
+
+                // a record is never split, skip the end of the buffer when it does not fit
+                const std::size_t pad = contiguous < need ? contiguous : 0;
+
+                if (need + pad > m_buf.size() - (head - m_cached_tail))
+                {
+                    m_cached_tail = m_tail.load(std::memory_order_acquire);
+                    if (b >= wrap_marker || need + pad > m_buf.size() - (head - m_cached_tail))
+                        return nullptr;
+                }
+
+                if (pad)
+                {
+                    const record_len_t marker = wrap_marker;
+                    if (pad >= sizeof(marker))
+                        std::memcpy(&m_buf[idx], &marker, sizeof(marker));
+                    head += pad;
+                }
+
+                auto* dst = &m_buf[head & m_mask];
+                std::memcpy(dst, &len, sizeof(len));
+                m_reserved_head = head + need;
+                return dst + sizeof(len);
+            }
+
+            bool buffered_per_thread_endpoint_t::ring_t::push(const uint8_t* p, const uint8_t* e) noexcept
+            {
+                const std::size_t b = e - p;
+                uint8_t* dst = reserve(b);
+                if (!dst)
+                {
+                    m_dropped_bytes.store(m_dropped_bytes.load(std::memory_order_relaxed) + b, std::memory_order_relaxed);
+                    return false;
+                }
+                std::memcpy(dst, p, b);
+                commit();
+                return true;
+            }
+
+            buffered_per_thread_endpoint_t::buffered_per_thread_endpoint_t(
+                std::shared_ptr<endpoint_t> endpoint
+                , const buffered_endpoint_t::buffered_endpoint_params_t bpo
+                , const buffered_per_thread_params_t po
+            )
+                : buffered_singlethread_endpoint_t(endpoint, bpo), m_params(po), m_id(next_endpoint_id++)
+            {
+                m_drainer = std::thread([this]() { drainer(); });
+            }
+
+            buffered_per_thread_endpoint_t::~buffered_per_thread_endpoint_t()
+            {
+                {
+                    std::lock_guard<std::mutex> l(m_drain_mtx);
+                    m_stop = true;
+                }
+                m_drain_cv.notify_one();
+                m_drainer.join();
+
+                // threads still holding rings drop them on next lookup or exit
+                std::lock_guard<std::mutex> l(m_new_rings_mtx);
+                for (auto& r : m_rings)
+                    r->m_detached.store(true, std::memory_order_release);
+                for (auto& r : m_new_rings)
+                    r->m_detached.store(true, std::memory_order_release);
+            }
+
+            buffered_per_thread_endpoint_t::ring_t* buffered_per_thread_endpoint_t::this_thread_ring()
+            {
+                auto& tr = this_thread_rings;
+                if (tr.m_last_id == m_id)
+                    return tr.m_last;
+
+                // slow path: first use by this thread or switch between endpoints
+                tr.m_rings.erase(
+                    std::remove_if(tr.m_rings.begin(), tr.m_rings.end(),
+                        [](const decltype(tr.m_rings)::value_type& r) { return r.second->m_detached.load(std::memory_order_acquire); })
+                    , tr.m_rings.end()
+                );
+
+                auto it = std::find_if(tr.m_rings.begin(), tr.m_rings.end(),
+                    [this](const decltype(tr.m_rings)::value_type& r) { return r.first == m_id; });
+
+                if (it == tr.m_rings.end())
+                {
+                    auto r = aligned_shared<ring_t>(m_params.m_ring_size);
+                    {
+                        std::lock_guard<std::mutex> l(m_new_rings_mtx);
+                        m_new_rings.push_back(r);
+                    }
+                    tr.m_rings.emplace_back(m_id, r);
+                    it = tr.m_rings.end() - 1;
+                }
+
+                tr.m_last_id = m_id;
+                tr.m_last = it->second.get();
+                return tr.m_last;
+            }
+
+            bool buffered_per_thread_endpoint_t::consume(const std::uint8_t* p, const std::uint8_t* e)
+            {
+                if (p == e) // 0 bytes is a way how caller asks to flush the buffer
+                    return flush();
+
+                auto* r = this_thread_ring();
+                if (std::size_t(e - p) > m_sz)
+                {
+                    // would never fit into drainer's buffer
+                    r->m_dropped_bytes.store(r->m_dropped_bytes.load(std::memory_order_relaxed) + (e - p), std::memory_order_relaxed);
+                    return false;
+                }
+                return r->push(p, e);
+            }
+
+            bool buffered_per_thread_endpoint_t::consume_frames(const std::uint8_t* p, const std::uint8_t* e, const std::size_t frame_size)
+            {
+                // one ring record per run of frames which fits into drainer's buffer
+                bool ret = true;
+                while (p < e)
+                {
+                    const auto b = frames_chunk(0, frame_size, e - p);
+                    if (!b)
+                        return false;
+                    ret = consume(p, p + b) && ret;
+                    p += b;
+                }
+                return ret;
+            }
+
+            uint8_t* buffered_per_thread_endpoint_t::reserve(const std::size_t b)
+            {
+                // nullptr sends the caller to consume(), which counts the drop
+                if (!b || b > m_sz)
+                    return nullptr;
+                return this_thread_ring()->reserve(b);
+            }
+
+            bool buffered_per_thread_endpoint_t::commit(uint8_t*, const std::size_t)
+            {
+                this_thread_ring()->commit();
+                return true;
+            }
+
+            uint64_t buffered_per_thread_endpoint_t::dropped_bytes()
+            {
+                uint64_t ret = m_retired_dropped_bytes.load();
+                std::lock_guard<std::mutex> l(m_drain_mtx);
+                for (const auto& r : m_rings)
+                    ret += r->m_dropped_bytes.load(std::memory_order_relaxed);
+                std::lock_guard<std::mutex> ln(m_new_rings_mtx);
+                for (const auto& r : m_new_rings)
+                    ret += r->m_dropped_bytes.load(std::memory_order_relaxed);
+                return ret;
+            }
+
+            uint64_t buffered_per_thread_endpoint_t::pending()
+            {
+                std::lock_guard<std::mutex> l(m_drain_mtx);
+                uint64_t ret = m_frame_start;
+                for (const auto& r : m_rings)
+                    ret += r->m_head.load(std::memory_order_relaxed) - r->m_tail.load(std::memory_order_relaxed);
+                std::lock_guard<std::mutex> ln(m_new_rings_mtx);
+                for (const auto& r : m_new_rings)
+                    ret += r->m_head.load(std::memory_order_relaxed) - r->m_tail.load(std::memory_order_relaxed);
+                return ret;
+            }
+
+            bool buffered_per_thread_endpoint_t::append_locked(const uint8_t* p, const uint8_t* e)
+            {
+                // same rules as buffered_singlethread_endpoint_t::consume, but flushes downstream directly:
+                // virtual flush() is the one which drains the rings
+                const std::size_t b = e - p;
+                if (m_frame_start + b >= m_sz && !buffered_singlethread_endpoint_t::flush())
+                    return false;
+
+                std::copy(p, e, m_data + m_frame_start);
+                m_frame_start += b;
+
+                return m_frame_start <= m_buffered_endpoint_params.m_message_buf_watermark || buffered_singlethread_endpoint_t::flush();
+            }
+
+            bool buffered_per_thread_endpoint_t::drain_locked()
+            {
+                {
+                    std::lock_guard<std::mutex> l(m_new_rings_mtx);
+                    m_rings.insert(m_rings.end(), m_new_rings.begin(), m_new_rings.end());
+                    m_new_rings.clear();
+                }
+
+                bool ret = true;
+                for (auto it = m_rings.begin(); it != m_rings.end(); )
+                {
+                    auto& r = **it;
+                    // read orphaned before draining, producer does not write after it is set
+                    const bool orphaned = r.m_orphaned.load(std::memory_order_acquire);
+                    if (!r.drain([this](const uint8_t* p, const uint8_t* e) { return append_locked(p, e); }))
+                    {
+                        ret = false;
+                        ++it;
+                        continue;
+                    }
+                    if (orphaned)
+                    {
+                        m_retired_dropped_bytes += r.m_dropped_bytes.load(std::memory_order_relaxed);
+                        it = m_rings.erase(it);
+                        continue;
+                    }
+                    ++it;
+                }
+                return ret;
+            }
+
+            bool buffered_per_thread_endpoint_t::flush()
+            {
+                std::lock_guard<std::mutex> l(m_drain_mtx);
+                return drain_locked() && buffered_singlethread_endpoint_t::flush();
+            }
+
+            void buffered_per_thread_endpoint_t::drainer()
+            {
+                std::unique_lock<std::mutex> l(m_drain_mtx);
+                while (!m_stop)
+                {
+                    drain_locked();
+                    m_drain_cv.wait_for(l, m_params.m_drain_period);
+                }
+                drain_locked();
+                buffered_singlethread_endpoint_t::flush();
+            }
+        }
+    }
+}
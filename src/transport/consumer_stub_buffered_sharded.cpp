@@ -0,0 +1,155 @@
+#include <atomic>
+#include <algorithm>
+#include <mutex>
+#include <thread>
+#include <utility>
+
+#if defined(_WIN32)
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#elif defined(__linux__)
+#include <sched.h>
+#endif
+
+#include <neutrino_transport_buffered_sharded.hpp>
+
+namespace
+{
+    std::atomic<uint64_t> next_endpoint_id{ 1 };
+
+    // ids of endpoints not destroyed yet, sorted; threads drop their entries of other ids
+    struct live_endpoints_t
+    {
+        std::mutex m_mtx;
+        std::vector<uint64_t> m_ids;
+        std::atomic<uint64_t> m_destroyed{ 0 };
+    };
+
+    // never destroyed, endpoints may outlive statics of this file
+    live_endpoints_t& live_endpoints()
+    {
+        static live_endpoints_t* l = new live_endpoints_t;
+        return *l;
+    }
+
+    // last shard used by current thread, per endpoint
+    thread_local std::vector<std::pair<uint64_t, std::size_t>> last_shards;
+    thread_local uint64_t last_shards_destroyed = 0; // m_destroyed when last_shards was pruned
+
+    // once an endpoint is destroyed, consume() pays one relaxed load to notice it
+    void prune_last_shards()
+    {
+        live_endpoints_t& l = live_endpoints();
+        const uint64_t destroyed = l.m_destroyed.load(std::memory_order_relaxed);
+        if (destroyed == last_shards_destroyed)
+            return;
+        last_shards_destroyed = destroyed;
+
+        std::lock_guard<std::mutex> lk(l.m_mtx);
+        last_shards.erase(std::remove_if(last_shards.begin(), last_shards.end()
+            , [&l](const std::pair<uint64_t, std::size_t>& s) { return !std::binary_search(l.m_ids.begin(), l.m_ids.end(), s.first); })
+            , last_shards.end());
+    }
+
+    std::size_t current_cpu()
+    {
+#if defined(_WIN32)
+        return GetCurrentProcessorNumber();
+#elif defined(__linux__)
+        const int cpu = sched_getcpu();
+        if (cpu >= 0)
+            return cpu;
+#endif
+        return std::hash<std::thread::id>()(std::this_thread::get_id());
+    }
+}
+
+namespace neutrino
+{
+    namespace impl
+    {
+        namespace transport
+        {
+            buffered_sharded_endpoint_t::buffered_sharded_endpoint_t(shard_factory_t f, const buffered_sharded_params_t po)
+                : m_params(po), m_id(next_endpoint_id++)
+            {
+                std::size_t cc_shards = m_params.m_shards;
+                if (!cc_shards)
+                    cc_shards = std::thread::hardware_concurrency();
+                if (!cc_shards)
+                    cc_shards = 1;
+
+                m_shards.resize(cc_shards);
+                for (auto& s : m_shards)
+                    s.m_endpoint = f();
+
+                live_endpoints_t& l = live_endpoints();
+                std::lock_guard<std::mutex> lk(l.m_mtx);
+                l.m_ids.insert(std::lower_bound(l.m_ids.begin(), l.m_ids.end(), m_id), m_id);
+            }
+
+            buffered_sharded_endpoint_t::~buffered_sharded_endpoint_t()
+            {
+                flush();
+
+                live_endpoints_t& l = live_endpoints();
+                std::lock_guard<std::mutex> lk(l.m_mtx);
+                l.m_ids.erase(std::lower_bound(l.m_ids.begin(), l.m_ids.end(), m_id));
+                l.m_destroyed.fetch_add(1, std::memory_order_relaxed);
+            }
+
+            std::size_t buffered_sharded_endpoint_t::this_thread_endpoints()
+            {
+                prune_last_shards();
+                return last_shards.size();
+            }
+
+            endpoint_t* buffered_sharded_endpoint_t::this_thread_shard()
+            {
+                const std::size_t idx = (
+                    m_params.m_selector == buffered_sharded_params_t::shard_selector_t::CPU
+                    ? current_cpu()
+                    : std::hash<std::thread::id>()(std::this_thread::get_id())
+                ) % m_shards.size();
+
+                prune_last_shards();
+                auto it = std::find_if(last_shards.begin(), last_shards.end(), [this](const auto& l) { return l.first == m_id; });
+                if (it == last_shards.end())
+                {
+                    last_shards.emplace_back(m_id, idx);
+                }
+                else if (it->second != idx)
+                {
+                    // thread moved, earlier frames go downstream before the new ones
+                    uint8_t dummy[1];
+                    m_shards[it->second].m_endpoint->consume(dummy, dummy);
+                    it->second = idx;
+                }
+                return m_shards[idx].m_endpoint.get();
+            }
+
+            bool buffered_sharded_endpoint_t::consume(const std::uint8_t* p, const std::uint8_t* e)
+            {
+                if (p == e) // 0 bytes is a way how caller asks to flush the buffer
+                    return flush();
+
+                return this_thread_shard()->consume(p, e);
+            }
+
+            bool buffered_sharded_endpoint_t::consume_frames(const std::uint8_t* p, const std::uint8_t* e, const std::size_t frame_size)
+            {
+                return this_thread_shard()->consume_frames(p, e, frame_size);
+            }
+
+            bool buffered_sharded_endpoint_t::flush()
+            {
+                bool ret = true;
+                uint8_t dummy[1];
+                for (auto& s : m_shards)
+                    ret = s.m_endpoint->consume(dummy, dummy) && ret;
+                return ret;
+            }
+        }
+    }
+}
@@ -1,63 +1,91 @@
-#include <cstring>
-#include <neutrino_transport_buffered_st.hpp>
-
-namespace neutrino
-{
-    namespace impl
-    {
-        namespace transport
-        {
-            bool buffered_singlethread_endpoint_t::consume(const std::uint8_t* p, const std::uint8_t* e)
-            {
-                // step one: copy data
-                auto b = e - p;
-
-                if(!b) // 0 bytes is a way how caller asks to flush the buffer
-                    return flush();
-
-                auto end = m_frame_start + b;
-
-                if (end >= m_sz) 
-                {
-                    // proposed amount of bytes + current buffer in-use bytes may overflow the buffer, flush first
-                    if(!flush())
-                    {
-                        // TODO: retry on fatal consumer error
-                        // TODO: retval & retry || retval & fatal
-                        // TODO error.fetch_or(neutrino::impl::frame_v00::header::bits::MASK_PREV_FRAME_ERROR);
-                        return false;
-                    }
-                    end = m_frame_start + b;
-                    if(end > m_sz)
-                    {
-                        // TODO: handle overflow
-                        return false;
-                    }
-                }
-
-                // a region [pcfg->m_message_buf + start ... pcfg->m_message_buf + start + b) is now in exclusive use of current thread
-                std::copy(p, p + b, m_data + m_frame_start);
-                m_frame_start = end;
-
-                return m_frame_start <= m_buffered_endpoint_params.m_message_buf_watermark || flush();
-            }
-            bool buffered_singlethread_endpoint_t::flush()
-            {
-                if(!m_frame_start)
-                    return true;
-
-                auto* p = m_data;
-                if (!m_endpoint->consume(p, p + m_frame_start))
-                {
-                    // TODO: retry on fatal consumer error
-                    // TODO: retval & retry || retval & fatal
-                    // TODO error.fetch_or(neutrino::impl::frame_v00::header::bits::MASK_PREV_FRAME_ERROR);
-                    return false;
-                }
-                m_frame_start = 0;
-
-                return true;
-            }
-        }
-    }
-}
+#include <cstdint>
+#include <cstring>
+#include <neutrino_transport_buffered_st.hpp>
+
+namespace neutrino
+{
+    namespace impl
+    {
+        namespace transport
+        {
+            bool buffered_singlethread_endpoint_t::consume(const std::uint8_t* p, const std::uint8_t* e)
+            {
+                // step one: copy data
+                auto b = e - p;
+
+                if(!b) // 0 bytes is a way how caller asks to flush the buffer
+                    return flush();
+
+                auto end = m_frame_start + b;
+
+                if (end >= m_sz) 
+                {
+                    // proposed amount of bytes + current buffer in-use bytes may overflow the buffer, flush first
+                    if(!flush())
+                    {
+                        // TODO: retry on fatal consumer error
+                        // TODO: retval & retry || retval & fatal
+                        // TODO error.fetch_or(neutrino::impl::frame_v00::header::bits::MASK_PREV_FRAME_ERROR);
+                        return false;
+                    }
+                    end = m_frame_start + b;
+                    if(end > m_sz)
+                    {
+                        // TODO: handle overflow
+                        return false;
+                    }
+                }
+
+                // a region [pcfg->m_message_buf + start ... pcfg->m_message_buf + start + b) is now in exclusive use of current thread
+                std::copy(p, p + b, m_data + m_frame_start);
+                m_frame_start = end;
+
+                return m_frame_start <= m_buffered_endpoint_params.m_message_buf_watermark || flush();
+            }
+            bool buffered_singlethread_endpoint_t::consume_frames(const std::uint8_t* p, const std::uint8_t* e, const std::size_t frame_size)
+            {
+                while (p < e)
+                {
+                    const auto b = frames_chunk(m_frame_start, frame_size, e - p);
+                    if (!b || !buffered_singlethread_endpoint_t::consume(p, p + b))
+                        return false;
+                    p += b;
+                }
+                return true;
+            }
+
+            uint8_t* buffered_singlethread_endpoint_t::reserve(const std::size_t b)
+            {
+                if (m_frame_start + b >= m_sz && !flush())
+                    return nullptr;
+                if (m_frame_start + b > m_sz)
+                    return nullptr;
+                return m_data + m_frame_start;
+            }
+
+            bool buffered_singlethread_endpoint_t::commit(uint8_t* p, const std::size_t b)
+            {
+                m_frame_start = (p - m_data) + b;
+                return m_frame_start <= m_buffered_endpoint_params.m_message_buf_watermark || flush();
+            }
+
+            bool buffered_singlethread_endpoint_t::flush()
+            {
+                if(!m_frame_start)
+                    return true;
+
+                auto* p = m_data;
+                if (!deliver(p, p + m_frame_start))
+                {
+                    // TODO: retry on fatal consumer error
+                    // TODO: retval & retry || retval & fatal
+                    // TODO error.fetch_or(neutrino::impl::frame_v00::header::bits::MASK_PREV_FRAME_ERROR);
+                    return false;
+                }
+                m_frame_start = 0;
+
+                return true;
+            }
+        }
+    }
+}
@@ -0,0 +1,225 @@
+#include <algorithm>
+#include <cerrno>
+
+#include <unistd.h>
+#include <poll.h>
+#include <signal.h>
+#include <limits.h>
+#include <pthread.h>
+#include <sys/uio.h>
+
+#include <neutrino_transport_endpoint_async_posix_handle.hpp>
+
+namespace
+{
+#if defined(IOV_MAX)
+    const std::size_t max_iov = IOV_MAX;
+#else
+    const std::size_t max_iov = 16;
+#endif
+    const int pollout_timeout_ms = 100;
+}
+
+namespace neutrino
+{
+    namespace impl
+    {
+        namespace transport
+        {
+            async_posix_consumer_t::async_posix_consumer_t(const async_posix_consumer_params_t asp)
+                : m_params(asp)
+            {
+                m_writer = std::thread([this]() { writer(); });
+            }
+
+            async_posix_consumer_t::~async_posix_consumer_t()
+            {
+                {
+                    std::lock_guard<std::mutex> l(m_mtx);
+                    m_stop = true;
+                }
+                m_cv.notify_one();
+                m_writer.join();
+
+                if (m_params.m_close_fd && m_params.m_fd >= 0)
+                    close(m_params.m_fd);
+            }
+
+            bool async_posix_consumer_t::consume(const std::uint8_t* p, const std::uint8_t* e)
+            {
+                const region_t r{ p, e };
+                return enqueue(&r, 1);
+            }
+
+            bool async_posix_consumer_t::consumev(const region_t* r, const std::size_t count)
+            {
+                return enqueue(r, count);
+            }
+
+            bool async_posix_consumer_t::enqueue(const region_t* r, const std::size_t count)
+            {
+                std::size_t b = 0;
+                for (std::size_t cc = 0; cc < count; cc++)
+                    b += r[cc].m_e - r[cc].m_p;
+                if (!b)
+                    return true;
+
+                std::vector<uint8_t> data;
+                {
+                    std::lock_guard<std::mutex> l(m_mtx);
+                    if (m_params.m_fd < 0 || m_metrics.m_bytes_in_flight + b > m_params.m_max_queue_bytes)
+                    {
+                        m_metrics.m_bytes_dropped += b;
+                        return false;
+                    }
+                    m_metrics.m_bytes_in_flight += b; // room is taken before the copy
+                    if (!m_free.empty())
+                    {
+                        data.swap(m_free.back());
+                        m_free.pop_back();
+                    }
+                }
+
+                // copy outside of the lock, writer keeps going meanwhile
+                data.resize(b);
+                auto* d = data.data();
+                for (std::size_t cc = 0; cc < count; cc++)
+                    d = std::copy(r[cc].m_p, r[cc].m_e, d);
+
+                {
+                    std::lock_guard<std::mutex> l(m_mtx);
+                    m_queue.push_back(buffer_t{ std::move(data), std::chrono::steady_clock::now() });
+                    m_enqueued_seq++;
+                }
+                m_cv.notify_one();
+                return true;
+            }
+
+            bool async_posix_consumer_t::flush()
+            {
+                std::unique_lock<std::mutex> l(m_mtx);
+                const auto seq = m_enqueued_seq;
+                const auto errors = m_metrics.m_write_errors;
+                m_written_cv.wait(l, [this, seq]() { return m_written_seq >= seq; });
+                return errors == m_metrics.m_write_errors;
+            }
+
+            async_posix_consumer_t::metrics_t async_posix_consumer_t::metrics()
+            {
+                std::lock_guard<std::mutex> l(m_mtx);
+                auto ret = m_metrics;
+                ret.m_queue_depth = m_queue.size();
+                return ret;
+            }
+
+            void async_posix_consumer_t::writer()
+            {
+                // broken pipe is reported as EPIPE to this thread instead of terminating the process
+                sigset_t sigpipe;
+                sigemptyset(&sigpipe);
+                sigaddset(&sigpipe, SIGPIPE);
+                pthread_sigmask(SIG_BLOCK, &sigpipe, nullptr);
+
+                const std::size_t batch_size = std::max<std::size_t>(1, std::min(m_params.m_max_iov, max_iov));
+
+                std::unique_lock<std::mutex> l(m_mtx);
+                for (;;)
+                {
+                    m_cv.wait(l, [this]() { return m_stop || !m_queue.empty(); });
+                    if (m_queue.empty())
+                        break; // stopped, everything is written
+
+                    std::deque<buffer_t> batch;
+                    const auto n = std::min(batch_size, m_queue.size());
+                    std::move(m_queue.begin(), m_queue.begin() + n, std::back_inserter(batch));
+                    m_queue.erase(m_queue.begin(), m_queue.begin() + n);
+                    l.unlock();
+
+                    uint64_t writes = 0;
+                    const uint64_t written = write_batch(batch, writes);
+                    const auto latency = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - batch.front().m_queued);
+
+                    // clears SIGPIPE raised by EPIPE, it stays pending otherwise
+                    timespec zero{ 0, 0 };
+                    while (sigtimedwait(&sigpipe, nullptr, &zero) > 0)
+                        ;
+
+                    l.lock();
+                    uint64_t b = 0;
+                    for (auto& buf : batch)
+                    {
+                        b += buf.m_data.size();
+                        if (m_free.size() < batch_size)
+                        {
+                            buf.m_data.clear();
+                            m_free.push_back(std::move(buf.m_data));
+                        }
+                    }
+                    m_metrics.m_bytes_in_flight -= b;
+                    m_metrics.m_writes += writes;
+                    m_metrics.m_bytes_written += written;
+                    if (written == b)
+                    {
+                        m_metrics.m_last_write_latency = latency;
+                        m_metrics.m_max_write_latency = std::max(m_metrics.m_max_write_latency, latency);
+                    }
+                    else
+                    {
+                        m_metrics.m_write_errors++;
+                        m_metrics.m_bytes_dropped += b - written;
+                    }
+                    m_written_seq += n;
+                    m_written_cv.notify_all();
+                }
+            }
+
+            uint64_t async_posix_consumer_t::write_batch(const std::deque<buffer_t>& batch, uint64_t& writes)
+            {
+                uint64_t total = 0;
+                std::vector<iovec> iov(batch.size());
+                for (std::size_t cc = 0; cc < batch.size(); cc++)
+                {
+                    iov[cc].iov_base = const_cast<uint8_t*>(batch[cc].m_data.data());
+                    iov[cc].iov_len = batch[cc].m_data.size();
+                }
+
+                std::size_t idx = 0;
+                while (idx < iov.size())
+                {
+                    const auto n = writev(m_params.m_fd, &iov[idx], int(iov.size() - idx));
+                    writes++;
+                    if (n < 0)
+                    {
+                        if (errno == EINTR)
+                            continue;
+                        if (errno == EAGAIN || errno == EWOULDBLOCK)
+                        {
+                            // non blocking fd is full, wait in this thread; on stop the rest is dropped
+                            pollfd pfd{ m_params.m_fd, POLLOUT, 0 };
+                            if (poll(&pfd, 1, pollout_timeout_ms) == 0)
+                            {
+                                std::lock_guard<std::mutex> l(m_mtx);
+                                if (m_stop)
+                                    return total;
+                            }
+                            continue;
+                        }
+                        return total;
+                    }
+
+                    total += uint64_t(n);
+                    // partial write: skip written buffers, resume inside the first unwritten one
+                    std::size_t written = n;
+                    while (idx < iov.size() && written >= iov[idx].iov_len)
+                        written -= iov[idx++].iov_len;
+                    if (idx < iov.size())
+                    {
+                        iov[idx].iov_base = static_cast<uint8_t*>(iov[idx].iov_base) + written;
+                        iov[idx].iov_len -= written;
+                    }
+                }
+                return total;
+            }
+        }
+    }
+}
@@ -0,0 +1,284 @@
+#include <array>
+#include <cstring>
+#include <algorithm>
+
+#include <neutrino_transport_endpoint_framed.hpp>
+
+#if defined(__x86_64__) || defined(__i386__) || defined(_M_X64) || defined(_M_IX86)
+// SSE4.2 code is built for the function only, baseline builds take it when the CPU has it
+#define NEUTRINO_CRC32C_SSE42
+#include <nmmintrin.h>
+#if defined(_MSC_VER)
+#include <intrin.h>
+#define NEUTRINO_TARGET_SSE42
+#else
+#define NEUTRINO_TARGET_SSE42 __attribute__((target("sse4.2")))
+#endif
+#endif
+
+namespace neutrino
+{
+    namespace impl
+    {
+        namespace transport
+        {
+            namespace
+            {
+                inline void put_u32(uint8_t* p, const uint32_t v) noexcept
+                {
+                    p[0] = uint8_t(v >> 24);
+                    p[1] = uint8_t(v >> 16);
+                    p[2] = uint8_t(v >> 8);
+                    p[3] = uint8_t(v);
+                }
+
+                inline uint32_t get_u32(const uint8_t* p) noexcept
+                {
+                    return (uint32_t(p[0]) << 24) | (uint32_t(p[1]) << 16) | (uint32_t(p[2]) << 8) | uint32_t(p[3]);
+                }
+
+                struct crc32c_table_t
+                {
+                    uint32_t m_t[256];
+
+                    crc32c_table_t()
+                    {
+                        for (uint32_t cc = 0; cc < 256; cc++)
+                        {
+                            uint32_t c = cc;
+                            for (int bit = 0; bit < 8; bit++)
+                                c = (c >> 1) ^ (0x82F63B78u & (0 - (c & 1)));
+                            m_t[cc] = c;
+                        }
+                    }
+                };
+                const crc32c_table_t crc32c_table;
+
+#if defined(NEUTRINO_CRC32C_SSE42)
+                bool cpu_has_sse42() noexcept
+                {
+#if defined(__SSE4_2__)
+                    return true;
+#elif defined(_MSC_VER)
+                    int r[4];
+                    __cpuid(r, 1);
+                    return (r[2] & (1 << 20)) != 0;
+#else
+                    // runs from a static initializer, possibly before the one of libgcc
+                    __builtin_cpu_init();
+                    return __builtin_cpu_supports("sse4.2");
+#endif
+                }
+
+                NEUTRINO_TARGET_SSE42 uint32_t crc32c_instruction(uint32_t crc, const uint8_t* p, const uint8_t* e) noexcept
+                {
+#if defined(__x86_64__) || defined(_M_X64)
+                    uint64_t crc64 = crc;
+                    for (; e - p >= 8; p += 8)
+                    {
+                        uint64_t v;
+                        std::memcpy(&v, p, sizeof(v));
+                        crc64 = _mm_crc32_u64(crc64, v);
+                    }
+                    crc = uint32_t(crc64);
+#endif
+                    for (; p < e; p++)
+                        crc = _mm_crc32_u8(crc, *p);
+                    return crc;
+                }
+
+                const bool use_sse42 = cpu_has_sse42();
+#else
+                const bool use_sse42 = false;
+#endif
+
+                // kind, flags and length, the header part covered by crc
+                const std::size_t crc_header_offset = 2;
+                const std::size_t crc_offset = 8;
+
+                uint32_t record_crc(const uint8_t* header, const uint8_t* p, const uint8_t* e) noexcept
+                {
+                    return framed::crc32c(framed::crc32c(0, header + crc_header_offset, header + crc_offset), p, e);
+                }
+
+                // magic[0] followed by magic[1] or by the end of [p, e), where the rest may come with the next input
+                const uint8_t* find_magic(const uint8_t* p, const uint8_t* e) noexcept
+                {
+                    for (; (p = std::find(p, e, framed::magic[0])) != e; p++)
+                    {
+                        if (p + 1 == e || p[1] == framed::magic[1])
+                            break;
+                    }
+                    return p;
+                }
+
+                void put_header(uint8_t* header, const uint8_t kind, const uint8_t* p, const uint8_t* e) noexcept
+                {
+                    header[0] = framed::magic[0];
+                    header[1] = framed::magic[1];
+                    header[2] = kind;
+                    header[3] = 0; // flags
+                    put_u32(header + 4, uint32_t(e - p));
+                    put_u32(header + crc_offset, record_crc(header, p, e));
+                }
+            }
+
+            namespace framed
+            {
+                uint32_t crc32c(uint32_t crc, const uint8_t* p, const uint8_t* e) noexcept
+                {
+#if defined(NEUTRINO_CRC32C_SSE42)
+                    if (use_sse42)
+                        return ~crc32c_instruction(~crc, p, e);
+#endif
+                    return crc32c_scalar(crc, p, e);
+                }
+
+                uint32_t crc32c_scalar(uint32_t crc, const uint8_t* p, const uint8_t* e) noexcept
+                {
+                    crc = ~crc;
+                    for (; p < e; p++)
+                        crc = crc32c_table.m_t[(crc ^ *p) & 0xff] ^ (crc >> 8);
+                    return ~crc;
+                }
+
+                bool crc32c_sse42() noexcept
+                {
+                    return use_sse42;
+                }
+            }
+
+            bool framed_endpoint_t::consume(const uint8_t* p, const uint8_t* e)
+            {
+                if (p == e)
+                    return m_endpoint.consume(p, e); // flush
+
+                const std::size_t b = e - p;
+                if (b > uint32_t(~0u))
+                    return false;
+                const uint8_t kind = static_cast<uint8_t>(m_params.m_kind);
+
+                // record right in the buffer of the endpoint when it has one
+                if (uint8_t* d = m_endpoint.reserve(framed::header_size + b))
+                {
+                    put_header(d, kind, p, e);
+                    std::copy(p, e, d + framed::header_size);
+                    return m_endpoint.commit(d, framed::header_size + b);
+                }
+
+                std::array<uint8_t, framed::header_size> header;
+                put_header(header.data(), kind, p, e);
+                const region_t r[2] = { { header.data(), header.data() + header.size() }, { p, e } };
+                return m_endpoint.consumev(r, 2);
+            }
+
+            endpoint_impl_t* deframer_endpoint_t::deserializer(const uint8_t kind)
+            {
+                if (kind >= m_deserializers.size())
+                    return nullptr;
+                auto& d = m_deserializers[kind];
+                if (!d)
+                    d = frame_v00::create_endpoint_impl(static_cast<frame_v00::known_encodings_t>(kind), m_consumer);
+                return d.get();
+            }
+
+            bool deframer_endpoint_t::deliver(const uint8_t* p, bool& ret)
+            {
+                const std::size_t len = get_u32(p + 4);
+                const uint8_t* payload = p + framed::header_size;
+                if (record_crc(p, payload, payload + len) != get_u32(p + crc_offset))
+                {
+                    m_metrics.m_records_corrupt++;
+                    return false;
+                }
+                m_metrics.m_records++;
+                if (endpoint_impl_t* d = deserializer(p[2]))
+                {
+                    if (!d->consume(payload, payload + len))
+                    {
+                        m_metrics.m_records_refused++;
+                        ret = false;
+                    }
+                }
+                else
+                {
+                    m_metrics.m_records_unknown++;
+                }
+                return true;
+            }
+
+            bool deframer_endpoint_t::consume(const uint8_t* p, const uint8_t* e)
+            {
+                bool ret = true;
+                while (!m_tail.empty())
+                {
+                    // complete the cut record: header first, then the payload it announces
+                    const std::size_t kept = m_tail.size();
+                    const uint8_t* q = p;
+                    auto fill = [&](const std::size_t n)
+                    {
+                        if (m_tail.size() >= n)
+                            return true;
+                        const std::size_t b = std::min<std::size_t>(n - m_tail.size(), e - q);
+                        m_tail.insert(m_tail.end(), q, q + b);
+                        q += b;
+                        return m_tail.size() == n;
+                    };
+
+                    if (!fill(framed::header_size))
+                        return ret;
+                    const std::size_t len = get_u32(m_tail.data() + 4);
+                    if (m_tail[1] == framed::magic[1] && len <= m_params.m_max_record)
+                    {
+                        if (!fill(framed::header_size + len))
+                            return ret;
+                        if (deliver(m_tail.data(), ret))
+                        {
+                            m_tail.clear();
+                            p = q;
+                            break;
+                        }
+                    }
+
+                    // resync within the bytes kept from before, the input is scanned in place after them
+                    ret = false;
+                    m_metrics.m_resyncs++;
+                    m_tail.resize(kept);
+                    const std::size_t dropped = find_magic(m_tail.data() + 1, m_tail.data() + kept) - m_tail.data();
+                    m_metrics.m_bytes_dropped += dropped;
+                    m_tail.erase(m_tail.begin(), m_tail.begin() + dropped);
+                }
+
+                while (p < e)
+                {
+                    const std::size_t left = e - p;
+                    if (p[0] == framed::magic[0] && (left == 1 || p[1] == framed::magic[1]))
+                    {
+                        const std::size_t len = left >= framed::header_size ? get_u32(p + 4) : 0;
+                        if (len <= m_params.m_max_record)
+                        {
+                            if (left < framed::header_size + len)
+                            {
+                                m_tail.assign(p, e);
+                                return ret;
+                            }
+                            if (deliver(p, ret))
+                            {
+                                p += framed::header_size + len;
+                                continue;
+                            }
+                        }
+                    }
+
+                    // resync: the next magic after this position, a false positive fails the checks above and is skipped too
+                    ret = false;
+                    m_metrics.m_resyncs++;
+                    const uint8_t* q = find_magic(p + 1, e);
+                    m_metrics.m_bytes_dropped += q - p;
+                    p = q;
+                }
+                return ret;
+            }
+        }
+    }
+}
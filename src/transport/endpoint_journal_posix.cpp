@@ -0,0 +1,273 @@
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <cstdio>
+#include <new>
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include <neutrino_transport_endpoint_journal.hpp>
+
+namespace
+{
+    using namespace neutrino::impl::transport;
+
+    const uint64_t header_size = (sizeof(journal::segment_header_t) + 63) & ~uint64_t(63);
+    typedef journal::segment_header_t::record_len_t record_len_t;
+
+    uint8_t* records(journal::segment_header_t* h)
+    {
+        return reinterpret_cast<uint8_t*>(h) + h->m_header_size;
+    }
+
+    // a writer which did not close the segment is gone, readers waiting for more may move on
+    void seal(const std::string& name)
+    {
+        const int fd = open(name.c_str(), O_RDWR | O_CLOEXEC);
+        if (fd < 0)
+            return;
+        struct stat st;
+        void* p = fstat(fd, &st) == 0 && uint64_t(st.st_size) >= header_size
+            ? mmap(nullptr, header_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0)
+            : MAP_FAILED;
+        close(fd);
+        if (p == MAP_FAILED)
+            return;
+        auto* h = static_cast<journal::segment_header_t*>(p);
+        if (h->m_magic == journal::segment_header_t::magic)
+            h->m_sealed.store(1, std::memory_order_release);
+        munmap(p, header_size);
+    }
+}
+
+namespace neutrino
+{
+    namespace impl
+    {
+        namespace transport
+        {
+            namespace journal
+            {
+                std::string segment_path(const std::string& path, const uint64_t seq)
+                {
+                    char suffix[32];
+                    snprintf(suffix, sizeof(suffix), ".%06llu", static_cast<unsigned long long>(seq));
+                    return path + suffix;
+                }
+            }
+
+            journal_endpoint_t::journal_endpoint_t(const journal_params_t po)
+                : m_params(po)
+            {
+                // segments of previous runs are kept, this one goes on after the last of them
+                uint64_t seq = 0;
+                while (access(journal::segment_path(m_params.m_path, seq).c_str(), F_OK) == 0)
+                    seq++;
+                if (seq)
+                    seal(journal::segment_path(m_params.m_path, seq - 1));
+                open_segment(seq);
+            }
+
+            journal_endpoint_t::~journal_endpoint_t()
+            {
+                close_segment();
+            }
+
+            bool journal_endpoint_t::open_segment(const uint64_t seq)
+            {
+                const uint64_t sz = std::max<uint64_t>(m_params.m_segment_size, header_size + sizeof(record_len_t) + 1);
+                const auto name = journal::segment_path(m_params.m_path, seq);
+
+                const int fd = open(name.c_str(), O_CREAT | O_EXCL | O_RDWR | O_CLOEXEC, 0644);
+                if (fd < 0)
+                {
+                    m_error = errno;
+                    return false;
+                }
+
+                // preallocated, so page faults of the mapping do not hit a full disk
+                int error = ftruncate(fd, sz) == 0 ? 0 : errno;
+#if defined(__linux__)
+                if (!error)
+                    error = posix_fallocate(fd, 0, sz);
+#endif
+                void* p = MAP_FAILED;
+                if (!error)
+                {
+                    p = mmap(nullptr, sz, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+                    if (p == MAP_FAILED)
+                        error = errno;
+                }
+                close(fd);
+                if (error)
+                {
+                    m_error = error;
+                    return false;
+                }
+
+                auto* h = static_cast<journal::segment_header_t*>(p);
+                h->m_version = journal::segment_header_t::version;
+                h->m_header_size = uint32_t(header_size);
+                h->m_segment_seq = seq;
+                h->m_segment_size = sz;
+                h->m_encoding = static_cast<uint32_t>(m_params.m_encoding);
+                h->m_clock_source = static_cast<uint32_t>(clock::source());
+                const auto& c = clock::calibration();
+                h->m_ticks0 = c.m_ticks0;
+                h->m_nanoepoch0 = c.m_nanoepoch0;
+                h->m_mult = c.m_mult;
+                h->m_shift = c.m_shift;
+                const auto id_len = std::min(m_params.m_producer_id.size(), sizeof(h->m_producer_id) - 1);
+                std::memcpy(h->m_producer_id, m_params.m_producer_id.data(), id_len);
+                h->m_producer_id[id_len] = 0;
+                new (&h->m_committed) std::atomic<uint64_t>(0);
+                new (&h->m_sealed) std::atomic<uint32_t>(0);
+                std::atomic_thread_fence(std::memory_order_release);
+                h->m_magic = journal::segment_header_t::magic;
+
+                m_segment = h;
+                m_seq = seq;
+                m_committed = 0;
+                return true;
+            }
+
+            void journal_endpoint_t::close_segment()
+            {
+                if (!m_segment)
+                    return;
+                m_segment->m_sealed.store(1, std::memory_order_release);
+                munmap(m_segment, m_segment->m_segment_size);
+                m_segment = nullptr;
+            }
+
+            bool journal_endpoint_t::consume(const std::uint8_t* p, const std::uint8_t* e)
+            {
+                if (p == e)
+                    return true;
+
+                const uint64_t b = e - p;
+                const uint64_t record = sizeof(record_len_t) + b;
+
+                std::lock_guard<std::mutex> l(m_mtx);
+                if (!m_segment)
+                    return false;
+
+                const uint64_t capacity = m_segment->m_segment_size - m_segment->m_header_size;
+                if (record > capacity)
+                    return false;
+
+                if (m_committed + record > capacity)
+                {
+                    // rollover, the only place with syscalls
+                    const auto seq = m_seq + 1;
+                    close_segment();
+                    if (!open_segment(seq))
+                        return false;
+                }
+
+                uint8_t* d = records(m_segment) + m_committed;
+                const record_len_t len = record_len_t(b);
+                std::memcpy(d, &len, sizeof(len));
+                std::memcpy(d + sizeof(len), p, b);
+
+                m_committed += record;
+                m_segment->m_committed.store(m_committed, std::memory_order_release);
+                return true;
+            }
+
+            bool journal_endpoint_t::flush()
+            {
+                std::lock_guard<std::mutex> l(m_mtx);
+                return m_segment && msync(m_segment, m_segment->m_header_size + m_committed, MS_ASYNC) == 0;
+            }
+
+            journal_reader_t::journal_reader_t(const std::string& path)
+                : m_path(path)
+            {
+            }
+
+            journal_reader_t::~journal_reader_t()
+            {
+                close_segment();
+            }
+
+            void journal_reader_t::close_segment()
+            {
+                if (m_segment)
+                    munmap(m_segment, m_mapping_size);
+                m_segment = nullptr;
+                m_mapping_size = 0;
+                m_replayed = 0;
+            }
+
+            bool journal_reader_t::next_segment()
+            {
+                close_segment();
+
+                const int fd = open(journal::segment_path(m_path, m_next_seq).c_str(), O_RDONLY | O_CLOEXEC);
+                if (fd < 0)
+                    return false;
+
+                struct stat st;
+                void* p = MAP_FAILED;
+                if (fstat(fd, &st) == 0 && uint64_t(st.st_size) >= header_size)
+                    p = mmap(nullptr, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+                close(fd);
+                if (p == MAP_FAILED)
+                    return false;
+
+                auto* h = static_cast<journal::segment_header_t*>(p);
+                if (h->m_magic != journal::segment_header_t::magic
+                    || h->m_version != journal::segment_header_t::version
+                    || h->m_segment_size > uint64_t(st.st_size)
+                    || h->m_header_size > h->m_segment_size)
+                {
+                    munmap(p, st.st_size);
+                    return false;
+                }
+
+                m_segment = h;
+                m_mapping_size = st.st_size;
+                m_next_seq++;
+                return true;
+            }
+
+            std::size_t journal_reader_t::replay(endpoint_t& e)
+            {
+                if (!m_segment)
+                    return 0;
+
+                const uint64_t capacity = m_segment->m_segment_size - m_segment->m_header_size;
+                const uint64_t committed = std::min(m_segment->m_committed.load(std::memory_order_acquire), capacity);
+                const uint8_t* p = records(m_segment);
+
+                std::size_t ret = 0;
+                while (m_replayed < committed)
+                {
+                    record_len_t len = 0;
+                    const uint64_t left = committed - m_replayed;
+                    if (left >= sizeof(len))
+                        std::memcpy(&len, p + m_replayed, sizeof(len));
+                    if (left < sizeof(len) || sizeof(len) + uint64_t(len) > left)
+                    {
+                        // writer publishes whole records only and goes on after committed
+                        m_metrics.m_damaged++;
+                        m_metrics.m_bytes_skipped += left;
+                        m_replayed = committed;
+                        break;
+                    }
+                    const uint8_t* r = p + m_replayed + sizeof(len);
+                    m_metrics.m_records++;
+                    if (!e.consume(r, r + len))
+                        m_metrics.m_records_refused++;
+                    m_replayed += sizeof(len) + len;
+                    ret++;
+                }
+                return ret;
+            }
+        }
+    }
+}
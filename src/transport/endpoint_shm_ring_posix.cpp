@@ -0,0 +1,346 @@
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <new>
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#if defined(__linux__)
+#include <sys/syscall.h>
+#include <linux/futex.h>
+#endif
+
+#include <neutrino_transport_endpoint_shm_ring.hpp>
+
+namespace
+{
+    using namespace neutrino::impl::transport;
+
+    std::size_t round_up_pow2(std::size_t sz)
+    {
+        std::size_t ret = 64;
+        while (ret < sz)
+            ret <<= 1;
+        return ret;
+    }
+
+    // futex word lives in a shared mapping, so no FUTEX_PRIVATE_FLAG
+    void futex_wait(std::atomic<uint32_t>& w, const uint32_t expected, const std::chrono::milliseconds timeout)
+    {
+#if defined(__linux__)
+        timespec ts;
+        ts.tv_sec = timeout.count() / 1000;
+        ts.tv_nsec = (timeout.count() % 1000) * 1000000;
+        syscall(SYS_futex, reinterpret_cast<uint32_t*>(&w), FUTEX_WAIT, expected, &ts, nullptr, 0);
+#else
+        // no cross process wait primitive, poll
+        (void)w;
+        (void)expected;
+        usleep(std::min<long long>(timeout.count(), 1) * 1000);
+#endif
+    }
+
+    void futex_wake(std::atomic<uint32_t>& w)
+    {
+#if defined(__linux__)
+        syscall(SYS_futex, reinterpret_cast<uint32_t*>(&w), FUTEX_WAKE, 1, nullptr, nullptr, 0);
+#else
+        (void)w;
+#endif
+    }
+
+    shm_ring::header_t* map_ring(int fd, std::size_t sz)
+    {
+        void* p = mmap(nullptr, sz, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+        return p == MAP_FAILED ? nullptr : static_cast<shm_ring::header_t*>(p);
+    }
+}
+
+namespace neutrino
+{
+    namespace impl
+    {
+        namespace transport
+        {
+            namespace shm_ring
+            {
+                std::size_t mapping_size(const std::size_t data_size)
+                {
+                    return offsetof(header_t, m_data) + data_size;
+                }
+            }
+
+            shm_ring_endpoint_t::shm_ring_endpoint_t(const shm_ring_params_t po)
+                : m_params(po)
+            {
+                const auto data_size = round_up_pow2(m_params.m_size);
+
+                if (m_params.m_name.empty())
+                {
+#if defined(__linux__) && defined(MFD_CLOEXEC)
+                    m_fd = memfd_create("neutrino", MFD_CLOEXEC);
+#else
+                    errno = ENOSYS;
+#endif
+                }
+                else
+                {
+                    // no O_TRUNC: an aggregator may still map the ring of the previous run
+                    m_fd = shm_open(m_params.m_name.c_str(), O_CREAT | O_RDWR, 0600);
+                }
+                struct stat st;
+                if (m_fd < 0 || fstat(m_fd, &st) != 0)
+                {
+                    m_error = errno;
+                    return;
+                }
+
+                m_mapping_size = shm_ring::mapping_size(data_size);
+                if (st.st_size)
+                {
+                    // left by the previous run, appended to as is
+                    if (std::size_t(st.st_size) != m_mapping_size)
+                    {
+                        m_error = EINVAL;
+                        return;
+                    }
+                    auto* ring = map_ring(m_fd, m_mapping_size);
+                    if (!ring)
+                    {
+                        m_error = errno;
+                        return;
+                    }
+                    if (ring->m_magic.load(std::memory_order_acquire) != shm_ring::header_t::magic
+                        || ring->m_size != data_size
+                        || ring->m_head.load(std::memory_order_relaxed) - ring->m_tail.load(std::memory_order_relaxed) > data_size)
+                    {
+                        munmap(ring, m_mapping_size);
+                        m_error = EINVAL;
+                        return;
+                    }
+                    m_ring = ring;
+                    return;
+                }
+
+                if (ftruncate(m_fd, m_mapping_size) != 0)
+                {
+                    m_error = errno;
+                    return;
+                }
+
+                auto* ring = map_ring(m_fd, m_mapping_size);
+                if (!ring)
+                {
+                    m_error = errno;
+                    return;
+                }
+
+                // fresh file is zero filled, atomics are constructed in place before magic is published
+                new (&ring->m_head) std::atomic<uint64_t>(0);
+                new (&ring->m_dropped_bytes) std::atomic<uint64_t>(0);
+                new (&ring->m_tail) std::atomic<uint64_t>(0);
+                new (&ring->m_reader_idle) std::atomic<uint32_t>(0);
+                ring->m_size = data_size;
+                new (&ring->m_magic) std::atomic<uint64_t>(0);
+                ring->m_magic.store(shm_ring::header_t::magic, std::memory_order_release);
+
+                m_ring = ring;
+            }
+
+            shm_ring_endpoint_t::~shm_ring_endpoint_t()
+            {
+                // data stays in the shared memory for the aggregator
+                if (m_ring)
+                    munmap(m_ring, m_mapping_size);
+                if (m_fd >= 0)
+                    close(m_fd);
+            }
+
+            bool shm_ring_endpoint_t::consume(const std::uint8_t* p, const std::uint8_t* e)
+            {
+                typedef shm_ring::header_t::record_len_t record_len_t;
+
+                if (!m_ring)
+                    return false;
+                if (p == e)
+                    return true;
+
+                const uint64_t b = e - p;
+                const uint64_t record = sizeof(record_len_t) + b;
+                const uint64_t sz = m_ring->m_size;
+
+                std::lock_guard<std::mutex> l(m_mtx);
+
+                auto head = m_ring->m_head.load(std::memory_order_relaxed);
+                const auto tail = m_ring->m_tail.load(std::memory_order_acquire);
+
+                // records are contiguous, the rest of the ring is skipped when record does not fit before the end
+                const auto idx = head & (sz - 1);
+                const uint64_t skip = sz - idx < record ? sz - idx : 0;
+                if (record > sz || head + skip + record - tail > sz)
+                {
+                    m_ring->m_dropped_bytes.fetch_add(b, std::memory_order_relaxed);
+                    return false;
+                }
+
+                if (skip)
+                {
+                    if (skip >= sizeof(record_len_t))
+                    {
+                        const record_len_t marker = shm_ring::header_t::wrap_marker;
+                        std::memcpy(m_ring->m_data + idx, &marker, sizeof(marker));
+                    }
+                    head += skip;
+                }
+
+                const record_len_t len = record_len_t(b);
+                uint8_t* d = m_ring->m_data + (head & (sz - 1));
+                std::memcpy(d, &len, sizeof(len));
+                std::memcpy(d + sizeof(len), p, b);
+
+                // publish, then check if reader went to sleep meanwhile (pairs with reader's store idle, load head)
+                m_ring->m_head.store(head + record, std::memory_order_seq_cst);
+                if (m_ring->m_reader_idle.load(std::memory_order_seq_cst))
+                {
+                    m_ring->m_reader_idle.store(0, std::memory_order_relaxed);
+                    futex_wake(m_ring->m_reader_idle);
+                }
+                return true;
+            }
+
+            uint64_t shm_ring_endpoint_t::dropped_bytes() const
+            {
+                return m_ring ? m_ring->m_dropped_bytes.load(std::memory_order_relaxed) : 0;
+            }
+
+            shm_ring_reader_t::shm_ring_reader_t(const std::string& name)
+            {
+                const int fd = shm_open(name.c_str(), O_RDWR, 0600);
+                if (fd >= 0)
+                    map(fd);
+            }
+
+            shm_ring_reader_t::shm_ring_reader_t(int fd)
+            {
+                map(dup(fd));
+            }
+
+            shm_ring_reader_t::~shm_ring_reader_t()
+            {
+                if (m_ring)
+                    munmap(m_ring, m_mapping_size);
+                if (m_fd >= 0)
+                    close(m_fd);
+            }
+
+            void shm_ring_reader_t::map(int fd)
+            {
+                m_fd = fd;
+                if (m_fd < 0)
+                    return;
+
+                struct stat st;
+                if (fstat(m_fd, &st) != 0 || std::size_t(st.st_size) < shm_ring::mapping_size(64))
+                    return;
+
+                auto* ring = map_ring(m_fd, st.st_size);
+                if (!ring)
+                    return;
+
+                if (ring->m_magic.load(std::memory_order_acquire) != shm_ring::header_t::magic
+                    || ring->m_size < 64 || (ring->m_size & (ring->m_size - 1))
+                    || shm_ring::mapping_size(ring->m_size) > std::size_t(st.st_size))
+                {
+                    // not a ring or not initialized yet
+                    munmap(ring, st.st_size);
+                    return;
+                }
+
+                m_mapping_size = st.st_size;
+                m_ring = ring;
+            }
+
+            std::size_t shm_ring_reader_t::drain(endpoint_t& e)
+            {
+                typedef shm_ring::header_t::record_len_t record_len_t;
+
+                if (!m_ring)
+                    return 0;
+
+                const uint64_t sz = m_ring->m_size;
+                auto tail = m_ring->m_tail.load(std::memory_order_relaxed);
+                const auto head = m_ring->m_head.load(std::memory_order_acquire);
+                const auto drained = head - tail;
+
+                // the ring is written by another process, nothing read from it is trusted
+                bool corrupt = drained > sz;
+                while (tail != head && !corrupt)
+                {
+                    const auto idx = tail & (sz - 1);
+                    const auto contiguous = sz - idx;
+                    const auto published = head - tail;
+                    record_len_t len = shm_ring::header_t::wrap_marker;
+                    if (contiguous >= sizeof(len))
+                        std::memcpy(&len, m_ring->m_data + idx, sizeof(len));
+                    if (len == shm_ring::header_t::wrap_marker)
+                    {
+                        corrupt = contiguous > published;
+                        if (!corrupt)
+                            tail += contiguous;
+                        continue;
+                    }
+                    if (sizeof(len) + uint64_t(len) > std::min<uint64_t>(contiguous, published))
+                    {
+                        corrupt = true;
+                        continue;
+                    }
+                    const uint8_t* p = m_ring->m_data + idx + sizeof(len);
+                    m_metrics.m_records++;
+                    if (!e.consume(p, p + len))
+                        m_metrics.m_records_refused++;
+                    tail += sizeof(len) + len;
+                }
+                if (corrupt)
+                {
+                    // no way to find the next record, the producer continues after head
+                    m_metrics.m_corruptions++;
+                    m_metrics.m_bytes_skipped += head - tail;
+                    tail = head;
+                }
+
+                m_ring->m_tail.store(tail, std::memory_order_release);
+                return drained;
+            }
+
+            bool shm_ring_reader_t::wait(const std::chrono::milliseconds timeout)
+            {
+                if (!m_ring)
+                    return false;
+
+                const auto tail = m_ring->m_tail.load(std::memory_order_relaxed);
+                if (m_ring->m_head.load(std::memory_order_acquire) != tail)
+                    return true;
+
+                // announce sleep, then re-check head: producer either sees idle or reader sees new head
+                m_ring->m_reader_idle.store(1, std::memory_order_seq_cst);
+                if (m_ring->m_head.load(std::memory_order_seq_cst) == tail)
+                    futex_wait(m_ring->m_reader_idle, 1, timeout);
+                m_ring->m_reader_idle.store(0, std::memory_order_relaxed);
+
+                return m_ring->m_head.load(std::memory_order_acquire) != tail;
+            }
+
+            uint64_t shm_ring_reader_t::dropped_bytes() const
+            {
+                return m_ring ? m_ring->m_dropped_bytes.load(std::memory_order_relaxed) : 0;
+            }
+
+            bool shm_ring_reader_t::remove(const std::string& name)
+            {
+                return shm_unlink(name.c_str()) == 0;
+            }
+        }
+    }
+}
@@ -0,0 +1,482 @@
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+
+#include <unistd.h>
+#include <poll.h>
+#include <fcntl.h>
+#include <netdb.h>
+#include <limits.h>
+#include <sys/uio.h>
+#include <sys/un.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+
+#include <neutrino_transport_endpoint_socket.hpp>
+
+namespace
+{
+    using namespace neutrino::impl::transport;
+
+#if defined(IOV_MAX)
+    const std::size_t max_iov = IOV_MAX;
+#else
+    const std::size_t max_iov = 16;
+#endif
+#if defined(MSG_NOSIGNAL)
+    const int send_flags = MSG_NOSIGNAL;
+#else
+    const int send_flags = 0;
+#endif
+    const int poll_timeout_ms = 100;
+
+    int socket_type(socket::kind_t k)
+    {
+        return k == socket::kind_t::UNIX_SEQPACKET ? SOCK_SEQPACKET : SOCK_STREAM;
+    }
+
+    bool split_host_port(const std::string& address, std::string& host, std::string& port)
+    {
+        const auto colon = address.rfind(':');
+        if (colon == std::string::npos)
+            return false;
+        host = address.substr(0, colon);
+        port = address.substr(colon + 1);
+        return true;
+    }
+
+    // socket for the address, connected (connect_to) or bound; -1 on failure
+    int open_socket(socket::kind_t k, const std::string& address, bool connect_to)
+    {
+        if (k == socket::kind_t::TCP)
+        {
+            std::string host, port;
+            if (!split_host_port(address, host, port))
+                return -1;
+
+            addrinfo hints{};
+            hints.ai_family = AF_UNSPEC;
+            hints.ai_socktype = SOCK_STREAM;
+            hints.ai_flags = connect_to ? 0 : AI_PASSIVE;
+            addrinfo* ai = nullptr;
+            if (getaddrinfo(host.empty() ? nullptr : host.c_str(), port.c_str(), &hints, &ai) != 0)
+                return -1;
+
+            int fd = -1;
+            for (auto* a = ai; a && fd < 0; a = a->ai_next)
+            {
+                fd = ::socket(a->ai_family, a->ai_socktype | SOCK_CLOEXEC, a->ai_protocol);
+                if (fd < 0)
+                    continue;
+                const int one = 1;
+                if (connect_to)
+                    setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one)); // records are batched already
+                else
+                    setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+                if ((connect_to ? ::connect(fd, a->ai_addr, a->ai_addrlen) : ::bind(fd, a->ai_addr, a->ai_addrlen)) != 0)
+                {
+                    close(fd);
+                    fd = -1;
+                }
+            }
+            freeaddrinfo(ai);
+            return fd;
+        }
+
+        sockaddr_un sa{};
+        sa.sun_family = AF_UNIX;
+        if (address.size() >= sizeof(sa.sun_path))
+            return -1;
+        std::memcpy(sa.sun_path, address.c_str(), address.size() + 1);
+
+        int fd = ::socket(AF_UNIX, socket_type(k) | SOCK_CLOEXEC, 0);
+        if (fd < 0)
+            return -1;
+        if (!connect_to)
+            unlink(address.c_str()); // stale socket file of previous run
+        if ((connect_to ? ::connect(fd, reinterpret_cast<sockaddr*>(&sa), sizeof(sa)) : ::bind(fd, reinterpret_cast<sockaddr*>(&sa), sizeof(sa))) != 0)
+        {
+            close(fd);
+            return -1;
+        }
+        return fd;
+    }
+}
+
+namespace neutrino
+{
+    namespace impl
+    {
+        namespace transport
+        {
+            socket_endpoint_t::socket_endpoint_t(const socket_endpoint_params_t po)
+                : m_params(po)
+            {
+                m_sender = std::thread([this]() { sender(); });
+            }
+
+            socket_endpoint_t::~socket_endpoint_t()
+            {
+                {
+                    std::lock_guard<std::mutex> l(m_mtx);
+                    m_stop = true;
+                }
+                m_cv.notify_one();
+                m_sender.join();
+            }
+
+            bool socket_endpoint_t::consume(const std::uint8_t* p, const std::uint8_t* e)
+            {
+                const region_t r{ p, e };
+                return enqueue(&r, 1);
+            }
+
+            bool socket_endpoint_t::consumev(const region_t* r, const std::size_t count)
+            {
+                return enqueue(r, count);
+            }
+
+            bool socket_endpoint_t::enqueue(const region_t* r, const std::size_t count)
+            {
+                std::size_t b = 0;
+                for (std::size_t cc = 0; cc < count; cc++)
+                    b += r[cc].m_e - r[cc].m_p;
+                if (!b)
+                    return true;
+
+                const std::size_t record = sizeof(socket::record_len_t) + b;
+                std::vector<uint8_t> data;
+                {
+                    std::lock_guard<std::mutex> l(m_mtx);
+                    if (b > socket::record_len_t(~0u) || m_metrics.m_backlog_bytes + record > m_params.m_max_backlog_bytes)
+                    {
+                        m_metrics.m_bytes_dropped += b;
+                        return false;
+                    }
+                    m_metrics.m_backlog_bytes += record;
+                    if (!m_free.empty())
+                    {
+                        data.swap(m_free.back());
+                        m_free.pop_back();
+                    }
+                }
+
+                data.resize(record);
+                const socket::record_len_t len = htonl(socket::record_len_t(b));
+                std::memcpy(data.data(), &len, sizeof(len));
+                auto* d = data.data() + sizeof(len);
+                for (std::size_t cc = 0; cc < count; cc++)
+                    d = std::copy(r[cc].m_p, r[cc].m_e, d);
+
+                {
+                    std::lock_guard<std::mutex> l(m_mtx);
+                    m_queue.push_back(std::move(data));
+                    m_enqueued_seq++;
+                }
+                m_cv.notify_one();
+                return true;
+            }
+
+            bool socket_endpoint_t::flush(const std::chrono::milliseconds timeout)
+            {
+                std::unique_lock<std::mutex> l(m_mtx);
+                const auto seq = m_enqueued_seq;
+                return m_sent_cv.wait_for(l, timeout, [this, seq]() { return m_sent_seq >= seq; });
+            }
+
+            socket_endpoint_t::metrics_t socket_endpoint_t::metrics()
+            {
+                std::lock_guard<std::mutex> l(m_mtx);
+                auto ret = m_metrics;
+                ret.m_queue_depth = m_queue.size();
+                return ret;
+            }
+
+            bool socket_endpoint_t::connect()
+            {
+                m_fd = open_socket(m_params.m_kind, m_params.m_address, true);
+                if (m_fd < 0)
+                    return false;
+
+                // sender checks for stop between timed out sends
+                timeval tv{ 0, poll_timeout_ms * 1000 };
+                setsockopt(m_fd, SOL_SOCKET, SO_SNDTIMEO, &tv, sizeof(tv));
+                return true;
+            }
+
+            std::size_t socket_endpoint_t::send(const std::vector<region_t>& records)
+            {
+                const std::size_t n = records.size();
+                std::vector<iovec> iov(n);
+                for (std::size_t cc = 0; cc < n; cc++)
+                {
+                    iov[cc].iov_base = const_cast<uint8_t*>(records[cc].m_p);
+                    iov[cc].iov_len = records[cc].m_e - records[cc].m_p;
+                }
+
+                std::size_t idx = 0;
+                while (idx < n)
+                {
+                    msghdr msg{};
+                    msg.msg_iov = &iov[idx];
+                    msg.msg_iovlen = n - idx;
+                    const auto sent = sendmsg(m_fd, &msg, send_flags);
+                    {
+                        std::lock_guard<std::mutex> l(m_mtx);
+                        m_metrics.m_sends++;
+                        if (sent < 0 && (errno == EAGAIN || errno == EWOULDBLOCK) && m_stop)
+                            return idx;
+                    }
+                    if (sent < 0)
+                    {
+                        if (errno == EINTR || errno == EAGAIN || errno == EWOULDBLOCK)
+                            continue;
+                        return idx;
+                    }
+
+                    std::size_t written = sent;
+                    while (idx < n && written >= iov[idx].iov_len)
+                        written -= iov[idx++].iov_len;
+                    if (idx < n)
+                    {
+                        iov[idx].iov_base = static_cast<uint8_t*>(iov[idx].iov_base) + written;
+                        iov[idx].iov_len -= written;
+                    }
+                }
+                return n;
+            }
+
+            void socket_endpoint_t::sender()
+            {
+                const std::size_t batch_size = m_params.m_kind == socket::kind_t::UNIX_SEQPACKET
+                    ? 1 // one record per message
+                    : std::max<std::size_t>(1, std::min(m_params.m_max_iov, max_iov));
+
+                std::unique_lock<std::mutex> l(m_mtx);
+                for (;;)
+                {
+                    m_cv.wait(l, [this]() { return m_stop || !m_queue.empty(); });
+                    if (m_queue.empty())
+                        break;
+
+                    if (m_fd < 0)
+                    {
+                        l.unlock();
+                        const bool connected = connect();
+                        l.lock();
+                        if (!connected)
+                        {
+                            if (m_stop)
+                                break; // backlog is lost
+                            m_cv.wait_for(l, m_params.m_reconnect_period, [this]() { return m_stop; });
+                            continue;
+                        }
+                        m_metrics.m_connects++;
+                        m_metrics.m_connected = true;
+                    }
+
+                    // records stay in the queue until sent, only this thread pops them
+                    const auto n = std::min(batch_size, m_queue.size());
+                    std::vector<region_t> records(n);
+                    for (std::size_t cc = 0; cc < n; cc++)
+                        records[cc] = region_t{ m_queue[cc].data(), m_queue[cc].data() + m_queue[cc].size() };
+                    l.unlock();
+                    const std::size_t sent = send(records);
+                    l.lock();
+
+                    // whole records are done even when the connection broke after them
+                    for (std::size_t cc = 0; cc < sent; cc++)
+                    {
+                        auto& r = m_queue.front();
+                        m_metrics.m_backlog_bytes -= r.size();
+                        m_metrics.m_bytes_sent += r.size() - sizeof(socket::record_len_t);
+                        if (m_free.size() < batch_size)
+                        {
+                            r.clear();
+                            m_free.push_back(std::move(r));
+                        }
+                        m_queue.pop_front();
+                    }
+                    m_sent_seq += sent;
+                    m_sent_cv.notify_all();
+
+                    if (sent < n)
+                    {
+                        // the record cut in the middle is sent again on the next connection
+                        close(m_fd);
+                        m_fd = -1;
+                        m_metrics.m_connected = false;
+                        m_metrics.m_disconnects++;
+                        if (m_stop)
+                            break;
+                    }
+                }
+
+                // not sent records are dropped
+                for (const auto& r : m_queue)
+                    m_metrics.m_bytes_dropped += r.size() - sizeof(socket::record_len_t);
+                m_sent_seq += m_queue.size();
+                m_queue.clear();
+                m_sent_cv.notify_all();
+
+                if (m_fd >= 0)
+                {
+                    close(m_fd);
+                    m_fd = -1;
+                }
+            }
+
+            socket_acceptor_t::socket_acceptor_t(const socket_acceptor_params_t po, connection_endpoint_factory_t f)
+                : m_params(po), m_factory(f)
+            {
+                if (pipe(m_wakeup) != 0)
+                    return;
+
+                m_listen_fd = open_socket(m_params.m_kind, m_params.m_address, false);
+                if (m_listen_fd < 0)
+                    return;
+                if (listen(m_listen_fd, SOMAXCONN) != 0)
+                {
+                    close(m_listen_fd);
+                    m_listen_fd = -1;
+                    return;
+                }
+
+                if (m_params.m_kind == socket::kind_t::TCP)
+                {
+                    sockaddr_storage sa{};
+                    socklen_t len = sizeof(sa);
+                    if (getsockname(m_listen_fd, reinterpret_cast<sockaddr*>(&sa), &len) == 0)
+                        m_port = ntohs(sa.ss_family == AF_INET6 ? reinterpret_cast<sockaddr_in6*>(&sa)->sin6_port : reinterpret_cast<sockaddr_in*>(&sa)->sin_port);
+                }
+
+                m_thread = std::thread([this]() { run(); });
+            }
+
+            socket_acceptor_t::~socket_acceptor_t()
+            {
+                if (m_thread.joinable())
+                {
+                    const uint8_t stop = 1;
+                    while (write(m_wakeup[1], &stop, 1) < 0 && errno == EINTR)
+                        ;
+                    m_thread.join();
+                }
+                if (m_listen_fd >= 0)
+                {
+                    close(m_listen_fd);
+                    if (m_params.m_kind != socket::kind_t::TCP)
+                        unlink(m_params.m_address.c_str());
+                }
+                for (int fd : m_wakeup)
+                    if (fd >= 0)
+                        close(fd);
+            }
+
+            void socket_acceptor_t::run()
+            {
+                std::vector<connection_t> connections;
+                std::vector<pollfd> fds;
+                for (;;)
+                {
+                    fds.clear();
+                    fds.push_back(pollfd{ m_wakeup[0], POLLIN, 0 });
+                    fds.push_back(pollfd{ m_listen_fd, POLLIN, 0 });
+                    for (const auto& c : connections)
+                        fds.push_back(pollfd{ c.m_fd, POLLIN, 0 });
+
+                    if (poll(fds.data(), fds.size(), -1) < 0)
+                    {
+                        if (errno == EINTR)
+                            continue;
+                        break;
+                    }
+
+                    if (fds[0].revents)
+                        break;
+
+                    // connections first, indexes in fds match connections before accept adds new ones
+                    for (std::size_t cc = connections.size(); cc-- > 0; )
+                    {
+                        if (!fds[cc + 2].revents)
+                            continue;
+                        if (!receive(connections[cc]))
+                        {
+                            // partial record of a closed connection is dropped, sender sends it again
+                            close(connections[cc].m_fd);
+                            connections.erase(connections.begin() + cc);
+                        }
+                    }
+
+                    if (fds[1].revents & POLLIN)
+                    {
+                        const int fd = accept(m_listen_fd, nullptr, nullptr);
+                        if (fd >= 0)
+                        {
+                            connections.push_back(connection_t{ fd, m_factory(), {} });
+                            m_connections++;
+                        }
+                    }
+                }
+
+                for (auto& c : connections)
+                    close(c.m_fd);
+            }
+
+            bool socket_acceptor_t::receive(connection_t& c)
+            {
+                const std::size_t prefix = sizeof(socket::record_len_t);
+                std::size_t capacity = 64 * 1024;
+                if (m_params.m_kind == socket::kind_t::UNIX_SEQPACKET)
+                {
+                    // whole message at once, ask for its size
+                    const auto sz = recv(c.m_fd, nullptr, 0, MSG_PEEK | MSG_TRUNC);
+                    if (sz <= 0)
+                        return false;
+                    capacity = sz;
+                }
+                if (m_read_buf.size() < capacity)
+                    m_read_buf.resize(capacity);
+
+                const auto n = recv(c.m_fd, m_read_buf.data(), capacity, 0);
+                if (n <= 0)
+                    return n < 0 && (errno == EINTR || errno == EAGAIN);
+
+                const uint8_t* p = m_read_buf.data();
+                const uint8_t* e = p + n;
+                const bool tail = !c.m_tail.empty();
+                if (tail)
+                {
+                    c.m_tail.insert(c.m_tail.end(), p, e);
+                    p = c.m_tail.data();
+                    e = p + c.m_tail.size();
+                }
+
+                // hand over complete records, keep the rest for the next read
+                const uint8_t* start = p;
+                while (std::size_t(e - start) >= prefix)
+                {
+                    socket::record_len_t len;
+                    std::memcpy(&len, start, prefix);
+                    len = ntohl(len);
+                    if (len > m_params.m_max_record)
+                        return false;
+                    if (std::size_t(e - start) - prefix < len)
+                        break;
+                    if (!c.m_endpoint->consume(start + prefix, start + prefix + len))
+                        m_records_refused++;
+                    m_records++;
+                    start += prefix + len;
+                }
+
+                if (tail)
+                    c.m_tail.erase(c.m_tail.begin(), c.m_tail.begin() + (start - p));
+                else
+                    c.m_tail.assign(start, e);
+                return true;
+            }
+        }
+    }
+}
@@ -1,251 +1,1445 @@
-#include <gtest/gtest.h>
-#include <thread>
-#include <neutrino_mock.hpp>
-
-#include <random>
-
-#include <neutrino_transport_buffered_st.hpp>
-#include <neutrino_transport_buffered_mt.hpp>
-
-using namespace neutrino::impl;
-
-namespace
-{
-    const static auto test_buffers = []() 
-    {
-        std::vector<std::vector<uint8_t>> ret;
-        for (uint8_t i = 1; i < (uint8_t)0xff; i++)
-        {
-            ret.emplace_back(i, i);
-        }
-        return ret;
-    }();
-
-    struct named_buffered_endpoint_params_t
-    {
-        transport::buffered_endpoint_t::buffered_endpoint_params_t m_params;
-        std::string m_name;
-    };
-
-    const static auto test_params = []()
-    {
-        return std::vector<named_buffered_endpoint_params_t>{
-            { {1000, 1}, "1000/1"}
-            , { {1000, 500}, "1000/500"}
-            , { {1000, 750}, "1000/750" }
-            , { {1000, 999}, "1000/999" }
-            , { {1000, 1000}, "1000/1000" }
-            , { {1000, 1001}, "1000/1001" }
-            , { {1000, 1100}, "1000/1100" }
-        };
-    }();
-}
-
-
-struct neutrino_buffered_endpoints_tests : public ::testing::Test
-{
-    std::shared_ptr<transport::endpoint_t> m_frames_collector;
-
-    struct run_parameters_t
-    {
-        transport::buffered_endpoint_t* e = nullptr;
-        std::size_t cc_frames = 0;
-        std::atomic<std::size_t> bytes_sent = 0;
-        std::atomic<std::size_t> bytes_failed = 0;
-    };
-
-    static void run_iterations(run_parameters_t& p)
-    {
-        const std::size_t retries = 100;
-        for(std::size_t cc = 0; cc < p.cc_frames; cc++)
-        {
-            const auto& b = test_buffers[std::rand() % test_buffers.size()];
-
-            auto cc_retries = retries;
-            do
-            {
-                if (p.e->consume(&(b[0]), &(b[b.size() - 1]) + 1 /*past last item*/))
-                {
-                    p.bytes_sent += b.size();
-                    break;
-                }
-            }
-            while(cc_retries--);
-
-            if(!cc_retries)
-            {
-                // TODO: collect failed attempts
-                p.bytes_failed += b.size();
-            }
-            
-        }
-
-        // perform flush() by calling with 0-len data 
-        uint8_t dummy[1];
-        p.e->consume(dummy, dummy);
-    }
-
-    void validate_run(const run_parameters_t& p, const named_buffered_endpoint_params_t& po)
-    {
-        char msg_buf[1000];
-        ASSERT_TRUE(m_frames_collector);
-
-        {
-            auto& cast_m_frames_collector = static_cast<neutrino::mock::frames_collector_t&>(*m_frames_collector);
-            ASSERT_FALSE(cast_m_frames_collector.m_sumbissions.empty());
-
-            snprintf(msg_buf, sizeof(msg_buf) - 1, "total frames %d", cast_m_frames_collector.m_sumbissions.size());
-            SCOPED_TRACE(msg_buf);
-
-            std::size_t submission_cc = 0;
-            std::size_t bytes_received = 0;
-            for(const auto& submission : cast_m_frames_collector.m_sumbissions)
-            {
-                bytes_received += submission.m_buffer.size();
-                snprintf(msg_buf, sizeof(msg_buf) - 1, "submission # %d size %d", submission_cc++, submission.m_buffer.size());
-                SCOPED_TRACE(msg_buf);
-                ASSERT_TRUE(submission.m_buffer.size() <= po.m_params.m_message_buf_size) << "individual submission can't exceed expected buffer size";
-
-                // frames are jammed into one buffer, validate frame by frame
-                std::size_t frame_start_idx = 0;
-                std::size_t frame_cc = 0;
-                do
-                {
-                    // frame contains same symbol A repeated A times 
-                    // any other symbol in a region [frme_start ... frame_start + A] means the buffer is corrupted 
-                    auto expected_frame_symbol = submission.m_buffer[frame_start_idx];
-                    auto expected_frame_end = frame_start_idx + expected_frame_symbol;
-
-                    snprintf(msg_buf, sizeof(msg_buf) - 1, "frame # %d symbol %d", frame_cc, expected_frame_symbol);
-                    SCOPED_TRACE(msg_buf);
-
-                    ASSERT_TRUE(expected_frame_end > frame_start_idx); // self check
-                    if (expected_frame_end > submission.m_buffer.size())
-                    {
-                        ASSERT_TRUE(expected_frame_end <= submission.m_buffer.size())
-                        << "frame ends at " << expected_frame_end << " outside of submission size " << submission.m_buffer.size();
-                    }
-
-                    std::size_t cc_symbol_in_frame = 0;
-                    while(++frame_start_idx < expected_frame_end)
-                    {
-                        if(expected_frame_symbol != submission.m_buffer[frame_start_idx])
-                        {
-                            ASSERT_EQ(expected_frame_symbol, submission.m_buffer[frame_start_idx]) << "frame is corrupted at idx " << frame_start_idx << " symbol # " << cc_symbol_in_frame << " countdown to frame end " << (expected_frame_end - frame_start_idx);
-                        }
-                        ASSERT_EQ(expected_frame_symbol, submission.m_buffer[frame_start_idx]) << "frame is corrupted at idx " << frame_start_idx << " symbol # " << cc_symbol_in_frame << " countdown to frame end " << (expected_frame_end - frame_start_idx);
-                        cc_symbol_in_frame++;
-                    }
-
-                    frame_cc++;
-                }
-                while(frame_start_idx < submission.m_buffer.size());
-            }
-            ASSERT_EQ(p.bytes_sent.load(), bytes_received) << "bytes sent/received mismatch";
-            ASSERT_EQ(p.bytes_failed, 0);
-            
-            cast_m_frames_collector.m_sumbissions.clear();
-        }
-    }
-
-    void SetUp() final
-    {
-        std::srand(std::time(0));
-        m_frames_collector.reset(new neutrino::mock::frames_collector_t());
-    }
-
-    void TearDown() final
-    {
-        auto& cast_m_frames_collector = static_cast<neutrino::mock::frames_collector_t&>(*m_frames_collector);
-        ASSERT_TRUE(cast_m_frames_collector.m_sumbissions.empty());
-        m_frames_collector.reset();
-    }
-
-    void validate_buffered_singlethread()
-    {
-        for (const auto& po : test_params)
-        {
-            SCOPED_TRACE(po.m_name);
-            transport::buffered_singlethread_endpoint_t e(m_frames_collector, po.m_params);
-            run_parameters_t p{ &e, 100000 };
-            run_iterations(p);
-            validate_run(p, po);
-        }
-    }
-
-    template <typename endpoint_factory>
-    void validate_buffered_multithread(endpoint_factory f)
-    {
-        const std::size_t cc_threads = 20;
-        for (const auto& po : test_params)
-        {
-            SCOPED_TRACE(po.m_name);
-            auto e{f(po)};
-            run_parameters_t p{ e.get(), 10000 / cc_threads };
-
-            std::mutex m;
-            std::condition_variable v;
-            bool ready = false;
-
-            auto l = [&v, &m, &ready, &p]()
-            {
-                {
-                    std::unique_lock<std::mutex> lk(m);
-                    v.wait(lk, [&ready] {return ready; });
-                    lk.unlock();
-                }
-                run_iterations(p);
-            };
-
-            std::list<std::thread> tt;
-
-            for (std::size_t cc = 0; cc < cc_threads; cc++)
-                tt.emplace_back(l);
-
-            {
-                std::lock_guard<std::mutex> lk(m);
-                ready = true;
-            }
-            v.notify_all();
-
-            for (auto& t : tt)
-                t.join();
-
-            validate_run(p, po);
-        }
-    }
-};
-
-TEST_F(neutrino_buffered_endpoints_tests, buffered_st)
-{
-    validate_buffered_singlethread();
-}
-
-TEST_F(neutrino_buffered_endpoints_tests, buffered_mt_exclusive)
-{
-    validate_buffered_multithread(
-        [this](const auto& po)
-        {
-            return std::make_shared<transport::buffered_exclusive_endpoint_t>(m_frames_collector, po.m_params);
-        }
-    );
-}
-
-TEST_F(neutrino_buffered_endpoints_tests, buffered_mt_optimistic_default_optimistic_retry)
-{
-    transport::buffered_optimistic_endpoint_t::buffered_optimistic_consumer_params_t opo;
-
-    validate_buffered_multithread(
-        [this, &opo](const auto& po)
-        {
-            return std::make_shared<transport::buffered_optimistic_endpoint_t>(m_frames_collector, po.m_params, opo);
-        }
-    );
-}
-
-#if (USE_MT)
-TEST_F(neutrino_buffered_endpoints_tests, buffered_mt)
-{
-    ADD_FAILURE();
-}
+#include <gtest/gtest.h>
+#include <thread>
+#include <neutrino_mock.hpp>
+
+#include <random>
+#include <cstring>
+
+#include <neutrino_transport_buffered_st.hpp>
+#include <neutrino_transport_buffered_mt.hpp>
+#include <neutrino_transport_buffered_per_thread.hpp>
+#include <neutrino_transport_buffered_sharded.hpp>
+#include <neutrino_transport_buffered_flush_scheduler.hpp>
+#include <neutrino_transport_endpoint_shm_ring.hpp>
+#include <neutrino_transport_endpoint_async_posix_handle.hpp>
+#include <neutrino_transport_endpoint_socket.hpp>
+#include <neutrino_transport_endpoint_journal.hpp>
+#include <neutrino_transport_endpoint_framed.hpp>
+
+#if !defined(_WIN32)
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <arpa/inet.h>
+#endif
+
+using namespace neutrino::impl;
+
+namespace
+{
+    const static auto test_buffers = []() 
+    {
+        std::vector<std::vector<uint8_t>> ret;
+        for (uint8_t i = 1; i < (uint8_t)0xff; i++)
+        {
+            ret.emplace_back(i, i);
+        }
+        return ret;
+    }();
+
+    struct named_buffered_endpoint_params_t
+    {
+        transport::buffered_endpoint_t::buffered_endpoint_params_t m_params;
+        std::string m_name;
+    };
+
+    const static auto test_params = []()
+    {
+        return std::vector<named_buffered_endpoint_params_t>{
+            { {1000, 1}, "1000/1"}
+            , { {1000, 500}, "1000/500"}
+            , { {1000, 750}, "1000/750" }
+            , { {1000, 999}, "1000/999" }
+            , { {1000, 1000}, "1000/1000" }
+            , { {1000, 1001}, "1000/1001" }
+            , { {1000, 1100}, "1000/1100" }
+        };
+    }();
+}
+
+
+struct neutrino_buffered_endpoints_tests : public ::testing::Test
+{
+    std::shared_ptr<transport::endpoint_t> m_frames_collector;
+
+    struct run_parameters_t
+    {
+        transport::endpoint_t* e = nullptr;
+        std::size_t cc_frames = 0;
+        std::atomic<std::size_t> bytes_sent = 0;
+        std::atomic<std::size_t> bytes_failed = 0;
+        std::size_t frames_in_run = 0; // 0: frame by frame consume(), otherwise consume_frames() with up to frames_in_run frames
+        bool regions = false; // frame by frame consumev(), each frame split into two regions
+    };
+
+    static void run_iterations(run_parameters_t& p)
+    {
+        const std::size_t retries = 100;
+        for(std::size_t cc = 0; cc < p.cc_frames; cc++)
+        {
+            const auto& b = test_buffers[std::rand() % test_buffers.size()];
+
+            if (p.frames_in_run)
+            {
+                // a run of same size frames, endpoint may split it between frames only
+                std::vector<uint8_t> run;
+                const std::size_t cc_run = 1 + std::rand() % p.frames_in_run;
+                for (std::size_t cc_frame = 0; cc_frame < cc_run; cc_frame++)
+                    run.insert(run.end(), b.begin(), b.end());
+                if (p.e->consume_frames(&(run[0]), &(run[run.size() - 1]) + 1, b.size()))
+                    p.bytes_sent += run.size();
+                else
+                    p.bytes_failed += run.size();
+                continue;
+            }
+
+            const std::size_t split = p.regions ? std::rand() % b.size() : 0;
+            const transport::endpoint_t::region_t r[2]{ { &(b[0]), &(b[0]) + split }, { &(b[0]) + split, &(b[b.size() - 1]) + 1 } };
+
+            auto cc_retries = retries;
+            do
+            {
+                if (p.regions ? p.e->consumev(r, 2) : p.e->consume(&(b[0]), &(b[b.size() - 1]) + 1 /*past last item*/))
+                {
+                    p.bytes_sent += b.size();
+                    break;
+                }
+            }
+            while(cc_retries--);
+
+            if(!cc_retries)
+            {
+                // TODO: collect failed attempts
+                p.bytes_failed += b.size();
+            }
+            
+        }
+
+        // perform flush() by calling with 0-len data 
+        uint8_t dummy[1];
+        p.e->consume(dummy, dummy);
+    }
+
+    void validate_run(const run_parameters_t& p, const named_buffered_endpoint_params_t& po)
+    {
+        char msg_buf[1000];
+        ASSERT_TRUE(m_frames_collector);
+
+        {
+            auto& cast_m_frames_collector = static_cast<neutrino::mock::frames_collector_t&>(*m_frames_collector);
+            ASSERT_FALSE(cast_m_frames_collector.m_sumbissions.empty());
+
+            snprintf(msg_buf, sizeof(msg_buf) - 1, "total frames %d", cast_m_frames_collector.m_sumbissions.size());
+            SCOPED_TRACE(msg_buf);
+
+            std::size_t submission_cc = 0;
+            std::size_t bytes_received = 0;
+            for(const auto& submission : cast_m_frames_collector.m_sumbissions)
+            {
+                bytes_received += submission.m_buffer.size();
+                snprintf(msg_buf, sizeof(msg_buf) - 1, "submission # %d size %d", submission_cc++, submission.m_buffer.size());
+                SCOPED_TRACE(msg_buf);
+                ASSERT_TRUE(submission.m_buffer.size() <= po.m_params.m_message_buf_size) << "individual submission can't exceed expected buffer size";
+
+                // frames are jammed into one buffer, validate frame by frame
+                std::size_t frame_start_idx = 0;
+                std::size_t frame_cc = 0;
+                do
+                {
+                    // frame contains same symbol A repeated A times 
+                    // any other symbol in a region [frme_start ... frame_start + A] means the buffer is corrupted 
+                    auto expected_frame_symbol = submission.m_buffer[frame_start_idx];
+                    auto expected_frame_end = frame_start_idx + expected_frame_symbol;
+
+                    snprintf(msg_buf, sizeof(msg_buf) - 1, "frame # %d symbol %d", frame_cc, expected_frame_symbol);
+                    SCOPED_TRACE(msg_buf);
+
+                    ASSERT_TRUE(expected_frame_end > frame_start_idx); // self check
+                    if (expected_frame_end > submission.m_buffer.size())
+                    {
+                        ASSERT_TRUE(expected_frame_end <= submission.m_buffer.size())
+                        << "frame ends at " << expected_frame_end << " outside of submission size " << submission.m_buffer.size();
+                    }
+
+                    std::size_t cc_symbol_in_frame = 0;
+                    while(++frame_start_idx < expected_frame_end)
+                    {
+                        if(expected_frame_symbol != submission.m_buffer[frame_start_idx])
+                        {
+                            ASSERT_EQ(expected_frame_symbol, submission.m_buffer[frame_start_idx]) << "frame is corrupted at idx " << frame_start_idx << " symbol # " << cc_symbol_in_frame << " countdown to frame end " << (expected_frame_end - frame_start_idx);
+                        }
+                        ASSERT_EQ(expected_frame_symbol, submission.m_buffer[frame_start_idx]) << "frame is corrupted at idx " << frame_start_idx << " symbol # " << cc_symbol_in_frame << " countdown to frame end " << (expected_frame_end - frame_start_idx);
+                        cc_symbol_in_frame++;
+                    }
+
+                    frame_cc++;
+                }
+                while(frame_start_idx < submission.m_buffer.size());
+            }
+            ASSERT_EQ(p.bytes_sent.load(), bytes_received) << "bytes sent/received mismatch";
+            ASSERT_EQ(p.bytes_failed, 0);
+            
+            cast_m_frames_collector.m_sumbissions.clear();
+        }
+    }
+
+    void SetUp() final
+    {
+        std::srand(std::time(0));
+        m_frames_collector.reset(new neutrino::mock::frames_collector_t());
+    }
+
+    void TearDown() final
+    {
+        auto& cast_m_frames_collector = static_cast<neutrino::mock::frames_collector_t&>(*m_frames_collector);
+        ASSERT_TRUE(cast_m_frames_collector.m_sumbissions.empty());
+        m_frames_collector.reset();
+    }
+
+    void validate_buffered_singlethread(std::size_t frames_in_run = 0, bool regions = false)
+    {
+        for (const auto& po : test_params)
+        {
+            SCOPED_TRACE(po.m_name);
+            transport::buffered_singlethread_endpoint_t e(m_frames_collector, po.m_params);
+            run_parameters_t p{ &e, 100000 };
+            p.frames_in_run = frames_in_run;
+            p.regions = regions;
+            run_iterations(p);
+            validate_run(p, po);
+        }
+    }
+
+    template <typename endpoint_factory>
+    void validate_buffered_multithread(endpoint_factory f, std::size_t frames_in_run = 0, bool regions = false)
+    {
+        const std::size_t cc_threads = 20;
+        for (const auto& po : test_params)
+        {
+            SCOPED_TRACE(po.m_name);
+            auto e{f(po)};
+            run_parameters_t p{ e.get(), 10000 / cc_threads };
+            p.frames_in_run = frames_in_run;
+            p.regions = regions;
+
+            std::mutex m;
+            std::condition_variable v;
+            bool ready = false;
+
+            auto l = [&v, &m, &ready, &p]()
+            {
+                {
+                    std::unique_lock<std::mutex> lk(m);
+                    v.wait(lk, [&ready] {return ready; });
+                    lk.unlock();
+                }
+                run_iterations(p);
+            };
+
+            std::list<std::thread> tt;
+
+            for (std::size_t cc = 0; cc < cc_threads; cc++)
+                tt.emplace_back(l);
+
+            {
+                std::lock_guard<std::mutex> lk(m);
+                ready = true;
+            }
+            v.notify_all();
+
+            for (auto& t : tt)
+                t.join();
+
+            validate_run(p, po);
+        }
+    }
+};
+
+TEST_F(neutrino_buffered_endpoints_tests, buffered_st)
+{
+    validate_buffered_singlethread();
+}
+
+TEST_F(neutrino_buffered_endpoints_tests, buffered_st_frames)
+{
+    validate_buffered_singlethread(8);
+}
+
+TEST_F(neutrino_buffered_endpoints_tests, buffered_st_regions)
+{
+    validate_buffered_singlethread(0, true);
+}
+
+TEST_F(neutrino_buffered_endpoints_tests, buffered_mt_regions)
+{
+    validate_buffered_multithread(
+        [this](const auto& po)
+        {
+            return std::make_shared<transport::buffered_exclusive_endpoint_t>(m_frames_collector, po.m_params);
+        }
+        , 0, true
+    );
+    validate_buffered_multithread(
+        [this](const auto& po)
+        {
+            return aligned_shared<transport::buffered_reserve_commit_endpoint_t>(m_frames_collector, po.m_params);
+        }
+        , 0, true
+    );
+    // no reserve(), regions are coalesced
+    validate_buffered_multithread(
+        [this](const auto& po)
+        {
+            return std::make_shared<transport::buffered_optimistic_endpoint_t>(m_frames_collector, po.m_params, transport::buffered_optimistic_endpoint_t::buffered_optimistic_consumer_params_t{});
+        }
+        , 0, true
+    );
+}
+
+TEST_F(neutrino_buffered_endpoints_tests, buffered_mt_exclusive)
+{
+    validate_buffered_multithread(
+        [this](const auto& po)
+        {
+            return std::make_shared<transport::buffered_exclusive_endpoint_t>(m_frames_collector, po.m_params);
+        }
+    );
+}
+
+TEST_F(neutrino_buffered_endpoints_tests, buffered_mt_optimistic_default_optimistic_retry)
+{
+    transport::buffered_optimistic_endpoint_t::buffered_optimistic_consumer_params_t opo;
+
+    validate_buffered_multithread(
+        [this, &opo](const auto& po)
+        {
+            return std::make_shared<transport::buffered_optimistic_endpoint_t>(m_frames_collector, po.m_params, opo);
+        }
+    );
+}
+
+TEST_F(neutrino_buffered_endpoints_tests, buffered_mt_optimistic_frames)
+{
+    transport::buffered_optimistic_endpoint_t::buffered_optimistic_consumer_params_t opo;
+
+    validate_buffered_multithread(
+        [this, &opo](const auto& po)
+        {
+            return std::make_shared<transport::buffered_optimistic_endpoint_t>(m_frames_collector, po.m_params, opo);
+        }
+        , 8
+    );
+}
+
+TEST_F(neutrino_buffered_endpoints_tests, buffered_mt_reserve_commit)
+{
+    validate_buffered_multithread(
+        [this](const auto& po)
+        {
+            return aligned_shared<transport::buffered_reserve_commit_endpoint_t>(m_frames_collector, po.m_params);
+        }
+    );
+    validate_buffered_multithread(
+        [this](const auto& po)
+        {
+            return aligned_shared<transport::buffered_reserve_commit_endpoint_t>(m_frames_collector, po.m_params);
+        }
+        , 8
+    );
+}
+
+TEST_F(neutrino_buffered_endpoints_tests, buffered_mt_sharded)
+{
+    typedef transport::buffered_sharded_endpoint_t::buffered_sharded_params_t params_t;
+    for (auto selector : { params_t::shard_selector_t::CPU, params_t::shard_selector_t::THREAD })
+    {
+        SCOPED_TRACE(selector == params_t::shard_selector_t::CPU ? "CPU" : "THREAD");
+        params_t spo;
+        spo.m_shards = 4;
+        spo.m_selector = selector;
+
+        for (std::size_t frames_in_run : { 0, 8 })
+        {
+            validate_buffered_multithread(
+                [this, &spo](const auto& po)
+                {
+                    auto collector = m_frames_collector;
+                    auto params = po.m_params;
+                    return std::make_shared<transport::buffered_sharded_endpoint_t>(
+                        [collector, params]() { return aligned_shared<transport::buffered_reserve_commit_endpoint_t>(collector, params); }
+                        , spo
+                    );
+                }
+                , frames_in_run
+            );
+        }
+    }
+}
+
+TEST_F(neutrino_buffered_endpoints_tests, buffered_mt_sharded_recreated)
+{
+    transport::buffered_sharded_endpoint_t::buffered_sharded_params_t spo;
+    spo.m_shards = 4;
+    const transport::buffered_endpoint_t::buffered_endpoint_params_t bpo{ 1000, 1100 };
+    auto collector = m_frames_collector;
+
+    // a long living thread keeps no state of endpoints gone
+    const auto& b = test_buffers[9];
+    for (std::size_t cc = 0; cc < 100; cc++)
+    {
+        transport::buffered_sharded_endpoint_t e([collector, bpo]() { return aligned_shared<transport::buffered_reserve_commit_endpoint_t>(collector, bpo); }, spo);
+        ASSERT_TRUE(e.consume(&(b[0]), &(b[b.size() - 1]) + 1));
+        ASSERT_EQ(std::size_t{ 1 }, transport::buffered_sharded_endpoint_t::this_thread_endpoints());
+    }
+    ASSERT_EQ(std::size_t{ 0 }, transport::buffered_sharded_endpoint_t::this_thread_endpoints());
+
+    auto& cast_m_frames_collector = static_cast<neutrino::mock::frames_collector_t&>(*m_frames_collector);
+    std::size_t bytes_received = 0;
+    for (const auto& submission : cast_m_frames_collector.m_sumbissions)
+        bytes_received += submission.m_buffer.size();
+    ASSERT_EQ(100 * b.size(), bytes_received);
+    cast_m_frames_collector.m_sumbissions.clear();
+}
+
+TEST_F(neutrino_buffered_endpoints_tests, buffered_mt_over_aligned)
+{
+    const transport::buffered_endpoint_t::buffered_endpoint_params_t bpo{ 1000, 1100 };
+    auto collector = m_frames_collector;
+    transport::buffered_sharded_endpoint_t::buffered_sharded_params_t spo;
+    spo.m_shards = 3;
+    transport::buffered_sharded_endpoint_t e([collector, bpo]() { return aligned_shared<transport::buffered_reserve_commit_endpoint_t>(collector, bpo); }, spo);
+
+    for (const auto& s : e.m_shards)
+    {
+        ASSERT_EQ(0u, reinterpret_cast<std::uintptr_t>(&s) % 64);
+        auto& rc = static_cast<transport::buffered_reserve_commit_endpoint_t&>(*s.m_endpoint);
+        ASSERT_EQ(0u, reinterpret_cast<std::uintptr_t>(&rc.m_reserved) % 64);
+        ASSERT_EQ(0u, reinterpret_cast<std::uintptr_t>(&rc.m_committed) % 64);
+    }
+}
+
+TEST_F(neutrino_buffered_endpoints_tests, buffered_mt_multi_optimistic)
+{
+    typedef transport::buffered_multi_optimistic_endpoint_t::buffered_multi_optimistic_params_t params_t;
+    for (std::size_t cc_buffers : { 2, 4 })
+    {
+        for (auto policy : { params_t::all_in_flight_policy_t::WAIT, params_t::all_in_flight_policy_t::DROP })
+        {
+            SCOPED_TRACE(std::string("buffers ").append(std::to_string(cc_buffers)).append(policy == params_t::all_in_flight_policy_t::WAIT ? " WAIT" : " DROP"));
+            params_t mpo;
+            mpo.m_buffers = cc_buffers;
+            mpo.m_all_in_flight = policy;
+
+            validate_buffered_multithread(
+                [this, &mpo](const auto& po)
+                {
+                    return std::make_shared<transport::buffered_multi_optimistic_endpoint_t>(m_frames_collector, po.m_params, mpo);
+                }
+            );
+            if (policy == params_t::all_in_flight_policy_t::DROP)
+                continue; // dropped part of a run is not accounted by run_iterations
+
+            validate_buffered_multithread(
+                [this, &mpo](const auto& po)
+                {
+                    return std::make_shared<transport::buffered_multi_optimistic_endpoint_t>(m_frames_collector, po.m_params, mpo);
+                }
+                , 8
+            );
+        }
+    }
+}
+
+TEST_F(neutrino_buffered_endpoints_tests, buffered_mt_per_thread)
+{
+    transport::buffered_per_thread_endpoint_t::buffered_per_thread_params_t ptpo;
+    ptpo.m_ring_size = 256 * 1024; // whole run of one thread fits, drops are not expected
+
+    validate_buffered_multithread(
+        [this, &ptpo](const auto& po)
+        {
+            return std::make_shared<transport::buffered_per_thread_endpoint_t>(m_frames_collector, po.m_params, ptpo);
+        }
+    );
+}
+
+TEST_F(neutrino_buffered_endpoints_tests, buffered_mt_per_thread_dropped_bytes)
+{
+    transport::buffered_per_thread_endpoint_t::buffered_per_thread_params_t ptpo;
+    ptpo.m_ring_size = 1024;
+    ptpo.m_drain_period = std::chrono::hours(1); // drain on flush only
+
+    transport::buffered_per_thread_endpoint_t e(m_frames_collector, { 1000, 500 }, ptpo);
+
+    const auto& b = test_buffers[99]; // 100 bytes of symbol 100
+    std::size_t bytes_sent = 0;
+    std::size_t bytes_refused = 0;
+    for (std::size_t cc = 0; cc < 20; cc++)
+    {
+        if (e.consume(&(b[0]), &(b[b.size() - 1]) + 1))
+            bytes_sent += b.size();
+        else
+            bytes_refused += b.size();
+    }
+
+    ASSERT_NE(std::size_t{ 0 }, bytes_refused);
+    ASSERT_EQ(bytes_refused, e.dropped_bytes());
+
+    uint8_t dummy[1];
+    ASSERT_TRUE(e.consume(dummy, dummy));
+
+    std::size_t bytes_received = 0;
+    auto& cast_m_frames_collector = static_cast<neutrino::mock::frames_collector_t&>(*m_frames_collector);
+    for (const auto& submission : cast_m_frames_collector.m_sumbissions)
+        bytes_received += submission.m_buffer.size();
+    ASSERT_EQ(bytes_sent, bytes_received);
+    cast_m_frames_collector.m_sumbissions.clear();
+}
+
+TEST(neutrino_buffered_per_thread_tests, stub_reserve_commit_from_many_threads)
+{
+    // v00 stub serializes right into reserve() of the endpoint, every thread must get its own ring
+    const std::size_t cc_threads = 8;
+    const std::size_t cc_frames = 20000;
+
+    neutrino::mock::counting_columns_consumer_t counter;
+    auto endpoint_impl = transport::frame_v00::create_endpoint_impl(transport::frame_v00::known_encodings_t::BINARY_NATIVE, counter);
+    transport::buffered_per_thread_endpoint_t::buffered_per_thread_params_t ptpo;
+    ptpo.m_ring_size = 1024 * 1024; // whole run of one thread fits, drops are not expected
+    auto e = std::make_shared<transport::buffered_per_thread_endpoint_t>(
+        endpoint_impl, transport::buffered_endpoint_t::buffered_endpoint_params_t{ 64 * 1024, 32 * 1024 }, ptpo);
+    auto stub = transport::frame_v00::create_consumer_stub(transport::frame_v00::known_encodings_t::BINARY_NATIVE, *e);
+
+    std::list<std::thread> tt;
+    for (std::size_t t = 0; t < cc_threads; t++)
+    {
+        tt.emplace_back([&stub, t, cc_frames]()
+            {
+                for (std::size_t cc = 0; cc < cc_frames; cc++)
+                    stub->consume_checkpoint(cc, t, cc);
+            });
+    }
+    for (auto& t : tt)
+        t.join();
+
+    uint8_t dummy[1];
+    ASSERT_TRUE(e->consume(dummy, dummy));
+    ASSERT_EQ(uint64_t{ 0 }, e->dropped_bytes());
+    ASSERT_EQ(cc_threads * cc_frames, counter.m_cc);
+}
+
+TEST_F(neutrino_buffered_endpoints_tests, flush_scheduler_max_latency)
+{
+    const transport::buffered_endpoint_t::buffered_endpoint_params_t bpo{ 1000, 1100 }; // watermark is never crossed
+    std::vector<std::shared_ptr<transport::buffered_endpoint_t>> endpoints{
+        std::make_shared<transport::buffered_exclusive_endpoint_t>(m_frames_collector, bpo)
+        , std::make_shared<transport::buffered_optimistic_endpoint_t>(m_frames_collector, bpo, transport::buffered_optimistic_endpoint_t::buffered_optimistic_consumer_params_t{})
+        , aligned_shared<transport::buffered_reserve_commit_endpoint_t>(m_frames_collector, bpo)
+        , std::make_shared<transport::buffered_multi_optimistic_endpoint_t>(m_frames_collector, bpo, transport::buffered_multi_optimistic_endpoint_t::buffered_multi_optimistic_params_t{})
+        , std::make_shared<transport::buffered_per_thread_endpoint_t>(m_frames_collector, bpo, transport::buffered_per_thread_endpoint_t::buffered_per_thread_params_t{})
+    };
+
+    transport::flush_scheduler_t::flush_scheduler_params_t fpo;
+    fpo.m_max_latency = std::chrono::milliseconds(5);
+    transport::flush_scheduler_t scheduler(fpo);
+
+    auto& cast_m_frames_collector = static_cast<neutrino::mock::frames_collector_t&>(*m_frames_collector);
+    const auto& b = test_buffers[99];
+    for (std::size_t cc = 0; cc < endpoints.size(); cc++)
+    {
+        SCOPED_TRACE(std::string("endpoint # ").append(std::to_string(cc)));
+        scheduler.add(endpoints[cc]);
+        ASSERT_TRUE(endpoints[cc]->consume(&(b[0]), &(b[b.size() - 1]) + 1));
+
+        // quiet producer, frame leaves the buffer with no flush from it
+        std::size_t bytes_received = 0;
+        for (std::size_t cc_wait = 0; cc_wait < 1000 && !bytes_received; cc_wait++)
+        {
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+            std::lock_guard<std::mutex> lk(cast_m_frames_collector.m_m);
+            for (const auto& submission : cast_m_frames_collector.m_sumbissions)
+                bytes_received += submission.m_buffer.size();
+        }
+        ASSERT_EQ(b.size(), bytes_received);
+        ASSERT_EQ(uint64_t{ 0 }, endpoints[cc]->pending());
+
+        std::lock_guard<std::mutex> lk(cast_m_frames_collector.m_m);
+        cast_m_frames_collector.m_sumbissions.clear();
+    }
+    ASSERT_LE(endpoints.size(), scheduler.metrics().m_flushes);
+    ASSERT_EQ(uint64_t{ 0 }, scheduler.metrics().m_failed_flushes);
+}
+
+#if !defined(_WIN32)
+struct neutrino_shm_ring_tests : public ::testing::Test
+{
+    neutrino::mock::frames_collector_t m_collector;
+
+    // every submission is one record, same bytes in same order
+    void validate_records(const std::vector<const std::vector<uint8_t>*>& expected)
+    {
+        ASSERT_EQ(expected.size(), m_collector.m_sumbissions.size());
+        auto it = m_collector.m_sumbissions.begin();
+        for (std::size_t cc = 0; cc < expected.size(); cc++, ++it)
+            ASSERT_EQ(*expected[cc], it->m_buffer) << "record # " << cc;
+        m_collector.m_sumbissions.clear();
+    }
+};
+
+TEST_F(neutrino_shm_ring_tests, memfd_roundtrip_with_wrap)
+{
+    transport::shm_ring_endpoint_t::shm_ring_params_t po;
+    po.m_size = 4096;
+    transport::shm_ring_endpoint_t w(po);
+    if (w.fd() < 0)
+        GTEST_SKIP() << "memfd is not available";
+    ASSERT_TRUE(w.valid());
+
+    transport::shm_ring_reader_t r(w.fd());
+    ASSERT_TRUE(r.valid());
+
+    std::vector<const std::vector<uint8_t>*> expected;
+    for (std::size_t cc = 0; cc < 1000; cc++)
+    {
+        const auto& b = test_buffers[std::rand() % test_buffers.size()];
+        ASSERT_TRUE(w.consume(&(b[0]), &(b[b.size() - 1]) + 1));
+        expected.push_back(&b);
+        if (cc % 10 == 9)
+            r.drain(m_collector);
+    }
+    r.drain(m_collector);
+
+    validate_records(expected);
+    ASSERT_EQ(uint64_t{ 0 }, r.dropped_bytes());
+}
+
+TEST_F(neutrino_shm_ring_tests, full_ring_drops)
+{
+    transport::shm_ring_endpoint_t::shm_ring_params_t po;
+    po.m_size = 1024;
+    transport::shm_ring_endpoint_t w(po);
+    if (w.fd() < 0)
+        GTEST_SKIP() << "memfd is not available";
+
+    transport::shm_ring_reader_t r(w.fd());
+    ASSERT_TRUE(r.valid());
+
+    const auto& b = test_buffers[99];
+    std::vector<const std::vector<uint8_t>*> expected;
+    uint64_t bytes_refused = 0;
+    for (std::size_t cc = 0; cc < 20; cc++)
+    {
+        if (w.consume(&(b[0]), &(b[b.size() - 1]) + 1))
+            expected.push_back(&b);
+        else
+            bytes_refused += b.size();
+    }
+
+    ASSERT_NE(uint64_t{ 0 }, bytes_refused);
+    ASSERT_EQ(bytes_refused, w.dropped_bytes());
+    ASSERT_EQ(bytes_refused, r.dropped_bytes());
+
+    r.drain(m_collector);
+    validate_records(expected);
+}
+
+TEST_F(neutrino_shm_ring_tests, reader_wakeup)
+{
+    transport::shm_ring_endpoint_t::shm_ring_params_t po;
+    transport::shm_ring_endpoint_t w(po);
+    if (w.fd() < 0)
+        GTEST_SKIP() << "memfd is not available";
+
+    transport::shm_ring_reader_t r(w.fd());
+    ASSERT_TRUE(r.valid());
+
+    const std::size_t cc_records = 100;
+    std::thread reader([&r, this, cc_records]()
+        {
+            std::size_t cc_timeouts = 0;
+            while (m_collector.m_sumbissions.size() < cc_records && cc_timeouts < 10)
+            {
+                if (!r.wait(std::chrono::milliseconds(1000)))
+                    cc_timeouts++;
+                r.drain(m_collector);
+            }
+        });
+
+    std::vector<const std::vector<uint8_t>*> expected;
+    for (std::size_t cc = 0; cc < cc_records; cc++)
+    {
+        const auto& b = test_buffers[cc];
+        ASSERT_TRUE(w.consume(&(b[0]), &(b[b.size() - 1]) + 1));
+        expected.push_back(&b);
+        if (cc % 7 == 0)
+            std::this_thread::sleep_for(std::chrono::milliseconds(1)); // let reader go idle
+    }
+    reader.join();
+
+    validate_records(expected);
+}
+
+TEST_F(neutrino_shm_ring_tests, drain_after_producer_exit)
+{
+    const std::string name = std::string("/neutrino_ut_").append(std::to_string(getpid()));
+
+    std::vector<const std::vector<uint8_t>*> expected;
+    {
+        transport::shm_ring_endpoint_t::shm_ring_params_t po;
+        po.m_name = name;
+        transport::shm_ring_endpoint_t w(po);
+        ASSERT_TRUE(w.valid());
+        for (std::size_t cc = 0; cc < 10; cc++)
+        {
+            const auto& b = test_buffers[cc];
+            ASSERT_TRUE(w.consume(&(b[0]), &(b[b.size() - 1]) + 1));
+            expected.push_back(&b);
+        }
+    }
+
+    transport::shm_ring_reader_t r(name);
+    transport::shm_ring_reader_t::remove(name);
+    ASSERT_TRUE(r.valid());
+    r.drain(m_collector);
+    validate_records(expected);
+}
+
+TEST_F(neutrino_shm_ring_tests, restarted_producer_appends)
+{
+    const std::string name = std::string("/neutrino_ut_restart_").append(std::to_string(getpid()));
+    transport::shm_ring_reader_t::remove(name);
+
+    transport::shm_ring_endpoint_t::shm_ring_params_t po;
+    po.m_name = name;
+    po.m_size = 4096;
+
+    std::vector<const std::vector<uint8_t>*> expected;
+    for (std::size_t run = 0; run < 2; run++)
+    {
+        transport::shm_ring_endpoint_t w(po);
+        ASSERT_TRUE(w.valid()) << w.error();
+        for (std::size_t cc = 0; cc < 5; cc++)
+        {
+            const auto& b = test_buffers[run * 5 + cc];
+            ASSERT_TRUE(w.consume(&(b[0]), &(b[b.size() - 1]) + 1));
+            expected.push_back(&b);
+        }
+    }
+
+    // not a ring of this size, left untouched
+    po.m_size = 8192;
+    transport::shm_ring_endpoint_t other(po);
+    ASSERT_FALSE(other.valid());
+    ASSERT_EQ(EINVAL, other.error());
+
+    transport::shm_ring_reader_t r(name);
+    transport::shm_ring_reader_t::remove(name);
+    ASSERT_TRUE(r.valid());
+    r.drain(m_collector);
+    validate_records(expected);
+}
+
+TEST_F(neutrino_shm_ring_tests, corrupt_length_skips_published)
+{
+    typedef transport::shm_ring::header_t::record_len_t record_len_t;
+
+    transport::shm_ring_endpoint_t::shm_ring_params_t po;
+    po.m_size = 4096;
+    transport::shm_ring_endpoint_t w(po);
+    if (w.fd() < 0)
+        GTEST_SKIP() << "memfd is not available";
+    transport::shm_ring_reader_t r(w.fd());
+    ASSERT_TRUE(r.valid());
+
+    const auto& b = test_buffers[9]; // 10 bytes of symbol 10
+    for (std::size_t cc = 0; cc < 3; cc++)
+        ASSERT_TRUE(w.consume(&(b[0]), &(b[b.size() - 1]) + 1));
+
+    // length of the second record goes past what is published
+    const std::size_t mapping = transport::shm_ring::mapping_size(4096);
+    void* m = mmap(nullptr, mapping, PROT_READ | PROT_WRITE, MAP_SHARED, w.fd(), 0);
+    ASSERT_NE(MAP_FAILED, m);
+    const record_len_t bad = 1000;
+    std::memcpy(static_cast<transport::shm_ring::header_t*>(m)->m_data + sizeof(record_len_t) + b.size(), &bad, sizeof(bad));
+    munmap(m, mapping);
+
+    r.drain(m_collector);
+    validate_records({ &b });
+    ASSERT_EQ(uint64_t{ 1 }, r.metrics().m_records);
+    ASSERT_EQ(uint64_t{ 1 }, r.metrics().m_corruptions);
+    ASSERT_EQ(uint64_t{ 2 * (sizeof(record_len_t) + b.size()) }, r.metrics().m_bytes_skipped);
+
+    // records published after it are read
+    ASSERT_TRUE(w.consume(&(b[0]), &(b[b.size() - 1]) + 1));
+    r.drain(m_collector);
+    validate_records({ &b });
+    ASSERT_EQ(uint64_t{ 1 }, r.metrics().m_corruptions);
+}
+
+struct neutrino_async_posix_tests : public ::testing::Test
+{
+    int m_fds[2] = { -1, -1 };
+    std::vector<uint8_t> m_received;
+    std::thread m_reader;
+
+    void SetUp() final
+    {
+        ASSERT_EQ(0, pipe(m_fds));
+        fcntl(m_fds[1], F_SETFL, fcntl(m_fds[1], F_GETFL) | O_NONBLOCK); // writer sees EAGAIN on full pipe
+    }
+
+    void TearDown() final
+    {
+        if (m_reader.joinable())
+            m_reader.join();
+        close(m_fds[0]);
+    }
+
+    // reads until the endpoint closes write end
+    void start_reader()
+    {
+        m_reader = std::thread([this]()
+            {
+                uint8_t buf[4096];
+                ssize_t n;
+                while ((n = read(m_fds[0], buf, sizeof(buf))) > 0)
+                    m_received.insert(m_received.end(), buf, buf + n);
+            });
+    }
+
+    transport::async_posix_consumer_t::async_posix_consumer_params_t params()
+    {
+        transport::async_posix_consumer_t::async_posix_consumer_params_t ret;
+        ret.m_fd = m_fds[1];
+        ret.m_close_fd = true;
+        return ret;
+    }
+};
+
+TEST_F(neutrino_async_posix_tests, pipe_roundtrip_with_eagain)
+{
+    std::vector<uint8_t> sent;
+    {
+        transport::async_posix_consumer_t e(params());
+
+        // pipe fills up before reader starts, producer keeps going
+        for (std::size_t cc = 0; cc < 2000; cc++)
+        {
+            const auto& b = test_buffers[std::rand() % test_buffers.size()];
+            ASSERT_TRUE(e.consume(&(b[0]), &(b[b.size() - 1]) + 1));
+            sent.insert(sent.end(), b.begin(), b.end());
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(50));
+        start_reader();
+
+        ASSERT_TRUE(e.flush());
+        const auto m = e.metrics();
+        ASSERT_EQ(std::size_t{ 0 }, m.m_queue_depth);
+        ASSERT_EQ(uint64_t{ 0 }, m.m_bytes_in_flight);
+        ASSERT_EQ(uint64_t(sent.size()), m.m_bytes_written);
+        ASSERT_EQ(uint64_t{ 0 }, m.m_bytes_dropped);
+        ASSERT_EQ(uint64_t{ 0 }, m.m_write_errors);
+        ASSERT_NE(uint64_t{ 0 }, m.m_writes);
+        ASSERT_TRUE(m.m_max_write_latency >= m.m_last_write_latency);
+    }
+    m_reader.join();
+    ASSERT_EQ(sent, m_received);
+}
+
+TEST_F(neutrino_async_posix_tests, queue_overflow_drops)
+{
+    auto po = params();
+    po.m_max_queue_bytes = 1000;
+
+    uint64_t bytes_sent = 0;
+    uint64_t bytes_refused = 0;
+    {
+        transport::async_posix_consumer_t e(po);
+
+        const auto& b = test_buffers[99];
+        for (std::size_t cc = 0; cc < 2000; cc++)
+        {
+            if (e.consume(&(b[0]), &(b[b.size() - 1]) + 1))
+                bytes_sent += b.size();
+            else
+                bytes_refused += b.size();
+        }
+        start_reader();
+
+        ASSERT_TRUE(e.flush());
+        const auto m = e.metrics();
+        ASSERT_NE(uint64_t{ 0 }, bytes_refused);
+        ASSERT_EQ(bytes_refused, m.m_bytes_dropped);
+        ASSERT_EQ(bytes_sent, m.m_bytes_written);
+    }
+    m_reader.join();
+    ASSERT_EQ(bytes_sent, m_received.size());
+}
+
+TEST_F(neutrino_async_posix_tests, broken_pipe_counts_partial_batch)
+{
+    const std::size_t cc_buffers = 4000;
+    const std::size_t bytes_read = 50000;
+    uint64_t bytes_sent = 0;
+    {
+        transport::async_posix_consumer_t e(params());
+
+        const auto& b = test_buffers[99];
+        for (std::size_t cc = 0; cc < cc_buffers; cc++)
+        {
+            ASSERT_TRUE(e.consume(&(b[0]), &(b[b.size() - 1]) + 1));
+            bytes_sent += b.size();
+        }
+        // reader goes away in the middle, not at a buffer boundary
+        m_reader = std::thread([this, bytes_read]()
+            {
+                uint8_t buf[4096];
+                ssize_t n;
+                while (m_received.size() < bytes_read && (n = read(m_fds[0], buf, std::min(sizeof(buf), bytes_read - m_received.size()))) > 0)
+                    m_received.insert(m_received.end(), buf, buf + n);
+                close(m_fds[0]);
+                m_fds[0] = -1;
+            });
+        m_reader.join();
+
+        e.flush(); // errors may come before it
+        const auto m = e.metrics();
+        ASSERT_NE(uint64_t{ 0 }, m.m_write_errors);
+        ASSERT_NE(uint64_t{ 0 }, m.m_bytes_dropped);
+        // bytes left in the pipe were written, bytes read were written for sure
+        ASSERT_LE(uint64_t(m_received.size()), m.m_bytes_written);
+        ASSERT_EQ(bytes_sent, m.m_bytes_written + m.m_bytes_dropped);
+        ASSERT_EQ(uint64_t{ 0 }, m.m_bytes_in_flight);
+    }
+}
+
+struct neutrino_socket_tests : public ::testing::Test
+{
+    std::shared_ptr<neutrino::mock::frames_collector_t> m_collector{ std::make_shared<neutrino::mock::frames_collector_t>() };
+    std::string m_path{ std::string("/tmp/neutrino_ut_").append(std::to_string(getpid())).append(".sock") };
+
+    transport::socket_acceptor_t::connection_endpoint_factory_t factory()
+    {
+        auto collector = m_collector;
+        return [collector]() { return collector; };
+    }
+
+    std::size_t received()
+    {
+        std::lock_guard<std::mutex> lk(m_collector->m_m);
+        return m_collector->m_sumbissions.size();
+    }
+
+    void wait_received(std::size_t cc_records)
+    {
+        for (std::size_t cc = 0; cc < 5000 && received() < cc_records; cc++)
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+
+    // every record is delivered as sent, in order
+    void validate_records(const std::vector<const std::vector<uint8_t>*>& expected)
+    {
+        wait_received(expected.size());
+        std::lock_guard<std::mutex> lk(m_collector->m_m);
+        ASSERT_EQ(expected.size(), m_collector->m_sumbissions.size());
+        auto it = m_collector->m_sumbissions.begin();
+        for (std::size_t cc = 0; cc < expected.size(); cc++, ++it)
+            ASSERT_EQ(*expected[cc], it->m_buffer) << "record # " << cc;
+        m_collector->m_sumbissions.clear();
+    }
+
+    void validate_roundtrip(transport::socket::kind_t kind, const std::string& address)
+    {
+        transport::socket_acceptor_t::socket_acceptor_params_t apo;
+        apo.m_kind = kind;
+        apo.m_address = address;
+        transport::socket_acceptor_t a(apo, factory());
+        ASSERT_TRUE(a.valid());
+
+        transport::socket_endpoint_t::socket_endpoint_params_t spo;
+        spo.m_kind = kind;
+        spo.m_address = kind == transport::socket::kind_t::TCP ? std::string("127.0.0.1:").append(std::to_string(a.port())) : address;
+        transport::socket_endpoint_t e(spo);
+
+        std::vector<const std::vector<uint8_t>*> expected;
+        for (std::size_t cc = 0; cc < 2000; cc++)
+        {
+            const auto& b = test_buffers[std::rand() % test_buffers.size()];
+            ASSERT_TRUE(e.consume(&(b[0]), &(b[b.size() - 1]) + 1));
+            expected.push_back(&b);
+        }
+        ASSERT_TRUE(e.flush(std::chrono::milliseconds(5000)));
+        validate_records(expected);
+
+        const auto m = e.metrics();
+        ASSERT_TRUE(m.m_connected);
+        ASSERT_EQ(uint64_t{ 1 }, m.m_connects);
+        ASSERT_EQ(uint64_t{ 0 }, m.m_bytes_dropped);
+        ASSERT_EQ(uint64_t{ 0 }, m.m_backlog_bytes);
+    }
+};
+
+TEST_F(neutrino_socket_tests, unix_stream_roundtrip)
+{
+    validate_roundtrip(transport::socket::kind_t::UNIX_STREAM, m_path);
+}
+
+TEST_F(neutrino_socket_tests, unix_seqpacket_roundtrip)
+{
+    validate_roundtrip(transport::socket::kind_t::UNIX_SEQPACKET, m_path);
+}
+
+TEST_F(neutrino_socket_tests, tcp_roundtrip)
+{
+    validate_roundtrip(transport::socket::kind_t::TCP, "127.0.0.1:0");
+}
+
+TEST_F(neutrino_socket_tests, reconnect_with_backlog)
+{
+    transport::socket_endpoint_t::socket_endpoint_params_t spo;
+    spo.m_address = m_path;
+    spo.m_reconnect_period = std::chrono::milliseconds(10);
+    transport::socket_endpoint_t e(spo);
+
+    // no acceptor yet, records wait in the backlog
+    std::vector<const std::vector<uint8_t>*> expected;
+    for (std::size_t cc = 0; cc < 100; cc++)
+    {
+        const auto& b = test_buffers[cc];
+        ASSERT_TRUE(e.consume(&(b[0]), &(b[b.size() - 1]) + 1));
+        expected.push_back(&b);
+    }
+    std::this_thread::sleep_for(std::chrono::milliseconds(50));
+    ASSERT_FALSE(e.metrics().m_connected);
+
+    transport::socket_acceptor_t::socket_acceptor_params_t apo;
+    apo.m_address = m_path;
+    transport::socket_acceptor_t a(apo, factory());
+    ASSERT_TRUE(a.valid());
+
+    ASSERT_TRUE(e.flush(std::chrono::milliseconds(5000)));
+    validate_records(expected);
+}
+
+TEST_F(neutrino_socket_tests, record_split_across_reads)
+{
+    transport::socket_acceptor_t::socket_acceptor_params_t apo;
+    apo.m_address = m_path;
+    transport::socket_acceptor_t a(apo, factory());
+    ASSERT_TRUE(a.valid());
+
+    const int fd = ::socket(AF_UNIX, SOCK_STREAM, 0);
+    sockaddr_un sa{};
+    sa.sun_family = AF_UNIX;
+    ASSERT_LT(m_path.size(), sizeof(sa.sun_path));
+    std::memcpy(sa.sun_path, m_path.c_str(), m_path.size() + 1);
+    ASSERT_EQ(0, connect(fd, reinterpret_cast<sockaddr*>(&sa), sizeof(sa)));
+
+    // two records sent byte by byte
+    std::vector<uint8_t> wire;
+    std::vector<const std::vector<uint8_t>*> expected{ &test_buffers[9], &test_buffers[199] };
+    for (const auto* b : expected)
+    {
+        const transport::socket::record_len_t len = htonl(transport::socket::record_len_t(b->size()));
+        wire.insert(wire.end(), reinterpret_cast<const uint8_t*>(&len), reinterpret_cast<const uint8_t*>(&len) + sizeof(len));
+        wire.insert(wire.end(), b->begin(), b->end());
+    }
+    for (auto c : wire)
+    {
+        ASSERT_EQ(1, write(fd, &c, 1));
+        if (received() == 0)
+            std::this_thread::sleep_for(std::chrono::microseconds(100));
+    }
+
+    validate_records(expected);
+    close(fd);
+}
+
+TEST_F(neutrino_socket_tests, records_refused_by_endpoint)
+{
+    transport::socket_acceptor_t::socket_acceptor_params_t apo;
+    apo.m_address = m_path;
+    transport::socket_acceptor_t a(apo, []() { return std::make_shared<transport::endpoint_t>(); }); // refuses everything
+    ASSERT_TRUE(a.valid());
+
+    transport::socket_endpoint_t::socket_endpoint_params_t spo;
+    spo.m_address = m_path;
+    transport::socket_endpoint_t e(spo);
+    for (std::size_t cc = 0; cc < 3; cc++)
+    {
+        const auto& b = test_buffers[cc];
+        ASSERT_TRUE(e.consume(&(b[0]), &(b[b.size() - 1]) + 1));
+    }
+    ASSERT_TRUE(e.flush(std::chrono::milliseconds(5000)));
+
+    for (std::size_t cc = 0; cc < 5000 && a.records() < 3; cc++)
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    ASSERT_EQ(uint64_t{ 3 }, a.records());
+    ASSERT_EQ(uint64_t{ 3 }, a.records_refused());
+}
+
+TEST_F(neutrino_socket_tests, peer_dropped_mid_batch)
+{
+    // records larger than the socket buffer, the batch breaks after some of them are written whole
+    const std::size_t cc_records = 16;
+    std::vector<std::vector<uint8_t>> records;
+    for (std::size_t cc = 0; cc < cc_records; cc++)
+        records.emplace_back(64 * 1024, uint8_t(cc));
+
+    const int listen_fd = ::socket(AF_UNIX, SOCK_STREAM, 0);
+    sockaddr_un sa{};
+    sa.sun_family = AF_UNIX;
+    ASSERT_LT(m_path.size(), sizeof(sa.sun_path));
+    std::memcpy(sa.sun_path, m_path.c_str(), m_path.size() + 1);
+    unlink(m_path.c_str());
+    ASSERT_EQ(0, bind(listen_fd, reinterpret_cast<sockaddr*>(&sa), sizeof(sa)));
+    ASSERT_EQ(0, listen(listen_fd, 1));
+
+    // first peer reads two records and goes away
+    std::vector<uint8_t> first_peer;
+    std::thread peer([listen_fd, &first_peer, this]()
+        {
+            const int fd = accept(listen_fd, nullptr, nullptr);
+            close(listen_fd);
+            unlink(m_path.c_str());
+            for (std::size_t cc = 0; fd >= 0 && cc < 2; cc++)
+            {
+                transport::socket::record_len_t len;
+                std::vector<uint8_t> b(sizeof(len));
+                for (std::size_t got = 0; got < b.size(); )
+                {
+                    const auto r = read(fd, b.data() + got, b.size() - got);
+                    if (r <= 0)
+                        return;
+                    got += r;
+                    if (got == sizeof(len) && b.size() == sizeof(len))
+                    {
+                        std::memcpy(&len, b.data(), sizeof(len));
+                        b.resize(sizeof(len) + ntohl(len));
+                    }
+                }
+                first_peer.push_back(b.back());
+            }
+            close(fd);
+        });
+
+    transport::socket_endpoint_t::socket_endpoint_params_t spo;
+    spo.m_address = m_path;
+    spo.m_reconnect_period = std::chrono::milliseconds(10);
+    transport::socket_endpoint_t e(spo);
+    for (const auto& b : records)
+        ASSERT_TRUE(e.consume(&(b[0]), &(b[b.size() - 1]) + 1));
+    peer.join();
+    ASSERT_EQ((std::vector<uint8_t>{ 0, 1 }), first_peer);
+
+    transport::socket_acceptor_t::socket_acceptor_params_t apo;
+    apo.m_address = m_path;
+    transport::socket_acceptor_t a(apo, factory());
+    ASSERT_TRUE(a.valid());
+    ASSERT_TRUE(e.flush(std::chrono::milliseconds(5000)));
+    auto last_received = [this]()
+    {
+        std::lock_guard<std::mutex> lk(m_collector->m_m);
+        return m_collector->m_sumbissions.empty() ? 0 : int(m_collector->m_sumbissions.back().m_buffer.front());
+    };
+    for (std::size_t cc = 0; cc < 5000 && last_received() != int(cc_records - 1); cc++)
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+
+    // second peer gets what was not written whole to the first one: a tail of the records, none of them again
+    std::lock_guard<std::mutex> lk(m_collector->m_m);
+    ASSERT_FALSE(m_collector->m_sumbissions.empty());
+    ASSERT_GT(m_collector->m_sumbissions.front().m_buffer.front(), first_peer.back());
+    uint8_t next = m_collector->m_sumbissions.front().m_buffer.front();
+    for (const auto& submission : m_collector->m_sumbissions)
+        ASSERT_EQ(records[next++], submission.m_buffer);
+    ASSERT_EQ(cc_records, std::size_t(next));
+    ASSERT_EQ(uint64_t{ 1 }, e.metrics().m_disconnects);
+}
+
+struct neutrino_journal_tests : public ::testing::Test
+{
+    neutrino::mock::frames_collector_t m_collector;
+    std::string m_path{ std::string("/tmp/neutrino_ut_journal_").append(std::to_string(getpid())) };
+
+    void TearDown() final
+    {
+        for (uint64_t seq = 0; unlink(transport::journal::segment_path(m_path, seq).c_str()) == 0; seq++)
+            ;
+    }
+
+    void validate_records(const std::vector<const std::vector<uint8_t>*>& expected)
+    {
+        ASSERT_EQ(expected.size(), m_collector.m_sumbissions.size());
+        auto it = m_collector.m_sumbissions.begin();
+        for (std::size_t cc = 0; cc < expected.size(); cc++, ++it)
+            ASSERT_EQ(*expected[cc], it->m_buffer) << "record # " << cc;
+        m_collector.m_sumbissions.clear();
+    }
+};
+
+TEST_F(neutrino_journal_tests, rollover_and_replay)
+{
+    transport::journal_endpoint_t::journal_params_t po;
+    po.m_path = m_path;
+    po.m_segment_size = 4096;
+    po.m_encoding = transport::frame_v00::known_encodings_t::BINARY_NETWORK;
+    po.m_producer_id = "ut producer";
+
+    std::vector<const std::vector<uint8_t>*> expected;
+    {
+        transport::journal_endpoint_t e(po);
+        ASSERT_TRUE(e.valid());
+        for (std::size_t cc = 0; cc < 200; cc++)
+        {
+            const auto& b = test_buffers[std::rand() % test_buffers.size()];
+            ASSERT_TRUE(e.consume(&(b[0]), &(b[b.size() - 1]) + 1));
+            expected.push_back(&b);
+        }
+        ASSERT_NE(uint64_t{ 0 }, e.segment_seq());
+        ASSERT_TRUE(e.flush());
+    }
+
+    transport::journal_reader_t r(m_path);
+    uint64_t seq = 0;
+    while (r.next_segment())
+    {
+        ASSERT_EQ(seq++, r.header()->m_segment_seq);
+        ASSERT_EQ(static_cast<uint32_t>(transport::frame_v00::known_encodings_t::BINARY_NETWORK), r.header()->m_encoding);
+        ASSERT_STREQ("ut producer", r.header()->m_producer_id);
+        ASSERT_EQ(uint32_t{ 1 }, r.header()->m_sealed.load());
+        r.replay(m_collector);
+    }
+    ASSERT_TRUE(seq > 1);
+    validate_records(expected);
+}
+
+TEST_F(neutrino_journal_tests, readable_while_writer_is_alive)
+{
+    transport::journal_endpoint_t::journal_params_t po;
+    po.m_path = m_path;
+    po.m_segment_size = 64 * 1024;
+
+    // writer never closes the segment, as if the process died
+    std::unique_ptr<transport::journal_endpoint_t> e(new transport::journal_endpoint_t(po));
+    ASSERT_TRUE(e->valid());
+
+    transport::journal_reader_t r(m_path);
+    ASSERT_TRUE(r.next_segment());
+    ASSERT_EQ(uint32_t{ 0 }, r.header()->m_sealed.load());
+
+    std::vector<const std::vector<uint8_t>*> expected;
+    for (std::size_t cc = 0; cc < 10; cc++)
+    {
+        const auto& b = test_buffers[cc];
+        ASSERT_TRUE(e->consume(&(b[0]), &(b[b.size() - 1]) + 1));
+        expected.push_back(&b);
+        if (cc == 4)
+        {
+            ASSERT_EQ(std::size_t{ 5 }, r.replay(m_collector));
+        }
+    }
+    ASSERT_EQ(std::size_t{ 5 }, r.replay(m_collector));
+    validate_records(expected);
+}
+
+TEST_F(neutrino_journal_tests, new_run_keeps_previous_segments)
+{
+    transport::journal_endpoint_t::journal_params_t po;
+    po.m_path = m_path;
+    po.m_segment_size = 64 * 1024;
+
+    // first run is never closed, as if the process died
+    std::unique_ptr<transport::journal_endpoint_t> first(new transport::journal_endpoint_t(po));
+    ASSERT_TRUE(first->valid());
+    std::vector<const std::vector<uint8_t>*> expected;
+    for (std::size_t cc = 0; cc < 5; cc++)
+    {
+        const auto& b = test_buffers[cc];
+        ASSERT_TRUE(first->consume(&(b[0]), &(b[b.size() - 1]) + 1));
+        expected.push_back(&b);
+    }
+
+    transport::journal_endpoint_t second(po);
+    ASSERT_TRUE(second.valid()) << second.error();
+    ASSERT_EQ(uint64_t{ 1 }, second.segment_seq());
+    for (std::size_t cc = 5; cc < 10; cc++)
+    {
+        const auto& b = test_buffers[cc];
+        ASSERT_TRUE(second.consume(&(b[0]), &(b[b.size() - 1]) + 1));
+        expected.push_back(&b);
+    }
+
+    transport::journal_reader_t r(m_path);
+    ASSERT_TRUE(r.next_segment());
+    ASSERT_EQ(uint32_t{ 1 }, r.header()->m_sealed.load()); // by the second run
+    ASSERT_EQ(std::size_t{ 5 }, r.replay(m_collector));
+    ASSERT_TRUE(r.next_segment());
+    ASSERT_EQ(uint64_t{ 1 }, r.header()->m_segment_seq);
+    ASSERT_EQ(std::size_t{ 5 }, r.replay(m_collector));
+    validate_records(expected);
+}
+
+TEST_F(neutrino_journal_tests, damaged_record_skips_published)
+{
+    transport::journal_endpoint_t::journal_params_t po;
+    po.m_path = m_path;
+    po.m_segment_size = 64 * 1024;
+    transport::journal_endpoint_t e(po);
+    ASSERT_TRUE(e.valid());
+
+    const auto& b = test_buffers[9]; // 10 bytes of symbol 10
+    for (std::size_t cc = 0; cc < 3; cc++)
+        ASSERT_TRUE(e.consume(&(b[0]), &(b[b.size() - 1]) + 1));
+
+    transport::journal_reader_t r(m_path);
+    ASSERT_TRUE(r.next_segment());
+
+    // length of the second record goes past what is published
+    typedef transport::journal::segment_header_t::record_len_t record_len_t;
+    const record_len_t bad = 1000;
+    const int fd = open(transport::journal::segment_path(m_path, 0).c_str(), O_WRONLY);
+    ASSERT_LE(0, fd);
+    ASSERT_EQ(ssize_t(sizeof(bad)), pwrite(fd, &bad, sizeof(bad), r.header()->m_header_size + sizeof(record_len_t) + b.size()));
+    close(fd);
+
+    ASSERT_EQ(std::size_t{ 1 }, r.replay(m_collector));
+    validate_records({ &b });
+    ASSERT_EQ(uint64_t{ 1 }, r.metrics().m_damaged);
+    ASSERT_EQ(uint64_t{ 2 * (sizeof(record_len_t) + b.size()) }, r.metrics().m_bytes_skipped);
+
+    // records published after it are read
+    ASSERT_TRUE(e.consume(&(b[0]), &(b[b.size() - 1]) + 1));
+    ASSERT_EQ(std::size_t{ 1 }, r.replay(m_collector));
+    validate_records({ &b });
+    ASSERT_EQ(uint64_t{ 2 }, r.metrics().m_records);
+}
+#endif
+
+namespace
+{
+    struct checkpoints_counter_t : public transport::consumer_t
+    {
+        std::vector<local::payload::event_id_t::type_t> m_event_ids;
+
+        void consume_checkpoint(
+            const local::payload::nanoepoch_t::type_t&
+            , const local::payload::stream_id_t::type_t&
+            , const local::payload::event_id_t::type_t& event_id
+        ) final
+        {
+            m_event_ids.push_back(event_id);
+        }
+    };
+}
+
+TEST(neutrino_framed_tests, crc32c)
+{
+    const char s[] = "123456789";
+    const uint8_t* p = reinterpret_cast<const uint8_t*>(s);
+    ASSERT_EQ(uint32_t{ 0xE3069283 }, transport::framed::crc32c(0, p, p + 9));
+    ASSERT_EQ(uint32_t{ 0xE3069283 }, transport::framed::crc32c(transport::framed::crc32c(0, p, p + 4), p + 4, p + 9));
+    ASSERT_EQ(uint32_t{ 0xE3069283 }, transport::framed::crc32c_scalar(0, p, p + 9));
+}
+
+TEST(neutrino_framed_tests, crc32c_instruction_matches_table)
+{
+#if (defined(__x86_64__) || defined(__i386__)) && !defined(_MSC_VER)
+    __builtin_cpu_init();
+    ASSERT_EQ(bool(__builtin_cpu_supports("sse4.2")), transport::framed::crc32c_sse42());
+#endif
+    std::mt19937 rnd(5);
+    std::vector<uint8_t> b(300);
+    for (auto& c : b)
+        c = uint8_t(rnd());
+    // unaligned starts, lengths with and without a tail after the 8 byte steps
+    for (std::size_t at = 0; at < 8; at++)
+    {
+        for (std::size_t n = 0; at + n <= b.size(); n += 5)
+        {
+            const uint32_t seed = uint32_t(rnd());
+            ASSERT_EQ(transport::framed::crc32c_scalar(seed, &b[at], &b[at] + n), transport::framed::crc32c(seed, &b[at], &b[at] + n));
+        }
+    }
+}
+
+TEST(neutrino_framed_tests, skip_unknown_and_resync_after_corruption)
+{
+    neutrino::mock::concat_endpoint_t wire;
+    transport::framed_endpoint_t::framed_params_t po;
+    po.m_kind = transport::frame_v00::known_encodings_t::BINARY_NETWORK;
+    transport::framed_endpoint_t framed(po, wire);
+    auto stub = transport::frame_v00::create_consumer_stub(po.m_kind, framed);
+
+    po.m_kind = static_cast<transport::frame_v00::known_encodings_t>(200);
+    transport::framed_endpoint_t framed_unknown(po, wire);
+
+    std::vector<std::size_t> record_start;
+    for (local::payload::event_id_t::type_t cc = 0; cc < 50; cc++)
+    {
+        record_start.push_back(wire.m_data.size());
+        stub->consume_checkpoint(1000 + cc, 1, cc);
+        if (cc == 20)
+        {
+            const uint8_t future[] = { 1, 2, 3, 4, 5 };
+            ASSERT_TRUE(framed_unknown.consume(future, future + sizeof(future)));
+        }
+        if (cc == 30)
+            wire.m_data.insert(wire.m_data.end(), { 0xF7, 0x4E, 0xF7, 0, 0xF7 }); // garbage with a false magic
+    }
+    wire.m_data[record_start[10] + transport::framed::header_size + 9] ^= 0x40; // payload of 11th record
+
+    checkpoints_counter_t consumer;
+    transport::deframer_endpoint_t deframer(transport::deframer_endpoint_t::deframer_params_t{}, consumer);
+    ASSERT_FALSE(deframer.consume(wire.m_data.data(), wire.m_data.data() + wire.m_data.size()));
+
+    ASSERT_EQ(std::size_t{ 49 }, consumer.m_event_ids.size());
+    ASSERT_EQ(local::payload::event_id_t::type_t{ 11 }, consumer.m_event_ids[10]);
+    ASSERT_EQ(local::payload::event_id_t::type_t{ 49 }, consumer.m_event_ids.back());
+
+    const auto& m = deframer.metrics();
+    ASSERT_EQ(uint64_t{ 50 }, m.m_records); // 49 + unknown
+    ASSERT_EQ(uint64_t{ 1 }, m.m_records_unknown);
+    ASSERT_EQ(uint64_t{ 1 }, m.m_records_corrupt);
+    ASSERT_EQ(uint64_t{ 0 }, m.m_records_refused);
+    ASSERT_EQ(uint64_t{ 2 }, m.m_resyncs); // corrupt record, garbage starting with a false magic
+    ASSERT_EQ(uint64_t{ transport::framed::header_size + 26 + 5 }, m.m_bytes_dropped);
+
+    // record cut at the end of the input waits for its rest
+    checkpoints_counter_t consumer2;
+    transport::deframer_endpoint_t deframer2(transport::deframer_endpoint_t::deframer_params_t{}, consumer2);
+    ASSERT_TRUE(deframer2.consume(wire.m_data.data(), wire.m_data.data() + record_start[5] + 7));
+    ASSERT_EQ(std::size_t{ 5 }, consumer2.m_event_ids.size());
+    ASSERT_EQ(uint64_t{ 0 }, deframer2.metrics().m_bytes_dropped);
+    ASSERT_TRUE(deframer2.consume(wire.m_data.data() + record_start[5] + 7, wire.m_data.data() + record_start[6]));
+    ASSERT_EQ(std::size_t{ 6 }, consumer2.m_event_ids.size());
+    ASSERT_EQ(local::payload::event_id_t::type_t{ 5 }, consumer2.m_event_ids.back());
+
+    // reads cut anywhere, corrupt record and garbage included, give what one read gives
+    for (std::size_t step = 1; step < 40; step += 6)
+    {
+        SCOPED_TRACE(step);
+        checkpoints_counter_t consumer3;
+        transport::deframer_endpoint_t deframer3(transport::deframer_endpoint_t::deframer_params_t{}, consumer3);
+        for (std::size_t at = 0, cc = 0; at < wire.m_data.size(); cc++)
+        {
+            const std::size_t b = std::min(wire.m_data.size() - at, 1 + (cc * step) % 29);
+            deframer3.consume(wire.m_data.data() + at, wire.m_data.data() + at + b);
+            at += b;
+        }
+        ASSERT_EQ(consumer.m_event_ids, consumer3.m_event_ids);
+        const auto& m3 = deframer3.metrics();
+        ASSERT_EQ(m.m_records, m3.m_records);
+        ASSERT_EQ(m.m_records_unknown, m3.m_records_unknown);
+        ASSERT_EQ(m.m_records_corrupt, m3.m_records_corrupt);
+        ASSERT_EQ(m.m_bytes_dropped, m3.m_bytes_dropped);
+    }
+}
+
+#if (USE_MT)
+TEST_F(neutrino_buffered_endpoints_tests, buffered_mt)
+{
+    ADD_FAILURE();
+}
 #endif
\ No newline at end of file
@@ -1,219 +1,1190 @@
-#include <gtest/gtest.h>
-#include <thread>
-#include <neutrino_mock.hpp>
-
-#include <neutrino_producer.hpp>
-
-#include <neutrino_transport_buffered_mt.hpp>
-#include <neutrino_transport_buffered_st.hpp>
-
-using namespace neutrino::impl;
-
-namespace
-{
-    const uint64_t checkpoint_id_1 = 1;
-    const uint64_t checkpoint_id_2 = 2;
-    const uint64_t checkpoint_id_3 = 3;
-    const uint64_t checkpoint_id_4 = 4;
-
-    const uint64_t context_id_1 = 3;
-    const uint64_t context_id_2 = 4;
-
-    const uint64_t stream_id_1 = 301;
-    const uint64_t stream_id_2 = 302;
-
-    struct named_buffered_endpoint_params_t
-    {
-        transport::buffered_endpoint_t::buffered_endpoint_params_t m_params;
-        std::string m_name;
-    };
-
-    const static auto test_params = []()
-    {
-        return std::vector<named_buffered_endpoint_params_t>{
-            { {1000, 1}, "1000/1"}
-            , { {1000, 500}, "1000/500" }
-                , { {1000, 750}, "1000/750" }
-                , { {1000, 999}, "1000/999" }
-                , { {1000, 1000}, "1000/1000" }
-                , { {1000, 1001}, "1000/1001" }
-                , { {1000, 1100}, "1000/1100" }
-        };
-    }();
-
-    struct named_buffered_optimistic_endpoint_params_t
-    {
-        transport::buffered_optimistic_endpoint_t::buffered_optimistic_consumer_params_t m_params;
-        std::string m_name;
-    };
-
-    const static auto test_optimistic_params = []()
-    {
-        return std::vector<named_buffered_optimistic_endpoint_params_t>{
-            { 1, "1"}
-            , { {100}, "100" }
-            , { {1000}, "1000" }
-        };
-    }();
-}
-
-using namespace neutrino::impl;
-
-struct neutrino_general_with_transport_workflow_tests : public ::testing::Test
-{
-    struct dummy_exception
-    {
-    };
-
-    static void run_transaction(neutrino::impl::local::payload::stream_id_t::type_t stream_id)
-    {
-        neutrino_checkpoint(neutrino_nanoepoch(), stream_id, checkpoint_id_1);
-        {
-            neutrino::helpers::context_t ctx(stream_id, context_id_1);
-            try
-            {
-                neutrino::helpers::context_t ctx(stream_id, context_id_2);
-                throw dummy_exception{};
-            }
-            catch(const dummy_exception&)
-            {
-                neutrino_checkpoint(neutrino_nanoepoch(), stream_id, checkpoint_id_2);
-            }
-            neutrino_checkpoint(neutrino_nanoepoch(), stream_id, checkpoint_id_3);
-        }
-        neutrino_checkpoint(neutrino_nanoepoch(), stream_id, checkpoint_id_4);
-    }
-
-    typedef std::function<std::shared_ptr<transport::endpoint_t>(std::shared_ptr<transport::endpoint_t>)> buffered_endpoint_factory_t;
-
-    template <transport::frame_v00::known_encodings_t transport_encoding>
-    struct channel_t
-    {
-        std::shared_ptr<transport::endpoint_impl_t> m_endpoint_impl;
-
-        std::shared_ptr<transport::endpoint_t> m_endpoint;
-
-        std::shared_ptr<neutrino::mock::connection_t<neutrino::impl::transport::endpoint_impl_t>> m_connection;
-        std::shared_ptr<transport::consumer_stub_t> m_consumer_stub;
-
-        std::shared_ptr<neutrino::impl::transport::consumer_stub_t> m_prev_consumer;
-
-        channel_t(buffered_endpoint_factory_t buffered_endpoint_factory, neutrino::mock::consumer_t& consumer)
-        {
-            // deserialises from raw and forwards frames to consumer
-            m_endpoint_impl = transport::frame_v00::create_endpoint_impl(transport_encoding, consumer);
-
-            // collects raw frames and forwards to endpoint impl
-            m_connection.reset(new neutrino::mock::connection_t<neutrino::impl::transport::endpoint_impl_t>(*m_endpoint_impl));
-
-            m_endpoint = buffered_endpoint_factory(m_connection);
-
-            // serializes frames to raw and forwards to endpoint
-            m_consumer_stub = transport::frame_v00::create_consumer_stub(
-                transport_encoding, *m_endpoint);
-
-            // istall consumer, API will call it
-            m_prev_consumer = producer::set_consumer(m_consumer_stub);
-        }
-        ~channel_t()
-        {
-            // restore just in case
-            producer::set_consumer(m_prev_consumer);
-        }
-
-    };
-
-    std::shared_ptr<neutrino::mock::consumer_t> m_mock_consumer;
-
-    void SetUp() final
-    {
-    }
-
-    void TearDown() final
-    {
-    }
-
-    template <transport::frame_v00::known_encodings_t transport_encoding>
-    void validate_transaction_singlethread(std::function<std::shared_ptr<transport::endpoint_t>(std::shared_ptr<transport::endpoint_t> endpoint)>f)
-    {
-        SCOPED_TRACE(__FUNCTION__);
-        // events sequence corresponds to run_transaction impl
-        m_mock_consumer.reset(new neutrino::mock::consumer_t());
-        m_mock_consumer->
-            expect_checkpoint(0, stream_id_1, checkpoint_id_1)
-            .expect_context_enter(0, stream_id_1, context_id_1)
-            .expect_context_enter(0, stream_id_1, context_id_2)
-            .expect_context_panic(0, stream_id_1, context_id_2)
-            .expect_checkpoint(0, stream_id_1, checkpoint_id_2)
-            .expect_checkpoint(0, stream_id_1, checkpoint_id_3)
-            .expect_context_leave(0, stream_id_1, context_id_1)
-            .expect_checkpoint(0, stream_id_1, checkpoint_id_4)
-            ;
-
-        channel_t<transport_encoding> channel(f, *m_mock_consumer);
-
-        try
-        {
-            run_transaction(stream_id_1);
-
-            // expect flush at the very end of simulated app operations 
-            neutrino_flush();
-        }
-        catch(const std::exception& e)
-        {
-            ADD_FAILURE() << e.what();
-        }
-
-        ASSERT_EQ(std::size_t{0}, m_mock_consumer->m_expected_checkpoints.size());
-        ASSERT_EQ(std::size_t{0}, m_mock_consumer->m_expected_contexts.size());
-        m_mock_consumer.reset();
-    }
-
-    void validate_transaction_singlethread_transport_options(std::function<std::shared_ptr<transport::endpoint_t>(std::shared_ptr<transport::endpoint_t>)>f)
-    {
-        SCOPED_TRACE(__FUNCTION__);
-
-        validate_transaction_singlethread<transport::frame_v00::known_encodings_t::BINARY_NATIVE>(f);
-        validate_transaction_singlethread<transport::frame_v00::known_encodings_t::BINARY_NETWORK>(f);
-        //validate_transaction_singlethread<transport::frame_v00::known_encodings_t::JSON>(ep_factory);
-    }
-};
-
-TEST_F(neutrino_general_with_transport_workflow_tests, transaction_singlethread)
-{
-    for(const auto& po : test_params)
-    {
-        SCOPED_TRACE(po.m_name);
-        {
-            SCOPED_TRACE("buffered_singlethread_endpoint_t");
-            validate_transaction_singlethread_transport_options(
-                [po](std::shared_ptr<transport::endpoint_t> chained_endpoint)
-                {
-                    return std::shared_ptr<transport::endpoint_t>(new transport::buffered_singlethread_endpoint_t(chained_endpoint, po.m_params));
-                }
-            );
-        }
-        {
-            SCOPED_TRACE("buffered_exclusive_endpoint_t");
-            validate_transaction_singlethread_transport_options(
-                [po](std::shared_ptr<transport::endpoint_t> chained_endpoint)
-                {
-                    return std::shared_ptr<transport::endpoint_t>(new transport::buffered_exclusive_endpoint_t(chained_endpoint, po.m_params));
-                }
-            );
-        }
-        {
-            SCOPED_TRACE("buffered_optimistic_endpoint_t");
-            for (const auto& opo : test_optimistic_params)
-            {
-                SCOPED_TRACE(opo.m_name);
-                validate_transaction_singlethread_transport_options(
-                    [opo, po](std::shared_ptr<transport::endpoint_t> chained_endpoint)
-                    {
-                        return std::shared_ptr<transport::endpoint_t>(new transport::buffered_optimistic_endpoint_t(chained_endpoint, po.m_params, opo.m_params));
-                    }
-                );
-            }
-        }
-    }
-}
+#include <gtest/gtest.h>
+#include <thread>
+#include <atomic>
+#include <chrono>
+#include <iostream>
+#include <algorithm>
+#include <map>
+#include <random>
+#include <neutrino_mock.hpp>
+
+#include <neutrino_producer.hpp>
+
+#include <neutrino_transport_buffered_mt.hpp>
+#include <neutrino_transport_buffered_st.hpp>
+#include <neutrino_producer_pipeline.hpp>
+#include <neutrino_consumer.hpp>
+#include <neutrino_consumer_sharded.hpp>
+
+using namespace neutrino::impl;
+
+namespace
+{
+    const uint64_t checkpoint_id_1 = 1;
+    const uint64_t checkpoint_id_2 = 2;
+    const uint64_t checkpoint_id_3 = 3;
+    const uint64_t checkpoint_id_4 = 4;
+
+    const uint64_t context_id_1 = 3;
+    const uint64_t context_id_2 = 4;
+
+    const uint64_t stream_id_1 = 301;
+    const uint64_t stream_id_2 = 302;
+
+    struct named_buffered_endpoint_params_t
+    {
+        transport::buffered_endpoint_t::buffered_endpoint_params_t m_params;
+        std::string m_name;
+    };
+
+    const static auto test_params = []()
+    {
+        return std::vector<named_buffered_endpoint_params_t>{
+            { {1000, 1}, "1000/1"}
+            , { {1000, 500}, "1000/500" }
+                , { {1000, 750}, "1000/750" }
+                , { {1000, 999}, "1000/999" }
+                , { {1000, 1000}, "1000/1000" }
+                , { {1000, 1001}, "1000/1001" }
+                , { {1000, 1100}, "1000/1100" }
+        };
+    }();
+
+    struct named_buffered_optimistic_endpoint_params_t
+    {
+        transport::buffered_optimistic_endpoint_t::buffered_optimistic_consumer_params_t m_params;
+        std::string m_name;
+    };
+
+    const static auto test_optimistic_params = []()
+    {
+        return std::vector<named_buffered_optimistic_endpoint_params_t>{
+            { 1, "1"}
+            , { {100}, "100" }
+            , { {1000}, "1000" }
+        };
+    }();
+}
+
+using namespace neutrino::impl;
+
+struct neutrino_general_with_transport_workflow_tests : public ::testing::Test
+{
+    struct dummy_exception
+    {
+    };
+
+    static void run_transaction(neutrino::impl::local::payload::stream_id_t::type_t stream_id)
+    {
+        neutrino_checkpoint(neutrino_nanoepoch(), stream_id, checkpoint_id_1);
+        {
+            neutrino::helpers::context_t ctx(stream_id, context_id_1);
+            try
+            {
+                neutrino::helpers::context_t ctx(stream_id, context_id_2);
+                throw dummy_exception{};
+            }
+            catch(const dummy_exception&)
+            {
+                neutrino_checkpoint(neutrino_nanoepoch(), stream_id, checkpoint_id_2);
+            }
+            neutrino_checkpoint(neutrino_nanoepoch(), stream_id, checkpoint_id_3);
+        }
+        neutrino_checkpoint(neutrino_nanoepoch(), stream_id, checkpoint_id_4);
+    }
+
+    typedef std::function<std::shared_ptr<transport::endpoint_t>(std::shared_ptr<transport::endpoint_t>)> buffered_endpoint_factory_t;
+
+    template <transport::frame_v00::known_encodings_t transport_encoding>
+    struct channel_t
+    {
+        std::shared_ptr<transport::endpoint_impl_t> m_endpoint_impl;
+
+        std::shared_ptr<transport::endpoint_t> m_endpoint;
+
+        std::shared_ptr<neutrino::mock::connection_t<neutrino::impl::transport::endpoint_impl_t>> m_connection;
+        std::shared_ptr<transport::consumer_stub_t> m_consumer_stub;
+
+        std::shared_ptr<neutrino::impl::transport::consumer_stub_t> m_prev_consumer;
+
+        channel_t(buffered_endpoint_factory_t buffered_endpoint_factory, neutrino::mock::consumer_t& consumer)
+        {
+            // deserialises from raw and forwards frames to consumer
+            m_endpoint_impl = transport::frame_v00::create_endpoint_impl(transport_encoding, consumer);
+
+            // collects raw frames and forwards to endpoint impl
+            m_connection.reset(new neutrino::mock::connection_t<neutrino::impl::transport::endpoint_impl_t>(*m_endpoint_impl));
+
+            m_endpoint = buffered_endpoint_factory(m_connection);
+
+            // serializes frames to raw and forwards to endpoint
+            m_consumer_stub = transport::frame_v00::create_consumer_stub(
+                transport_encoding, *m_endpoint);
+
+            // istall consumer, API will call it
+            m_prev_consumer = producer::set_consumer(m_consumer_stub);
+        }
+        ~channel_t()
+        {
+            // restore just in case
+            producer::set_consumer(m_prev_consumer);
+        }
+
+    };
+
+    std::shared_ptr<neutrino::mock::consumer_t> m_mock_consumer;
+
+    void SetUp() final
+    {
+    }
+
+    void TearDown() final
+    {
+    }
+
+    template <transport::frame_v00::known_encodings_t transport_encoding>
+    void validate_transaction_singlethread(std::function<std::shared_ptr<transport::endpoint_t>(std::shared_ptr<transport::endpoint_t> endpoint)>f)
+    {
+        SCOPED_TRACE(__FUNCTION__);
+        // events sequence corresponds to run_transaction impl
+        m_mock_consumer.reset(new neutrino::mock::consumer_t());
+        m_mock_consumer->
+            expect_checkpoint(0, stream_id_1, checkpoint_id_1)
+            .expect_context_enter(0, stream_id_1, context_id_1)
+            .expect_context_enter(0, stream_id_1, context_id_2)
+            .expect_context_panic(0, stream_id_1, context_id_2)
+            .expect_checkpoint(0, stream_id_1, checkpoint_id_2)
+            .expect_checkpoint(0, stream_id_1, checkpoint_id_3)
+            .expect_context_leave(0, stream_id_1, context_id_1)
+            .expect_checkpoint(0, stream_id_1, checkpoint_id_4)
+            ;
+
+        channel_t<transport_encoding> channel(f, *m_mock_consumer);
+
+        try
+        {
+            run_transaction(stream_id_1);
+
+            // expect flush at the very end of simulated app operations 
+            neutrino_flush();
+        }
+        catch(const std::exception& e)
+        {
+            ADD_FAILURE() << e.what();
+        }
+
+        ASSERT_EQ(std::size_t{0}, m_mock_consumer->m_expected_checkpoints.size());
+        ASSERT_EQ(std::size_t{0}, m_mock_consumer->m_expected_contexts.size());
+        m_mock_consumer.reset();
+    }
+
+    void validate_transaction_singlethread_transport_options(std::function<std::shared_ptr<transport::endpoint_t>(std::shared_ptr<transport::endpoint_t>)>f)
+    {
+        SCOPED_TRACE(__FUNCTION__);
+
+        validate_transaction_singlethread<transport::frame_v00::known_encodings_t::BINARY_NATIVE>(f);
+        validate_transaction_singlethread<transport::frame_v00::known_encodings_t::BINARY_NETWORK>(f);
+        //validate_transaction_singlethread<transport::frame_v00::known_encodings_t::JSON>(ep_factory);
+    }
+};
+
+TEST_F(neutrino_general_with_transport_workflow_tests, transaction_singlethread)
+{
+    for(const auto& po : test_params)
+    {
+        SCOPED_TRACE(po.m_name);
+        {
+            SCOPED_TRACE("buffered_singlethread_endpoint_t");
+            validate_transaction_singlethread_transport_options(
+                [po](std::shared_ptr<transport::endpoint_t> chained_endpoint)
+                {
+                    return std::shared_ptr<transport::endpoint_t>(new transport::buffered_singlethread_endpoint_t(chained_endpoint, po.m_params));
+                }
+            );
+        }
+        {
+            SCOPED_TRACE("buffered_exclusive_endpoint_t");
+            validate_transaction_singlethread_transport_options(
+                [po](std::shared_ptr<transport::endpoint_t> chained_endpoint)
+                {
+                    return std::shared_ptr<transport::endpoint_t>(new transport::buffered_exclusive_endpoint_t(chained_endpoint, po.m_params));
+                }
+            );
+        }
+        {
+            SCOPED_TRACE("buffered_optimistic_endpoint_t");
+            for (const auto& opo : test_optimistic_params)
+            {
+                SCOPED_TRACE(opo.m_name);
+                validate_transaction_singlethread_transport_options(
+                    [opo, po](std::shared_ptr<transport::endpoint_t> chained_endpoint)
+                    {
+                        return std::shared_ptr<transport::endpoint_t>(new transport::buffered_optimistic_endpoint_t(chained_endpoint, po.m_params, opo.m_params));
+                    }
+                );
+            }
+        }
+    }
+}
+
+namespace
+{
+    struct swap_tracking_consumer_stub_t : public transport::consumer_stub_t
+    {
+        std::atomic<bool> m_released{ false };
+        std::atomic<std::size_t> m_calls{ 0 };
+        std::atomic<std::size_t>& m_use_after_release;
+
+        swap_tracking_consumer_stub_t(transport::endpoint_t& endpoint, std::atomic<std::size_t>& use_after_release)
+            : transport::consumer_stub_t(endpoint), m_use_after_release(use_after_release)
+        {
+        }
+
+        void consume_checkpoint(
+            const local::payload::nanoepoch_t::type_t&
+            , const local::payload::stream_id_t::type_t&
+            , const local::payload::event_id_t::type_t&
+        ) final
+        {
+            m_calls++;
+            if (m_released.load())
+                m_use_after_release++;
+        }
+    };
+
+    // constructed before the first call of the thread, so destroyed after the thread gave its reader record back
+    struct call_at_thread_exit_t
+    {
+        bool m_armed = false;
+        ~call_at_thread_exit_t()
+        {
+            if (m_armed)
+                neutrino_checkpoint(1, 2, 3);
+        }
+    };
+    thread_local call_at_thread_exit_t call_at_thread_exit;
+
+    template <typename F>
+    double measure_ns_per_call(std::size_t cc_threads, std::size_t cc_calls, F f)
+    {
+        std::atomic<bool> go{ false };
+        std::list<std::thread> tt;
+        for (std::size_t cc = 0; cc < cc_threads; cc++)
+        {
+            tt.emplace_back([&go, &f, cc_calls]()
+                {
+                    while (!go.load())
+                        std::this_thread::yield();
+                    for (std::size_t cc = 0; cc < cc_calls; cc++)
+                        f(cc);
+                }
+            );
+        }
+        const auto start = std::chrono::steady_clock::now();
+        go = true;
+        for (auto& t : tt)
+            t.join();
+        const auto elapsed = std::chrono::steady_clock::now() - start;
+        return double(std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count()) / cc_calls;
+    }
+}
+
+TEST(neutrino_producer_consumer_publication, hot_swap_under_load)
+{
+    transport::endpoint_t endpoint;
+    std::atomic<std::size_t> use_after_release{ 0 };
+    std::atomic<bool> stop{ false };
+
+    // released stubs are kept allocated until the end of the test, so late use is detectable
+    std::list<std::unique_ptr<swap_tracking_consumer_stub_t>> released;
+    std::mutex released_mtx;
+
+    auto make_stub = [&]()
+    {
+        return std::shared_ptr<transport::consumer_stub_t>(
+            new swap_tracking_consumer_stub_t(endpoint, use_after_release)
+            , [&](transport::consumer_stub_t* p)
+            {
+                auto* s = static_cast<swap_tracking_consumer_stub_t*>(p);
+                s->m_released = true;
+                std::lock_guard<std::mutex> l(released_mtx);
+                released.emplace_back(s);
+            }
+        );
+    };
+
+    auto prev = producer::set_consumer(make_stub());
+
+    std::list<std::thread> tt;
+    for (std::size_t cc = 0; cc < 4; cc++)
+    {
+        tt.emplace_back([&stop]()
+            {
+                while (!stop.load())
+                    neutrino_checkpoint(1, 2, 3);
+            }
+        );
+    }
+
+    for (std::size_t cc = 0; cc < 1000; cc++)
+        producer::set_consumer(make_stub());
+
+    stop = true;
+    for (auto& t : tt)
+        t.join();
+
+    producer::set_consumer(prev);
+
+    ASSERT_EQ(std::size_t{ 0 }, use_after_release.load());
+}
+
+TEST(neutrino_producer_consumer_publication, calls_from_thread_local_destructors)
+{
+    transport::endpoint_t endpoint;
+    std::atomic<std::size_t> use_after_release{ 0 };
+    auto stub = std::make_shared<swap_tracking_consumer_stub_t>(endpoint, use_after_release);
+    auto prev = producer::set_consumer(stub);
+
+    const std::size_t cc_threads = 8;
+    for (std::size_t round = 0; round < 4; round++)
+    {
+        std::list<std::thread> tt;
+        for (std::size_t cc = 0; cc < cc_threads; cc++)
+        {
+            tt.emplace_back([]()
+                {
+                    call_at_thread_exit.m_armed = true;
+                    neutrino_checkpoint(1, 2, 3);
+                }
+            );
+        }
+        for (auto& t : tt)
+            t.join();
+    }
+
+    // no record is left inside a read-side section, the grace period ends
+    ASSERT_EQ(stub.get(), producer::set_consumer(prev).get());
+    ASSERT_EQ(4 * cc_threads * 2, stub->m_calls.load());
+    ASSERT_EQ(std::size_t{ 0 }, use_after_release.load());
+}
+
+TEST(neutrino_producer_consumer_publication, benchmark_per_call_cost_vs_threads)
+{
+    transport::endpoint_t endpoint; // no-op stub and endpoint: measures API dispatch only
+    neutrino::mock::scoped_guard sg(std::make_shared<transport::consumer_stub_t>(endpoint));
+
+    const std::size_t cc_calls = 1000000;
+    const std::size_t max_threads = std::max(2u, std::thread::hardware_concurrency());
+    const auto published = producer::get_consumer();
+
+    for (std::size_t cc_threads = 1; cc_threads <= max_threads; cc_threads *= 2)
+    {
+        // both through the same inlined path, only the publication differs
+        const auto guarded = measure_ns_per_call(cc_threads, cc_calls
+            , [](std::size_t cc) { producer::consumer_guard_t c; c->consume_checkpoint(cc, 1, 1); });
+        // previous publication: shared_ptr copied on every call
+        const auto shared_copy = measure_ns_per_call(cc_threads, cc_calls
+            , [&published](std::size_t cc) { auto c = published; c->consume_checkpoint(cc, 1, 1); });
+
+        std::cout << "[ BENCH    ] threads " << cc_threads
+            << " consumer_guard_t " << guarded << " ns/call"
+            << " shared_ptr copy " << shared_copy << " ns/call"
+            << std::endl;
+    }
+}
+
+namespace
+{
+    struct pipeline_sink_t : public transport::endpoint_t
+    {
+        std::vector<uint8_t> m_data;
+        uint64_t m_bytes = 0;
+        bool m_keep = false;
+        bool m_refuse = false;
+
+        pipeline_sink_t(bool keep = false) : m_keep(keep) {}
+
+        bool consume(const uint8_t* p, const uint8_t* e) final
+        {
+            if (m_refuse)
+                return false;
+            m_bytes += e - p;
+            if (m_keep)
+                m_data.insert(m_data.end(), p, e);
+            return true;
+        }
+    };
+
+    typedef pipeline::pipeline_t<
+        pipeline::serializer_t<serialized::native_byte_order_target_t>
+        , pipeline::buffered_t<pipeline_sink_t, 1 << 16>
+    > static_pipeline_t;
+
+    typedef pipeline::pipeline_t<
+        pipeline::serializer_t<serialized::native_byte_order_target_t>
+        , pipeline::endpoint_stage_t<transport::buffered_singlethread_endpoint_t>
+    > endpoint_stage_pipeline_t;
+}
+
+TEST(neutrino_producer_pipeline, same_frames_as_runtime_path)
+{
+    auto sink = std::make_shared<pipeline_sink_t>(true);
+    transport::buffered_singlethread_endpoint_t buffered(sink, { 1000, 999 });
+    auto stub = transport::frame_v00::create_consumer_stub(transport::frame_v00::known_encodings_t::BINARY_NATIVE, buffered);
+
+    static_pipeline_t p(true);
+    endpoint_stage_pipeline_t ep(sink, transport::buffered_endpoint_t::buffered_endpoint_params_t{ 1000, 999 });
+
+    for (uint64_t cc = 0; cc < 100; cc++)
+    {
+        stub->consume_checkpoint(cc, stream_id_1, checkpoint_id_1);
+        stub->consume_context(cc, stream_id_2, context_id_1, local::payload::event_type_t::event_types::CONTEXT_LEAVE);
+        p.checkpoint(cc, stream_id_1, checkpoint_id_1);
+        p.context(cc, stream_id_2, context_id_1, local::payload::event_type_t::event_types::CONTEXT_LEAVE);
+    }
+    uint8_t dummy[1];
+    ASSERT_TRUE(buffered.consume(dummy, dummy));
+    ASSERT_TRUE(p.flush());
+    ASSERT_EQ(sink->m_data, p.m_stage.m_sink.m_data);
+
+    // endpoint stage appends the same frames once more to the same sink
+    const auto runtime_frames = sink->m_data;
+    for (uint64_t cc = 0; cc < 100; cc++)
+    {
+        ep.checkpoint(cc, stream_id_1, checkpoint_id_1);
+        ep.context(cc, stream_id_2, context_id_1, local::payload::event_type_t::event_types::CONTEXT_LEAVE);
+    }
+    ASSERT_TRUE(ep.flush());
+    ASSERT_EQ(runtime_frames.size() * 2, sink->m_data.size());
+    ASSERT_TRUE(std::equal(runtime_frames.begin(), runtime_frames.end(), sink->m_data.begin() + runtime_frames.size()));
+}
+
+TEST(neutrino_producer_pipeline, refused_delivery_is_reported)
+{
+    typedef serialized::v00::frames_t<serialized::native_byte_order_target_t> frames_t;
+
+    // composed buffer: the frame which does not fit fails, refused data is delivered with the next flush
+    pipeline::pipeline_t<
+        pipeline::serializer_t<serialized::native_byte_order_target_t>
+        , pipeline::buffered_t<pipeline_sink_t, 4 * frames_t::checkpoint_size>
+    > p(true);
+    p.m_stage.m_sink.m_refuse = true;
+    for (uint64_t cc = 0; cc < 4; cc++)
+        ASSERT_TRUE(p.checkpoint(cc, stream_id_1, checkpoint_id_1));
+    ASSERT_FALSE(p.checkpoint(4, stream_id_1, checkpoint_id_1));
+    ASSERT_FALSE(p.flush());
+    p.m_stage.m_sink.m_refuse = false;
+    ASSERT_TRUE(p.checkpoint(5, stream_id_1, checkpoint_id_1));
+    ASSERT_TRUE(p.flush());
+    ASSERT_EQ(uint64_t{ 5 * frames_t::checkpoint_size }, p.m_stage.m_sink.m_bytes);
+
+    // endpoint stage: the watermark flush of commit
+    auto sink = std::make_shared<pipeline_sink_t>();
+    pipeline::pipeline_t<
+        pipeline::serializer_t<serialized::native_byte_order_target_t>
+        , pipeline::endpoint_stage_t<transport::buffered_singlethread_endpoint_t>
+    > ep(sink, transport::buffered_endpoint_t::buffered_endpoint_params_t{ 1000, 1 });
+    sink->m_refuse = true;
+    ASSERT_FALSE(ep.checkpoint(0, stream_id_1, checkpoint_id_1));
+    ASSERT_FALSE(ep.context(1, stream_id_2, context_id_1, local::payload::event_type_t::event_types::CONTEXT_LEAVE));
+    sink->m_refuse = false;
+    ASSERT_TRUE(ep.checkpoint(2, stream_id_1, checkpoint_id_1));
+}
+
+TEST(neutrino_producer_pipeline, benchmark_per_event_cost)
+{
+    const std::size_t cc_calls = 10000000;
+
+    auto sink = std::make_shared<pipeline_sink_t>();
+    transport::buffered_singlethread_endpoint_t buffered(sink, { 1 << 16, (1 << 16) - 1 });
+    auto stub = transport::frame_v00::create_consumer_stub(transport::frame_v00::known_encodings_t::BINARY_NATIVE, buffered);
+    double c_api;
+    {
+        neutrino::mock::scoped_guard sg(stub);
+        c_api = measure_ns_per_call(1, cc_calls, [](std::size_t cc) { neutrino_checkpoint(cc, 1, 1); });
+    }
+    const auto runtime = measure_ns_per_call(1, cc_calls, [&stub](std::size_t cc) { stub->consume_checkpoint(cc, 1, 1); });
+
+    std::unique_ptr<endpoint_stage_pipeline_t> ep(new endpoint_stage_pipeline_t(sink, transport::buffered_endpoint_t::buffered_endpoint_params_t{ 1 << 16, (1 << 16) - 1 }));
+    const auto endpoint_stage = measure_ns_per_call(1, cc_calls, [&ep](std::size_t cc) { ep->checkpoint(cc, 1, 1); });
+
+    std::unique_ptr<static_pipeline_t> p(new static_pipeline_t());
+    const auto composed = measure_ns_per_call(1, cc_calls, [&p](std::size_t cc) { p->checkpoint(cc, 1, 1); });
+    ASSERT_TRUE(p->flush());
+    ASSERT_EQ(uint64_t(cc_calls * serialized::v00::frames_t<serialized::native_byte_order_target_t>::checkpoint_size), p->m_stage.m_sink.m_bytes);
+
+    std::cout << "[ BENCH    ] checkpoint C API " << c_api << " ns/event"
+        << ", runtime stub " << runtime << " ns/event"
+        << ", pipeline over endpoint " << endpoint_stage << " ns/event"
+        << ", composed pipeline " << composed << " ns/event" << std::endl;
+}
+
+TEST(neutrino_consumer_stream_table, lru_eviction_and_erase)
+{
+    consumer::stream_table_t::stream_table_params_t po;
+    po.m_max_streams = 256;
+    po.m_max_stack_blocks = 16;
+    consumer::stream_table_t t(po);
+
+    // random touch/erase against a reference, the small table exercises probe chains and backward shift
+    std::map<uint64_t, uint64_t> reference; // stream -> last nanoepoch
+    std::mt19937_64 rnd(1);
+    for (uint64_t cc = 1; cc < 20000; cc++)
+    {
+        const uint64_t stream_id = rnd() % 200;
+        if (rnd() % 4 == 0)
+        {
+            ASSERT_EQ(reference.erase(stream_id) == 1, t.erase(stream_id));
+        }
+        else
+        {
+            ASSERT_EQ(stream_id, t.touch(stream_id, cc).m_stream_id);
+            reference[stream_id] = cc;
+        }
+        ASSERT_EQ(reference.size(), t.size());
+    }
+    for (const auto& r : reference)
+    {
+        const consumer::stream_state_t* s = t.find(r.first);
+        ASSERT_TRUE(s != nullptr);
+        ASSERT_EQ(r.second, s->m_last_nanoepoch);
+    }
+    ASSERT_EQ(uint64_t{ 0 }, t.metrics().m_evicted_lru);
+
+    // full table: least recently used streams go first
+    for (uint64_t cc = 1000; cc < 2000; cc++)
+    {
+        t.touch(cc, cc);
+        t.touch(1000, cc); // kept recent
+    }
+    ASSERT_EQ(std::size_t{ 256 }, t.size());
+    ASSERT_TRUE(t.find(1000) != nullptr);
+    ASSERT_TRUE(t.find(1999) != nullptr);
+    ASSERT_TRUE(t.find(1001) == nullptr);
+    ASSERT_EQ(reference.size() + 1000 - 256, t.metrics().m_evicted_lru);
+
+    ASSERT_EQ(std::size_t{ 0 }, t.evict_idle(2000, 1000));
+    ASSERT_EQ(std::size_t{ 245 }, t.evict_idle(2000, 10)); // 1990-1999 and 1000, touched at 1999, stay
+    ASSERT_EQ(std::size_t{ 11 }, t.size());
+    ASSERT_TRUE(t.find(1000) != nullptr);
+    ASSERT_EQ(uint64_t{ 245 }, t.metrics().m_evicted_idle);
+}
+
+TEST(neutrino_consumer_stream_table, pooled_context_stacks)
+{
+    consumer::stream_table_t::stream_table_params_t po;
+    po.m_max_streams = 4;
+    po.m_max_stack_blocks = 4;
+    consumer::stream_table_t t(po);
+
+    auto& s1 = t.touch(1, 0);
+    for (uint64_t cc = 0; cc < 3 * consumer::stream_table_t::block_contexts; cc++)
+        ASSERT_TRUE(t.push(s1, consumer::open_context_t{ 100 + cc, cc }));
+    auto& s2 = t.touch(2, 0);
+    ASSERT_TRUE(t.push(s2, consumer::open_context_t{ 7, 7 }));
+    for (uint64_t cc = 1; cc < consumer::stream_table_t::block_contexts; cc++)
+        ASSERT_TRUE(t.push(s2, consumer::open_context_t{ 7, 7 }));
+    ASSERT_FALSE(t.push(s2, consumer::open_context_t{ 8, 8 })); // all 4 blocks taken
+    ASSERT_EQ(uint64_t{ 1 }, t.metrics().m_stack_overflows);
+
+    auto* s = t.find(1);
+    ASSERT_EQ(uint64_t{ 3 * consumer::stream_table_t::block_contexts - 1 }, t.top(*s)->m_event_id);
+    ASSERT_EQ(std::size_t{ 1 }, t.depth_of(*s, 3 * consumer::stream_table_t::block_contexts - 1));
+    ASSERT_EQ(std::size_t{ 3 * consumer::stream_table_t::block_contexts }, t.depth_of(*s, 0));
+    ASSERT_EQ(std::size_t{ 0 }, t.depth_of(*s, 1000));
+    for (uint64_t cc = 3 * consumer::stream_table_t::block_contexts; cc-- > 0; )
+    {
+        ASSERT_EQ(100 + cc, t.top(*s)->m_nanoepoch);
+        t.pop(*s);
+    }
+    ASSERT_TRUE(t.top(*s) == nullptr);
+
+    // blocks are back in the pool
+    ASSERT_TRUE(t.push(*t.find(2), consumer::open_context_t{ 8, 8 }));
+    ASSERT_TRUE(t.erase(2));
+    auto& s3 = t.touch(3, 0);
+    for (uint64_t cc = 0; cc < 4 * consumer::stream_table_t::block_contexts; cc++)
+        ASSERT_TRUE(t.push(s3, consumer::open_context_t{ cc, cc }));
+}
+
+TEST(neutrino_consumer_stream_table, snapshot_moves_between_tables)
+{
+    consumer::stream_table_t::stream_table_params_t po;
+    po.m_max_streams = 16;
+    po.m_max_stack_blocks = 32;
+    po.m_pattern_cursors = 2;
+    consumer::stream_table_t from(po), to(po);
+
+    for (uint64_t id = 0; id < 10; id++)
+    {
+        auto& s = from.touch(id, 100 + id);
+        from.cursors(s)[1].m_state = uint32_t(id);
+        for (uint64_t cc = 0; cc < id; cc++)
+            ASSERT_TRUE(from.push(s, consumer::open_context_t{ cc, id * 10 + cc }));
+    }
+    to.touch(4, 0); // replaced by the moved one
+
+    std::vector<consumer::stream_snapshot_t> moved;
+    ASSERT_EQ(std::size_t{ 5 }, from.extract([](const uint64_t id) { return id % 2 == 0; }, moved));
+    ASSERT_EQ(std::size_t{ 5 }, from.size());
+    ASSERT_TRUE(from.find(4) == nullptr);
+    ASSERT_TRUE(from.find(5) != nullptr);
+    ASSERT_EQ(uint64_t{ 54 }, from.top(*from.find(5))->m_event_id);
+
+    for (const auto& m : moved)
+        to.insert(m);
+    ASSERT_EQ(std::size_t{ 5 }, to.size());
+    for (uint64_t id = 0; id < 10; id += 2)
+    {
+        auto* s = to.find(id);
+        ASSERT_TRUE(s != nullptr);
+        ASSERT_EQ(uint32_t(id), s->m_depth);
+        ASSERT_EQ(uint32_t{ 0 }, to.cursors(*s)[0].m_state);
+        ASSERT_EQ(uint32_t(id), to.cursors(*s)[1].m_state);
+        ASSERT_EQ(100 + id, s->m_last_nanoepoch);
+        for (uint64_t cc = id; cc-- > 0; )
+        {
+            ASSERT_EQ(id * 10 + cc, to.top(*s)->m_event_id);
+            to.pop(*s);
+        }
+    }
+}
+
+TEST(neutrino_consumer_aggregator, contexts_from_deserializer)
+{
+    consumer::aggregator_t aggregator(consumer::aggregator_t::aggregator_params_t{});
+    auto endpoint_impl = transport::frame_v00::create_endpoint_impl(transport::frame_v00::known_encodings_t::BINARY_NATIVE, aggregator);
+    neutrino::mock::connection_t<transport::endpoint_impl_t> connection(*endpoint_impl);
+    auto stub = transport::frame_v00::create_consumer_stub(transport::frame_v00::known_encodings_t::BINARY_NATIVE, connection);
+
+    stub->consume_context(10, stream_id_1, context_id_1, local::payload::event_type_t::event_types::CONTEXT_ENTER);
+    stub->consume_context(11, stream_id_1, context_id_2, local::payload::event_type_t::event_types::CONTEXT_ENTER);
+    stub->consume_context(12, stream_id_2, context_id_2, local::payload::event_type_t::event_types::CONTEXT_ENTER);
+    stub->consume_checkpoint(13, stream_id_1, checkpoint_id_4);
+    stub->consume_context(14, stream_id_1, context_id_1, local::payload::event_type_t::event_types::CONTEXT_PANIC); // inner one never left
+    stub->consume_context(15, stream_id_1, context_id_2, local::payload::event_type_t::event_types::CONTEXT_LEAVE);
+
+    const auto& m = aggregator.metrics();
+    ASSERT_EQ(uint64_t{ 1 }, m.m_checkpoints);
+    ASSERT_EQ(uint64_t{ 5 }, m.m_contexts);
+    ASSERT_EQ(uint64_t{ 1 }, m.m_unwound);
+    ASSERT_EQ(uint64_t{ 1 }, m.m_unmatched);
+
+    const consumer::stream_state_t* s1 = aggregator.streams().find(stream_id_1);
+    ASSERT_TRUE(s1 != nullptr);
+    ASSERT_EQ(uint32_t{ 0 }, s1->m_depth);
+    ASSERT_TRUE(s1->m_has_checkpoint);
+    ASSERT_EQ(checkpoint_id_4, s1->m_checkpoint_event_id);
+    ASSERT_EQ(uint64_t{ 15 }, s1->m_last_nanoepoch);
+
+    const consumer::stream_state_t* s2 = aggregator.streams().find(stream_id_2);
+    ASSERT_TRUE(s2 != nullptr);
+    ASSERT_EQ(context_id_2, aggregator.streams().top(*s2)->m_event_id);
+    ASSERT_EQ(uint64_t{ 12 }, aggregator.streams().top(*s2)->m_nanoepoch);
+}
+
+namespace
+{
+    const local::payload::event_type_t::type_t type_checkpoint = static_cast<local::payload::event_type_t::type_t>(local::payload::event_type_t::event_types::NO_CONTEXT);
+    const local::payload::event_type_t::type_t type_enter = NEUTRINO_CONTEXT_ENTER;
+    const local::payload::event_type_t::type_t type_leave = NEUTRINO_CONTEXT_LEAVE;
+
+    consumer::pattern_t make_pattern(const char* name, std::vector<consumer::pattern_step_t> steps, std::vector<consumer::pattern_step_t> exclusions = {}, uint64_t max_gap = 0, const char* category = "ut")
+    {
+        consumer::pattern_t p;
+        p.m_name = name;
+        p.m_category = category;
+        p.m_steps = std::move(steps);
+        p.m_exclusions = std::move(exclusions);
+        p.m_max_gap = max_gap;
+        return p;
+    }
+
+    struct pattern_matches_t
+    {
+        const consumer::pattern_automaton_t& m_automaton;
+        std::vector<consumer::pattern_cursor_t> m_cursors;
+        std::vector<std::string> m_matched;
+
+        explicit pattern_matches_t(const consumer::pattern_automaton_t& automaton)
+            : m_automaton(automaton), m_cursors(automaton.categories())
+        {
+        }
+
+        void feed(const uint64_t nanoepoch, const local::payload::event_type_t::type_t event_type, const uint64_t event_id)
+        {
+            m_automaton.match(m_cursors.data(), nanoepoch, event_type, event_id, [&](const uint32_t p) { m_matched.push_back(m_automaton.pattern(p).m_name); });
+        }
+    };
+}
+
+TEST(neutrino_consumer_patterns, automaton)
+{
+    const consumer::pattern_automaton_t automaton({
+        make_pattern("scope", { { type_enter, 1 }, { type_leave, 1 } })
+        , make_pattern("five_six_seven", { { type_checkpoint, 5 }, { type_checkpoint, 6 }, { type_checkpoint, 7 } }, {}, 100)
+        , make_pattern("six_seven", { { type_checkpoint, 6 }, { type_checkpoint, 7 } })
+        , make_pattern("five_eight", { { type_checkpoint, 5 }, { type_checkpoint, 8 } }, { { type_checkpoint, 9 } })
+    });
+    ASSERT_EQ(std::size_t{ 7 }, automaton.symbols());
+
+    ASSERT_EQ(std::size_t{ 1 }, automaton.categories());
+
+    pattern_matches_t m(automaton);
+    m.feed(1, type_enter, 1);
+    m.feed(2, type_checkpoint, 1000); // not significant
+    m.feed(3, type_leave, 1);
+    ASSERT_EQ(std::vector<std::string>{ "scope" }, m.m_matched);
+
+    // overlapping: a suffix pattern is reported with the longer one
+    m.m_matched.clear();
+    for (uint64_t id : { 5, 6, 7 })
+        m.feed(10 + id, type_checkpoint, id);
+    ASSERT_EQ((std::vector<std::string>{ "five_six_seven", "six_seven" }), m.m_matched);
+
+    // exclusion between the steps breaks the series, fail link keeps the suffix
+    m.m_matched.clear();
+    for (uint64_t id : { 5, 9, 8, 5, 5, 8 })
+        m.feed(20, type_checkpoint, id);
+    ASSERT_EQ(std::vector<std::string>{ "five_eight" }, m.m_matched);
+
+    // gap over the bound restarts matching, six_seven is unbounded
+    m.m_matched.clear();
+    m.feed(100, type_checkpoint, 5);
+    m.feed(150, type_checkpoint, 6);
+    m.feed(1000, type_checkpoint, 7);
+    ASSERT_EQ(std::vector<std::string>{ "six_seven" }, m.m_matched);
+}
+
+TEST(neutrino_consumer_patterns, categories_match_on_their_own)
+{
+    const consumer::pattern_automaton_t automaton({
+        make_pattern("scope", { { type_enter, 1 }, { type_leave, 1 } }, {}, 0, "contexts")
+        , make_pattern("five_eight", { { type_checkpoint, 5 }, { type_checkpoint, 8 } }, {}, 0, "checkpoints")
+        , make_pattern("five_six", { { type_checkpoint, 5 }, { type_checkpoint, 6 } }, {}, 0, "checkpoints")
+        , make_pattern("one_two", { { type_checkpoint, 1 }, { type_checkpoint, 2 } }, {}, 0, "contexts")
+    });
+    ASSERT_EQ(std::size_t{ 2 }, automaton.categories());
+
+    // a symbol of another category does not break a partial match
+    pattern_matches_t m(automaton);
+    m.feed(1, type_enter, 1);
+    m.feed(2, type_checkpoint, 5);
+    m.feed(3, type_leave, 1);
+    m.feed(4, type_checkpoint, 8);
+    ASSERT_EQ((std::vector<std::string>{ "scope", "five_eight" }), m.m_matched);
+
+    // a symbol of the same category does
+    m.m_matched.clear();
+    m.feed(10, type_checkpoint, 5);
+    m.feed(11, type_checkpoint, 6);
+    m.feed(12, type_checkpoint, 8);
+    m.feed(13, type_enter, 1);
+    m.feed(14, type_checkpoint, 1);
+    m.feed(15, type_leave, 1);
+    ASSERT_EQ(std::vector<std::string>{ "five_six" }, m.m_matched);
+
+    // a symbol of both categories moves both
+    m.m_matched.clear();
+    m.feed(20, type_enter, 1);
+    m.feed(21, type_checkpoint, 1);
+    m.feed(22, type_checkpoint, 5);
+    m.feed(23, type_checkpoint, 2);
+    m.feed(24, type_checkpoint, 6);
+    ASSERT_EQ((std::vector<std::string>{ "one_two", "five_six" }), m.m_matched);
+}
+
+namespace
+{
+    struct patterns_aggregator_t : public consumer::aggregator_t
+    {
+        using consumer::aggregator_t::aggregator_t;
+        std::vector<std::pair<uint64_t, std::size_t>> m_matched;
+
+        void consume_pattern(
+            const local::payload::stream_id_t::type_t& stream_id
+            , const std::size_t pattern
+            , const local::payload::nanoepoch_t::type_t&
+        ) final
+        {
+            m_matched.emplace_back(stream_id, pattern);
+        }
+    };
+}
+
+TEST(neutrino_consumer_patterns, per_stream_cursors_in_aggregator)
+{
+    consumer::aggregator_t::aggregator_params_t po;
+    po.m_patterns = std::make_shared<consumer::pattern_automaton_t>(std::vector<consumer::pattern_t>{
+        make_pattern("scope", { { type_enter, context_id_1 }, { type_checkpoint, checkpoint_id_1 }, { type_leave, context_id_1 } })
+    });
+    patterns_aggregator_t aggregator(po);
+    auto endpoint_impl = transport::frame_v00::create_endpoint_impl(transport::frame_v00::known_encodings_t::BINARY_NATIVE, aggregator);
+    neutrino::mock::connection_t<transport::endpoint_impl_t> connection(*endpoint_impl);
+    auto stub = transport::frame_v00::create_consumer_stub(transport::frame_v00::known_encodings_t::BINARY_NATIVE, connection);
+
+    // two streams interleaved, each one matches on its own
+    stub->consume_context(1, stream_id_1, context_id_1, local::payload::event_type_t::event_types::CONTEXT_ENTER);
+    stub->consume_context(2, stream_id_2, context_id_1, local::payload::event_type_t::event_types::CONTEXT_ENTER);
+    stub->consume_checkpoint(3, stream_id_2, checkpoint_id_1);
+    stub->consume_checkpoint(4, stream_id_1, checkpoint_id_1);
+    stub->consume_context(5, stream_id_1, context_id_1, local::payload::event_type_t::event_types::CONTEXT_LEAVE);
+    stub->consume_context(6, stream_id_2, context_id_1, local::payload::event_type_t::event_types::CONTEXT_PANIC);
+
+    ASSERT_EQ((std::vector<std::pair<uint64_t, std::size_t>>{ { stream_id_1, 0 } }), aggregator.m_matched);
+    ASSERT_EQ(uint64_t{ 1 }, aggregator.metrics().m_patterns);
+}
+
+TEST(neutrino_consumer_patterns, benchmark_synthetic_set)
+{
+    // 4000 patterns of 2-6 steps over 2000 symbols, 1000 streams, 15% of the frames are planted pattern runs
+    std::mt19937_64 rnd(7);
+    const uint64_t symbols = 2000;
+    auto step = [&](const uint64_t s) { return consumer::pattern_step_t{ uint8_t(s % 2 ? type_checkpoint : type_enter), s }; };
+    std::vector<consumer::pattern_t> patterns;
+    for (std::size_t cc = 0; cc < 4000; cc++)
+    {
+        std::vector<consumer::pattern_step_t> steps;
+        for (std::size_t len = 2 + rnd() % 5; len > 0; len--)
+            steps.push_back(step(rnd() % symbols));
+        patterns.push_back(make_pattern("synthetic", std::move(steps), {}, rnd() % 2 ? 0 : 100000));
+    }
+    using clock_t = std::chrono::steady_clock;
+    const auto t0 = clock_t::now();
+    const consumer::pattern_automaton_t automaton(patterns);
+    const auto t1 = clock_t::now();
+
+    const std::size_t n = 2000000, streams = 1000;
+    struct frame_t { uint64_t m_stream; consumer::pattern_step_t m_step; };
+    std::vector<frame_t> frames;
+    frames.reserve(n + 8);
+    while (frames.size() < n)
+    {
+        const uint64_t stream = rnd() % streams;
+        if (rnd() % 100 < 5)
+        {
+            for (const auto& s : patterns[rnd() % patterns.size()].m_steps)
+                frames.push_back(frame_t{ stream, s });
+        }
+        else
+        {
+            frames.push_back(frame_t{ stream, step(rnd() % (symbols * 4)) }); // 3/4 not significant
+        }
+    }
+
+    std::vector<consumer::pattern_cursor_t> cursors(streams * automaton.categories());
+    uint64_t matched = 0;
+    const auto t2 = clock_t::now();
+    for (std::size_t cc = 0; cc < frames.size(); cc++)
+    {
+        const frame_t& f = frames[cc];
+        automaton.match(&cursors[f.m_stream * automaton.categories()], cc * 10, f.m_step.m_event_type, f.m_step.m_event_id, [&](const uint32_t) { matched++; });
+    }
+    const auto t3 = clock_t::now();
+    ASSERT_NE(uint64_t{ 0 }, matched);
+
+    std::cout << "[ BENCH    ] patterns " << automaton.patterns() << ", states " << automaton.states() << ", symbols " << automaton.symbols()
+        << ", compile " << std::chrono::duration<double, std::milli>(t1 - t0).count() << " ms"
+        << ", match " << std::chrono::duration<double, std::nano>(t3 - t2).count() / frames.size() << " ns/frame"
+        << ", matched " << matched << std::endl;
+}
+
+namespace
+{
+    // stream_id, then frames with well nested contexts and checkpoints, the pattern enter(10) checkpoint(1) leave(10) occurs
+    void generate_streams(std::vector<uint8_t>& buf, const std::vector<uint64_t>& hot, const std::vector<uint64_t>& cold, const std::size_t n, const uint64_t seed)
+    {
+        pipeline_sink_t sink(true);
+        auto stub = transport::frame_v00::create_consumer_stub(transport::frame_v00::known_encodings_t::BINARY_NATIVE, sink);
+        std::mt19937_64 rnd(seed);
+        std::map<uint64_t, std::vector<uint64_t>> stacks;
+        for (std::size_t cc = 0; cc < n; cc++)
+        {
+            const uint64_t stream_id = rnd() % 10 < 8 ? hot[rnd() % hot.size()] : cold[rnd() % cold.size()];
+            auto& stack = stacks[stream_id];
+            const uint64_t nanoepoch = 1000 + cc;
+            const uint64_t r = rnd() % 3;
+            if (r == 0 && stack.size() < 5)
+            {
+                stack.push_back(10 + stack.size());
+                stub->consume_context(nanoepoch, stream_id, stack.back(), local::payload::event_type_t::event_types::CONTEXT_ENTER);
+            }
+            else if (r == 1 && !stack.empty())
+            {
+                stub->consume_context(nanoepoch, stream_id, stack.back(), local::payload::event_type_t::event_types::CONTEXT_LEAVE);
+                stack.pop_back();
+            }
+            else
+            {
+                stub->consume_checkpoint(nanoepoch, stream_id, rnd() % 2);
+            }
+        }
+        buf.swap(sink.m_data);
+    }
+
+    void replay(transport::consumer_t& consumer, const std::vector<uint8_t>& buf, const std::size_t chunk)
+    {
+        auto impl = transport::frame_v00::create_stream_endpoint_impl(transport::frame_v00::known_encodings_t::BINARY_NATIVE, consumer);
+        for (std::size_t pos = 0; pos < buf.size(); pos += chunk)
+            ASSERT_TRUE(impl->consume(buf.data() + pos, buf.data() + std::min(buf.size(), pos + chunk)));
+    }
+}
+
+TEST(neutrino_consumer_sharded, same_states_as_one_aggregator_while_buckets_move)
+{
+    consumer::aggregator_t::aggregator_params_t apo;
+    apo.m_patterns = std::make_shared<consumer::pattern_automaton_t>(std::vector<consumer::pattern_t>{
+        make_pattern("scope", { { type_enter, 10 }, { type_checkpoint, 1 }, { type_leave, 10 } })
+    });
+
+    consumer::sharded_aggregator_t::sharded_aggregator_params_t po;
+    po.m_workers = 4;
+    po.m_ring_frames = 1024;
+    po.m_buckets = 64;
+    po.m_rebalance_frames = 2048;
+    po.m_aggregator = apo;
+    consumer::sharded_aggregator_t sharded(po);
+
+    // most of the traffic starts on worker 0
+    std::vector<uint64_t> hot, cold;
+    for (uint64_t id = 1; hot.size() < 300 || cold.size() < 300; id++)
+        (sharded.worker_of(id) == 0 ? hot : cold).push_back(id);
+    std::vector<uint8_t> buf;
+    generate_streams(buf, hot, cold, 400000, 3);
+
+    consumer::aggregator_t reference(apo);
+    replay(reference, buf, buf.size());
+    replay(sharded, buf, 100000);
+    sharded.flush();
+
+    ASSERT_NE(uint64_t{ 0 }, sharded.metrics().m_migrations);
+    ASSERT_EQ(uint64_t{ 400000 }, sharded.metrics().m_frames);
+
+    consumer::aggregator_t::metrics_t total;
+    std::size_t streams = 0;
+    for (std::size_t cc = 0; cc < sharded.workers(); cc++)
+    {
+        const auto& m = sharded.aggregator(cc).metrics();
+        total.m_checkpoints += m.m_checkpoints;
+        total.m_contexts += m.m_contexts;
+        total.m_unmatched += m.m_unmatched;
+        total.m_unwound += m.m_unwound;
+        total.m_patterns += m.m_patterns;
+        streams += sharded.aggregator(cc).streams().size();
+    }
+    ASSERT_EQ(reference.metrics().m_checkpoints, total.m_checkpoints);
+    ASSERT_EQ(reference.metrics().m_contexts, total.m_contexts);
+    ASSERT_EQ(uint64_t{ 0 }, total.m_unmatched);
+    ASSERT_EQ(uint64_t{ 0 }, total.m_unwound);
+    ASSERT_NE(uint64_t{ 0 }, total.m_patterns);
+    ASSERT_EQ(reference.metrics().m_patterns, total.m_patterns);
+    ASSERT_EQ(reference.streams().size(), streams);
+
+    for (const auto* ids : { &hot, &cold })
+    {
+        for (const uint64_t id : *ids)
+        {
+            const consumer::stream_state_t* r = reference.streams().find(id);
+            const consumer::stream_state_t* s = sharded.aggregator(sharded.worker_of(id)).streams().find(id);
+            ASSERT_TRUE(r != nullptr);
+            ASSERT_TRUE(s != nullptr);
+            ASSERT_EQ(r->m_depth, s->m_depth);
+            ASSERT_EQ(r->m_last_nanoepoch, s->m_last_nanoepoch);
+            ASSERT_EQ(r->m_checkpoint_event_id, s->m_checkpoint_event_id);
+            for (std::size_t c = 0; c < reference.streams().m_params.m_pattern_cursors; c++)
+                ASSERT_EQ(reference.streams().cursors(*r)[c].m_state, sharded.aggregator(sharded.worker_of(id)).streams().cursors(*s)[c].m_state);
+        }
+    }
+}
+
+TEST(neutrino_consumer_sharded, benchmark_replay)
+{
+    // 2M frames of 10000 streams against 1000 patterns, decode and route on this thread
+    std::mt19937_64 rnd(11);
+    std::vector<consumer::pattern_t> patterns;
+    for (std::size_t cc = 0; cc < 1000; cc++)
+    {
+        std::vector<consumer::pattern_step_t> steps;
+        for (std::size_t len = 2 + rnd() % 3; len > 0; len--)
+            steps.push_back(consumer::pattern_step_t{ uint8_t(rnd() % 2 ? type_checkpoint : type_enter), rnd() % 20 });
+        patterns.push_back(make_pattern("synthetic", std::move(steps)));
+    }
+    consumer::aggregator_t::aggregator_params_t apo;
+    apo.m_patterns = std::make_shared<consumer::pattern_automaton_t>(patterns);
+
+    std::vector<uint64_t> ids;
+    for (uint64_t id = 1; id <= 10000; id++)
+        ids.push_back(id);
+    std::vector<uint8_t> buf;
+    generate_streams(buf, ids, ids, 2000000, 5);
+
+    using clock_t = std::chrono::steady_clock;
+    {
+        consumer::aggregator_t aggregator(apo);
+        const auto t0 = clock_t::now();
+        replay(aggregator, buf, 4096 * 32);
+        const auto t1 = clock_t::now();
+        std::cout << "[ BENCH    ] one aggregator: " << std::chrono::duration<double, std::nano>(t1 - t0).count() / 2000000 << " ns/frame" << std::endl;
+    }
+
+    double single = 0;
+    for (std::size_t workers = 1; workers <= std::max<std::size_t>(8, std::thread::hardware_concurrency()); workers *= 2)
+    {
+        consumer::sharded_aggregator_t::sharded_aggregator_params_t po;
+        po.m_workers = workers;
+        po.m_aggregator = apo;
+        consumer::sharded_aggregator_t sharded(po);
+        const auto t0 = clock_t::now();
+        replay(sharded, buf, 4096 * 32);
+        sharded.flush();
+        const auto t1 = clock_t::now();
+        const double ns = std::chrono::duration<double, std::nano>(t1 - t0).count() / 2000000;
+        if (workers == 1)
+            single = ns;
+        std::cout << "[ BENCH    ] sharded, " << workers << " workers (" << std::thread::hardware_concurrency() << " cpus): "
+            << ns << " ns/frame, x" << single / ns << ", buckets moved " << sharded.metrics().m_migrations << std::endl;
+    }
+}
+
+TEST(neutrino_consumer_latency, histogram_buckets_and_percentiles)
+{
+    typedef consumer::latency_histogram_t h_t;
+    for (uint64_t v = 0; v < 32; v++)
+        ASSERT_EQ(v, h_t::highest_of(h_t::bucket_of(v)));
+    std::mt19937_64 rnd(9);
+    for (std::size_t cc = 0; cc < 100000; cc++)
+    {
+        const uint64_t v = rnd() >> (rnd() % 64);
+        const uint64_t c = std::min(v, (uint64_t(1) << h_t::max_bits) - 1);
+        const std::size_t b = h_t::bucket_of(v);
+        ASSERT_LT(b, h_t::buckets);
+        ASSERT_LE(c, h_t::highest_of(b));
+        ASSERT_LE(h_t::highest_of(b) - c, c / 16);
+        ASSERT_TRUE(b == 0 || h_t::highest_of(b - 1) < c);
+    }
+    ASSERT_EQ(h_t::buckets - 1, h_t::bucket_of(~uint64_t(0)));
+
+    h_t h;
+    ASSERT_EQ(uint64_t{ 0 }, h.value_at(0.5));
+    for (uint64_t v = 1; v <= 10000; v++)
+        h.record(v);
+    const struct { double p; uint64_t v; } expected[] = { { 0.5, 5000 }, { 0.99, 9900 }, { 0.999, 9990 }, { 1, 10000 } };
+    for (const auto& e : expected)
+    {
+        ASSERT_GE(h.value_at(e.p), e.v);
+        ASSERT_LE(h.value_at(e.p), e.v + e.v / 16);
+    }
+
+    h_t merged;
+    merged.merge(h);
+    merged.merge(h);
+    ASSERT_EQ(uint64_t{ 20000 }, merged.count());
+    ASSERT_EQ(h.value_at(0.99), merged.value_at(0.99));
+}
+
+TEST(neutrino_consumer_latency, durations_of_closed_contexts)
+{
+    consumer::aggregator_t::aggregator_params_t po;
+    po.m_latencies.m_max_keys = 3;
+    consumer::aggregator_t aggregator(po);
+    ASSERT_TRUE(aggregator.latencies() != nullptr);
+
+    for (uint64_t cc = 0; cc < 100; cc++)
+    {
+        const uint64_t t = cc * 1000000;
+        aggregator.consume_context(t, stream_id_1, context_id_1, local::payload::event_type_t::event_types::CONTEXT_ENTER);
+        aggregator.consume_context(t + 10, stream_id_1, context_id_2, local::payload::event_type_t::event_types::CONTEXT_ENTER); // unwound, no duration
+        aggregator.consume_context(t + 1000 + cc, stream_id_1, context_id_1, cc % 10 ? local::payload::event_type_t::event_types::CONTEXT_LEAVE : local::payload::event_type_t::event_types::CONTEXT_PANIC);
+        aggregator.consume_context(t, stream_id_2, context_id_1, local::payload::event_type_t::event_types::CONTEXT_ENTER);
+        aggregator.consume_context(t + 7, stream_id_2, context_id_1, local::payload::event_type_t::event_types::CONTEXT_LEAVE);
+    }
+    aggregator.consume_context(0, stream_id_1, context_id_2, local::payload::event_type_t::event_types::CONTEXT_LEAVE); // unmatched, no duration
+
+    consumer::latency_histogram_t h;
+    ASSERT_TRUE(aggregator.latencies()->snapshot(stream_id_1, context_id_1, h));
+    ASSERT_EQ(uint64_t{ 100 }, h.count());
+    ASSERT_GE(h.value_at(0.5), uint64_t{ 1049 });
+    ASSERT_LE(h.value_at(0.5), uint64_t{ 1049 + 1049 / 16 });
+    ASSERT_GE(h.value_at(1), uint64_t{ 1099 });
+
+    consumer::latency_histogram_t h2;
+    ASSERT_TRUE(aggregator.latencies()->snapshot(stream_id_2, context_id_1, h2));
+    ASSERT_EQ(uint64_t{ 7 }, h2.value_at(0.999));
+    ASSERT_FALSE(aggregator.latencies()->snapshot(stream_id_1, context_id_2, h2));
+
+    // keys over m_max_keys are dropped
+    aggregator.consume_context(0, 1, context_id_1, local::payload::event_type_t::event_types::CONTEXT_ENTER);
+    aggregator.consume_context(1, 1, context_id_1, local::payload::event_type_t::event_types::CONTEXT_LEAVE);
+    aggregator.consume_context(0, 2, context_id_1, local::payload::event_type_t::event_types::CONTEXT_ENTER);
+    aggregator.consume_context(1, 2, context_id_1, local::payload::event_type_t::event_types::CONTEXT_LEAVE);
+    ASSERT_EQ(std::size_t{ 3 }, aggregator.latencies()->size());
+    ASSERT_EQ(uint64_t{ 1 }, aggregator.latencies()->metrics().m_dropped);
+
+    std::size_t keys = 0;
+    aggregator.latencies()->for_each([&](const uint64_t, const uint64_t event_id, const consumer::latency_histogram_t& k)
+    {
+        keys++;
+        ASSERT_EQ(context_id_1, event_id);
+        ASSERT_NE(uint64_t{ 0 }, k.count());
+    });
+    ASSERT_EQ(std::size_t{ 3 }, keys);
+}
+
+TEST(neutrino_consumer_latency, sharded_snapshots_while_ingesting)
+{
+    consumer::aggregator_t::aggregator_params_t apo;
+    apo.m_latencies.m_max_keys = 1024;
+
+    consumer::sharded_aggregator_t::sharded_aggregator_params_t po;
+    po.m_workers = 4;
+    po.m_ring_frames = 1024;
+    po.m_buckets = 64;
+    po.m_rebalance_frames = 2048;
+    po.m_aggregator = apo;
+    consumer::sharded_aggregator_t sharded(po);
+
+    std::vector<uint64_t> hot, cold;
+    for (uint64_t id = 1; hot.size() < 100 || cold.size() < 100; id++)
+        (sharded.worker_of(id) == 0 ? hot : cold).push_back(id);
+    std::vector<uint8_t> buf;
+    generate_streams(buf, hot, cold, 400000, 4);
+
+    // a reader sees counts grow while the workers write
+    std::atomic<bool> done{ false };
+    uint64_t reads = 0;
+    bool monotonic = true;
+    std::thread reader([&]()
+    {
+        uint64_t last = 0;
+        while (!done.load())
+        {
+            consumer::latency_histogram_t h;
+            sharded.latency(hot[0], 10, h);
+            monotonic = monotonic && h.count() >= last;
+            last = h.count();
+            h.value_at(0.999);
+            reads++;
+            std::this_thread::yield();
+        }
+    });
+    replay(sharded, buf, 100000);
+    sharded.flush();
+    done = true;
+    reader.join();
+    ASSERT_TRUE(monotonic);
+    ASSERT_NE(uint64_t{ 0 }, reads);
+    ASSERT_NE(uint64_t{ 0 }, sharded.metrics().m_migrations);
+
+    // merged shards hold exactly what one aggregator has
+    consumer::aggregator_t reference(apo);
+    replay(reference, buf, buf.size());
+    std::size_t keys = 0;
+    reference.latencies()->for_each([&](const uint64_t stream_id, const uint64_t event_id, const consumer::latency_histogram_t& r)
+    {
+        consumer::latency_histogram_t h;
+        ASSERT_TRUE(sharded.latency(stream_id, event_id, h));
+        ASSERT_TRUE(h.m_counts == r.m_counts);
+        keys++;
+    });
+    ASSERT_NE(std::size_t{ 0 }, keys);
+}
@@ -0,0 +1,116 @@
+#include <neutrino_frames_serialized_v00.hpp>
+
+#if defined(__x86_64__) || defined(__i386__) || defined(_M_X64) || defined(_M_IX86)
+// SSSE3 code is built for the function only, baseline builds take it when the CPU has it
+#define NEUTRINO_NETWORK_BO_SHUFFLE
+#include <immintrin.h>
+#if defined(_MSC_VER)
+#include <intrin.h>
+#define NEUTRINO_TARGET_SSSE3
+#else
+#define NEUTRINO_TARGET_SSSE3 __attribute__((target("ssse3")))
+#endif
+#endif
+
+namespace neutrino
+{
+    namespace impl
+    {
+        namespace serialized
+        {
+            namespace v00
+            {
+                namespace
+                {
+                    typedef frames_t<network_byte_order_target_t>::checkpoint_t checkpoint_t;
+                    const std::size_t nanoepoch_offset = checkpoint_t::offset<0>();
+                    const std::size_t stream_id_offset = checkpoint_t::offset<1>();
+                    const std::size_t event_id_offset = checkpoint_t::offset<2>();
+                    const std::size_t frame_size = checkpoint_t::span();
+                    static_assert(stream_id_offset == nanoepoch_offset + 8, "nanoepoch and stream_id are loaded together");
+
+#if defined(NEUTRINO_NETWORK_BO_SHUFFLE)
+                    bool cpu_has_ssse3() noexcept
+                    {
+#if defined(__SSSE3__)
+                        return true;
+#elif defined(_MSC_VER)
+                        int r[4];
+                        __cpuid(r, 1);
+                        return (r[2] & (1 << 9)) != 0;
+#else
+                        // runs from a static initializer, possibly before the one of libgcc
+                        __builtin_cpu_init();
+                        return __builtin_cpu_supports("ssse3");
+#endif
+                    }
+
+                    // two frames per step: three shuffles, columns are stored as pairs
+                    NEUTRINO_TARGET_SSSE3 std::size_t decode_pairs_ssse3(
+                        const uint8_t* p
+                        , const std::size_t count
+                        , local::payload::nanoepoch_t::type_t* nanoepoch
+                        , local::payload::stream_id_t::type_t* stream_id
+                        , local::payload::event_id_t::type_t* event_id
+                    ) noexcept
+                    {
+                        const __m128i swap64 = _mm_set_epi8(8, 9, 10, 11, 12, 13, 14, 15, 0, 1, 2, 3, 4, 5, 6, 7);
+                        std::size_t cc = 0;
+                        for (; cc + 2 <= count; cc += 2, p += 2 * frame_size)
+                        {
+                            // [nanoepoch][stream_id] of each frame
+                            const __m128i a = _mm_shuffle_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i*>(p + nanoepoch_offset)), swap64);
+                            const __m128i b = _mm_shuffle_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i*>(p + frame_size + nanoepoch_offset)), swap64);
+                            // event_id of both frames in one register
+                            const __m128i e = _mm_shuffle_epi8(_mm_unpacklo_epi64(
+                                _mm_loadl_epi64(reinterpret_cast<const __m128i*>(p + event_id_offset))
+                                , _mm_loadl_epi64(reinterpret_cast<const __m128i*>(p + frame_size + event_id_offset))), swap64);
+                            _mm_storeu_si128(reinterpret_cast<__m128i*>(nanoepoch + cc), _mm_unpacklo_epi64(a, b));
+                            _mm_storeu_si128(reinterpret_cast<__m128i*>(stream_id + cc), _mm_unpackhi_epi64(a, b));
+                            _mm_storeu_si128(reinterpret_cast<__m128i*>(event_id + cc), e);
+                        }
+                        return cc;
+                    }
+
+                    const bool use_shuffle = !bo::host_is_network && cpu_has_ssse3();
+#else
+                    const bool use_shuffle = false;
+#endif
+                }
+
+                bool network_bo_shuffle() noexcept
+                {
+                    return use_shuffle;
+                }
+
+                void decode_checkpoints_network_bo_scalar(
+                    const uint8_t* p
+                    , const std::size_t count
+                    , local::payload::nanoepoch_t::type_t* nanoepoch
+                    , local::payload::stream_id_t::type_t* stream_id
+                    , local::payload::event_id_t::type_t* event_id
+                ) noexcept
+                {
+                    for (std::size_t cc = 0; cc < count; cc++, p += frame_size)
+                        checkpoint_t::decode(p, nanoepoch[cc], stream_id[cc], event_id[cc]);
+                }
+
+                void decode_checkpoints_network_bo(
+                    const uint8_t* p
+                    , const std::size_t count
+                    , local::payload::nanoepoch_t::type_t* nanoepoch
+                    , local::payload::stream_id_t::type_t* stream_id
+                    , local::payload::event_id_t::type_t* event_id
+                ) noexcept
+                {
+                    std::size_t cc = 0;
+#if defined(NEUTRINO_NETWORK_BO_SHUFFLE)
+                    if (use_shuffle)
+                        cc = decode_pairs_ssse3(p, count, nanoepoch, stream_id, event_id);
+#endif
+                    decode_checkpoints_network_bo_scalar(p + cc * frame_size, count - cc, nanoepoch + cc, stream_id + cc, event_id + cc);
+                }
+            }
+        }
+    }
+}
@@ -1,199 +1,487 @@
-#include <chrono>
-#include <array>
-
-#include <neutrino_transport.hpp>
-#include <neutrino_frames_serialized_native_bo.hpp>
-#include <neutrino_frames_serialized_network_bo.hpp>
-#include <neutrino_transport_endpoint_async_posix_handle.hpp>
-#include <neutrino_transport_buffered_mt.hpp>
-#include <neutrino_transport_buffered_st.hpp>
-
-using namespace neutrino::impl;
-
-namespace
-{
-    template <typename raw_encoding_t>
-    struct frame_v00_raw_traits_t
-    {
-        typedef serialized::raw_t<local::payload::header_t, raw_encoding_t> header_raw_t;
-        typedef serialized::raw_t<local::payload::nanoepoch_t, raw_encoding_t> nanoepoch_raw_t;
-        typedef serialized::raw_t<local::payload::stream_id_t, raw_encoding_t> stream_id_raw_t;
-        typedef serialized::raw_t<local::payload::event_id_t, raw_encoding_t> event_id_raw_t;
-        typedef serialized::raw_t<local::payload::event_type_t, raw_encoding_t> event_type_raw_t;
-        constexpr static const std::size_t max_buf_size = 2 * header_raw_t::span() + nanoepoch_raw_t::span() + stream_id_raw_t::span() + event_id_raw_t::span() + event_type_raw_t::span();
-    };
-
-
-
-    template <typename raw_encoding_t>
-    struct frame_v00_deserializer_endpoint_impl_t : public transport::endpoint_impl_t, frame_v00_raw_traits_t<raw_encoding_t>
-    {
-        using transport::endpoint_impl_t::endpoint_impl_t;
-
-        bool consume(const uint8_t* pBuf, const uint8_t* pBufEnd) final
-        {
-            const uint8_t* pFrameStart = pBuf;
-            const std::size_t b = pBufEnd - pBuf;
-            while(pFrameStart < pBufEnd)
-            {
-                local::payload::header_t::type_t header;
-                const uint8_t* pFrameHeader = pFrameStart;
-                const uint8_t* pFrameEnd = pFrameHeader;
-                pFrameStart += header_raw_t::span();
-
-                if (pFrameStart >= pBufEnd || !header_raw_t::convert(pFrameHeader, header))
-                    break;
-
-                if (header == local::frame::v00::checkpoint::header)
-                {
-                    const uint8_t* pFrameNanoepoch = pFrameStart;
-                    const uint8_t* pFrameStreamId = pFrameNanoepoch + nanoepoch_raw_t::span();
-                    const uint8_t* pFrameEventId = pFrameStreamId + stream_id_raw_t::span();
-                    const uint8_t* pFrameFooter = pFrameEventId + event_id_raw_t::span();
-                    pFrameEnd = pFrameFooter + header_raw_t::span();
-                    if (pFrameEnd > pBufEnd)
-                        break;
-                    local::payload::header_t::type_t footer;
-                    if (!header_raw_t::convert(pFrameFooter, footer))
-                        break;
-                    if (footer != header)
-                        break;
-                    local::payload::nanoepoch_t::type_t nanoepoch;
-                    local::payload::stream_id_t::type_t stream_id;
-                    local::payload::event_id_t::type_t event_id;
-                    nanoepoch_raw_t::convert(pFrameNanoepoch, nanoepoch);
-                    stream_id_raw_t::convert(pFrameStreamId, stream_id);
-                    event_id_raw_t::convert(pFrameEventId, event_id);
-                    m_consumer.consume_checkpoint(nanoepoch, stream_id, event_id);
-                }
-                else if (header == local::frame::v00::context::header_context)
-                {
-                    const uint8_t* pFrameNanoepoch = pFrameStart;
-                    const uint8_t* pFrameStreamId = pFrameNanoepoch + nanoepoch_raw_t::span();
-                    const uint8_t* pFrameEventId = pFrameStreamId + stream_id_raw_t::span();
-                    const uint8_t* pFrameEventType = pFrameEventId + event_id_raw_t::span();
-                    const uint8_t* pFrameFooter = pFrameEventType + event_type_raw_t::span();
-                    pFrameEnd = pFrameFooter + header_raw_t::span();
-                    if (pFrameEnd > pBufEnd)
-                        break;
-                    local::payload::header_t::type_t footer;
-                    if (!header_raw_t::convert(pFrameFooter, footer))
-                        break;
-                    if (footer != header)
-                        break;
-                    local::payload::nanoepoch_t::type_t nanoepoch;
-                    local::payload::stream_id_t::type_t stream_id;
-                    local::payload::event_id_t::type_t event_id;
-                    local::payload::event_type_t::type_t event_type;
-                    nanoepoch_raw_t::convert(pFrameNanoepoch, nanoepoch);
-                    stream_id_raw_t::convert(pFrameStreamId, stream_id);
-                    event_id_raw_t::convert(pFrameEventId, event_id);
-                    event_type_raw_t::convert(pFrameEventType, event_type);
-
-                    if (event_type > static_cast<decltype(event_type)>(local::payload::event_type_t::event_types::NO_CONTEXT) && event_type < static_cast<decltype(event_type)>(local::payload::event_type_t::event_types::_LAST))
-                    {
-                        m_consumer.consume_context(nanoepoch, stream_id, event_id, static_cast<local::payload::event_type_t::event_types>(event_type));
-                    }
-                    else
-                    {
-                        break; // unknown event type
-                    }
-                }
-                else
-                    break;
-                pFrameStart = pFrameEnd;
-            }
-            // TODO: notify not consumed bytes
-            return (pFrameStart - pBuf) == b;
-        };
-    };
-
-    template <typename raw_encoding_t>
-    struct frame_v00_serializer_consumer_stub_impl_t : public transport::consumer_stub_t, frame_v00_raw_traits_t<raw_encoding_t>
-    {
-        using transport::consumer_stub_t::consumer_stub_t;
-
-        void consume_checkpoint(
-            const local::payload::nanoepoch_t::type_t& nanoepoch
-            , const local::payload::stream_id_t::type_t& stream_id
-            , const local::payload::event_id_t::type_t& event_id
-        ) final
-        {
-            std::array<uint8_t, max_buf_size > buf;
-            const auto header = local::frame::v00::checkpoint::header;
-            m_endpoint.consume(
-                buf.data()
-                , header_raw_t::convert(header
-                    , event_id_raw_t::convert(event_id
-                        , stream_id_raw_t::convert(stream_id
-                            , nanoepoch_raw_t::convert(nanoepoch
-                                , header_raw_t::convert(header
-                                    , buf.data())))))
-            );
-        }
-
-        void consume_context(
-            const local::payload::nanoepoch_t::type_t& nanoepoch
-            , const local::payload::stream_id_t::type_t& stream_id
-            , const local::payload::event_id_t::type_t& event_id
-            , const local::payload::event_type_t::event_types& event_type
-        ) final
-        {
-            std::array<uint8_t, max_buf_size> buf;
-            const auto header = local::frame::v00::context::header_context;
-
-            m_endpoint.consume(
-                buf.data()
-                , header_raw_t::convert( header
-                    , event_type_raw_t::convert(event_type
-                        , event_id_raw_t::convert(event_id
-                            , stream_id_raw_t::convert(stream_id
-                                , nanoepoch_raw_t::convert(nanoepoch
-                                    , header_raw_t::convert(header
-                                        , buf.data()))))))
-            );
-        }
-    };
-}
-
-namespace neutrino
-{
-    namespace impl
-    {
-        namespace transport
-        {
-            namespace frame_v00
-            {
-                std::shared_ptr<consumer_stub_t> create_consumer_stub(known_encodings_t ke, endpoint_t& endpoint)
-                {
-                    switch(ke)
-                    {
-                    case known_encodings_t::BINARY_NETWORK:
-                        return std::shared_ptr<consumer_stub_t>(new frame_v00_serializer_consumer_stub_impl_t<serialized::network_byte_order_target_t>(endpoint));
-                    case known_encodings_t::BINARY_NATIVE:
-                        return std::shared_ptr<consumer_stub_t>(new frame_v00_serializer_consumer_stub_impl_t<serialized::native_byte_order_target_t>(endpoint));
-                    case known_encodings_t::JSON:
-                    default:
-                        break;
-                    }
-                    return std::shared_ptr<consumer_stub_t>(new consumer_stub_t(endpoint));
-                }
-
-                std::shared_ptr<endpoint_impl_t> create_endpoint_impl(known_encodings_t ke, consumer_t& consumer)
-                {
-                    switch (ke)
-                    {
-                    case known_encodings_t::BINARY_NETWORK:
-                        return std::shared_ptr<endpoint_impl_t>(new frame_v00_deserializer_endpoint_impl_t<serialized::network_byte_order_target_t>(consumer));
-                    case known_encodings_t::BINARY_NATIVE:
-                        return std::shared_ptr<endpoint_impl_t>(new frame_v00_deserializer_endpoint_impl_t<serialized::native_byte_order_target_t>(consumer));
-                    case known_encodings_t::JSON:
-                    default:
-                        break;
-                    }
-                    return std::shared_ptr<endpoint_impl_t>(new endpoint_impl_t(consumer));
-                }
-            }
-        }
-    }
-}
+#include <chrono>
+#include <array>
+#include <algorithm>
+
+#include <neutrino_transport.hpp>
+#include <neutrino_frames_serialized_v00.hpp>
+#include <neutrino_transport_endpoint_async_posix_handle.hpp>
+#include <neutrino_transport_buffered_mt.hpp>
+#include <neutrino_transport_buffered_st.hpp>
+
+using namespace neutrino::impl;
+
+namespace
+{
+    // decodes count back to back checkpoint frames, their headers and footers are already checked
+    template <typename raw_encoding_t>
+    struct frame_v00_checkpoint_run_t
+    {
+        typedef typename serialized::v00::frames_t<raw_encoding_t>::checkpoint_t checkpoint_t;
+
+        static void decode(
+            const uint8_t* p
+            , const std::size_t count
+            , local::payload::nanoepoch_t::type_t* nanoepoch
+            , local::payload::stream_id_t::type_t* stream_id
+            , local::payload::event_id_t::type_t* event_id
+        ) noexcept
+        {
+            for (std::size_t cc = 0; cc < count; cc++, p += checkpoint_t::span())
+                checkpoint_t::decode(p, nanoepoch[cc], stream_id[cc], event_id[cc]);
+        }
+    };
+
+    template <>
+    struct frame_v00_checkpoint_run_t<serialized::network_byte_order_target_t>
+    {
+        static void decode(
+            const uint8_t* p
+            , const std::size_t count
+            , local::payload::nanoepoch_t::type_t* nanoepoch
+            , local::payload::stream_id_t::type_t* stream_id
+            , local::payload::event_id_t::type_t* event_id
+        ) noexcept
+        {
+            serialized::v00::decode_checkpoints_network_bo(p, count, nanoepoch, stream_id, event_id);
+        }
+    };
+
+    template <typename raw_encoding_t>
+    struct frame_v00_deserializer_endpoint_impl_t : public transport::endpoint_impl_t
+    {
+        using transport::endpoint_impl_t::endpoint_impl_t;
+
+        typedef serialized::v00::frames_t<raw_encoding_t> frames_t;
+        typedef typename frames_t::checkpoint_t checkpoint_t;
+        typedef typename frames_t::context_t context_t;
+        typedef typename frames_t::clock_calibration_t clock_calibration_t;
+        typedef serialized::raw_t<local::payload::header_t, raw_encoding_t> header_raw_t;
+
+        constexpr static const std::size_t batch_frames = 64;
+        constexpr static const std::size_t columns_frames = 256;
+
+        // number of well formed checkpoint frames starting at p, up to batch_frames
+        static std::size_t checkpoint_run(const uint8_t* p, const uint8_t* pBufEnd) noexcept
+        {
+            std::size_t run = 0;
+            for (; run < batch_frames && checkpoint_t::check(p, pBufEnd); run++)
+                p += checkpoint_t::span();
+            return run;
+        }
+
+        // span of the frame with header at p, 0 for unknown header
+        static std::size_t frame_span(const uint8_t* p, const uint8_t* pBufEnd) noexcept
+        {
+            local::payload::header_t::type_t header;
+            if (pBufEnd - p < std::ptrdiff_t(header_raw_t::span()) || !header_raw_t::convert(p, header))
+                return 0;
+            return header == local::frame::v00::checkpoint::header ? checkpoint_t::span()
+                : header == local::frame::v00::context::header_context ? context_t::span()
+                : header == local::frame::v00::clock_calibration::header ? clock_calibration_t::span()
+                : 0;
+        }
+
+        // decodes whole frames from pBuf on, returns the first byte not decoded
+        const uint8_t* decode(const uint8_t* pBuf, const uint8_t* pBufEnd, transport::frames_columns_collector_t<columns_frames>& columns)
+        {
+            const uint8_t* pFrameStart = pBuf;
+            while(pFrameStart < pBufEnd)
+            {
+                local::payload::header_t::type_t header;
+                if (pBufEnd - pFrameStart < std::ptrdiff_t(header_raw_t::span()) || !header_raw_t::convert(pFrameStart, header))
+                    break;
+
+                if (header == local::frame::v00::checkpoint::header)
+                {
+                    // runs of checkpoints are decoded at once right into the columns
+                    const std::size_t run = checkpoint_run(pFrameStart, pBufEnd);
+                    if (!run)
+                        break;
+                    const std::size_t at = columns.reserve(run);
+                    frame_v00_checkpoint_run_t<raw_encoding_t>::decode(pFrameStart, run, columns.m_nanoepoch.data() + at, columns.m_stream_id.data() + at, columns.m_event_id.data() + at);
+                    std::fill_n(columns.m_event_type.data() + at, run, static_cast<local::payload::event_type_t::type_t>(local::payload::event_type_t::event_types::NO_CONTEXT));
+                    columns.commit(run);
+                    pFrameStart += run * checkpoint_t::span();
+                }
+                else if (header == local::frame::v00::context::header_context)
+                {
+                    if (!context_t::check(pFrameStart, pBufEnd))
+                        break;
+                    local::payload::nanoepoch_t::type_t nanoepoch;
+                    local::payload::stream_id_t::type_t stream_id;
+                    local::payload::event_id_t::type_t event_id;
+                    local::payload::event_type_t::type_t event_type;
+                    context_t::decode(pFrameStart, nanoepoch, stream_id, event_id, event_type);
+
+                    if (event_type > static_cast<decltype(event_type)>(local::payload::event_type_t::event_types::NO_CONTEXT) && event_type < static_cast<decltype(event_type)>(local::payload::event_type_t::event_types::_LAST))
+                    {
+                        columns.push(nanoepoch, stream_id, event_id, event_type);
+                    }
+                    else
+                    {
+                        break; // unknown event type
+                    }
+                    pFrameStart += context_t::span();
+                }
+                else if (header == local::frame::v00::clock_calibration::header)
+                {
+                    if (!clock_calibration_t::check(pFrameStart, pBufEnd))
+                        break;
+                    local::payload::ticks_t::type_t ticks;
+                    local::payload::nanoepoch_t::type_t nanoepoch;
+                    local::payload::ticks_mult_t::type_t mult;
+                    local::payload::ticks_shift_t::type_t shift;
+                    clock_calibration_t::decode(pFrameStart, ticks, nanoepoch, mult, shift);
+                    columns.flush(); // frames before calibration are in the old time base
+                    m_consumer.consume_clock_calibration(ticks, nanoepoch, mult, shift);
+                    pFrameStart += clock_calibration_t::span();
+                }
+                else
+                    break;
+            }
+            return pFrameStart;
+        }
+
+        bool consume(const uint8_t* pBuf, const uint8_t* pBufEnd) override
+        {
+            transport::frames_columns_collector_t<columns_frames> columns(m_consumer);
+            const uint8_t* pFrameStart = decode(pBuf, pBufEnd, columns);
+            columns.flush();
+            // TODO: notify not consumed bytes
+            return pFrameStart == pBufEnd;
+        };
+    };
+
+    // for byte streams (pipes, stream sockets) cut at arbitrary points: frames are decoded in place from the caller's buffer,
+    // a frame cut at the end is kept in a fixed tail and completed by the next consume().
+    // v00 has no magic: after a broken frame decoding goes on from the first position with two well formed frames in a row,
+    // a damaged channel may still yield false frames there, see framed endpoints for channels which need more than that
+    template <typename raw_encoding_t>
+    struct frame_v00_stream_deserializer_endpoint_impl_t final : public frame_v00_deserializer_endpoint_impl_t<raw_encoding_t>
+    {
+        typedef frame_v00_deserializer_endpoint_impl_t<raw_encoding_t> base_t;
+        using base_t::base_t;
+
+        constexpr static const std::size_t max_frame_size =
+            base_t::checkpoint_t::span() > base_t::context_t::span()
+            ? (base_t::checkpoint_t::span() > base_t::clock_calibration_t::span() ? base_t::checkpoint_t::span() : base_t::clock_calibration_t::span())
+            : (base_t::context_t::span() > base_t::clock_calibration_t::span() ? base_t::context_t::span() : base_t::clock_calibration_t::span());
+
+        std::array<uint8_t, 2 * max_frame_size> m_tail; // a frame cut at the end of the input, or bytes to resync on
+        std::size_t m_tail_size = 0;
+        bool m_resync = false; // after a broken frame: m_tail holds bytes not told apart yet
+
+        enum class sync_t
+        {
+            FRAMES, // two well formed frames in a row
+            NONE,
+            MORE // too few bytes to tell
+        };
+
+        // span of the well formed frame at p, 0 when there is none
+        static std::size_t whole_frame(const uint8_t* p, const uint8_t* pBufEnd) noexcept
+        {
+            local::payload::header_t::type_t header;
+            if (pBufEnd - p < std::ptrdiff_t(base_t::header_raw_t::span()) || !base_t::header_raw_t::convert(p, header))
+                return 0;
+            if (header == local::frame::v00::checkpoint::header)
+                return base_t::checkpoint_t::check(p, pBufEnd) ? base_t::checkpoint_t::span() : 0;
+            if (header == local::frame::v00::clock_calibration::header)
+                return base_t::clock_calibration_t::check(p, pBufEnd) ? base_t::clock_calibration_t::span() : 0;
+            if (header != local::frame::v00::context::header_context || !base_t::context_t::check(p, pBufEnd))
+                return 0;
+            local::payload::nanoepoch_t::type_t nanoepoch;
+            local::payload::stream_id_t::type_t stream_id;
+            local::payload::event_id_t::type_t event_id;
+            local::payload::event_type_t::type_t event_type;
+            base_t::context_t::decode(p, nanoepoch, stream_id, event_id, event_type);
+            return event_type > static_cast<decltype(event_type)>(local::payload::event_type_t::event_types::NO_CONTEXT)
+                && event_type < static_cast<decltype(event_type)>(local::payload::event_type_t::event_types::_LAST)
+                ? base_t::context_t::span() : 0;
+        }
+
+        static sync_t sync_at(const uint8_t* p, const uint8_t* pBufEnd) noexcept
+        {
+            for (int frame = 0; frame < 2; frame++)
+            {
+                if (p == pBufEnd)
+                    return sync_t::MORE;
+                const std::size_t span = base_t::frame_span(p, pBufEnd);
+                if (!span)
+                    return sync_t::NONE;
+                if (std::size_t(pBufEnd - p) < span)
+                    return sync_t::MORE;
+                if (!whole_frame(p, pBufEnd))
+                    return sync_t::NONE;
+                p += span;
+            }
+            return sync_t::FRAMES;
+        }
+
+        // first position from p on where sync_at() tells FRAMES (found) or MORE, pBufEnd when there is none
+        static const uint8_t* resync(const uint8_t* p, const uint8_t* pBufEnd, bool& found) noexcept
+        {
+            for (; p < pBufEnd; p++)
+            {
+                const sync_t s = sync_at(p, pBufEnd);
+                if (s != sync_t::NONE)
+                {
+                    found = s == sync_t::FRAMES;
+                    return p;
+                }
+            }
+            found = false;
+            return pBufEnd;
+        }
+
+        // false: a broken frame, its bytes are dropped until two frames in a row show up
+        bool consume(const uint8_t* pBuf, const uint8_t* pBufEnd) final
+        {
+            transport::frames_columns_collector_t<base_t::columns_frames> columns(this->m_consumer);
+            bool ret = true;
+            for (;;)
+            {
+                if (m_resync)
+                {
+                    // bytes kept from before and as much of the input as the tail holds, two frames always fit
+                    const std::size_t b = std::min<std::size_t>(m_tail.size() - m_tail_size, pBufEnd - pBuf);
+                    std::copy(pBuf, pBuf + b, m_tail.data() + m_tail_size);
+                    m_tail_size += b;
+                    pBuf += b;
+                    bool found;
+                    const uint8_t* p = resync(m_tail.data(), m_tail.data() + m_tail_size, found);
+                    if (p != m_tail.data())
+                        ret = false;
+                    if (found)
+                    {
+                        p = this->decode(p, m_tail.data() + m_tail_size, columns);
+                        m_resync = false;
+                    }
+                    m_tail_size = std::copy(p, static_cast<const uint8_t*>(m_tail.data() + m_tail_size), m_tail.data()) - m_tail.data();
+                    if (m_resync)
+                    {
+                        if (pBuf == pBufEnd)
+                            break;
+                        continue;
+                    }
+                }
+
+                if (m_tail_size)
+                {
+                    // header is in the tail already
+                    const std::size_t span = base_t::frame_span(m_tail.data(), m_tail.data() + m_tail_size);
+                    if (span && m_tail_size < span)
+                    {
+                        const std::size_t b = std::min<std::size_t>(span - m_tail_size, pBufEnd - pBuf);
+                        std::copy(pBuf, pBuf + b, m_tail.data() + m_tail_size);
+                        m_tail_size += b;
+                        pBuf += b;
+                        if (m_tail_size < span)
+                            break;
+                    }
+                    std::size_t taken = span;
+                    if (!span || this->decode(m_tail.data(), m_tail.data() + span, columns) != m_tail.data() + span)
+                    {
+                        // broken, the next frame may start right after its first byte
+                        ret = false;
+                        m_resync = true;
+                        taken = 1;
+                    }
+                    m_tail_size = std::copy(m_tail.data() + taken, m_tail.data() + m_tail_size, m_tail.data()) - m_tail.data();
+                    continue;
+                }
+
+                const uint8_t* pFrameStart = pBuf;
+                while (pFrameStart < pBufEnd)
+                {
+                    pFrameStart = this->decode(pFrameStart, pBufEnd, columns);
+                    if (pFrameStart == pBufEnd)
+                        break;
+                    const std::size_t span = base_t::frame_span(pFrameStart, pBufEnd);
+                    if (span && std::size_t(pBufEnd - pFrameStart) < span)
+                    {
+                        m_tail_size = std::copy(pFrameStart, pBufEnd, m_tail.data()) - m_tail.data();
+                        break;
+                    }
+                    ret = false; // TODO: notify not consumed bytes
+                    bool found;
+                    pFrameStart = resync(pFrameStart + 1, pBufEnd, found);
+                    if (!found)
+                    {
+                        // fewer than two frames left, told apart with the next input
+                        m_tail_size = std::copy(pFrameStart, pBufEnd, m_tail.data()) - m_tail.data();
+                        m_resync = true;
+                        break;
+                    }
+                }
+                break;
+            }
+            columns.flush();
+            return ret;
+        }
+    };
+
+    template <typename raw_encoding_t>
+    struct frame_v00_serializer_consumer_stub_impl_t : public transport::consumer_stub_t
+    {
+        using transport::consumer_stub_t::consumer_stub_t;
+
+        typedef serialized::v00::frames_t<raw_encoding_t> frames_t;
+
+        constexpr static const std::size_t batch_frames = 64;
+
+        void consume_checkpoint(
+            const local::payload::nanoepoch_t::type_t& nanoepoch
+            , const local::payload::stream_id_t::type_t& stream_id
+            , const local::payload::event_id_t::type_t& event_id
+        ) final
+        {
+            // encode right into endpoint's buffer when it has one
+            if (uint8_t* p = m_endpoint.reserve(frames_t::checkpoint_size))
+            {
+                frames_t::checkpoint(p, nanoepoch, stream_id, event_id);
+                m_endpoint.commit(p, frames_t::checkpoint_size);
+                return;
+            }
+            std::array<uint8_t, frames_t::checkpoint_size> buf;
+            m_endpoint.consume(buf.data(), frames_t::checkpoint(buf.data(), nanoepoch, stream_id, event_id));
+        }
+
+        void consume_context(
+            const local::payload::nanoepoch_t::type_t& nanoepoch
+            , const local::payload::stream_id_t::type_t& stream_id
+            , const local::payload::event_id_t::type_t& event_id
+            , const local::payload::event_type_t::event_types& event_type
+        ) final
+        {
+            if (uint8_t* p = m_endpoint.reserve(frames_t::context_size))
+            {
+                frames_t::context(p, nanoepoch, stream_id, event_id, static_cast<local::payload::event_type_t::type_t>(event_type));
+                m_endpoint.commit(p, frames_t::context_size);
+                return;
+            }
+            std::array<uint8_t, frames_t::context_size> buf;
+            m_endpoint.consume(buf.data(), frames_t::context(buf.data(), nanoepoch, stream_id, event_id, static_cast<local::payload::event_type_t::type_t>(event_type)));
+        }
+
+        void consume_checkpoint_batch(
+            const std::size_t count
+            , const local::payload::nanoepoch_t::type_t* nanoepoch
+            , const local::payload::stream_id_t::type_t* stream_id
+            , const local::payload::event_id_t::type_t* event_id
+        ) final
+        {
+            // up to batch_frames frames are serialized back to back and handed over with one call
+            std::array<uint8_t, batch_frames * frames_t::checkpoint_size> buf;
+            for (std::size_t cc = 0; cc < count; )
+            {
+                uint8_t* p = buf.data();
+                for (const auto last = std::min(count, cc + batch_frames); cc < last; cc++)
+                    p = frames_t::checkpoint(p, nanoepoch[cc], stream_id[cc], event_id[cc]);
+                m_endpoint.consume_frames(buf.data(), p, frames_t::checkpoint_size);
+            }
+        }
+
+        void consume_context_batch(
+            const std::size_t count
+            , const local::payload::nanoepoch_t::type_t* nanoepoch
+            , const local::payload::stream_id_t::type_t* stream_id
+            , const local::payload::event_id_t::type_t* event_id
+            , const local::payload::event_type_t::type_t* event_type
+        ) final
+        {
+            std::array<uint8_t, batch_frames * frames_t::context_size> buf;
+            for (std::size_t cc = 0; cc < count; )
+            {
+                uint8_t* p = buf.data();
+                for (const auto last = std::min(count, cc + batch_frames); cc < last; cc++)
+                {
+                    // deserializer drops the rest of a buffer on unknown event type, do not send it
+                    if (event_type[cc] > static_cast<local::payload::event_type_t::type_t>(local::payload::event_type_t::event_types::NO_CONTEXT)
+                        && event_type[cc] < static_cast<local::payload::event_type_t::type_t>(local::payload::event_type_t::event_types::_LAST))
+                    {
+                        p = frames_t::context(p, nanoepoch[cc], stream_id[cc], event_id[cc], event_type[cc]);
+                    }
+                }
+                m_endpoint.consume_frames(buf.data(), p, frames_t::context_size);
+            }
+        }
+
+        void consume_clock_calibration(
+            const local::payload::ticks_t::type_t& ticks
+            , const local::payload::nanoepoch_t::type_t& nanoepoch
+            , const local::payload::ticks_mult_t::type_t& mult
+            , const local::payload::ticks_shift_t::type_t& shift
+        ) final
+        {
+            std::array<uint8_t, frames_t::clock_calibration_size> buf;
+            m_endpoint.consume(buf.data(), frames_t::clock_calibration_t::encode(buf.data(), ticks, nanoepoch, mult, shift));
+        }
+    };
+}
+
+namespace neutrino
+{
+    namespace impl
+    {
+        namespace transport
+        {
+            namespace frame_v00
+            {
+                std::shared_ptr<consumer_stub_t> create_consumer_stub(known_encodings_t ke, endpoint_t& endpoint)
+                {
+                    switch(ke)
+                    {
+                    case known_encodings_t::BINARY_NETWORK:
+                        return std::shared_ptr<consumer_stub_t>(new frame_v00_serializer_consumer_stub_impl_t<serialized::network_byte_order_target_t>(endpoint));
+                    case known_encodings_t::BINARY_NATIVE:
+                        return std::shared_ptr<consumer_stub_t>(new frame_v00_serializer_consumer_stub_impl_t<serialized::native_byte_order_target_t>(endpoint));
+                    case known_encodings_t::COMPACT_V01:
+                        return frame_v01::create_consumer_stub(endpoint);
+                    case known_encodings_t::JSON:
+                        return frame_json::create_consumer_stub(endpoint);
+                    default:
+                        break;
+                    }
+                    return std::shared_ptr<consumer_stub_t>(new consumer_stub_t(endpoint));
+                }
+
+                std::shared_ptr<endpoint_impl_t> create_endpoint_impl(known_encodings_t ke, consumer_t& consumer)
+                {
+                    switch (ke)
+                    {
+                    case known_encodings_t::BINARY_NETWORK:
+                        return std::shared_ptr<endpoint_impl_t>(new frame_v00_deserializer_endpoint_impl_t<serialized::network_byte_order_target_t>(consumer));
+                    case known_encodings_t::BINARY_NATIVE:
+                        return std::shared_ptr<endpoint_impl_t>(new frame_v00_deserializer_endpoint_impl_t<serialized::native_byte_order_target_t>(consumer));
+                    case known_encodings_t::COMPACT_V01:
+                        return frame_v01::create_endpoint_impl(consumer);
+                    case known_encodings_t::JSON:
+                        return frame_json::create_endpoint_impl(consumer);
+                    default:
+                        break;
+                    }
+                    return std::shared_ptr<endpoint_impl_t>(new endpoint_impl_t(consumer));
+                }
+
+                std::shared_ptr<endpoint_impl_t> create_stream_endpoint_impl(known_encodings_t ke, consumer_t& consumer)
+                {
+                    switch (ke)
+                    {
+                    case known_encodings_t::BINARY_NETWORK:
+                        return std::shared_ptr<endpoint_impl_t>(new frame_v00_stream_deserializer_endpoint_impl_t<serialized::network_byte_order_target_t>(consumer));
+                    case known_encodings_t::BINARY_NATIVE:
+                        return std::shared_ptr<endpoint_impl_t>(new frame_v00_stream_deserializer_endpoint_impl_t<serialized::native_byte_order_target_t>(consumer));
+                    case known_encodings_t::JSON:
+                        // keeps partial lines itself
+                        return frame_json::create_endpoint_impl(consumer);
+                    default:
+                        break;
+                    }
+                    // v01 blocks cut by a read are lost, they need record boundaries (socket records, framed_endpoint_t)
+                    return nullptr;
+                }
+            }
+        }
+    }
+}
@@ -1,334 +1,866 @@
-#include <gtest/gtest.h>
-#include <thread>
-#include <neutrino_mock.hpp>
-
-#include <neutrino_producer.hpp>
-
-using namespace neutrino::impl;
-
-TEST(neutrino_nanoepoch, is_linear)
-{
-    auto x1 = neutrino_nanoepoch();
-    auto x2 = neutrino_nanoepoch();
-    auto x3 = neutrino_nanoepoch();
-
-    ASSERT_TRUE(x3 > x2);
-    ASSERT_TRUE(x2 > x1);
-}
-
-TEST(neutrino_nanoepoch, interval)
-{
-    auto sleep_nanoseconds = std::chrono::nanoseconds(std::chrono::milliseconds(200));
-    auto sleep_nanoseconds_max = sleep_nanoseconds + std::chrono::milliseconds(200); // granularity is unknown, assume worst
-    auto x1 = neutrino_nanoepoch();
-    std::this_thread::sleep_for(sleep_nanoseconds);
-    auto x2 = neutrino_nanoepoch();
-
-    ASSERT_TRUE((x2 - x1) >= sleep_nanoseconds.count());
-    ASSERT_TRUE((x2 - x1) < sleep_nanoseconds_max.count());
-}
-
-struct neutrino_general_workflow_tests : public ::testing::Test
-{
-    const uint64_t checkpoint_id_1 = 1;
-    const uint64_t checkpoint_id_2 = 2;
-
-    const uint64_t nanoepoch_1 = 101;
-    const uint64_t nanoepoch_2 = 102;
-    const uint64_t nanoepoch_3 = 103;
-    const uint64_t nanoepoch_4 = 104;
-
-    const uint64_t stream_id_1 = 301;
-    const uint64_t stream_id_2 = 302;
-
-    template <transport::frame_v00::known_encodings_t transport_encoding>
-    struct channel_t
-    {
-        std::shared_ptr<neutrino::mock::connection_t<neutrino::impl::transport::endpoint_impl_t>> m_connection;
-        std::shared_ptr<transport::endpoint_impl_t> m_endpoint_impl;
-        std::shared_ptr<transport::consumer_stub_t> m_consumer_stub;
-
-        channel_t(neutrino::mock::consumer_t& consumer)
-        {
-            m_endpoint_impl = transport::frame_v00::create_endpoint_impl(
-                transport_encoding, consumer);
-
-            m_connection.reset(new neutrino::mock::connection_t<neutrino::impl::transport::endpoint_impl_t>(*m_endpoint_impl));
-
-            m_consumer_stub = transport::frame_v00::create_consumer_stub(
-                transport_encoding, *m_connection);
-        }
-    };
-
-    template <transport::frame_v00::known_encodings_t transport_encoding>
-    struct channel_guard_t
-    {
-        std::shared_ptr<channel_t<transport_encoding>> m_channel;
-        channel_guard_t(neutrino::mock::consumer_t& mock_consumer)
-        {
-            m_channel.reset(new channel_t<transport_encoding>(mock_consumer));
-        }
-    };
-
-    std::shared_ptr<neutrino::mock::consumer_t> m_mock_consumer;
-
-    void SetUp() final
-    {
-        m_mock_consumer.reset(new neutrino::mock::consumer_t());
-    }
-
-    void TearDown() final
-    {
-        ASSERT_TRUE(m_mock_consumer.get());
-        ASSERT_TRUE(m_mock_consumer->m_expected_checkpoints.empty());
-        ASSERT_TRUE(m_mock_consumer->m_expected_contexts.empty());
-        m_mock_consumer.reset();
-    }
-
-    template <transport::frame_v00::known_encodings_t transport_encoding>
-    void validate_checkpoint_same_stream()
-    {
-        SCOPED_TRACE(__FUNCTION__);
-        m_mock_consumer->
-            expect_checkpoint(nanoepoch_1, stream_id_1, checkpoint_id_1)
-            .expect_checkpoint(nanoepoch_2, stream_id_1, checkpoint_id_2);
-
-        channel_guard_t<transport_encoding> g(*m_mock_consumer);
-
-        {
-            neutrino::mock::scoped_guard sg(g.m_channel->m_consumer_stub);
-
-            ASSERT_NO_THROW(neutrino_checkpoint(nanoepoch_1, stream_id_1, checkpoint_id_1));
-            ASSERT_NO_THROW(neutrino_checkpoint(nanoepoch_2, stream_id_1, checkpoint_id_2));
-        }
-    }
-
-    template <transport::frame_v00::known_encodings_t transport_encoding>
-    void validate_checkpoint_different_stream()
-    {
-        SCOPED_TRACE(__FUNCTION__);
-        (*m_mock_consumer)
-            .expect_checkpoint(nanoepoch_1, stream_id_1, checkpoint_id_1)
-            .expect_checkpoint(nanoepoch_2, stream_id_2, checkpoint_id_2);
-
-        channel_guard_t<transport_encoding> g(*m_mock_consumer);
-
-        {
-            neutrino::mock::scoped_guard sg(g.m_channel->m_consumer_stub);
-
-            ASSERT_NO_THROW(neutrino_checkpoint(nanoepoch_1, stream_id_1, checkpoint_id_1));
-            ASSERT_NO_THROW(neutrino_checkpoint(nanoepoch_2, stream_id_2, checkpoint_id_2));
-        }
-    }
-
-    template <transport::frame_v00::known_encodings_t transport_encoding>
-    void validate_context_enter_leave_same_stream()
-    {
-        SCOPED_TRACE(__FUNCTION__);
-        (*m_mock_consumer)
-            .expect_context_enter(nanoepoch_1, stream_id_1, checkpoint_id_1)
-            .expect_context_leave(nanoepoch_2, stream_id_1, checkpoint_id_1);
-
-        channel_guard_t<transport_encoding> g(*m_mock_consumer);
-
-        {
-            neutrino::mock::scoped_guard sg(g.m_channel->m_consumer_stub);
-
-            ASSERT_NO_THROW(neutrino_context_enter(nanoepoch_1, stream_id_1, checkpoint_id_1));
-            ASSERT_NO_THROW(neutrino_context_leave(nanoepoch_2, stream_id_1, checkpoint_id_1));
-        }
-    }
-
-    template <transport::frame_v00::known_encodings_t transport_encoding>
-    void validate_context_enter_leave_interleaved_stream()
-    {
-        SCOPED_TRACE(__FUNCTION__);
-        (*m_mock_consumer)
-            .expect_context_enter(nanoepoch_1, stream_id_1, checkpoint_id_1)
-            .expect_context_enter(nanoepoch_1, stream_id_2, checkpoint_id_1)
-            .expect_context_leave(nanoepoch_2, stream_id_1, checkpoint_id_1)
-            .expect_context_leave(nanoepoch_2, stream_id_2, checkpoint_id_1)
-            ;
-
-        channel_guard_t<transport_encoding> g(*m_mock_consumer);
-
-        {
-            neutrino::mock::scoped_guard sg(g.m_channel->m_consumer_stub);
-
-            ASSERT_NO_THROW(neutrino_context_enter(nanoepoch_1, stream_id_1, checkpoint_id_1));
-            ASSERT_NO_THROW(neutrino_context_enter(nanoepoch_1, stream_id_2, checkpoint_id_1));
-            ASSERT_NO_THROW(neutrino_context_leave(nanoepoch_2, stream_id_1, checkpoint_id_1));
-            ASSERT_NO_THROW(neutrino_context_leave(nanoepoch_2, stream_id_2, checkpoint_id_1));
-        }
-    }
-
-    template <transport::frame_v00::known_encodings_t transport_encoding>
-    void validate_context_enter_panic_same_stream()
-    {
-        SCOPED_TRACE(__FUNCTION__);
-        (*m_mock_consumer)
-            .expect_context_enter(nanoepoch_1, stream_id_1, checkpoint_id_1)
-            .expect_context_panic(nanoepoch_2, stream_id_1, checkpoint_id_1);
-
-        channel_guard_t<transport_encoding> g(*m_mock_consumer);
-
-        {
-            neutrino::mock::scoped_guard sg(g.m_channel->m_consumer_stub);
-
-            ASSERT_NO_THROW(neutrino_context_enter(nanoepoch_1, stream_id_1, checkpoint_id_1));
-            ASSERT_NO_THROW(neutrino_context_panic(nanoepoch_2, stream_id_1, checkpoint_id_1));
-        }
-    }
-
-    template <transport::frame_v00::known_encodings_t transport_encoding>
-    void validate_context_enter_panic_interleaved_stream()
-    {
-        SCOPED_TRACE(__FUNCTION__);
-        (*m_mock_consumer)
-            .expect_context_enter(nanoepoch_1, stream_id_1, checkpoint_id_1)
-            .expect_context_enter(nanoepoch_2, stream_id_2, checkpoint_id_1)
-            .expect_context_panic(nanoepoch_3, stream_id_1, checkpoint_id_1)
-            .expect_context_panic(nanoepoch_4, stream_id_2, checkpoint_id_1)
-            ;
-
-        channel_guard_t<transport_encoding> g(*m_mock_consumer);
-
-        {
-            neutrino::mock::scoped_guard sg(g.m_channel->m_consumer_stub);
-
-            ASSERT_NO_THROW(neutrino_context_enter(nanoepoch_1, stream_id_1, checkpoint_id_1));
-            ASSERT_NO_THROW(neutrino_context_enter(nanoepoch_2, stream_id_2, checkpoint_id_1));
-            ASSERT_NO_THROW(neutrino_context_panic(nanoepoch_3, stream_id_1, checkpoint_id_1));
-            ASSERT_NO_THROW(neutrino_context_panic(nanoepoch_4, stream_id_2, checkpoint_id_1));
-        }
-    }
-
-    template <transport::frame_v00::known_encodings_t transport_encoding>
-    void validate_context_helper_normal_leave()
-    {
-        SCOPED_TRACE(__FUNCTION__);
-        (*m_mock_consumer)
-            .expect_context_enter(nanoepoch_1, stream_id_1, checkpoint_id_1)
-            .expect_context_leave(nanoepoch_2, stream_id_1, checkpoint_id_1);
-
-        channel_guard_t<transport_encoding> g(*m_mock_consumer);
-
-        {
-            neutrino::mock::scoped_guard sg(g.m_channel->m_consumer_stub);
-
-            neutrino::helpers::context_t ctx(stream_id_1, checkpoint_id_1, nanoepoch_1, nanoepoch_2);
-        }
-    }
-
-    template <transport::frame_v00::known_encodings_t transport_encoding>
-    void validate_context_helper_exception()
-    {
-        SCOPED_TRACE(__FUNCTION__);
-        (*m_mock_consumer)
-            .expect_context_enter(nanoepoch_1, stream_id_1, checkpoint_id_1)
-            .expect_context_panic(nanoepoch_2, stream_id_1, checkpoint_id_1);
-
-        channel_guard_t<transport_encoding> g(*m_mock_consumer);
-
-        {
-            neutrino::mock::scoped_guard sg(g.m_channel->m_consumer_stub);
-
-            try
-            {
-                neutrino::helpers::context_t ctx(stream_id_1, checkpoint_id_1, nanoepoch_1, nanoepoch_2);
-                throw "leave context with exception";
-            }
-            catch (...)
-            {
-            }
-        }
-    }
-
-    template <transport::frame_v00::known_encodings_t transport_encoding>
-    void validate_context_helper_exception_and_normal_interleaved()
-    {
-        SCOPED_TRACE(__FUNCTION__);
-        (*m_mock_consumer)
-            .expect_context_enter(nanoepoch_1, stream_id_1, checkpoint_id_1)
-            .expect_context_enter(nanoepoch_2, stream_id_1, checkpoint_id_2)
-            .expect_context_panic(nanoepoch_3, stream_id_1, checkpoint_id_2)
-            .expect_context_leave(nanoepoch_4, stream_id_1, checkpoint_id_1);
-
-        channel_guard_t<transport_encoding> g(*m_mock_consumer);
-
-        {
-            neutrino::mock::scoped_guard sg(g.m_channel->m_consumer_stub);
-
-            neutrino::helpers::context_t ctx(stream_id_1, checkpoint_id_1, nanoepoch_1, nanoepoch_4);
-            try
-            {
-                neutrino::helpers::context_t ctx(stream_id_1, checkpoint_id_2, nanoepoch_2, nanoepoch_3);
-                throw "leave context with exception";
-            }
-            catch (...)
-            {
-            }
-        }
-    }
-};
-
-TEST_F(neutrino_general_workflow_tests, checkpoint_same_stream)
-{
-    validate_checkpoint_same_stream<transport::frame_v00::known_encodings_t::BINARY_NATIVE>();
-    validate_checkpoint_same_stream<transport::frame_v00::known_encodings_t::BINARY_NETWORK>();
-    //validate_checkpoint_same_stream<transport::frame_v00::known_encodings_t::JSON>();
-}
-
-TEST_F(neutrino_general_workflow_tests, checkpoint_diff_stream)
-{
-    validate_checkpoint_different_stream<transport::frame_v00::known_encodings_t::BINARY_NATIVE>();
-    validate_checkpoint_different_stream<transport::frame_v00::known_encodings_t::BINARY_NETWORK>();
-    //validate_checkpoint_different_stream<transport::frame_v00::known_encodings_t::JSON>();
-}
-
-TEST_F(neutrino_general_workflow_tests, context_enter_leave_same_stream)
-{
-    validate_context_enter_leave_same_stream<transport::frame_v00::known_encodings_t::BINARY_NATIVE>();
-    validate_context_enter_leave_same_stream<transport::frame_v00::known_encodings_t::BINARY_NETWORK>();
-    //validate_context_enter_leave_same_stream<transport::frame_v00::known_encodings_t::JSON>();
-}
-
-TEST_F(neutrino_general_workflow_tests, context_enter_leave_interleaved_stream)
-{
-    validate_context_enter_leave_interleaved_stream<transport::frame_v00::known_encodings_t::BINARY_NATIVE>();
-    validate_context_enter_leave_interleaved_stream<transport::frame_v00::known_encodings_t::BINARY_NETWORK>();
-    //validate_context_enter_leave_interleaved_stream<transport::frame_v00::known_encodings_t::JSON>();
-}
-
-TEST_F(neutrino_general_workflow_tests, context_enter_panic_same_stream)
-{
-    validate_context_enter_panic_same_stream<transport::frame_v00::known_encodings_t::BINARY_NATIVE>();
-    validate_context_enter_panic_same_stream<transport::frame_v00::known_encodings_t::BINARY_NETWORK>();
-    //validate_context_enter_panic_same_stream<transport::frame_v00::known_encodings_t::JSON>();
-}
-
-TEST_F(neutrino_general_workflow_tests, context_enter_panic_interleaved_stream)
-{
-    validate_context_enter_panic_interleaved_stream<transport::frame_v00::known_encodings_t::BINARY_NATIVE>();
-    validate_context_enter_panic_interleaved_stream<transport::frame_v00::known_encodings_t::BINARY_NETWORK>();
-    //validate_context_enter_panic_interleaved_stream<transport::frame_v00::known_encodings_t::JSON>();
-}
-
-TEST_F(neutrino_general_workflow_tests, context_helper_normal_leave)
-{
-    validate_context_helper_normal_leave<transport::frame_v00::known_encodings_t::BINARY_NATIVE>();
-    validate_context_helper_normal_leave<transport::frame_v00::known_encodings_t::BINARY_NETWORK>();
-    //validate_context_helper_normal_leave<transport::frame_v00::known_encodings_t::JSON>();
-}
-TEST_F(neutrino_general_workflow_tests, context_helper_exception)
-{
-    validate_context_helper_exception<transport::frame_v00::known_encodings_t::BINARY_NATIVE>();
-    validate_context_helper_exception<transport::frame_v00::known_encodings_t::BINARY_NETWORK>();
-    //validate_context_helper_exception<transport::frame_v00::known_encodings_t::JSON>();
-}
-TEST_F(neutrino_general_workflow_tests, context_helper_exception_and_normal_interleaved)
-{
-    validate_context_helper_exception_and_normal_interleaved<transport::frame_v00::known_encodings_t::BINARY_NATIVE>();
-    validate_context_helper_exception_and_normal_interleaved<transport::frame_v00::known_encodings_t::BINARY_NETWORK>();
-    //validate_context_helper_exception_and_normal_interleaved<transport::frame_v00::known_encodings_t::JSON>();
-}
\ No newline at end of file
+#include <gtest/gtest.h>
+#include <thread>
+#include <neutrino_mock.hpp>
+
+#include <neutrino_producer.hpp>
+#include <neutrino_clock.hpp>
+#include <neutrino_transport_buffered_st.hpp>
+#include <neutrino_frames_serialized_v00.hpp>
+
+using namespace neutrino::impl;
+
+TEST(neutrino_nanoepoch, is_linear)
+{
+    auto x1 = neutrino_nanoepoch();
+    auto x2 = neutrino_nanoepoch();
+    auto x3 = neutrino_nanoepoch();
+
+    ASSERT_TRUE(x3 > x2);
+    ASSERT_TRUE(x2 > x1);
+}
+
+TEST(neutrino_nanoepoch, interval)
+{
+    auto sleep_nanoseconds = std::chrono::nanoseconds(std::chrono::milliseconds(200));
+    auto sleep_nanoseconds_max = sleep_nanoseconds + std::chrono::milliseconds(200); // granularity is unknown, assume worst
+    auto x1 = neutrino_nanoepoch();
+    std::this_thread::sleep_for(sleep_nanoseconds);
+    auto x2 = neutrino_nanoepoch();
+
+    ASSERT_TRUE((x2 - x1) >= sleep_nanoseconds.count());
+    ASSERT_TRUE((x2 - x1) < sleep_nanoseconds_max.count());
+}
+
+TEST(neutrino_nanoepoch, tsc_is_linear_and_matches_steady)
+{
+    if (!clock::startup(clock::clock_source_t::TSC))
+    {
+        ASSERT_EQ(clock::clock_source_t::STEADY, clock::source());
+        return; // no invariant TSC
+    }
+
+    auto x1 = neutrino_nanoepoch();
+    auto x2 = neutrino_nanoepoch();
+    int64_t steady = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+    auto x3 = neutrino_nanoepoch();
+
+    auto sleep_nanoseconds = std::chrono::nanoseconds(std::chrono::milliseconds(200));
+    std::this_thread::sleep_for(sleep_nanoseconds);
+    auto x4 = neutrino_nanoepoch();
+
+    clock::startup(clock::clock_source_t::STEADY);
+
+    ASSERT_TRUE(x2 >= x1);
+    ASSERT_TRUE(x3 >= x2);
+    // same epoch as steady clock, calibration error within a millisecond
+    ASSERT_TRUE(int64_t(x3) - steady < 1000000 && steady - int64_t(x3) < 1000000);
+    // 1% rate error tolerated
+    ASSERT_TRUE((x4 - x3) >= uint64_t(sleep_nanoseconds.count() * 99 / 100));
+    ASSERT_TRUE((x4 - x3) < uint64_t((sleep_nanoseconds + std::chrono::milliseconds(200)).count()));
+}
+
+TEST(neutrino_nanoepoch, coarse_is_monotonic)
+{
+    clock::startup(clock::clock_source_t::MONOTONIC_COARSE);
+
+    auto x1 = neutrino_nanoepoch();
+    std::this_thread::sleep_for(std::chrono::milliseconds(50));
+    auto x2 = neutrino_nanoepoch();
+
+    clock::startup(clock::clock_source_t::STEADY);
+
+    ASSERT_TRUE(x2 > x1);
+}
+
+TEST(neutrino_nanoepoch, tsc_calibration_fixed_point)
+{
+    clock::tsc_calibration_t c;
+    c.m_ticks0 = 1000000;
+    c.m_nanoepoch0 = 5000000000ull;
+    c.m_shift = 32;
+    c.m_mult = (uint64_t(1) << 32) / 3; // 3 GHz
+
+    ASSERT_EQ(c.m_nanoepoch0, c.to_nanoepoch(c.m_ticks0));
+    ASSERT_NEAR(double(c.m_nanoepoch0 + 1000000000ull), double(c.to_nanoepoch(c.m_ticks0 + 3000000000ull)), 1.0);
+    ASSERT_NEAR(double(c.m_nanoepoch0 - 100), double(c.to_nanoepoch(c.m_ticks0 - 300)), 1.0);
+    // a day of ticks does not overflow the multiply
+    ASSERT_NEAR(double(c.m_nanoepoch0 + 86400000000000ull), double(c.to_nanoepoch(c.m_ticks0 + 3ull * 86400000000000ull)), 86400.0);
+}
+
+struct neutrino_general_workflow_tests : public ::testing::Test
+{
+    const uint64_t checkpoint_id_1 = 1;
+    const uint64_t checkpoint_id_2 = 2;
+
+    const uint64_t nanoepoch_1 = 101;
+    const uint64_t nanoepoch_2 = 102;
+    const uint64_t nanoepoch_3 = 103;
+    const uint64_t nanoepoch_4 = 104;
+
+    const uint64_t stream_id_1 = 301;
+    const uint64_t stream_id_2 = 302;
+
+    template <transport::frame_v00::known_encodings_t transport_encoding>
+    struct channel_t
+    {
+        std::shared_ptr<neutrino::mock::connection_t<neutrino::impl::transport::endpoint_impl_t>> m_connection;
+        std::shared_ptr<transport::endpoint_impl_t> m_endpoint_impl;
+        std::shared_ptr<transport::consumer_stub_t> m_consumer_stub;
+
+        channel_t(neutrino::mock::consumer_t& consumer)
+        {
+            m_endpoint_impl = transport::frame_v00::create_endpoint_impl(
+                transport_encoding, consumer);
+
+            m_connection.reset(new neutrino::mock::connection_t<neutrino::impl::transport::endpoint_impl_t>(*m_endpoint_impl));
+
+            m_consumer_stub = transport::frame_v00::create_consumer_stub(
+                transport_encoding, *m_connection);
+        }
+    };
+
+    template <transport::frame_v00::known_encodings_t transport_encoding>
+    struct channel_guard_t
+    {
+        std::shared_ptr<channel_t<transport_encoding>> m_channel;
+        channel_guard_t(neutrino::mock::consumer_t& mock_consumer)
+        {
+            m_channel.reset(new channel_t<transport_encoding>(mock_consumer));
+        }
+    };
+
+    std::shared_ptr<neutrino::mock::consumer_t> m_mock_consumer;
+
+    void SetUp() final
+    {
+        m_mock_consumer.reset(new neutrino::mock::consumer_t());
+    }
+
+    void TearDown() final
+    {
+        ASSERT_TRUE(m_mock_consumer.get());
+        ASSERT_TRUE(m_mock_consumer->m_expected_checkpoints.empty());
+        ASSERT_TRUE(m_mock_consumer->m_expected_contexts.empty());
+        m_mock_consumer.reset();
+    }
+
+    template <transport::frame_v00::known_encodings_t transport_encoding>
+    void validate_checkpoint_same_stream()
+    {
+        SCOPED_TRACE(__FUNCTION__);
+        m_mock_consumer->
+            expect_checkpoint(nanoepoch_1, stream_id_1, checkpoint_id_1)
+            .expect_checkpoint(nanoepoch_2, stream_id_1, checkpoint_id_2);
+
+        channel_guard_t<transport_encoding> g(*m_mock_consumer);
+
+        {
+            neutrino::mock::scoped_guard sg(g.m_channel->m_consumer_stub);
+
+            ASSERT_NO_THROW(neutrino_checkpoint(nanoepoch_1, stream_id_1, checkpoint_id_1));
+            ASSERT_NO_THROW(neutrino_checkpoint(nanoepoch_2, stream_id_1, checkpoint_id_2));
+        }
+    }
+
+    template <transport::frame_v00::known_encodings_t transport_encoding>
+    void validate_checkpoint_different_stream()
+    {
+        SCOPED_TRACE(__FUNCTION__);
+        (*m_mock_consumer)
+            .expect_checkpoint(nanoepoch_1, stream_id_1, checkpoint_id_1)
+            .expect_checkpoint(nanoepoch_2, stream_id_2, checkpoint_id_2);
+
+        channel_guard_t<transport_encoding> g(*m_mock_consumer);
+
+        {
+            neutrino::mock::scoped_guard sg(g.m_channel->m_consumer_stub);
+
+            ASSERT_NO_THROW(neutrino_checkpoint(nanoepoch_1, stream_id_1, checkpoint_id_1));
+            ASSERT_NO_THROW(neutrino_checkpoint(nanoepoch_2, stream_id_2, checkpoint_id_2));
+        }
+    }
+
+    template <transport::frame_v00::known_encodings_t transport_encoding>
+    void validate_context_enter_leave_same_stream()
+    {
+        SCOPED_TRACE(__FUNCTION__);
+        (*m_mock_consumer)
+            .expect_context_enter(nanoepoch_1, stream_id_1, checkpoint_id_1)
+            .expect_context_leave(nanoepoch_2, stream_id_1, checkpoint_id_1);
+
+        channel_guard_t<transport_encoding> g(*m_mock_consumer);
+
+        {
+            neutrino::mock::scoped_guard sg(g.m_channel->m_consumer_stub);
+
+            ASSERT_NO_THROW(neutrino_context_enter(nanoepoch_1, stream_id_1, checkpoint_id_1));
+            ASSERT_NO_THROW(neutrino_context_leave(nanoepoch_2, stream_id_1, checkpoint_id_1));
+        }
+    }
+
+    template <transport::frame_v00::known_encodings_t transport_encoding>
+    void validate_context_enter_leave_interleaved_stream()
+    {
+        SCOPED_TRACE(__FUNCTION__);
+        (*m_mock_consumer)
+            .expect_context_enter(nanoepoch_1, stream_id_1, checkpoint_id_1)
+            .expect_context_enter(nanoepoch_1, stream_id_2, checkpoint_id_1)
+            .expect_context_leave(nanoepoch_2, stream_id_1, checkpoint_id_1)
+            .expect_context_leave(nanoepoch_2, stream_id_2, checkpoint_id_1)
+            ;
+
+        channel_guard_t<transport_encoding> g(*m_mock_consumer);
+
+        {
+            neutrino::mock::scoped_guard sg(g.m_channel->m_consumer_stub);
+
+            ASSERT_NO_THROW(neutrino_context_enter(nanoepoch_1, stream_id_1, checkpoint_id_1));
+            ASSERT_NO_THROW(neutrino_context_enter(nanoepoch_1, stream_id_2, checkpoint_id_1));
+            ASSERT_NO_THROW(neutrino_context_leave(nanoepoch_2, stream_id_1, checkpoint_id_1));
+            ASSERT_NO_THROW(neutrino_context_leave(nanoepoch_2, stream_id_2, checkpoint_id_1));
+        }
+    }
+
+    template <transport::frame_v00::known_encodings_t transport_encoding>
+    void validate_context_enter_panic_same_stream()
+    {
+        SCOPED_TRACE(__FUNCTION__);
+        (*m_mock_consumer)
+            .expect_context_enter(nanoepoch_1, stream_id_1, checkpoint_id_1)
+            .expect_context_panic(nanoepoch_2, stream_id_1, checkpoint_id_1);
+
+        channel_guard_t<transport_encoding> g(*m_mock_consumer);
+
+        {
+            neutrino::mock::scoped_guard sg(g.m_channel->m_consumer_stub);
+
+            ASSERT_NO_THROW(neutrino_context_enter(nanoepoch_1, stream_id_1, checkpoint_id_1));
+            ASSERT_NO_THROW(neutrino_context_panic(nanoepoch_2, stream_id_1, checkpoint_id_1));
+        }
+    }
+
+    template <transport::frame_v00::known_encodings_t transport_encoding>
+    void validate_context_enter_panic_interleaved_stream()
+    {
+        SCOPED_TRACE(__FUNCTION__);
+        (*m_mock_consumer)
+            .expect_context_enter(nanoepoch_1, stream_id_1, checkpoint_id_1)
+            .expect_context_enter(nanoepoch_2, stream_id_2, checkpoint_id_1)
+            .expect_context_panic(nanoepoch_3, stream_id_1, checkpoint_id_1)
+            .expect_context_panic(nanoepoch_4, stream_id_2, checkpoint_id_1)
+            ;
+
+        channel_guard_t<transport_encoding> g(*m_mock_consumer);
+
+        {
+            neutrino::mock::scoped_guard sg(g.m_channel->m_consumer_stub);
+
+            ASSERT_NO_THROW(neutrino_context_enter(nanoepoch_1, stream_id_1, checkpoint_id_1));
+            ASSERT_NO_THROW(neutrino_context_enter(nanoepoch_2, stream_id_2, checkpoint_id_1));
+            ASSERT_NO_THROW(neutrino_context_panic(nanoepoch_3, stream_id_1, checkpoint_id_1));
+            ASSERT_NO_THROW(neutrino_context_panic(nanoepoch_4, stream_id_2, checkpoint_id_1));
+        }
+    }
+
+    template <transport::frame_v00::known_encodings_t transport_encoding>
+    void validate_serializer_into_buffer()
+    {
+        SCOPED_TRACE(__FUNCTION__);
+        (*m_mock_consumer)
+            .expect_checkpoint(nanoepoch_1, stream_id_1, checkpoint_id_1)
+            .expect_context_enter(nanoepoch_2, stream_id_1, checkpoint_id_2)
+            .expect_context_leave(nanoepoch_3, stream_id_1, checkpoint_id_2);
+
+        auto endpoint_impl = transport::frame_v00::create_endpoint_impl(transport_encoding, *m_mock_consumer);
+        auto connection = std::make_shared<neutrino::mock::connection_t<transport::endpoint_impl_t>>(*endpoint_impl);
+        transport::buffered_singlethread_endpoint_t buffered(connection, { 1000, 999 });
+
+        // frames are encoded in place with reserve()/commit(), not consumed from a stack buffer
+        auto consumer_stub = transport::frame_v00::create_consumer_stub(transport_encoding, buffered);
+        consumer_stub->consume_checkpoint(nanoepoch_1, stream_id_1, checkpoint_id_1);
+        consumer_stub->consume_context(nanoepoch_2, stream_id_1, checkpoint_id_2, local::payload::event_type_t::event_types::CONTEXT_ENTER);
+        consumer_stub->consume_context(nanoepoch_3, stream_id_1, checkpoint_id_2, local::payload::event_type_t::event_types::CONTEXT_LEAVE);
+        ASSERT_TRUE(connection->m_sumbissions.empty());
+
+        uint8_t dummy[1];
+        ASSERT_TRUE(buffered.consume(dummy, dummy));
+        ASSERT_EQ(std::size_t{ 1 }, connection->m_sumbissions.size());
+    }
+
+    template <transport::frame_v00::known_encodings_t transport_encoding>
+    void validate_checkpoint_batch()
+    {
+        SCOPED_TRACE(__FUNCTION__);
+        // more than one serializer chunk
+        std::vector<uint64_t> nanoepoch, stream_id, event_id;
+        for (uint64_t cc = 0; cc < 150; cc++)
+        {
+            nanoepoch.push_back(nanoepoch_1 + cc);
+            stream_id.push_back(cc % 2 ? stream_id_1 : stream_id_2);
+            event_id.push_back(cc);
+            m_mock_consumer->expect_checkpoint(nanoepoch.back(), stream_id.back(), event_id.back());
+        }
+
+        channel_guard_t<transport_encoding> g(*m_mock_consumer);
+
+        {
+            neutrino::mock::scoped_guard sg(g.m_channel->m_consumer_stub);
+
+            ASSERT_NO_THROW(neutrino_checkpoint_batch(uint32_t(nanoepoch.size()), nanoepoch.data(), stream_id.data(), event_id.data()));
+        }
+    }
+
+    template <transport::frame_v00::known_encodings_t transport_encoding>
+    void validate_context_batch()
+    {
+        SCOPED_TRACE(__FUNCTION__);
+        const uint64_t nanoepoch[] = { nanoepoch_1, nanoepoch_2, nanoepoch_3, nanoepoch_4 };
+        const uint64_t stream_id[] = { stream_id_1, stream_id_2, stream_id_1, stream_id_2 };
+        const uint64_t event_id[] = { checkpoint_id_1, checkpoint_id_1, checkpoint_id_1, checkpoint_id_1 };
+        const uint8_t event_type[] = { NEUTRINO_CONTEXT_ENTER, NEUTRINO_CONTEXT_ENTER, NEUTRINO_CONTEXT_LEAVE, NEUTRINO_CONTEXT_PANIC };
+
+        (*m_mock_consumer)
+            .expect_context_enter(nanoepoch_1, stream_id_1, checkpoint_id_1)
+            .expect_context_enter(nanoepoch_2, stream_id_2, checkpoint_id_1)
+            .expect_context_leave(nanoepoch_3, stream_id_1, checkpoint_id_1)
+            .expect_context_panic(nanoepoch_4, stream_id_2, checkpoint_id_1)
+            ;
+
+        channel_guard_t<transport_encoding> g(*m_mock_consumer);
+
+        {
+            neutrino::mock::scoped_guard sg(g.m_channel->m_consumer_stub);
+
+            ASSERT_NO_THROW(neutrino_context_batch(4, nanoepoch, stream_id, event_id, event_type));
+        }
+    }
+
+    template <transport::frame_v00::known_encodings_t transport_encoding>
+    void validate_context_helper_normal_leave()
+    {
+        SCOPED_TRACE(__FUNCTION__);
+        (*m_mock_consumer)
+            .expect_context_enter(nanoepoch_1, stream_id_1, checkpoint_id_1)
+            .expect_context_leave(nanoepoch_2, stream_id_1, checkpoint_id_1);
+
+        channel_guard_t<transport_encoding> g(*m_mock_consumer);
+
+        {
+            neutrino::mock::scoped_guard sg(g.m_channel->m_consumer_stub);
+
+            neutrino::helpers::context_t ctx(stream_id_1, checkpoint_id_1, nanoepoch_1, nanoepoch_2);
+        }
+    }
+
+    template <transport::frame_v00::known_encodings_t transport_encoding>
+    void validate_context_helper_exception()
+    {
+        SCOPED_TRACE(__FUNCTION__);
+        (*m_mock_consumer)
+            .expect_context_enter(nanoepoch_1, stream_id_1, checkpoint_id_1)
+            .expect_context_panic(nanoepoch_2, stream_id_1, checkpoint_id_1);
+
+        channel_guard_t<transport_encoding> g(*m_mock_consumer);
+
+        {
+            neutrino::mock::scoped_guard sg(g.m_channel->m_consumer_stub);
+
+            try
+            {
+                neutrino::helpers::context_t ctx(stream_id_1, checkpoint_id_1, nanoepoch_1, nanoepoch_2);
+                throw "leave context with exception";
+            }
+            catch (...)
+            {
+            }
+        }
+    }
+
+    template <transport::frame_v00::known_encodings_t transport_encoding>
+    void validate_context_helper_exception_and_normal_interleaved()
+    {
+        SCOPED_TRACE(__FUNCTION__);
+        (*m_mock_consumer)
+            .expect_context_enter(nanoepoch_1, stream_id_1, checkpoint_id_1)
+            .expect_context_enter(nanoepoch_2, stream_id_1, checkpoint_id_2)
+            .expect_context_panic(nanoepoch_3, stream_id_1, checkpoint_id_2)
+            .expect_context_leave(nanoepoch_4, stream_id_1, checkpoint_id_1);
+
+        channel_guard_t<transport_encoding> g(*m_mock_consumer);
+
+        {
+            neutrino::mock::scoped_guard sg(g.m_channel->m_consumer_stub);
+
+            neutrino::helpers::context_t ctx(stream_id_1, checkpoint_id_1, nanoepoch_1, nanoepoch_4);
+            try
+            {
+                neutrino::helpers::context_t ctx(stream_id_1, checkpoint_id_2, nanoepoch_2, nanoepoch_3);
+                throw "leave context with exception";
+            }
+            catch (...)
+            {
+            }
+        }
+    }
+};
+
+TEST_F(neutrino_general_workflow_tests, checkpoint_same_stream)
+{
+    validate_checkpoint_same_stream<transport::frame_v00::known_encodings_t::BINARY_NATIVE>();
+    validate_checkpoint_same_stream<transport::frame_v00::known_encodings_t::BINARY_NETWORK>();
+    validate_checkpoint_same_stream<transport::frame_v00::known_encodings_t::COMPACT_V01>();
+    validate_checkpoint_same_stream<transport::frame_v00::known_encodings_t::JSON>();
+}
+
+TEST_F(neutrino_general_workflow_tests, checkpoint_diff_stream)
+{
+    validate_checkpoint_different_stream<transport::frame_v00::known_encodings_t::BINARY_NATIVE>();
+    validate_checkpoint_different_stream<transport::frame_v00::known_encodings_t::BINARY_NETWORK>();
+    validate_checkpoint_different_stream<transport::frame_v00::known_encodings_t::COMPACT_V01>();
+    validate_checkpoint_different_stream<transport::frame_v00::known_encodings_t::JSON>();
+}
+
+TEST_F(neutrino_general_workflow_tests, context_enter_leave_same_stream)
+{
+    validate_context_enter_leave_same_stream<transport::frame_v00::known_encodings_t::BINARY_NATIVE>();
+    validate_context_enter_leave_same_stream<transport::frame_v00::known_encodings_t::BINARY_NETWORK>();
+    validate_context_enter_leave_same_stream<transport::frame_v00::known_encodings_t::COMPACT_V01>();
+    validate_context_enter_leave_same_stream<transport::frame_v00::known_encodings_t::JSON>();
+}
+
+TEST_F(neutrino_general_workflow_tests, context_enter_leave_interleaved_stream)
+{
+    validate_context_enter_leave_interleaved_stream<transport::frame_v00::known_encodings_t::BINARY_NATIVE>();
+    validate_context_enter_leave_interleaved_stream<transport::frame_v00::known_encodings_t::BINARY_NETWORK>();
+    validate_context_enter_leave_interleaved_stream<transport::frame_v00::known_encodings_t::COMPACT_V01>();
+    validate_context_enter_leave_interleaved_stream<transport::frame_v00::known_encodings_t::JSON>();
+}
+
+TEST_F(neutrino_general_workflow_tests, context_enter_panic_same_stream)
+{
+    validate_context_enter_panic_same_stream<transport::frame_v00::known_encodings_t::BINARY_NATIVE>();
+    validate_context_enter_panic_same_stream<transport::frame_v00::known_encodings_t::BINARY_NETWORK>();
+    validate_context_enter_panic_same_stream<transport::frame_v00::known_encodings_t::COMPACT_V01>();
+    validate_context_enter_panic_same_stream<transport::frame_v00::known_encodings_t::JSON>();
+}
+
+TEST_F(neutrino_general_workflow_tests, context_enter_panic_interleaved_stream)
+{
+    validate_context_enter_panic_interleaved_stream<transport::frame_v00::known_encodings_t::BINARY_NATIVE>();
+    validate_context_enter_panic_interleaved_stream<transport::frame_v00::known_encodings_t::BINARY_NETWORK>();
+    validate_context_enter_panic_interleaved_stream<transport::frame_v00::known_encodings_t::COMPACT_V01>();
+    validate_context_enter_panic_interleaved_stream<transport::frame_v00::known_encodings_t::JSON>();
+}
+
+TEST_F(neutrino_general_workflow_tests, serializer_into_buffer)
+{
+    validate_serializer_into_buffer<transport::frame_v00::known_encodings_t::BINARY_NATIVE>();
+    validate_serializer_into_buffer<transport::frame_v00::known_encodings_t::BINARY_NETWORK>();
+    validate_serializer_into_buffer<transport::frame_v00::known_encodings_t::COMPACT_V01>();
+    validate_serializer_into_buffer<transport::frame_v00::known_encodings_t::JSON>();
+}
+
+TEST_F(neutrino_general_workflow_tests, checkpoint_batch)
+{
+    validate_checkpoint_batch<transport::frame_v00::known_encodings_t::BINARY_NATIVE>();
+    validate_checkpoint_batch<transport::frame_v00::known_encodings_t::BINARY_NETWORK>();
+    validate_checkpoint_batch<transport::frame_v00::known_encodings_t::COMPACT_V01>();
+    validate_checkpoint_batch<transport::frame_v00::known_encodings_t::JSON>();
+}
+
+TEST_F(neutrino_general_workflow_tests, context_batch)
+{
+    validate_context_batch<transport::frame_v00::known_encodings_t::BINARY_NATIVE>();
+    validate_context_batch<transport::frame_v00::known_encodings_t::BINARY_NETWORK>();
+    validate_context_batch<transport::frame_v00::known_encodings_t::COMPACT_V01>();
+    validate_context_batch<transport::frame_v00::known_encodings_t::JSON>();
+}
+
+TEST_F(neutrino_general_workflow_tests, context_helper_normal_leave)
+{
+    validate_context_helper_normal_leave<transport::frame_v00::known_encodings_t::BINARY_NATIVE>();
+    validate_context_helper_normal_leave<transport::frame_v00::known_encodings_t::BINARY_NETWORK>();
+    validate_context_helper_normal_leave<transport::frame_v00::known_encodings_t::COMPACT_V01>();
+    validate_context_helper_normal_leave<transport::frame_v00::known_encodings_t::JSON>();
+}
+TEST_F(neutrino_general_workflow_tests, context_helper_exception)
+{
+    validate_context_helper_exception<transport::frame_v00::known_encodings_t::BINARY_NATIVE>();
+    validate_context_helper_exception<transport::frame_v00::known_encodings_t::BINARY_NETWORK>();
+    validate_context_helper_exception<transport::frame_v00::known_encodings_t::COMPACT_V01>();
+    validate_context_helper_exception<transport::frame_v00::known_encodings_t::JSON>();
+}
+TEST_F(neutrino_general_workflow_tests, context_helper_exception_and_normal_interleaved)
+{
+    validate_context_helper_exception_and_normal_interleaved<transport::frame_v00::known_encodings_t::BINARY_NATIVE>();
+    validate_context_helper_exception_and_normal_interleaved<transport::frame_v00::known_encodings_t::BINARY_NETWORK>();
+    validate_context_helper_exception_and_normal_interleaved<transport::frame_v00::known_encodings_t::COMPACT_V01>();
+    validate_context_helper_exception_and_normal_interleaved<transport::frame_v00::known_encodings_t::JSON>();
+}
+
+namespace
+{
+    struct clock_calibration_consumer_t : public transport::consumer_t
+    {
+        std::size_t m_cc = 0;
+        clock::tsc_calibration_t m_calibration;
+
+        void consume_clock_calibration(
+            const local::payload::ticks_t::type_t& ticks
+            , const local::payload::nanoepoch_t::type_t& nanoepoch
+            , const local::payload::ticks_mult_t::type_t& mult
+            , const local::payload::ticks_shift_t::type_t& shift
+        ) final
+        {
+            m_cc++;
+            m_calibration.m_ticks0 = ticks;
+            m_calibration.m_nanoepoch0 = nanoepoch;
+            m_calibration.m_mult = mult;
+            m_calibration.m_shift = shift;
+        }
+    };
+
+    template <transport::frame_v00::known_encodings_t transport_encoding>
+    void validate_clock_calibration_frame()
+    {
+        SCOPED_TRACE(__FUNCTION__);
+        clock_calibration_consumer_t consumer;
+        auto endpoint_impl = transport::frame_v00::create_endpoint_impl(transport_encoding, consumer);
+        neutrino::mock::connection_t<transport::endpoint_impl_t> connection(*endpoint_impl);
+        auto consumer_stub = transport::frame_v00::create_consumer_stub(transport_encoding, connection);
+
+        consumer_stub->consume_clock_calibration(0x0102030405060708ull, 0x1112131415161718ull, 0x2122232425262728ull, 32);
+
+        ASSERT_EQ(std::size_t{ 1 }, consumer.m_cc);
+        ASSERT_EQ(0x0102030405060708ull, consumer.m_calibration.m_ticks0);
+        ASSERT_EQ(0x1112131415161718ull, consumer.m_calibration.m_nanoepoch0);
+        ASSERT_EQ(0x2122232425262728ull, consumer.m_calibration.m_mult);
+        ASSERT_EQ(32, consumer.m_calibration.m_shift);
+    }
+}
+
+TEST(neutrino_clock_calibration_frame, roundtrip)
+{
+    validate_clock_calibration_frame<transport::frame_v00::known_encodings_t::BINARY_NATIVE>();
+    validate_clock_calibration_frame<transport::frame_v00::known_encodings_t::BINARY_NETWORK>();
+    validate_clock_calibration_frame<transport::frame_v00::known_encodings_t::COMPACT_V01>();
+}
+
+TEST(neutrino_clock_calibration_frame, sent_by_producer_api_in_tsc_raw_mode)
+{
+    // no consumer set: nothing to send to
+    neutrino_clock_calibration();
+
+    clock_calibration_consumer_t consumer;
+    auto endpoint_impl = transport::frame_v00::create_endpoint_impl(transport::frame_v00::known_encodings_t::BINARY_NATIVE, consumer);
+    neutrino::mock::connection_t<transport::endpoint_impl_t> connection(*endpoint_impl);
+    std::shared_ptr<transport::consumer_stub_t> consumer_stub(transport::frame_v00::create_consumer_stub(transport::frame_v00::known_encodings_t::BINARY_NATIVE, connection));
+    neutrino::mock::scoped_guard sg(consumer_stub);
+
+    // converted clocks need no calibration
+    neutrino_clock_calibration();
+    ASSERT_EQ(std::size_t{ 0 }, consumer.m_cc);
+
+    if (!clock::startup(clock::clock_source_t::TSC_RAW))
+        return; // no invariant TSC
+    neutrino_clock_calibration();
+    const clock::tsc_calibration_t calibration = clock::calibration();
+    clock::startup(clock::clock_source_t::STEADY);
+
+    ASSERT_EQ(std::size_t{ 1 }, consumer.m_cc);
+    ASSERT_EQ(calibration.m_ticks0, consumer.m_calibration.m_ticks0);
+    ASSERT_EQ(calibration.m_nanoepoch0, consumer.m_calibration.m_nanoepoch0);
+    ASSERT_EQ(calibration.m_mult, consumer.m_calibration.m_mult);
+    ASSERT_EQ(calibration.m_shift, consumer.m_calibration.m_shift);
+}
+TEST(neutrino_frames_serialized, network_byte_order)
+{
+    typedef serialized::raw_t<local::payload::nanoepoch_t, serialized::network_byte_order_target_t> nanoepoch_raw_t;
+    uint8_t buf[8];
+    ASSERT_EQ(buf + 8, nanoepoch_raw_t::convert(0x0102030405060708ull, buf));
+    for (uint8_t cc = 0; cc < 8; cc++)
+        ASSERT_EQ(cc + 1, buf[cc]);
+    local::payload::nanoepoch_t::type_t nanoepoch;
+    ASSERT_TRUE(nanoepoch_raw_t::convert(buf, nanoepoch));
+    ASSERT_EQ(0x0102030405060708ull, nanoepoch);
+
+    // batch decode matches field by field decode
+    std::vector<uint8_t> frames;
+    const std::size_t n = 5;
+    for (uint64_t cc = 0; cc < n; cc++)
+    {
+        frames.push_back(local::frame::v00::checkpoint::header);
+        for (uint64_t v : { 0x1112131415161718ull + cc, 0x2122232425262728ull + cc, 0x3132333435363738ull + cc })
+            for (int b = 7; b >= 0; b--)
+                frames.push_back(uint8_t(v >> (8 * b)));
+        frames.push_back(local::frame::v00::checkpoint::header);
+    }
+    uint64_t ne[n], sid[n], eid[n];
+    serialized::v00::decode_checkpoints_network_bo(frames.data(), n, ne, sid, eid);
+    for (uint64_t cc = 0; cc < n; cc++)
+    {
+        ASSERT_EQ(0x1112131415161718ull + cc, ne[cc]);
+        ASSERT_EQ(0x2122232425262728ull + cc, sid[cc]);
+        ASSERT_EQ(0x3132333435363738ull + cc, eid[cc]);
+    }
+}
+
+TEST(neutrino_frames_serialized, network_byte_order_shuffle_matches_scalar)
+{
+    // odd and even counts, the shuffles take frames in pairs and leave the last one to the scalar code
+    const std::size_t n = 67;
+    std::vector<uint8_t> frames;
+    uint64_t x = 0x9E3779B97F4A7C15ull;
+    for (std::size_t cc = 0; cc < n; cc++)
+    {
+        frames.push_back(local::frame::v00::checkpoint::header);
+        for (int f = 0; f < 3; f++)
+        {
+            x ^= x << 13; x ^= x >> 7; x ^= x << 17;
+            for (int b = 7; b >= 0; b--)
+                frames.push_back(uint8_t(x >> (8 * b)));
+        }
+        frames.push_back(local::frame::v00::checkpoint::header);
+    }
+
+#if (defined(__x86_64__) || defined(__i386__)) && !defined(_MSC_VER)
+    __builtin_cpu_init();
+    ASSERT_EQ(!serialized::bo::host_is_network && __builtin_cpu_supports("ssse3"), serialized::v00::network_bo_shuffle());
+#endif
+    for (std::size_t count = 0; count <= n; count++)
+    {
+        std::vector<uint64_t> ne(n + 1, 0), sid(n + 1, 0), eid(n + 1, 0);
+        std::vector<uint64_t> ne_ref(n + 1, 0), sid_ref(n + 1, 0), eid_ref(n + 1, 0);
+        serialized::v00::decode_checkpoints_network_bo(frames.data(), count, ne.data(), sid.data(), eid.data());
+        serialized::v00::decode_checkpoints_network_bo_scalar(frames.data(), count, ne_ref.data(), sid_ref.data(), eid_ref.data());
+        // nothing written past count
+        ASSERT_EQ(ne_ref, ne);
+        ASSERT_EQ(sid_ref, sid);
+        ASSERT_EQ(eid_ref, eid);
+    }
+}
+
+namespace
+{
+    struct columns_consumer_t : public transport::consumer_t
+    {
+        std::size_t m_calls = 0;
+        std::vector<uint64_t> m_nanoepoch;
+        std::vector<uint8_t> m_event_type;
+
+        void consume_columns(const transport::frames_columns_t& c) final
+        {
+            m_calls++;
+            m_nanoepoch.insert(m_nanoepoch.end(), c.m_nanoepoch, c.m_nanoepoch + c.m_count);
+            m_event_type.insert(m_event_type.end(), c.m_event_type, c.m_event_type + c.m_count);
+        }
+    };
+
+    template <transport::frame_v00::known_encodings_t transport_encoding>
+    void validate_columns()
+    {
+        SCOPED_TRACE(__FUNCTION__);
+        columns_consumer_t consumer;
+        auto endpoint_impl = transport::frame_v00::create_endpoint_impl(transport_encoding, consumer);
+        auto connection = std::make_shared<neutrino::mock::connection_t<transport::endpoint_impl_t>>(*endpoint_impl);
+        transport::buffered_singlethread_endpoint_t buffered(connection, { 100000, 99999 });
+        auto consumer_stub = transport::frame_v00::create_consumer_stub(transport_encoding, buffered);
+
+        // mixed frames of one buffer arrive in order, in as few calls as columns hold
+        std::vector<uint8_t> expected_type;
+        for (uint64_t cc = 0; cc < 300; cc++)
+        {
+            if (cc % 100 < 90)
+            {
+                consumer_stub->consume_checkpoint(cc, 1, 2);
+                expected_type.push_back(uint8_t(local::payload::event_type_t::event_types::NO_CONTEXT));
+            }
+            else
+            {
+                consumer_stub->consume_context(cc, 1, 2, local::payload::event_type_t::event_types::CONTEXT_ENTER);
+                expected_type.push_back(NEUTRINO_CONTEXT_ENTER);
+            }
+        }
+        uint8_t dummy[1];
+        ASSERT_TRUE(buffered.consume(dummy, dummy));
+        ASSERT_EQ(std::size_t{ 1 }, connection->m_sumbissions.size());
+        ASSERT_EQ(std::size_t{ 2 }, consumer.m_calls);
+        ASSERT_EQ(expected_type, consumer.m_event_type);
+        for (uint64_t cc = 0; cc < consumer.m_nanoepoch.size(); cc++)
+            ASSERT_EQ(cc, consumer.m_nanoepoch[cc]);
+    }
+}
+
+TEST(neutrino_frames_columns, whole_buffer)
+{
+    validate_columns<transport::frame_v00::known_encodings_t::BINARY_NATIVE>();
+    validate_columns<transport::frame_v00::known_encodings_t::BINARY_NETWORK>();
+    validate_columns<transport::frame_v00::known_encodings_t::COMPACT_V01>();
+}
+
+TEST(neutrino_frames_columns, push_after_reserve_to_capacity)
+{
+    // a run reserved and committed up to capacity leaves the collector empty, the next push starts at 0
+    columns_consumer_t consumer;
+    transport::frames_columns_collector_t<4> collector(consumer);
+    const std::size_t at = collector.reserve(4);
+    ASSERT_EQ(std::size_t{ 0 }, at);
+    for (std::size_t cc = 0; cc < 4; cc++)
+    {
+        collector.m_nanoepoch[at + cc] = cc;
+        collector.m_event_type[at + cc] = uint8_t(local::payload::event_type_t::event_types::NO_CONTEXT);
+    }
+    collector.commit(4);
+    ASSERT_EQ(std::size_t{ 1 }, consumer.m_calls);
+    ASSERT_EQ(std::size_t{ 0 }, collector.m_count);
+
+    collector.push(4, 1, 2, NEUTRINO_CONTEXT_ENTER);
+    ASSERT_EQ(std::size_t{ 1 }, collector.m_count);
+    collector.flush();
+    ASSERT_EQ(std::size_t{ 2 }, consumer.m_calls);
+    ASSERT_EQ(std::size_t{ 5 }, consumer.m_nanoepoch.size());
+    for (uint64_t cc = 0; cc < consumer.m_nanoepoch.size(); cc++)
+        ASSERT_EQ(cc, consumer.m_nanoepoch[cc]);
+    ASSERT_EQ(NEUTRINO_CONTEXT_ENTER, consumer.m_event_type.back());
+}
+
+TEST(neutrino_frames_serialized, layouts)
+{
+    typedef serialized::v00::frames_t<serialized::native_byte_order_target_t> native_t;
+    typedef serialized::v00::frames_t<serialized::network_byte_order_target_t> network_t;
+    static_assert(native_t::checkpoint_size == 26 && network_t::checkpoint_size == 26, "checkpoint span");
+    static_assert(native_t::context_size == 27 && native_t::clock_calibration_size == 27, "context and calibration span");
+    static_assert(native_t::context_t::offset<3>() == 25, "event_type offset");
+
+    // packed native store writes the same bytes as field by field encoding
+    uint8_t packed[native_t::context_size], fields[native_t::context_size];
+    ASSERT_EQ(packed + native_t::context_size, native_t::context(packed, 0x0102030405060708ull, 301, 1, NEUTRINO_CONTEXT_LEAVE));
+    serialized::frame_fields_t<serialized::v00::context_layout_t, serialized::native_byte_order_target_t>::encode(fields, 0x0102030405060708ull, 301, 1, NEUTRINO_CONTEXT_LEAVE);
+    ASSERT_TRUE(std::equal(packed, packed + sizeof(packed), fields));
+
+    local::payload::nanoepoch_t::type_t nanoepoch;
+    local::payload::stream_id_t::type_t stream_id;
+    local::payload::event_id_t::type_t event_id;
+    local::payload::event_type_t::type_t event_type;
+    ASSERT_TRUE(native_t::context_t::check(packed, packed + sizeof(packed)));
+    ASSERT_FALSE(native_t::context_t::check(packed, packed + sizeof(packed) - 1));
+    native_t::context_t::decode(packed, nanoepoch, stream_id, event_id, event_type);
+    ASSERT_EQ(0x0102030405060708ull, nanoepoch);
+    ASSERT_EQ(301u, stream_id);
+    ASSERT_EQ(1u, event_id);
+    ASSERT_EQ(NEUTRINO_CONTEXT_LEAVE, event_type);
+}
+
+namespace
+{
+    struct stream_consumer_t : public columns_consumer_t
+    {
+        std::vector<std::size_t> m_calibration_at; // frames decoded before each calibration
+
+        void consume_clock_calibration(
+            const local::payload::ticks_t::type_t&
+            , const local::payload::nanoepoch_t::type_t&
+            , const local::payload::ticks_mult_t::type_t&
+            , const local::payload::ticks_shift_t::type_t&
+        ) final
+        {
+            m_calibration_at.push_back(m_nanoepoch.size());
+        }
+    };
+
+    template <transport::frame_v00::known_encodings_t transport_encoding>
+    void validate_stream_cut_at_any_byte()
+    {
+        SCOPED_TRACE(__FUNCTION__);
+        neutrino::mock::concat_endpoint_t stream;
+        auto consumer_stub = transport::frame_v00::create_consumer_stub(transport_encoding, stream);
+        for (uint64_t cc = 0; cc < 100; cc++)
+        {
+            if (cc % 3)
+                consumer_stub->consume_checkpoint(cc, 1, 2);
+            else
+                consumer_stub->consume_context(cc, 1, 2, local::payload::event_type_t::event_types::CONTEXT_LEAVE);
+            if (cc == 50)
+                consumer_stub->consume_clock_calibration(1, 2, 3, 4);
+        }
+
+        for (std::size_t chunk = 1; chunk < 64; chunk++)
+        {
+            stream_consumer_t consumer;
+            auto endpoint_impl = transport::frame_v00::create_stream_endpoint_impl(transport_encoding, consumer);
+            for (std::size_t pos = 0; pos < stream.m_data.size(); pos += chunk)
+                ASSERT_TRUE(endpoint_impl->consume(stream.m_data.data() + pos, stream.m_data.data() + std::min(stream.m_data.size(), pos + chunk))) << "chunk " << chunk;
+            ASSERT_EQ(std::size_t{ 100 }, consumer.m_nanoepoch.size()) << "chunk " << chunk;
+            for (uint64_t cc = 0; cc < consumer.m_nanoepoch.size(); cc++)
+                ASSERT_EQ(cc, consumer.m_nanoepoch[cc]);
+            ASSERT_EQ(std::vector<std::size_t>{ 51 }, consumer.m_calibration_at);
+        }
+
+        // whole buffer decoders still refuse a cut frame
+        stream_consumer_t consumer;
+        auto endpoint_impl = transport::frame_v00::create_endpoint_impl(transport_encoding, consumer);
+        ASSERT_FALSE(endpoint_impl->consume(stream.m_data.data(), stream.m_data.data() + 30));
+    }
+
+    template <transport::frame_v00::known_encodings_t transport_encoding>
+    void validate_stream_resync()
+    {
+        SCOPED_TRACE(__FUNCTION__);
+        typedef serialized::v00::frames_t<serialized::native_byte_order_target_t> frames_t;
+        neutrino::mock::concat_endpoint_t stream;
+        auto consumer_stub = transport::frame_v00::create_consumer_stub(transport_encoding, stream);
+        std::vector<std::size_t> frame_start;
+        for (uint64_t cc = 0; cc < 100; cc++)
+        {
+            frame_start.push_back(stream.m_data.size());
+            if (cc % 3)
+                consumer_stub->consume_checkpoint(cc, 1, 2);
+            else
+                consumer_stub->consume_context(cc, 1, 2, local::payload::event_type_t::event_types::CONTEXT_LEAVE);
+        }
+        // unknown header of frame 20, broken trailer of frame 40 (checkpoint), unknown event type of frame 60 (context)
+        stream.m_data[frame_start[20]] = 0x3F;
+        stream.m_data[frame_start[40] + frames_t::checkpoint_size - 1] = 0x3F;
+        stream.m_data[frame_start[60] + frames_t::context_size - 2] = 0x7F;
+
+        std::vector<std::size_t> chunks{ stream.m_data.size() };
+        for (std::size_t chunk = 1; chunk < 64; chunk++)
+            chunks.push_back(chunk);
+        for (const std::size_t chunk : chunks)
+        {
+            stream_consumer_t consumer;
+            auto endpoint_impl = transport::frame_v00::create_stream_endpoint_impl(transport_encoding, consumer);
+            bool ret = true;
+            for (std::size_t pos = 0; pos < stream.m_data.size(); pos += chunk)
+                ret = endpoint_impl->consume(stream.m_data.data() + pos, stream.m_data.data() + std::min(stream.m_data.size(), pos + chunk)) && ret;
+            ASSERT_FALSE(ret) << "chunk " << chunk;
+            // every frame but the broken ones
+            ASSERT_EQ(std::size_t{ 97 }, consumer.m_nanoepoch.size()) << "chunk " << chunk;
+            for (uint64_t cc = 0, n = 0; cc < 100; cc++)
+            {
+                if (cc == 20 || cc == 40 || cc == 60)
+                    continue;
+                ASSERT_EQ(cc, consumer.m_nanoepoch[n++]) << "chunk " << chunk;
+            }
+        }
+    }
+}
+
+TEST(neutrino_frames_stream, cut_at_any_byte)
+{
+    validate_stream_cut_at_any_byte<transport::frame_v00::known_encodings_t::BINARY_NATIVE>();
+    validate_stream_cut_at_any_byte<transport::frame_v00::known_encodings_t::BINARY_NETWORK>();
+}
+
+TEST(neutrino_frames_stream, resync_after_broken_frame)
+{
+    validate_stream_resync<transport::frame_v00::known_encodings_t::BINARY_NATIVE>();
+    validate_stream_resync<transport::frame_v00::known_encodings_t::BINARY_NETWORK>();
+}
+
+TEST(neutrino_frames_stream, no_stream_decoder_for_blocks)
+{
+    stream_consumer_t consumer;
+    ASSERT_TRUE(transport::frame_v00::create_stream_endpoint_impl(transport::frame_v00::known_encodings_t::COMPACT_V01, consumer) == nullptr);
+    ASSERT_TRUE(transport::frame_v00::create_stream_endpoint_impl(transport::frame_v00::known_encodings_t::JSON, consumer) != nullptr);
+}
@@ -0,0 +1,307 @@
+#include <array>
+#include <algorithm>
+
+#include <neutrino_transport.hpp>
+
+using namespace neutrino::impl;
+
+namespace
+{
+    namespace v01 = local::frame::v01;
+
+    inline uint8_t* put_varint(uint64_t v, uint8_t* p) noexcept
+    {
+        while (v >= 0x80)
+        {
+            *p++ = uint8_t(v) | 0x80;
+            v >>= 7;
+        }
+        *p++ = uint8_t(v);
+        return p;
+    }
+
+    inline const uint8_t* get_varint(const uint8_t* p, const uint8_t* e, uint64_t& v) noexcept
+    {
+        v = 0;
+        for (unsigned shift = 0; p < e && shift < 64; shift += 7)
+        {
+            const uint8_t b = *p++;
+            v |= uint64_t(b & 0x7f) << shift;
+            if (!(b & 0x80))
+                return p;
+        }
+        return nullptr; // truncated or longer than 10 bytes
+    }
+
+    inline uint64_t zigzag(const uint64_t delta) noexcept
+    {
+        return (delta << 1) ^ (0 - (delta >> 63));
+    }
+
+    inline uint64_t unzigzag(const uint64_t v) noexcept
+    {
+        return (v >> 1) ^ (0 - (v & 1));
+    }
+
+    // previous frame of a block, deltas are taken against it
+    struct frame_v01_block_state_t
+    {
+        local::payload::nanoepoch_t::type_t m_nanoepoch = 0;
+        local::payload::stream_id_t::type_t m_stream_id = 0;
+        bool m_valid = false;
+    };
+
+    struct frame_v01_deserializer_endpoint_impl_t : public transport::endpoint_impl_t
+    {
+        using transport::endpoint_impl_t::endpoint_impl_t;
+
+        constexpr static const std::size_t columns_frames = 256;
+
+        bool consume(const uint8_t* pBuf, const uint8_t* pBufEnd) final
+        {
+            // every consume() call may come from a different producer buffer, deltas never cross it
+            frame_v01_block_state_t state;
+            transport::frames_columns_collector_t<columns_frames> columns(m_consumer);
+            const uint8_t* pFrameStart = pBuf;
+            while (pFrameStart < pBufEnd)
+            {
+                const uint8_t header = *pFrameStart;
+                const uint8_t* p = pFrameStart + 1;
+                if ((header & v01::bits::MASK_VERSION) != v01::bits::VERSION)
+                    break;
+
+                const uint8_t kind = header & v01::bits::MASK_KIND;
+                if (kind == v01::clock_calibration::kind)
+                {
+                    uint64_t ticks, nanoepoch, mult;
+                    if (!(p = get_varint(p, pBufEnd, ticks)) || !(p = get_varint(p, pBufEnd, nanoepoch)) || !(p = get_varint(p, pBufEnd, mult)) || p >= pBufEnd)
+                        break;
+                    const local::payload::ticks_shift_t::type_t shift = *p++;
+                    columns.flush();
+                    m_consumer.consume_clock_calibration(ticks, nanoepoch, mult, shift);
+                    pFrameStart = p;
+                    continue;
+                }
+                if (kind != v01::checkpoint::kind && kind != v01::context::kind)
+                    break;
+
+                const bool reset = (header & v01::bits::RESET) != 0;
+                if (!reset && !state.m_valid)
+                    break; // delta frame without a reset point
+
+                uint64_t nanoepoch, event_id;
+                if (!(p = get_varint(p, pBufEnd, nanoepoch)))
+                    break;
+                nanoepoch = reset ? nanoepoch : state.m_nanoepoch + unzigzag(nanoepoch);
+
+                local::payload::stream_id_t::type_t stream_id = state.m_stream_id;
+                if ((reset || (header & v01::bits::STREAM)) && !(p = get_varint(p, pBufEnd, stream_id)))
+                    break;
+                if (!(p = get_varint(p, pBufEnd, event_id)))
+                    break;
+
+                const uint8_t event_type = (header & v01::bits::MASK_EVENT_TYPE) >> v01::bits::SHIFT_EVENT_TYPE;
+                if (kind == v01::checkpoint::kind)
+                {
+                    columns.push(nanoepoch, stream_id, event_id, static_cast<local::payload::event_type_t::type_t>(local::payload::event_type_t::event_types::NO_CONTEXT));
+                }
+                else if (event_type > static_cast<uint8_t>(local::payload::event_type_t::event_types::NO_CONTEXT))
+                {
+                    columns.push(nanoepoch, stream_id, event_id, event_type);
+                }
+                else
+                {
+                    break; // unknown event type
+                }
+
+                state.m_nanoepoch = nanoepoch;
+                state.m_stream_id = stream_id;
+                state.m_valid = true;
+                pFrameStart = p;
+            }
+            columns.flush();
+            // TODO: notify not consumed bytes
+            return pFrameStart == pBufEnd;
+        }
+    };
+
+    struct frame_v01_serializer_consumer_stub_impl_t : public transport::consumer_stub_t
+    {
+        using transport::consumer_stub_t::consumer_stub_t;
+
+        constexpr static const std::size_t batch_frames = 64;
+
+        // per-event frames refer to the previous one while the endpoint keeps them together in one buffer
+        const std::atomic<uint64_t>* const m_deliveries = m_endpoint.ordered_deliveries();
+        frame_v01_block_state_t m_state;
+        uint64_t m_state_deliveries = 0;
+
+        // first frame of a block (state invalid) is a reset point
+        static uint8_t* serialize(
+            uint8_t* p
+            , frame_v01_block_state_t& state
+            , const uint8_t kind
+            , const local::payload::nanoepoch_t::type_t nanoepoch
+            , const local::payload::stream_id_t::type_t stream_id
+            , const local::payload::event_id_t::type_t event_id
+            , const local::payload::event_type_t::type_t event_type
+        ) noexcept
+        {
+            uint8_t header = v01::bits::VERSION | kind | uint8_t(event_type << v01::bits::SHIFT_EVENT_TYPE);
+            uint8_t* h = p++;
+            if (!state.m_valid)
+            {
+                header |= v01::bits::RESET;
+                p = put_varint(stream_id, put_varint(nanoepoch, p));
+            }
+            else
+            {
+                p = put_varint(zigzag(nanoepoch - state.m_nanoepoch), p);
+                if (stream_id != state.m_stream_id)
+                {
+                    header |= v01::bits::STREAM;
+                    p = put_varint(stream_id, p);
+                }
+            }
+            *h = header;
+            state.m_nanoepoch = nanoepoch;
+            state.m_stream_id = stream_id;
+            state.m_valid = true;
+            return put_varint(event_id, p);
+        }
+
+        void serialize_one(
+            const uint8_t kind
+            , const local::payload::nanoepoch_t::type_t nanoepoch
+            , const local::payload::stream_id_t::type_t stream_id
+            , const local::payload::event_id_t::type_t event_id
+            , const local::payload::event_type_t::type_t event_type
+        )
+        {
+            if (m_deliveries)
+            {
+                // room for the largest frame, commit() takes what was written;
+                // reserve() may send the buffer downstream first, then the frame starts a new chain
+                if (uint8_t* d = m_endpoint.reserve(v01::max_frame_size))
+                {
+                    const uint64_t deliveries = m_deliveries->load(std::memory_order_relaxed);
+                    if (deliveries != m_state_deliveries)
+                        m_state.m_valid = false;
+                    uint8_t* e = serialize(d, m_state, kind, nanoepoch, stream_id, event_id, event_type);
+                    m_state_deliveries = deliveries;
+                    m_endpoint.commit(d, e - d);
+                    return;
+                }
+                m_state.m_valid = false;
+            }
+            std::array<uint8_t, v01::max_frame_size> buf;
+            frame_v01_block_state_t state;
+            m_endpoint.consume(buf.data(), serialize(buf.data(), state, kind, nanoepoch, stream_id, event_id, event_type));
+        }
+
+        void consume_checkpoint(
+            const local::payload::nanoepoch_t::type_t& nanoepoch
+            , const local::payload::stream_id_t::type_t& stream_id
+            , const local::payload::event_id_t::type_t& event_id
+        ) final
+        {
+            serialize_one(v01::checkpoint::kind, nanoepoch, stream_id, event_id, 0);
+        }
+
+        void consume_context(
+            const local::payload::nanoepoch_t::type_t& nanoepoch
+            , const local::payload::stream_id_t::type_t& stream_id
+            , const local::payload::event_id_t::type_t& event_id
+            , const local::payload::event_type_t::event_types& event_type
+        ) final
+        {
+            serialize_one(v01::context::kind, nanoepoch, stream_id, event_id, static_cast<local::payload::event_type_t::type_t>(event_type));
+        }
+
+        void consume_checkpoint_batch(
+            const std::size_t count
+            , const local::payload::nanoepoch_t::type_t* nanoepoch
+            , const local::payload::stream_id_t::type_t* stream_id
+            , const local::payload::event_id_t::type_t* event_id
+        ) final
+        {
+            // frames have variable size, so a block goes with consume() and is never split by the endpoint
+            // (whether it is delivered right after is unknown, the next per-event frame is a reset point)
+            m_state.m_valid = false;
+            std::array<uint8_t, batch_frames * v01::max_frame_size> buf;
+            for (std::size_t cc = 0; cc < count; )
+            {
+                frame_v01_block_state_t state;
+                uint8_t* p = buf.data();
+                for (const auto last = std::min(count, cc + batch_frames); cc < last; cc++)
+                    p = serialize(p, state, v01::checkpoint::kind, nanoepoch[cc], stream_id[cc], event_id[cc], 0);
+                m_endpoint.consume(buf.data(), p);
+            }
+        }
+
+        void consume_context_batch(
+            const std::size_t count
+            , const local::payload::nanoepoch_t::type_t* nanoepoch
+            , const local::payload::stream_id_t::type_t* stream_id
+            , const local::payload::event_id_t::type_t* event_id
+            , const local::payload::event_type_t::type_t* event_type
+        ) final
+        {
+            m_state.m_valid = false;
+            std::array<uint8_t, batch_frames * v01::max_frame_size> buf;
+            for (std::size_t cc = 0; cc < count; )
+            {
+                frame_v01_block_state_t state;
+                uint8_t* p = buf.data();
+                for (const auto last = std::min(count, cc + batch_frames); cc < last; cc++)
+                {
+                    // deserializer drops the rest of a buffer on unknown event type, do not send it
+                    if (event_type[cc] > static_cast<local::payload::event_type_t::type_t>(local::payload::event_type_t::event_types::NO_CONTEXT)
+                        && event_type[cc] < static_cast<local::payload::event_type_t::type_t>(local::payload::event_type_t::event_types::_LAST))
+                    {
+                        p = serialize(p, state, v01::context::kind, nanoepoch[cc], stream_id[cc], event_id[cc], event_type[cc]);
+                    }
+                }
+                if (p != buf.data())
+                    m_endpoint.consume(buf.data(), p);
+            }
+        }
+
+        void consume_clock_calibration(
+            const local::payload::ticks_t::type_t& ticks
+            , const local::payload::nanoepoch_t::type_t& nanoepoch
+            , const local::payload::ticks_mult_t::type_t& mult
+            , const local::payload::ticks_shift_t::type_t& shift
+        ) final
+        {
+            std::array<uint8_t, 1 + 3 * v01::max_varint_size + 1> buf;
+            uint8_t* p = buf.data();
+            *p++ = v01::bits::VERSION | v01::clock_calibration::kind;
+            p = put_varint(mult, put_varint(nanoepoch, put_varint(ticks, p)));
+            *p++ = shift;
+            m_endpoint.consume(buf.data(), p);
+        }
+    };
+}
+
+namespace neutrino
+{
+    namespace impl
+    {
+        namespace transport
+        {
+            namespace frame_v01
+            {
+                std::shared_ptr<consumer_stub_t> create_consumer_stub(endpoint_t& endpoint)
+                {
+                    return std::shared_ptr<consumer_stub_t>(new frame_v01_serializer_consumer_stub_impl_t(endpoint));
+                }
+
+                std::shared_ptr<endpoint_impl_t> create_endpoint_impl(consumer_t& consumer)
+                {
+                    return std::shared_ptr<endpoint_impl_t>(new frame_v01_deserializer_endpoint_impl_t(consumer));
+                }
+            }
+        }
+    }
+}
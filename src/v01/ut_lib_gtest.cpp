@@ -0,0 +1,155 @@
+#include <gtest/gtest.h>
+#include <chrono>
+#include <vector>
+#include <iostream>
+#include <neutrino_mock.hpp>
+
+#include <neutrino_transport.hpp>
+#include <neutrino_transport_buffered_st.hpp>
+
+using namespace neutrino::impl;
+
+using neutrino::mock::concat_endpoint_t;
+using neutrino::mock::counting_consumer_t;
+using neutrino::mock::counting_columns_consumer_t;
+using neutrino::mock::workload_t;
+
+TEST(neutrino_frame_v01, blocks_decode_from_one_buffer)
+{
+    const workload_t w(1000);
+    concat_endpoint_t collected;
+    auto stub = transport::frame_v00::create_consumer_stub(transport::frame_v00::known_encodings_t::COMPACT_V01, collected);
+    stub->consume_checkpoint_batch(w.m_nanoepoch.size(), w.m_nanoepoch.data(), w.m_stream_id.data(), w.m_event_id.data());
+    stub->consume_checkpoint(w.m_nanoepoch[0], w.m_stream_id[0], w.m_event_id[0]);
+    ASSERT_LT(std::size_t{ 1 }, collected.m_calls);
+
+    // a buffer of many blocks, as the buffered endpoint delivers it
+    neutrino::mock::consumer_t consumer;
+    for (std::size_t cc = 0; cc < w.m_nanoepoch.size(); cc++)
+        consumer.expect_checkpoint(w.m_nanoepoch[cc], w.m_stream_id[cc], w.m_event_id[cc]);
+    consumer.expect_checkpoint(w.m_nanoepoch[0], w.m_stream_id[0], w.m_event_id[0]);
+    auto impl = transport::frame_v00::create_endpoint_impl(transport::frame_v00::known_encodings_t::COMPACT_V01, consumer);
+    ASSERT_TRUE(impl->consume(collected.m_data.data(), collected.m_data.data() + collected.m_data.size()));
+    ASSERT_TRUE(consumer.m_expected_checkpoints.empty());
+    ASSERT_EQ(w.m_nanoepoch.size() + 1, consumer.m_actual_checkpoints.size());
+
+    // a delta frame cut from its block has no reset point
+    counting_consumer_t counting;
+    auto impl2 = transport::frame_v00::create_endpoint_impl(transport::frame_v00::known_encodings_t::COMPACT_V01, counting);
+    concat_endpoint_t one;
+    auto stub2 = transport::frame_v00::create_consumer_stub(transport::frame_v00::known_encodings_t::COMPACT_V01, one);
+    stub2->consume_checkpoint_batch(2, w.m_nanoepoch.data(), w.m_stream_id.data(), w.m_event_id.data());
+    const std::size_t first = 1 + 9 + 3 + 1; // header, 9-byte nanoepoch, 3-byte stream, 1-byte event
+    ASSERT_FALSE(impl2->consume(one.m_data.data() + first, one.m_data.data() + one.m_data.size()));
+    ASSERT_EQ(std::size_t{ 0 }, counting.m_cc);
+}
+
+TEST(neutrino_frame_v01, per_event_deltas_across_buffers)
+{
+    const workload_t w(1000);
+    neutrino::mock::consumer_t consumer;
+    auto impl = transport::frame_v00::create_endpoint_impl(transport::frame_v00::known_encodings_t::COMPACT_V01, consumer);
+    // small buffer, the chain starts over in every one of them
+    auto e = std::make_shared<transport::buffered_singlethread_endpoint_t>(impl, transport::buffered_endpoint_t::buffered_endpoint_params_t{ 256, 200 });
+    auto stub = transport::frame_v00::create_consumer_stub(transport::frame_v00::known_encodings_t::COMPACT_V01, *e);
+
+    for (std::size_t cc = 0; cc < w.m_nanoepoch.size(); cc++)
+        consumer.expect_checkpoint(w.m_nanoepoch[cc], w.m_stream_id[cc], w.m_event_id[cc]);
+    for (std::size_t cc = 0; cc < 500; cc++)
+        stub->consume_checkpoint(w.m_nanoepoch[cc], w.m_stream_id[cc], w.m_event_id[cc]);
+    // a block in between, per-event frames after it do not refer to its frames
+    stub->consume_checkpoint_batch(10, w.m_nanoepoch.data() + 500, w.m_stream_id.data() + 500, w.m_event_id.data() + 500);
+    for (std::size_t cc = 510; cc < w.m_nanoepoch.size(); cc++)
+        stub->consume_checkpoint(w.m_nanoepoch[cc], w.m_stream_id[cc], w.m_event_id[cc]);
+    uint8_t dummy[1];
+    ASSERT_TRUE(e->consume(dummy, dummy));
+
+    ASSERT_TRUE(consumer.m_expected_checkpoints.empty());
+    ASSERT_EQ(w.m_nanoepoch.size(), consumer.m_actual_checkpoints.size());
+    ASSERT_LT(uint64_t{ 10 }, e->m_deliveries.load());
+}
+
+TEST(neutrino_frame_v01, benchmark_per_event)
+{
+    const std::size_t n = 100000;
+    const workload_t w(n);
+    using clock_t = std::chrono::steady_clock;
+
+    auto run = [&](transport::frame_v00::known_encodings_t ke, const char* name, std::size_t& bytes)
+    {
+        auto collected = std::make_shared<concat_endpoint_t>();
+        transport::buffered_singlethread_endpoint_t e(collected, { 64 * 1024, 60 * 1024 });
+        auto stub = transport::frame_v00::create_consumer_stub(ke, e);
+        const auto t0 = clock_t::now();
+        for (std::size_t cc = 0; cc < n; cc++)
+            stub->consume_checkpoint(w.m_nanoepoch[cc], w.m_stream_id[cc], w.m_event_id[cc]);
+        uint8_t dummy[1];
+        EXPECT_TRUE(e.consume(dummy, dummy));
+        const auto t1 = clock_t::now();
+
+        counting_columns_consumer_t consumer;
+        auto impl = transport::frame_v00::create_endpoint_impl(ke, consumer);
+        EXPECT_TRUE(impl->consume(collected->m_data.data(), collected->m_data.data() + collected->m_data.size()));
+        EXPECT_EQ(n, consumer.m_cc);
+
+        bytes = collected->m_data.size();
+        const double enc = std::chrono::duration<double>(t1 - t0).count();
+        std::cout << "[ BENCH    ] " << name << " per event: " << double(bytes) / n << " bytes/event"
+            << ", encode " << (enc > 0 ? n / enc / 1e6 : 0) << " Mev/s" << std::endl;
+    };
+
+    std::size_t v00_bytes = 0, v01_bytes = 0;
+    run(transport::frame_v00::known_encodings_t::BINARY_NATIVE, "v00 native", v00_bytes);
+    run(transport::frame_v00::known_encodings_t::COMPACT_V01, "v01 compact", v01_bytes);
+
+    // buffers of 60k hold thousands of frames, the chain starts over rarely
+    ASSERT_LE(v01_bytes * 3, v00_bytes);
+}
+
+TEST(neutrino_frame_v01, benchmark_size_and_throughput)
+{
+    const std::size_t n = 100000;
+    const workload_t w(n);
+    using clock_t = std::chrono::steady_clock;
+
+    auto run = [&](transport::frame_v00::known_encodings_t ke, const char* name, std::size_t& bytes)
+    {
+        concat_endpoint_t collected;
+        auto stub = transport::frame_v00::create_consumer_stub(ke, collected);
+        const auto t0 = clock_t::now();
+        stub->consume_checkpoint_batch(n, w.m_nanoepoch.data(), w.m_stream_id.data(), w.m_event_id.data());
+        const auto t1 = clock_t::now();
+
+        counting_consumer_t consumer;
+        auto impl = transport::frame_v00::create_endpoint_impl(ke, consumer);
+        const auto t2 = clock_t::now();
+        EXPECT_TRUE(impl->consume(collected.m_data.data(), collected.m_data.data() + collected.m_data.size()));
+        const auto t3 = clock_t::now();
+        EXPECT_EQ(n, consumer.m_cc);
+
+        counting_columns_consumer_t columns_consumer;
+        auto columns_impl = transport::frame_v00::create_endpoint_impl(ke, columns_consumer);
+        const auto t4 = clock_t::now();
+        EXPECT_TRUE(columns_impl->consume(collected.m_data.data(), collected.m_data.data() + collected.m_data.size()));
+        const auto t5 = clock_t::now();
+        EXPECT_EQ(n, columns_consumer.m_cc);
+        EXPECT_EQ(consumer.m_sum, columns_consumer.m_sum);
+
+        bytes = collected.m_data.size();
+        const double enc = std::chrono::duration<double>(t1 - t0).count();
+        const double dec = std::chrono::duration<double>(t3 - t2).count();
+        const double col = std::chrono::duration<double>(t5 - t4).count();
+        std::cout << "[ BENCH    ] " << name << ": " << double(bytes) / n << " bytes/event"
+            << ", encode " << (enc > 0 ? n / enc / 1e6 : 0) << " Mev/s"
+            << ", decode " << (dec > 0 ? n / dec / 1e6 : 0) << " Mev/s"
+            << ", decode to columns " << (col > 0 ? n / col / 1e6 : 0) << " Mev/s" << std::endl;
+    };
+
+    std::size_t v00_bytes = 0, v01_bytes = 0;
+    run(transport::frame_v00::known_encodings_t::BINARY_NATIVE, "v00 native", v00_bytes);
+    run(transport::frame_v00::known_encodings_t::BINARY_NETWORK, "v00 network", v00_bytes);
+    run(transport::frame_v00::known_encodings_t::COMPACT_V01, "v01 compact", v01_bytes);
+
+    // 26 bytes per v00 checkpoint against ~7 for v01 deltas with a stream switch on every frame
+    ASSERT_LE(v01_bytes * 3, v00_bytes);
+}